@@ -0,0 +1,412 @@
+#include "compact.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+#include "db.h"
+#include "frozen.h"
+#include "lazyset.h"
+#include "liststore.h"
+#include "refcount.h"
+#include "spooky.h"
+
+// Containers that were found, but haven't been given their new id yet.
+static const uint32_t COMPACT_UNNUMBERED = std::numeric_limits<uint32_t>::max();
+
+static bool OOCCompact_isContainer(const OOCGCTable table) {
+    return table == OOCGC_LISTS || table == OOCGC_DICTS || table == OOCGC_SETS;
+}
+
+OOCCompactor::OOCCompactor(OOCMapObject* const source, OOCTransaction& txn) : m_source(source), m_txn(txn) { }
+
+// Remembers a value that was found while walking the map. Returns true if it wasn't seen before, and
+// has children that still need to be walked.
+bool OOCCompactor::see(const EncodedValue& value) {
+    OOCGCTable table;
+    uint64_t id;
+    if(!OOCGC_record(value, &table, &id)) return false;
+    if(OOCCompact_isContainer(table))
+        return m_newIds[table].emplace(id, COMPACT_UNNUMBERED).second;
+    return m_marks[table].insert(id) && table == OOCGC_TUPLES;
+}
+
+void OOCCompactor::plan() {
+    // None of this touches Python objects, so other threads can run while we walk the map.
+    GilUnlocker gil;
+
+    std::vector<EncodedValue> stack;
+    std::vector<EncodedValue> children;
+    MDB_val mdbKey;
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(m_txn.txn, m_source->rootDb);
+    try {
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_FIRST);
+        while(found) {
+            if(mdbKey.mv_size != sizeof(EncodedValue) || mdbValue.mv_size != sizeof(EncodedValue))
+                throw OocError(OocError::UnexpectedData);
+            EncodedValue entry[2];
+            memcpy(&entry[0], mdbKey.mv_data, sizeof(EncodedValue));
+            memcpy(&entry[1], mdbValue.mv_data, sizeof(EncodedValue));
+            if(see(entry[1]))
+                stack.push_back(entry[1]);
+            if(see(entry[0]))
+                stack.push_back(entry[0]);
+
+            // Containers are numbered when they come off the stack, and their children go onto it
+            // in reverse, so everything under the first child is numbered before the second child.
+            while(!stack.empty()) {
+                const EncodedValue value = stack.back();
+                stack.pop_back();
+                OOCGCTable table;
+                uint64_t id;
+                OOCGC_record(value, &table, &id);
+                if(OOCCompact_isContainer(table)) {
+                    m_newIds[table][id] = static_cast<uint32_t>(m_order[table].size());
+                    m_order[table].push_back(id);
+                }
+
+                children.clear();
+                OOCGC_children(m_source, m_txn, value, children);
+                for(auto child = children.rbegin(); child != children.rend(); ++child) {
+                    if(see(*child))
+                        stack.push_back(*child);
+                }
+            }
+
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+}
+
+uint32_t OOCCompactor::newId(const OOCGCTable table, const uint64_t oldId) const {
+    const auto found = m_newIds[table].find(oldId);
+    if(found == m_newIds[table].end() || found->second == COMPACT_UNNUMBERED)
+        throw OocError(OocError::UnexpectedData);
+    return found->second;
+}
+
+EncodedValue OOCCompactor::remap(const EncodedValue& value) {
+    OOCGCTable table;
+    uint64_t id;
+    if(!OOCGC_record(value, &table, &id)) return value;
+
+    EncodedValue result = value;
+    switch(table) {
+    case OOCGC_LISTS:
+        result.asListKey.listId = newId(table, id);
+        break;
+    case OOCGC_DICTS:
+        result.asDictKey.dictId = OOCMap_bytewiseId(newId(table, id));
+        break;
+    case OOCGC_SETS:
+        result.asSetKey.setId = OOCMap_bytewiseId(newId(table, id));
+        break;
+    case OOCGC_TUPLES:
+        result.asUInt = remapTuple(value);
+        break;
+    default:
+        break;
+    }
+    return result;
+}
+
+// Returns the new key of a tuple or a frozenset. If its content changes, this keeps the new content
+// for writeTuples().
+uint64_t OOCCompactor::remapTuple(const EncodedValue& value) {
+    const auto found = m_tupleKeys.find(value.asUInt);
+    if(found != m_tupleKeys.end()) return found->second;
+
+    std::vector<EncodedValue> items;
+    OOCGC_children(m_source, m_txn, value, items);
+    bool changed = false;
+    for(EncodedValue& item : items) {
+        const EncodedValue remapped = remap(item);
+        changed = changed || remapped != item;
+        item = remapped;
+    }
+
+    uint64_t key = value.asUInt;
+    if(changed) {
+        // This has to come out the same as in OOCMap_encode().
+        if(value.typeCode == TYPE_CODE_FROZENSET)
+            std::sort(items.begin(), items.end(), OOCLazySet_memberLess);
+        else if(value.typeCode == TYPE_CODE_FROZENDICT)
+            OOCFrozen_sortItems(items);
+        key = SpookyHash::hash64(items.data(), items.size() * sizeof(EncodedValue), value.typeCode);
+        m_changedTuples.push_back({ .key = key, .offset = m_changedTupleItems.size(), .size = items.size() });
+        m_changedTupleItems.insert(m_changedTupleItems.end(), items.begin(), items.end());
+    }
+    m_tupleKeys.emplace(value.asUInt, key);
+
+    // Tuples with the same new content are written once, so their elements are counted once.
+    if(m_counts[OOCGC_TUPLES].emplace(key, 0).second) {
+        for(const EncodedValue& item : items)
+            count(item);
+    }
+    return key;
+}
+
+// Counts one reference to a value in the copy. `value` has to be remapped already.
+void OOCCompactor::count(const EncodedValue& value) {
+    OOCGCTable table;
+    uint64_t id;
+    if(!OOCGC_record(value, &table, &id) || OOCCompact_isContainer(table)) return;
+    m_counts[table][id] += 1;
+}
+
+void OOCCompactor::write(OOCMapObject* const target, OOCTransaction& targetTxn) {
+    GilUnlocker gil;
+
+    const MDB_dbi targetDbis[] = {
+        target->rootDb, target->intsDb, target->stringsDb, target->listsDb, target->tuplesDb,
+        target->dictsDb, target->blobsDb, target->setsDb, target->metaDb, target->refcountsDb
+    };
+    for(const MDB_dbi dbi : targetDbis) {
+        MDB_stat stat;
+        const int error = mdb_stat(targetTxn.txn, dbi, &stat);
+        if(error != 0) throw MdbError(error);
+        if(stat.ms_entries != 0) throw OocError(OocError::CompactTargetNotEmpty);
+    }
+
+    // Tuples are remapped while the containers are written, and written after them.
+    m_tupleKeys.clear();
+    m_changedTuples.clear();
+    m_changedTupleItems.clear();
+    for(auto& counts : m_counts)
+        counts.clear();
+
+    writeRoot(target, targetTxn);
+    writeLists(target, targetTxn);
+    writeItems(target, targetTxn, OOCGC_DICTS);
+    writeItems(target, targetTxn, OOCGC_SETS);
+    writeTuples(target, targetTxn);
+    writeMarked(target, targetTxn, OOCGC_INTS);
+    writeMarked(target, targetTxn, OOCGC_STRINGS);
+    writeMarked(target, targetTxn, OOCGC_BLOBS);
+    writeCounters(target, targetTxn);
+    writeRefcounts(target, targetTxn);
+}
+
+void OOCCompactor::writeRoot(OOCMapObject* const target, OOCTransaction& targetTxn) {
+    MDB_val mdbKey;
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(m_txn.txn, m_source->rootDb);
+    try {
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_FIRST);
+        while(found) {
+            if(mdbKey.mv_size != sizeof(EncodedValue) || mdbValue.mv_size != sizeof(EncodedValue))
+                throw OocError(OocError::UnexpectedData);
+            EncodedValue entry[2];
+            memcpy(&entry[0], mdbKey.mv_data, sizeof(EncodedValue));
+            memcpy(&entry[1], mdbValue.mv_data, sizeof(EncodedValue));
+            // Keys are immutable, so they don't hold containers, and they keep their order.
+            entry[0] = remap(entry[0]);
+            entry[1] = remap(entry[1]);
+            count(entry[0]);
+            count(entry[1]);
+            MDB_val targetKey = { .mv_size = sizeof(EncodedValue), .mv_data = &entry[0] };
+            MDB_val targetValue = { .mv_size = sizeof(EncodedValue), .mv_data = &entry[1] };
+            put(targetTxn.txn, target->rootDb, &targetKey, &targetValue, MDB_APPEND);
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+}
+
+void OOCCompactor::writeLists(OOCMapObject* const target, OOCTransaction& targetTxn) {
+    std::vector<EncodedValue> items;
+    const std::vector<uint64_t>& order = m_order[OOCGC_LISTS];
+    for(uint32_t id = 0; id < order.size(); ++id) {
+        const uint32_t oldId = static_cast<uint32_t>(order[id]);
+        const ListHeader header = OOCListStore_header(m_source, m_txn, oldId);
+        if(ListHeader_isPacked(header)) {
+            // Packed lists hold only numbers, and live entirely in their header record.
+            ListKey listKey = { .listIndex = ListKey::listIndexLength, .listId = oldId };
+            MDB_val mdbKey = { .mv_size = sizeof(listKey), .mv_data = &listKey };
+            MDB_val mdbValue;
+            if(!get(m_txn.txn, m_source->listsDb, &mdbKey, &mdbValue)) throw OocError(OocError::UnexpectedData);
+            listKey.listId = id;
+            put(targetTxn.txn, target->listsDb, &mdbKey, &mdbValue, MDB_APPEND);
+        } else {
+            // This also turns lists that are stored in rows into blocks.
+            items.clear();
+            OOCListStore_read(m_source, m_txn, oldId, header, 0, header.length, items);
+            for(EncodedValue& item : items) {
+                item = remap(item);
+                count(item);
+            }
+            OOCListStore_create(target, targetTxn, id, items, MDB_APPEND);
+        }
+    }
+}
+
+STATIC_ASSERT(sizeof(DictItemKey) == sizeof(SetItemKey));
+STATIC_ASSERT(offsetof(DictItemKey, key) == offsetof(SetItemKey, member));
+
+// Writes the dicts or the sets. Both have a header under their id, and their items under keys that
+// start with it.
+void OOCCompactor::writeItems(OOCMapObject* const target, OOCTransaction& targetTxn, const OOCGCTable table) {
+    const MDB_dbi targetDbi = OOCGC_dbi(target, table);
+    const std::vector<uint64_t>& order = m_order[table];
+    MDB_val mdbKey;
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(m_txn.txn, OOCGC_dbi(m_source, table));
+    try {
+        for(uint32_t id = 0; id < order.size(); ++id) {
+            const uint32_t oldId = static_cast<uint32_t>(order[id]);
+            DictItemKey targetItemKey = { .dictId = OOCMap_bytewiseId(id) };
+            mdbKey = (MDB_val) { .mv_size = sizeof(oldId), .mv_data = const_cast<uint32_t*>(&oldId) };
+            bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_RANGE);
+            while(found && mdbKey.mv_size >= sizeof(oldId) && memcmp(mdbKey.mv_data, &oldId, sizeof(oldId)) == 0) {
+                MDB_val targetKey = { .mv_size = sizeof(targetItemKey.dictId), .mv_data = &targetItemKey };
+                MDB_val targetValue = mdbValue;
+                EncodedValue value;
+                if(mdbKey.mv_size == sizeof(DictItemKey)) {
+                    // Dict keys and set members are immutable, so they keep their order.
+                    memcpy(
+                        &targetItemKey.key,
+                        static_cast<const char*>(mdbKey.mv_data) + offsetof(DictItemKey, key),
+                        sizeof(targetItemKey.key));
+                    targetItemKey.key = remap(targetItemKey.key);
+                    count(targetItemKey.key);
+                    targetKey.mv_size = sizeof(targetItemKey);
+                    if(table == OOCGC_DICTS) {
+                        if(mdbValue.mv_size != sizeof(value)) throw OocError(OocError::UnexpectedData);
+                        memcpy(&value, mdbValue.mv_data, sizeof(value));
+                        value = remap(value);
+                        count(value);
+                        targetValue = (MDB_val) { .mv_size = sizeof(value), .mv_data = &value };
+                    }
+                } else if(mdbKey.mv_size != sizeof(oldId)) {
+                    throw OocError(OocError::UnexpectedData);
+                }
+                put(targetTxn.txn, targetDbi, &targetKey, &targetValue, MDB_APPEND);
+                found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+            }
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+}
+
+// Writes the tuples and frozensets that kept their key straight from the source, and merges in the
+// ones with a new key, so they all go in in key order.
+void OOCCompactor::writeTuples(OOCMapObject* const target, OOCTransaction& targetTxn) {
+    std::sort(
+        m_changedTuples.begin(),
+        m_changedTuples.end(),
+        [](const ChangedTuple& a, const ChangedTuple& b) { return a.key < b.key; });
+    size_t changed = 0;
+    bool written = false;
+    uint64_t lastKey = 0;
+    const auto putTuple = [&](uint64_t key, MDB_val* const mdbValue) {
+        // Two tuples only end up with the same key if they have the same content.
+        if(written && key == lastKey) return;
+        MDB_val targetKey = { .mv_size = sizeof(key), .mv_data = &key };
+        put(targetTxn.txn, target->tuplesDb, &targetKey, mdbValue, MDB_APPEND);
+        written = true;
+        lastKey = key;
+    };
+    const auto putChangedUntil = [&](const uint64_t key) {
+        while(changed < m_changedTuples.size() && m_changedTuples[changed].key <= key) {
+            const ChangedTuple& tuple = m_changedTuples[changed];
+            MDB_val mdbValue = {
+                .mv_size = tuple.size * sizeof(EncodedValue),
+                .mv_data = m_changedTupleItems.data() + tuple.offset
+            };
+            putTuple(tuple.key, &mdbValue);
+            changed += 1;
+        }
+    };
+
+    MDB_val mdbKey;
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(m_txn.txn, m_source->tuplesDb);
+    try {
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_FIRST);
+        while(found) {
+            uint64_t key;
+            if(mdbKey.mv_size != sizeof(key)) throw OocError(OocError::UnexpectedData);
+            memcpy(&key, mdbKey.mv_data, sizeof(key));
+            const auto remapped = m_tupleKeys.find(key);
+            if(m_marks[OOCGC_TUPLES].contains(key) && (remapped == m_tupleKeys.end() || remapped->second == key)) {
+                putChangedUntil(key);
+                putTuple(key, &mdbValue);
+            }
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+    putChangedUntil(std::numeric_limits<uint64_t>::max());
+}
+
+// Copies the marked records of a table that is keyed by content, in key order.
+void OOCCompactor::writeMarked(OOCMapObject* const target, OOCTransaction& targetTxn, const OOCGCTable table) {
+    const MDB_dbi targetDbi = OOCGC_dbi(target, table);
+    MDB_val mdbKey;
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(m_txn.txn, OOCGC_dbi(m_source, table));
+    try {
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_FIRST);
+        while(found) {
+            uint64_t key;
+            if(mdbKey.mv_size != sizeof(key)) throw OocError(OocError::UnexpectedData);
+            memcpy(&key, mdbKey.mv_data, sizeof(key));
+            if(m_marks[table].contains(key))
+                put(targetTxn.txn, targetDbi, &mdbKey, &mdbValue, MDB_APPEND);
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+}
+
+// Sets the counters that OOCMap_nextId() hands out ids from, so new containers in the copy are
+// numbered after the ones that are there.
+void OOCCompactor::writeCounters(OOCMapObject* const target, OOCTransaction& targetTxn) {
+    const std::pair<const char*, OOCGCTable> counters[] = {
+        { "nextDictId", OOCGC_DICTS },
+        { "nextListId", OOCGC_LISTS },
+        { "nextSetId", OOCGC_SETS },
+    };
+    for(const auto& counter : counters) {
+        uint32_t next = static_cast<uint32_t>(m_order[counter.second].size());
+        MDB_val mdbKey = { .mv_size = strlen(counter.first), .mv_data = const_cast<char*>(counter.first) };
+        MDB_val mdbValue = { .mv_size = sizeof(next), .mv_data = &next };
+        put(targetTxn.txn, target->metaDb, &mdbKey, &mdbValue);
+    }
+}
+
+// Writes the counts, sorted the way the refcounts table compares its keys.
+void OOCCompactor::writeRefcounts(OOCMapObject* const target, OOCTransaction& targetTxn) {
+    std::vector<RefcountKey> keys;
+    for(int table = 0; table < OOCGC_TABLE_COUNT; ++table) {
+        for(const auto& counted : m_counts[table])
+            keys.push_back({ .table = static_cast<uint8_t>(table), .id = counted.first });
+    }
+    std::sort(keys.begin(), keys.end(), [](const RefcountKey& a, const RefcountKey& b) {
+        return memcmp(&a, &b, sizeof(RefcountKey)) < 0;
+    });
+    for(RefcountKey& key : keys) {
+        uint64_t count = m_counts[key.table][key.id];
+        MDB_val mdbKey = { .mv_size = sizeof(key), .mv_data = &key };
+        MDB_val mdbValue = { .mv_size = sizeof(count), .mv_data = &count };
+        put(targetTxn.txn, target->refcountsDb, &mdbKey, &mdbValue, MDB_APPEND);
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef OOCMAP_COMPACT_H
+#define OOCMAP_COMPACT_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "oocmap.h"
+#include "gc.h"
+
+//
+// OOCCompactor
+//
+// Copies everything that can be reached from the root table into another map, and leaves the
+// garbage behind. mdb_env_copy2() with MDB_CP_COMPACT only leaves out free pages, and keeps records
+// that nothing refers to anymore.
+//
+// The copy numbers the lists, the dicts, and the sets from 0. The numbers are given out in the order
+// that a depth-first walk finds the containers, with the walk going through the root table in key
+// order. The containers of one root entry get numbers next to each other. Then every table is
+// written in key order with MDB_APPEND, one table after the other. This fills every page and
+// leaves each table in one piece of the file, so a scan of the root table reads mostly
+// sequentially.
+//
+// Immutable values are keyed by a hash of their content, so they keep their keys. The exception is
+// a tuple that holds a container, because its content changes with the container's new id.
+//
+// The copy gets exact reference counts (see refcount.h), including for records that an older version
+// wrote without one.
+//
+
+class OOCCompactor {
+public:
+    // `txn` is a transaction on `source`. It has to stay open until write() is done.
+    OOCCompactor(OOCMapObject* source, OOCTransaction& txn);
+    OOCCompactor(const OOCCompactor&) = delete;
+    OOCCompactor& operator=(const OOCCompactor&) = delete;
+
+    // Walks everything that can be reached from the root table, and hands out the new ids. Throws
+    // OocError.
+    void plan();
+
+    // Writes the copy into `target`, which has to be empty. This can run again after the
+    // transaction on the target was aborted, so it works with OOCMapObject_growingWrite(). Throws
+    // OocError.
+    void write(OOCMapObject* target, OOCTransaction& targetTxn);
+
+private:
+    bool see(const EncodedValue& value);
+    uint32_t newId(OOCGCTable table, uint64_t oldId) const;
+    EncodedValue remap(const EncodedValue& value);
+    uint64_t remapTuple(const EncodedValue& value);
+    void count(const EncodedValue& value);
+
+    void writeRoot(OOCMapObject* target, OOCTransaction& targetTxn);
+    void writeLists(OOCMapObject* target, OOCTransaction& targetTxn);
+    void writeItems(OOCMapObject* target, OOCTransaction& targetTxn, OOCGCTable table);
+    void writeTuples(OOCMapObject* target, OOCTransaction& targetTxn);
+    void writeMarked(OOCMapObject* target, OOCTransaction& targetTxn, OOCGCTable table);
+    void writeCounters(OOCMapObject* target, OOCTransaction& targetTxn);
+    void writeRefcounts(OOCMapObject* target, OOCTransaction& targetTxn);
+
+    OOCMapObject* const m_source;
+    OOCTransaction& m_txn;
+
+    // Both of these are indexed by OOCGCTable, and only used for lists, dicts, and sets: the old
+    // ids in the order of the new ones, and the new id for each old one.
+    std::vector<uint64_t> m_order[OOCGC_TABLE_COUNT];
+    std::unordered_map<uint64_t, uint32_t> m_newIds[OOCGC_TABLE_COUNT];
+    // The reachable records of everything else.
+    OOCGCMarks m_marks[OOCGC_TABLE_COUNT];
+
+    // The new key of every tuple and frozenset that was written so far, by the old key.
+    std::unordered_map<uint64_t, uint64_t> m_tupleKeys;
+    // The ones whose key changed, with their new content in m_changedTupleItems.
+    struct ChangedTuple {
+        uint64_t key;
+        size_t offset;
+        size_t size;
+    };
+    std::vector<ChangedTuple> m_changedTuples;
+    std::vector<EncodedValue> m_changedTupleItems;
+
+    // The references to every record in the copy that has a count, by its new key, indexed by
+    // OOCGCTable.
+    std::unordered_map<uint64_t, uint64_t> m_counts[OOCGC_TABLE_COUNT];
+};
+
+#endif //OOCMAP_COMPACT_H
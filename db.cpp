@@ -3,25 +3,14 @@
 #include "spooky.h"
 #include "errors.h"
 
-class GilUnlocker {
-    PyThreadState* const m_threadState;
-
-public:
-    GilUnlocker() : m_threadState(PyGILState_Check() ? PyEval_SaveThread() : nullptr) { }
-    ~GilUnlocker() {
-        if(m_threadState != nullptr)
-            PyEval_RestoreThread(m_threadState);
-    }
-};
-
-MDB_txn* txn_begin(MDB_env* const mdb, const bool write) {
+MDB_txn* txn_begin(MDB_env* const mdb, const bool write, MDB_txn* const parent) {
     GilUnlocker gil;
 
     const unsigned int flags = write ? 0 : MDB_RDONLY;
     MDB_txn* txn = nullptr;
     int mapsizePatience = 10;
     while(true) {
-        int error = mdb_txn_begin(mdb, nullptr, flags, &txn);
+        int error = mdb_txn_begin(mdb, parent, flags, &txn);
         switch(error) {
         case 0:
             return txn;
@@ -55,6 +44,18 @@ void txn_abort(MDB_txn* const txn) {
     mdb_txn_abort(txn); // This doesn't return any errors.
 }
 
+void txn_reset(MDB_txn* const txn) {
+    GilUnlocker gil;
+    mdb_txn_reset(txn); // This doesn't return any errors either.
+}
+
+bool txn_renew(MDB_txn* const txn) {
+    // If this fails, for example because the map was resized, the caller should abort the
+    // transaction and start a new one with txn_begin(), which knows how to deal with that.
+    GilUnlocker gil;
+    return mdb_txn_renew(txn) == 0;
+}
+
 void open_db(MDB_txn* const txn, const char* const name, unsigned int flags, MDB_dbi* const dbi) {
     GilUnlocker gil;
     const int error = mdb_dbi_open(txn, name, flags | MDB_CREATE, dbi);
@@ -98,7 +99,8 @@ uint64_t putImmutable(
     const MDB_dbi dbi,
     MDB_val* const mdbVal,
     const unsigned char typeCode,
-    const bool readonly
+    const bool readonly,
+    bool* const created
 ) {
     GilUnlocker gil;
     uint64_t key = SpookyHash::hash64(
@@ -121,7 +123,18 @@ uint64_t putImmutable(
             throw MdbError(error);
         }
     } else {
-        put(txn, dbi, &mdbKey, mdbVal);
+        // Records with the same key have the same content, so there is no need to write it again.
+        const int error = mdb_put(txn, dbi, &mdbKey, mdbVal, MDB_NOOVERWRITE);
+        switch(error) {
+        case 0:
+            if(created != nullptr) *created = true;
+            break;
+        case MDB_KEYEXIST:
+            if(created != nullptr) *created = false;
+            break;
+        default:
+            throw MdbError(error);
+        }
     }
 
     return key;
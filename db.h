@@ -2,11 +2,31 @@
 #define OOCMAP_DB_H
 
 #include <cstdint>
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
 #include "lmdb.h"
 
-MDB_txn* txn_begin(MDB_env* mdb, bool write);
+// Releases the GIL for as long as it is in scope. All the functions in this file use one, but
+// it does nothing when the GIL is already released, so loops that make many cheap LMDB calls
+// in a row can hold one around the whole loop instead of releasing and re-acquiring the GIL for
+// every call. Nothing inside that scope may touch Python objects.
+class GilUnlocker {
+    PyThreadState* const m_threadState;
+
+public:
+    GilUnlocker() : m_threadState(PyGILState_Check() ? PyEval_SaveThread() : nullptr) { }
+    ~GilUnlocker() {
+        if(m_threadState != nullptr)
+            PyEval_RestoreThread(m_threadState);
+    }
+};
+
+MDB_txn* txn_begin(MDB_env* mdb, bool write, MDB_txn* parent = nullptr);
 void txn_commit(MDB_txn* txn);
 void txn_abort(MDB_txn* txn);
+void txn_reset(MDB_txn* txn);
+bool txn_renew(MDB_txn* txn);
 void open_db(MDB_txn* txn, const char* name, unsigned int flags, MDB_dbi* dbi);
 
 void put(
@@ -29,7 +49,8 @@ uint64_t putImmutable(
     MDB_dbi dbi,
     MDB_val* mdbVal,
     unsigned char typeCode,
-    bool readonly = false
+    bool readonly = false,
+    bool* created = nullptr     // set to whether the record is new
 );
 
 void del(MDB_txn* txn, MDB_dbi dbi, MDB_val* key);
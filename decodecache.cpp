@@ -0,0 +1,62 @@
+#include "decodecache.h"
+
+OOCDecodeCache::OOCDecodeCache(const size_t capacity) :
+    capacity(capacity),
+    hits(0),
+    misses(0)
+{
+    m_index.reserve(capacity);
+}
+
+OOCDecodeCache::~OOCDecodeCache() {
+    clear();
+}
+
+PyObject* OOCDecodeCache::get(const EncodedValue& key) {
+    const auto found = m_index.find(key);
+    if(found == m_index.end()) {
+        misses += 1;
+        return nullptr;
+    }
+    hits += 1;
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    PyObject* const result = found->second->second;
+    Py_INCREF(result);
+    return result;
+}
+
+void OOCDecodeCache::put(const EncodedValue& key, PyObject* const value) {
+    if(capacity == 0 || m_index.count(key) > 0) return;
+    if(m_index.size() >= capacity) {
+        const auto& oldest = m_entries.back();
+        m_index.erase(oldest.first);
+        Py_DECREF(oldest.second);
+        m_entries.pop_back();
+    }
+    Py_INCREF(value);
+    m_entries.emplace_front(key, value);
+    m_index.emplace(key, m_entries.begin());
+}
+
+void OOCDecodeCache::clear() {
+    // Decrefs can run arbitrary code, so the cache has to be consistent before we do them.
+    Entries entries;
+    entries.swap(m_entries);
+    m_index.clear();
+    for(const auto& entry : entries)
+        Py_DECREF(entry.second);
+}
+
+PyObject* OOCInternedKeys::get(const EncodedValue& key) {
+    return m_strings.get(key);
+}
+
+void OOCInternedKeys::put(const EncodedValue& key, PyObject** const value) {
+    if(PyUnicode_GET_LENGTH(*value) > maxLength) return;
+    PyUnicode_InternInPlace(value);
+    m_strings.put(key, *value);
+}
+
+void OOCInternedKeys::clear() {
+    m_strings.clear();
+}
@@ -0,0 +1,60 @@
+#ifndef OOCMAP_DECODECACHE_H
+#define OOCMAP_DECODECACHE_H
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "oocmap.h"
+
+// Keeps the most recently decoded long strings, long ints, and long bytes of a map, so values that
+// appear over and over don't get copied out of LMDB into a new Python object every time. These
+// values are stored under a hash of their content, so an EncodedValue always means the same value,
+// except after an aborted write, which is why aborts clear the cache. Only used with the GIL held.
+struct OOCDecodeCache {
+    explicit OOCDecodeCache(size_t capacity);
+    ~OOCDecodeCache();
+
+    // Returns a new reference to the cached object, or nullptr if there is none.
+    PyObject* get(const EncodedValue& key);
+    // Remembers an object. This does not steal the reference.
+    void put(const EncodedValue& key, PyObject* value);
+    void clear();
+
+    const size_t capacity;
+    uint64_t hits;
+    uint64_t misses;
+    size_t size() const { return m_index.size(); }
+
+private:
+    // most recently used first
+    typedef std::list<std::pair<EncodedValue, PyObject*>> Entries;
+    Entries m_entries;
+    std::unordered_map<EncodedValue, Entries::iterator> m_index;
+};
+
+// With `intern_keys=True`, the strings that come out of dict keys are interned, and this table
+// remembers them, so every dict that uses the same key shares one object with its hash already
+// computed. It is meant for the small set of keys that a map's records have in common, so it only
+// takes short keys, and forgets the least recently used ones beyond `capacity`. A map whose dicts
+// use their keys as data would otherwise end up holding all of them.
+struct OOCInternedKeys {
+    static const size_t capacity = 1024;
+    static const Py_ssize_t maxLength = 32;
+
+    // Returns a new reference to the interned string, or nullptr if there is none.
+    PyObject* get(const EncodedValue& key);
+    // Interns the string if it is short enough, and replaces *value with the interned one.
+    void put(const EncodedValue& key, PyObject** value);
+    void clear();
+
+    size_t size() const { return m_strings.size(); }
+
+private:
+    OOCDecodeCache m_strings{capacity};
+};
+
+#endif //OOCMAP_DECODECACHE_H
@@ -0,0 +1,82 @@
+#include "durability.h"
+
+#include <chrono>
+
+#include "db.h"
+#include "errors.h"
+
+OOCSyncer::OOCSyncer(MDB_env* const mdb, const Durability durability, const double interval) :
+    mdb(mdb),
+    durability(durability),
+    interval(interval),
+    m_stats({0, 0, 0.0, 0.0, 0.0}),
+    m_stopping(false)
+{
+    if(durability != Durability::Periodic) return;
+
+    m_thread = std::thread([this]() {
+        const auto wait = std::chrono::duration<double>(this->interval);
+        std::unique_lock<std::mutex> stopLock(m_stopMutex);
+        while(!m_stopCondition.wait_for(stopLock, wait, [this]() { return m_stopping; })) {
+            // This thread never touches Python, so errors can only be counted.
+            std::lock_guard<std::mutex> syncLock(syncMutex);
+            syncLocked();
+        }
+    });
+}
+
+OOCSyncer::~OOCSyncer() {
+    if(m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> stopLock(m_stopMutex);
+            m_stopping = true;
+        }
+        m_stopCondition.notify_all();
+        m_thread.join();
+    }
+
+    // Whatever the mode, we don't lose data that's already committed when the map is closed.
+    if(durability != Durability::None) {
+        std::lock_guard<std::mutex> syncLock(syncMutex);
+        syncLocked();
+    }
+}
+
+int OOCSyncer::syncLocked() {
+    const auto start = std::chrono::steady_clock::now();
+    const int error = mdb_env_sync(mdb, 1);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if(error != 0) {
+        m_stats.errors += 1;
+    } else {
+        m_stats.syncs += 1;
+        m_stats.totalSeconds += seconds;
+        m_stats.lastSeconds = seconds;
+        if(seconds > m_stats.maxSeconds)
+            m_stats.maxSeconds = seconds;
+    }
+    return error;
+}
+
+void OOCSyncer::sync() {
+    int error;
+    {
+        GilUnlocker gil;
+        std::lock_guard<std::mutex> syncLock(syncMutex);
+        error = syncLocked();
+    }
+    if(error != 0)
+        throw MdbError(error);
+}
+
+void OOCSyncer::afterCommit() {
+    if(durability == Durability::Commit)
+        sync();
+}
+
+OOCSyncer::Stats OOCSyncer::stats() {
+    GilUnlocker gil;
+    std::lock_guard<std::mutex> syncLock(syncMutex);
+    return m_stats;
+}
@@ -0,0 +1,56 @@
+#ifndef OOCMAP_DURABILITY_H
+#define OOCMAP_DURABILITY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "lmdb.h"
+
+// How hard an OOCMap tries to get written data onto the disk. The map is always opened with
+// MDB_NOSYNC, and the syncing is done by OOCSyncer instead, so it can be timed the same way in
+// every mode.
+enum class Durability {
+    None,       // never sync explicitly, leave it to the OS
+    Periodic,   // sync from a background thread every few seconds
+    Commit      // sync after every top-level write transaction commits
+};
+
+struct OOCSyncer {
+    MDB_env* const mdb;
+    const Durability durability;
+    const double interval;
+
+    explicit OOCSyncer(MDB_env* mdb, Durability durability, double interval);
+    ~OOCSyncer();
+
+    // Flushes everything to disk. Throws MdbError.
+    void sync();
+    // Called after a top-level write transaction has committed.
+    void afterCommit();
+
+    struct Stats {
+        uint64_t syncs;
+        uint64_t errors;
+        double totalSeconds;
+        double maxSeconds;
+        double lastSeconds;
+    };
+    Stats stats();
+
+    // Held while syncing. Anything that remaps the file has to hold it too.
+    std::mutex syncMutex;
+
+private:
+    int syncLocked();
+
+    Stats m_stats;
+
+    std::thread m_thread;
+    std::mutex m_stopMutex;
+    std::condition_variable m_stopCondition;
+    bool m_stopping;
+};
+
+#endif //OOCMAP_DURABILITY_H
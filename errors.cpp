@@ -45,6 +45,30 @@ void OocError::pythonize() const {
     case WriteNotAllowed:
         PyErr_Format(PyExc_ValueError, "Not allowed to write now");
         break;
+    case ReadonlyTransaction:
+        PyErr_Format(PyExc_ValueError, "Cannot write inside a read-only transaction");
+        break;
+    case TransactionEnded:
+        PyErr_Format(PyExc_RuntimeError, "The transaction has already ended, or is waiting for a savepoint to end");
+        break;
+    case WriterClosed:
+        PyErr_Format(PyExc_RuntimeError, "The writer has already been closed");
+        break;
+    case WriterBlocked:
+        PyErr_Format(PyExc_RuntimeError, "Cannot wait for the writer while this thread has a write transaction open on the map");
+        break;
+    case CollectInTransaction:
+        PyErr_Format(PyExc_RuntimeError, "Cannot collect garbage while this thread has a transaction open on the map");
+        break;
+    case CompactTargetNotEmpty:
+        PyErr_Format(PyExc_ValueError, "Can only compact into a map that is empty");
+        break;
+    case LazyTupleGone:
+        PyErr_Format(PyExc_ValueError, "This tuple is no longer stored in the map");
+        break;
+    case ContainerGone:
+        PyErr_Format(PyExc_ReferenceError, "container was garbage collected");
+        break;
     }
 }
 
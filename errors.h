@@ -20,7 +20,15 @@ struct OocError : std::exception {
         IndexError,
         MdbError,
         MutableValueNotAllowed,
-        WriteNotAllowed
+        WriteNotAllowed,
+        ReadonlyTransaction,
+        TransactionEnded,
+        WriterClosed,
+        WriterBlocked,
+        CollectInTransaction,
+        CompactTargetNotEmpty,
+        LazyTupleGone,
+        ContainerGone
     } errorCode;
 
     explicit OocError(const ErrorCode errorCode) : errorCode(errorCode) { }
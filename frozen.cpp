@@ -0,0 +1,123 @@
+#include "frozen.h"
+
+#include <algorithm>
+
+#include "errors.h"
+#include "lazydict.h"
+#include "lazylist.h"
+#include "lazyset.h"
+
+// Returns the frozen copy of every item in a list or a tuple, as a new tuple. If `value` is a tuple
+// and none of the items change, returns a new reference to `value` itself.
+static PyObject* OOCFrozen_copySequence(PyObject* const value) {
+    const bool isTuple = PyTuple_CheckExact(value);
+    const Py_ssize_t size = isTuple ? PyTuple_GET_SIZE(value) : PyList_GET_SIZE(value);
+    PyObject* const result = PyTuple_New(size);
+    if(result == nullptr) throw OocError(OocError::OutOfMemory);
+    bool changed = !isTuple;
+    try {
+        for(Py_ssize_t i = 0; i < size; ++i) {
+            PyObject* const item = isTuple ? PyTuple_GET_ITEM(value, i) : PyList_GET_ITEM(value, i);
+            PyObject* const frozen = OOCFrozen_copy(item);
+            changed = changed || frozen != item;
+            PyTuple_SET_ITEM(result, i, frozen);
+        }
+    } catch(...) {
+        Py_DECREF(result);
+        throw;
+    }
+    if(changed) return result;
+    Py_DECREF(result);
+    Py_INCREF(value);
+    return value;
+}
+
+static PyObject* OOCFrozen_copyDict(PyObject* const value) {
+    PyObject* const dict = PyDict_New();
+    if(dict == nullptr) throw OocError(OocError::OutOfMemory);
+    try {
+        PyObject* key;
+        PyObject* item;
+        Py_ssize_t pos = 0;
+        while(PyDict_Next(value, &pos, &key, &item)) {
+            PyObject* const frozen = OOCFrozen_copy(item);
+            const int failure = PyDict_SetItem(dict, key, frozen);
+            Py_DECREF(frozen);
+            if(failure) throw OocError(OocError::AlreadyPythonizedError);
+        }
+    } catch(...) {
+        Py_DECREF(dict);
+        throw;
+    }
+    PyObject* const result = PyDictProxy_New(dict);
+    Py_DECREF(dict);
+    if(result == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+    return result;
+}
+
+// Reads a lazy container with `eager`, and freezes what comes out.
+static PyObject* OOCFrozen_copyLazy(PyObject* const value, PyObject* (*const eager)(PyObject*)) {
+    PyObject* const eagerValue = eager(value);
+    if(eagerValue == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+    try {
+        PyObject* const result = OOCFrozen_copy(eagerValue);
+        Py_DECREF(eagerValue);
+        return result;
+    } catch(...) {
+        Py_DECREF(eagerValue);
+        throw;
+    }
+}
+
+PyObject* OOCFrozen_copy(PyObject* const value) {
+    if(PyList_CheckExact(value) || PyTuple_CheckExact(value))
+        return OOCFrozen_copySequence(value);
+    if(PyDict_CheckExact(value))
+        return OOCFrozen_copyDict(value);
+    if(PySet_CheckExact(value)) {
+        // Set members are hashable, so there is nothing in them to freeze.
+        PyObject* const result = PyFrozenSet_New(value);
+        if(result == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+        return result;
+    }
+    if(value->ob_type == &OOCLazyListType)
+        return OOCFrozen_copyLazy(value, OOCLazyList_eager);
+    if(value->ob_type == &OOCLazyListSliceType)
+        return OOCFrozen_copyLazy(value, OOCLazyListSlice_eager);
+    if(value->ob_type == &OOCLazyDictType)
+        return OOCFrozen_copyLazy(value, OOCLazyDict_eager);
+    if(value->ob_type == &OOCLazySetType)
+        return OOCFrozen_copyLazy(value, OOCLazySet_eager);
+
+    // Everything else is stored by content already, including lazy tuples.
+    Py_INCREF(value);
+    return value;
+}
+
+void OOCFrozen_sortItems(std::vector<EncodedValue>& items) {
+    if(items.size() % 2 != 0) throw OocError(OocError::UnexpectedData);
+    std::vector<std::pair<EncodedValue, EncodedValue>> pairs(items.size() / 2);
+    for(size_t i = 0; i < pairs.size(); ++i)
+        pairs[i] = { items[i * 2], items[i * 2 + 1] };
+    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) {
+        return OOCLazySet_memberLess(a.first, b.first);
+    });
+    for(size_t i = 0; i < pairs.size(); ++i) {
+        items[i * 2] = pairs[i].first;
+        items[i * 2 + 1] = pairs[i].second;
+    }
+}
+
+//
+// Methods that are directly exposed to Python
+// These are not allowed to throw exceptions.
+//
+
+PyObject* OOCFrozen_freeze(PyObject* const module, PyObject* const value) {
+    try {
+        return OOCFrozen_copy(value);
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef OOCMAP_FROZEN_H
+#define OOCMAP_FROZEN_H
+
+#include <vector>
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "oocmap.h"
+
+//
+// Frozen containers
+//
+// Lists, dicts, and sets get a new id every time they are written, because they can change
+// afterwards. Tuples and frozensets can't, so they are stored in the tuples table keyed by a hash of
+// their content, and the same content is only stored once (see putImmutable()). freeze() makes a
+// copy of a value in which every list is a tuple, every set a frozenset, and every dict a read-only
+// `types.MappingProxyType`, so repeated parts of a value are stored once, no matter how often and
+// where they are written.
+//
+// Read-only mappings are stored in the tuples table too, as TYPE_CODE_FROZENDICT. Their records hold
+// the key and the value of each item, one after the other, sorted by key like the members of
+// frozensets. They come back as read-only mappings of a dict that is read in full.
+//
+
+// Returns a new reference to the frozen copy of `value`, or to `value` itself when nothing in it
+// needed to change. Lazy lists, dicts, and sets are read in full. Throws OocError.
+PyObject* OOCFrozen_copy(PyObject* value);
+
+// Sorts the key/value pairs of a frozen dict by key, so equal dicts have equal records.
+void OOCFrozen_sortItems(std::vector<EncodedValue>& items);
+
+// The Python-facing oocmap.freeze(value).
+PyObject* OOCFrozen_freeze(PyObject* module, PyObject* value);
+
+#endif //OOCMAP_FROZEN_H
@@ -0,0 +1,695 @@
+#include "gc.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include "db.h"
+#include "liststore.h"
+#include "refcount.h"
+#include "transaction.h"
+
+bool OOCGC_record(const EncodedValue& value, OOCGCTable* const table, uint64_t* const id) {
+    switch(value.typeCode) {
+    case TYPE_CODE_LONG_POSITIVE_INT:
+    case TYPE_CODE_LONG_NEGATIVE_INT:
+        *table = OOCGC_INTS;
+        *id = value.asUInt;
+        return true;
+    case TYPE_CODE_UNICODE_LONG_WCHAR:
+    case TYPE_CODE_UNICODE_LONG_1BYTE:
+    case TYPE_CODE_UNICODE_LONG_2BYTE:
+    case TYPE_CODE_UNICODE_LONG_4BYTE:
+        *table = OOCGC_STRINGS;
+        *id = value.asUInt;
+        return true;
+    case TYPE_CODE_BYTES_LONG:
+    case TYPE_CODE_BYTEARRAY_LONG:
+    case TYPE_CODE_NDARRAY:
+        *table = OOCGC_BLOBS;
+        *id = value.asUInt;
+        return true;
+    case TYPE_CODE_TUPLE:
+    case TYPE_CODE_FROZENSET:
+    case TYPE_CODE_FROZENDICT:
+        *table = OOCGC_TUPLES;
+        *id = value.asUInt;
+        return true;
+    case TYPE_CODE_LIST:
+        *table = OOCGC_LISTS;
+        *id = value.asListKey.listId;
+        return true;
+    case TYPE_CODE_DICT:
+        *table = OOCGC_DICTS;
+        *id = value.asDictKey.dictId;
+        return true;
+    case TYPE_CODE_SET:
+        *table = OOCGC_SETS;
+        *id = value.asSetKey.setId;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Finds the id of the value that a record in one of the tables belongs to. This is the same id
+// that OOCGC_record() returns for the value.
+static uint64_t OOCGC_recordId(const OOCGCTable table, const MDB_val& mdbKey) {
+    switch(table) {
+    case OOCGC_LISTS: {
+        if(mdbKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
+        ListKey listKey;
+        memcpy(&listKey, mdbKey.mv_data, sizeof(listKey));
+        return listKey.listId;
+    }
+    case OOCGC_DICTS:
+    case OOCGC_SETS: {
+        // Dicts and sets have a header under their id, and their items under keys that start with it.
+        uint32_t id;
+        if(mdbKey.mv_size < sizeof(id)) throw OocError(OocError::UnexpectedData);
+        memcpy(&id, mdbKey.mv_data, sizeof(id));
+        return id;
+    }
+    default: {
+        uint64_t id;
+        if(mdbKey.mv_size != sizeof(id)) throw OocError(OocError::UnexpectedData);
+        memcpy(&id, mdbKey.mv_data, sizeof(id));
+        return id;
+    }
+    }
+}
+
+void OOCGCMarks::reserve(const size_t count) {
+    size_t capacity = 16;
+    while(capacity < count * 2)
+        capacity *= 2;
+    if(capacity <= m_capacity) return;
+
+    uint64_t* const slots = static_cast<uint64_t*>(calloc(capacity, sizeof(uint64_t)));
+    if(slots == nullptr) throw OocError(OocError::OutOfMemory);
+    uint64_t* const oldSlots = m_slots;
+    const size_t oldCapacity = m_capacity;
+    m_slots = slots;
+    m_capacity = capacity;
+    for(size_t i = 0; i < oldCapacity; ++i) {
+        if(oldSlots[i] != 0)
+            m_slots[slot(oldSlots[i])] = oldSlots[i];
+    }
+    free(oldSlots);
+}
+
+size_t OOCGCMarks::slot(const uint64_t id) const {
+    // Fibonacci hashing, since list, dict, and set ids are sequential.
+    const size_t mask = m_capacity - 1;
+    size_t index = static_cast<size_t>((id * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    while(m_slots[index] != 0 && m_slots[index] != id)
+        index = (index + 1) & mask;
+    return index;
+}
+
+bool OOCGCMarks::insert(const uint64_t id) {
+    if(id == 0) {
+        const bool inserted = !m_hasZero;
+        m_hasZero = true;
+        return inserted;
+    }
+    if((m_size + 1) * 2 > m_capacity)
+        reserve(m_size + 1);
+    uint64_t& found = m_slots[slot(id)];
+    if(found == id) return false;
+    found = id;
+    m_size += 1;
+    return true;
+}
+
+bool OOCGCMarks::contains(const uint64_t id) const {
+    if(id == 0) return m_hasZero;
+    return m_capacity > 0 && m_slots[slot(id)] == id;
+}
+
+void OOCGCMarks::clear() {
+    free(m_slots);
+    m_slots = nullptr;
+    m_capacity = 0;
+    m_size = 0;
+    m_hasZero = false;
+}
+
+STATIC_ASSERT(sizeof(DictItemKey) == sizeof(SetItemKey));
+STATIC_ASSERT(offsetof(DictItemKey, key) == offsetof(SetItemKey, member));
+
+// Appends the keys of up to `limit` items of a dict or a set, and for dicts also their values. If
+// `resume` is set, this starts after the item with the key `*after`. Returns true if it got to the
+// last item, and otherwise sets `*after` to the key of the last item it read.
+static bool OOCGC_itemChildren(
+    OOCTransaction& txn,
+    const MDB_dbi dbi,
+    const uint32_t id,
+    const bool withValues,
+    size_t limit,
+    const bool resume,
+    EncodedValue* const after,
+    std::vector<EncodedValue>& children
+) {
+    DictItemKey start = { .dictId = id };
+    MDB_val mdbKey = { .mv_size = sizeof(id), .mv_data = &start };
+    if(resume) {
+        start.key = *after;
+        mdbKey.mv_size = sizeof(start);
+    }
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(txn.txn, dbi);
+    try {
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_RANGE);
+        if(found && resume && mdbKey.mv_size == sizeof(start) && memcmp(mdbKey.mv_data, &start, sizeof(start)) == 0)
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        while(found) {
+            if(mdbKey.mv_size < sizeof(id) || memcmp(mdbKey.mv_data, &id, sizeof(id)) != 0)
+                break;
+            if(mdbKey.mv_size == sizeof(DictItemKey)) {
+                if(limit == 0) {
+                    cursor_close(cursor);
+                    return false;
+                }
+                limit -= 1;
+                memcpy(after, static_cast<const char*>(mdbKey.mv_data) + offsetof(DictItemKey, key), sizeof(*after));
+                children.push_back(*after);
+                if(withValues) {
+                    if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
+                    EncodedValue value;
+                    memcpy(&value, mdbValue.mv_data, sizeof(value));
+                    children.push_back(value);
+                }
+            } else if(mdbKey.mv_size != sizeof(id)) {
+                throw OocError(OocError::UnexpectedData);
+            }
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+    return true;
+}
+
+void OOCGC_children(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const EncodedValue& value,
+    std::vector<EncodedValue>& children
+) {
+    switch(value.typeCode) {
+    case TYPE_CODE_TUPLE:
+    case TYPE_CODE_FROZENSET:
+    case TYPE_CODE_FROZENDICT: {
+        uint64_t key = value.asUInt;
+        MDB_val mdbKey = { .mv_size = sizeof(key), .mv_data = &key };
+        MDB_val mdbValue;
+        if(!get(txn.txn, ooc->tuplesDb, &mdbKey, &mdbValue)) throw OocError(OocError::UnexpectedData);
+        if(mdbValue.mv_size % sizeof(EncodedValue) != 0) throw OocError(OocError::UnexpectedData);
+        const size_t oldSize = children.size();
+        children.resize(oldSize + mdbValue.mv_size / sizeof(EncodedValue));
+        memcpy(children.data() + oldSize, mdbValue.mv_data, mdbValue.mv_size);
+        break;
+    }
+    case TYPE_CODE_LIST: {
+        const uint32_t listId = value.asListKey.listId;
+        const ListHeader header = OOCListStore_header(ooc, txn, listId);
+        // Packed lists hold only numbers that fit into their EncodedValues.
+        if(!ListHeader_isPacked(header))
+            OOCListStore_read(ooc, txn, listId, header, 0, header.length, children);
+        break;
+    }
+    case TYPE_CODE_DICT: {
+        EncodedValue after;
+        OOCGC_itemChildren(txn, ooc->dictsDb, value.asDictKey.dictId, true, SIZE_MAX, false, &after, children);
+        break;
+    }
+    case TYPE_CODE_SET: {
+        EncodedValue after;
+        OOCGC_itemChildren(txn, ooc->setsDb, value.asSetKey.setId, false, SIZE_MAX, false, &after, children);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+MDB_dbi OOCGC_dbi(const OOCMapObject* const ooc, const int table) {
+    switch(table) {
+    case OOCGC_INTS: return ooc->intsDb;
+    case OOCGC_STRINGS: return ooc->stringsDb;
+    case OOCGC_BLOBS: return ooc->blobsDb;
+    case OOCGC_TUPLES: return ooc->tuplesDb;
+    case OOCGC_LISTS: return ooc->listsDb;
+    case OOCGC_DICTS: return ooc->dictsDb;
+    default: return ooc->setsDb;
+    }
+}
+
+// Makes room in the marks for every record there is in each table.
+static void OOCGC_reserve(OOCMapObject* const ooc, OOCTransaction& txn, OOCGCMarks* const marks) {
+    for(int table = 0; table < OOCGC_TABLE_COUNT; ++table) {
+        MDB_stat stat;
+        const int error = mdb_stat(txn.txn, OOCGC_dbi(ooc, table), &stat);
+        if(error != 0) throw MdbError(error);
+        marks[table].reserve(stat.ms_entries);
+    }
+}
+
+// Reads the key and the value of an entry in the root table.
+static void OOCGC_rootEntry(const MDB_val& mdbKey, const MDB_val& mdbValue, EncodedValue* const entry) {
+    if(mdbKey.mv_size != sizeof(EncodedValue) || mdbValue.mv_size != sizeof(EncodedValue))
+        throw OocError(OocError::UnexpectedData);
+    memcpy(&entry[0], mdbKey.mv_data, sizeof(EncodedValue));
+    memcpy(&entry[1], mdbValue.mv_data, sizeof(EncodedValue));
+}
+
+// Deletes the records in a table that aren't marked, starting at `resumeKey`, or at the beginning
+// if it is empty, until it has looked at `budget` records. Afterwards, `resumeKey` is the key to
+// continue at, or empty if it got to the end. Returns what is left of the budget.
+static size_t OOCGC_sweep(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const OOCGCTable table,
+    const OOCGCMarks& marks,
+    std::vector<char>& resumeKey,
+    size_t budget,
+    OOCVacuumStats& stats
+) {
+    MDB_val mdbKey = { .mv_size = resumeKey.size(), .mv_data = resumeKey.data() };
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(txn.txn, OOCGC_dbi(ooc, table));
+    try {
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, resumeKey.empty() ? MDB_FIRST : MDB_SET_RANGE);
+        while(found && budget > 0) {
+            budget -= 1;
+            const uint64_t id = OOCGC_recordId(table, mdbKey);
+            if(!marks.contains(id)) {
+                stats.records += 1;
+                stats.bytes += mdbKey.mv_size + mdbValue.mv_size;
+                // The rows that the garbage refers to keep their counts, see refcount.h.
+                if(table < OOCGC_LISTS)
+                    OOCRefcount_forget(ooc, txn, table, id);
+                cursor_del(cursor);
+            }
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        }
+        if(found) {
+            const char* const key = static_cast<const char*>(mdbKey.mv_data);
+            resumeKey.assign(key, key + mdbKey.mv_size);
+        } else {
+            resumeKey.clear();
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+    return budget;
+}
+
+// Whether the record of a value is still there. The collector can find a container that is
+// already gone when a lazy object for it is written back into the map after it was swept, or
+// when a lazy object for it was read from a transaction that started before it was swept.
+static bool OOCGC_exists(OOCMapObject* const ooc, OOCTransaction& txn, const EncodedValue& value) {
+    OOCGCTable table;
+    uint64_t id;
+    if(!OOCGC_record(value, &table, &id)) return false;
+
+    ListKey listKey = { .listIndex = ListKey::listIndexLength, .listId = static_cast<uint32_t>(id) };
+    uint32_t containerId = static_cast<uint32_t>(id);
+    MDB_val mdbKey = { .mv_size = sizeof(id), .mv_data = &id };
+    if(table == OOCGC_LISTS) {
+        mdbKey = { .mv_size = sizeof(listKey), .mv_data = &listKey };
+    } else if(table == OOCGC_DICTS || table == OOCGC_SETS) {
+        mdbKey = { .mv_size = sizeof(containerId), .mv_data = &containerId };
+    }
+    MDB_val mdbValue;
+    return get(txn.txn, OOCGC_dbi(ooc, table), &mdbKey, &mdbValue);
+}
+
+OOCVacuumStats OOCMapObject_vacuum(OOCMapObject* const self, OOCTransaction& txn) {
+    OOCVacuumStats stats = { .records = 0, .bytes = 0 };
+    std::vector<EncodedValue> liveRoots;
+    if(self->collector != nullptr) {
+        liveRoots.reserve(self->collector->roots().size());
+        for(const auto& root : self->collector->roots())
+            liveRoots.push_back(root.first);
+    }
+    {
+        // None of this touches Python objects, so other threads can run while we walk the map.
+        GilUnlocker gil;
+
+        // Mark everything that can be reached from the root table and from the live lazy
+        // objects. Values go onto the stack
+        // when they are marked, so each one is visited only once, even in containers that
+        // contain themselves.
+        OOCGCMarks marks[OOCGC_TABLE_COUNT];
+        OOCGC_reserve(self, txn, marks);
+        std::vector<EncodedValue> stack;
+        const auto mark = [&](const EncodedValue& value) {
+            OOCGCTable table;
+            uint64_t id;
+            return OOCGC_record(value, &table, &id) && marks[table].insert(id);
+        };
+
+        MDB_val mdbKey;
+        MDB_val mdbValue;
+        MDB_cursor* const cursor = cursor_open(txn.txn, self->rootDb);
+        try {
+            bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_FIRST);
+            while(found) {
+                EncodedValue entry[2];
+                OOCGC_rootEntry(mdbKey, mdbValue, entry);
+                for(const EncodedValue& value : entry) {
+                    if(mark(value))
+                        stack.push_back(value);
+                }
+                found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+            }
+        } catch(...) {
+            cursor_close(cursor);
+            throw;
+        }
+        cursor_close(cursor);
+        for(const EncodedValue& value : liveRoots) {
+            if(OOCGC_exists(self, txn, value) && mark(value))
+                stack.push_back(value);
+        }
+
+        while(!stack.empty()) {
+            const EncodedValue value = stack.back();
+            stack.pop_back();
+            const size_t oldSize = stack.size();
+            OOCGC_children(self, txn, value, stack);
+            // Keep only the children that weren't marked before.
+            size_t newSize = oldSize;
+            for(size_t i = oldSize; i < stack.size(); ++i) {
+                if(mark(stack[i]))
+                    stack[newSize++] = stack[i];
+            }
+            stack.resize(newSize);
+        }
+
+        // Sweep
+        for(int table = 0; table < OOCGC_TABLE_COUNT; ++table) {
+            std::vector<char> resumeKey;
+            OOCGC_sweep(self, txn, static_cast<OOCGCTable>(table), marks[table], resumeKey, SIZE_MAX, stats);
+        }
+    }
+
+    // Whatever the collector has marked so far may point at records that are gone now.
+    if(self->collector != nullptr)
+        self->collector->reset();
+    if(stats.records > 0)
+        OOCMapObject_clearDecodeCache(self);
+    return stats;
+}
+
+
+//
+// OOCCollector
+//
+
+OOCCollector::OOCCollector(const size_t rowsPerWrite) :
+    rowsPerWrite(rowsPerWrite),
+    m_phase(Idle),
+    m_stepping(false),
+    m_hasCurrent(false),
+    m_currentIndex(0),
+    m_currentResume(false),
+    m_sweepTable(0),
+    m_cycleRecords(0),
+    m_stats({0, 0, 0, 0, 0.0, 0.0})
+{ }
+
+void OOCCollector::reset() {
+    m_phase = Idle;
+    for(OOCGCMarks& marks : m_marks)
+        marks.clear();
+    std::vector<EncodedValue>().swap(m_grey);
+    m_hasCurrent = false;
+    m_resumeKey.clear();
+    m_sweepTable = 0;
+    m_cycleRecords = 0;
+}
+
+void OOCCollector::mark(const EncodedValue& value) {
+    OOCGCTable table;
+    uint64_t id;
+    if(!OOCGC_record(value, &table, &id) || !m_marks[table].insert(id))
+        return;
+    // Only containers, tuples, and frozensets have children.
+    if(table == OOCGC_TUPLES || table == OOCGC_LISTS || table == OOCGC_DICTS || table == OOCGC_SETS)
+        m_grey.push_back(value);
+}
+
+void OOCCollector::listChanged(const uint32_t listId) {
+    if(m_hasCurrent && m_current.typeCode == TYPE_CODE_LIST && m_current.asListKey.listId == listId)
+        m_currentIndex = 0;
+}
+
+void OOCCollector::addRoot(const EncodedValue& container) {
+    m_roots[container] += 1;
+}
+
+void OOCCollector::removeRoot(const EncodedValue& container) {
+    const auto found = m_roots.find(container);
+    if(found == m_roots.end()) return;
+    if(--found->second == 0)
+        m_roots.erase(found);
+}
+
+// Marks the containers of the live lazy objects. This runs when marking is otherwise done, so it
+// sees the lazy objects that were made while the cycle ran, and the containers they hold that
+// nothing in the map refers to anymore. Returns true if that found anything new to mark.
+bool OOCCollector::markLiveRoots() {
+    for(const auto& root : m_roots)
+        mark(root.first);
+    return !m_grey.empty();
+}
+
+size_t OOCCollector::markRoots(OOCMapObject* const ooc, OOCTransaction& txn, size_t budget) {
+    MDB_val mdbKey = { .mv_size = m_resumeKey.size(), .mv_data = m_resumeKey.data() };
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(txn.txn, ooc->rootDb);
+    try {
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, m_resumeKey.empty() ? MDB_FIRST : MDB_SET_RANGE);
+        while(found && budget > 0) {
+            budget -= 1;
+            EncodedValue entry[2];
+            OOCGC_rootEntry(mdbKey, mdbValue, entry);
+            mark(entry[0]);
+            mark(entry[1]);
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        }
+        if(found) {
+            const char* const key = static_cast<const char*>(mdbKey.mv_data);
+            m_resumeKey.assign(key, key + mdbKey.mv_size);
+        } else {
+            m_resumeKey.clear();
+            m_phase = Mark;
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+    return budget;
+}
+
+size_t OOCCollector::markGrey(OOCMapObject* const ooc, OOCTransaction& txn, size_t budget) {
+    std::vector<EncodedValue> children;
+    while(budget > 0) {
+        if(!m_hasCurrent) {
+            if(m_grey.empty()) break;
+            m_current = m_grey.back();
+            m_grey.pop_back();
+            m_currentIndex = 0;
+            m_currentResume = false;
+            if(!OOCGC_exists(ooc, txn, m_current)) {
+                budget -= 1;
+                continue;
+            }
+            m_hasCurrent = true;
+        }
+
+        children.clear();
+        bool done = true;
+        switch(m_current.typeCode) {
+        case TYPE_CODE_LIST: {
+            const uint32_t listId = m_current.asListKey.listId;
+            const ListHeader header = OOCListStore_header(ooc, txn, listId);
+            if(!ListHeader_isPacked(header) && m_currentIndex < header.length) {
+                const uint32_t stop =
+                    header.length - m_currentIndex > budget ?
+                    m_currentIndex + static_cast<uint32_t>(budget) :
+                    header.length;
+                OOCListStore_read(ooc, txn, listId, header, m_currentIndex, stop, children);
+                m_currentIndex = stop;
+                done = stop == header.length;
+            }
+            break;
+        }
+        case TYPE_CODE_DICT:
+            // Every item has a key and a value.
+            done = OOCGC_itemChildren(
+                txn, ooc->dictsDb, m_current.asDictKey.dictId, true, (budget + 1) / 2,
+                m_currentResume, &m_currentAfter, children);
+            m_currentResume = m_currentResume || !children.empty();
+            break;
+        case TYPE_CODE_SET:
+            done = OOCGC_itemChildren(
+                txn, ooc->setsDb, m_current.asSetKey.setId, false, budget,
+                m_currentResume, &m_currentAfter, children);
+            m_currentResume = m_currentResume || !children.empty();
+            break;
+        default:
+            OOCGC_children(ooc, txn, m_current, children);
+            break;
+        }
+
+        // Empty containers cost a row too, so a step always ends.
+        const size_t cost = children.empty() ? 1 : children.size();
+        budget -= cost < budget ? cost : budget;
+        for(const EncodedValue& child : children)
+            mark(child);
+        if(done)
+            m_hasCurrent = false;
+    }
+
+    if(m_phase == Mark && !m_hasCurrent && m_grey.empty() && !markLiveRoots()) {
+        m_phase = Sweep;
+        m_sweepTable = 0;
+        m_resumeKey.clear();
+    }
+    return budget;
+}
+
+void OOCCollector::finishCycle(OOCMapObject* const ooc) {
+    const bool deleted = m_cycleRecords > 0;
+    reset();
+    m_stats.cycles += 1;
+    if(deleted)
+        OOCMapObject_clearDecodeCache(ooc);
+}
+
+bool OOCCollector::step(OOCMapObject* const ooc, const size_t rows) {
+    if(m_stepping) return false;
+    m_stepping = true;
+    struct Unstep {
+        bool& stepping;
+        ~Unstep() { stepping = false; }
+    } unstep = { m_stepping };
+
+    const auto start = std::chrono::steady_clock::now();
+    bool finished = false;
+    try {
+        OOCMapObject_growingWrite(ooc, [&]() {
+            OOCTransaction txn(ooc, false);
+            size_t budget = rows > 0 ? rows : 1;
+            if(m_phase == Idle) {
+                OOCGC_reserve(ooc, txn, m_marks);
+                m_phase = Roots;
+            }
+            if(m_phase == Roots)
+                budget = markRoots(ooc, txn, budget);
+            if(m_phase != Roots)
+                budget = markGrey(ooc, txn, budget);
+
+            // Marking only reads, but sweeping deletes, so its progress only counts once the
+            // transaction has committed.
+            const bool sweeping = m_phase == Sweep && !m_hasCurrent && m_grey.empty();
+            int sweepTable = m_sweepTable;
+            std::vector<char> resumeKey = m_resumeKey;
+            OOCVacuumStats swept = { .records = 0, .bytes = 0 };
+            if(sweeping) {
+                while(budget > 0 && sweepTable < OOCGC_TABLE_COUNT) {
+                    budget = OOCGC_sweep(
+                        ooc, txn, static_cast<OOCGCTable>(sweepTable), m_marks[sweepTable], resumeKey, budget, swept);
+                    if(resumeKey.empty())
+                        sweepTable += 1;
+                }
+            }
+            txn.commit();
+
+            if(sweeping) {
+                m_sweepTable = sweepTable;
+                m_resumeKey.swap(resumeKey);
+                m_cycleRecords += swept.records;
+                m_stats.records += swept.records;
+                m_stats.bytes += swept.bytes;
+                if(m_sweepTable == OOCGC_TABLE_COUNT) {
+                    finishCycle(ooc);
+                    finished = true;
+                }
+            }
+        });
+    } catch(...) {
+        reset();
+        throw;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_stats.steps += 1;
+    m_stats.totalSeconds += seconds;
+    if(seconds > m_stats.maxSeconds)
+        m_stats.maxSeconds = seconds;
+    return finished;
+}
+
+static EncodedValue OOCGC_container(const uint8_t typeCode, const uint32_t id) {
+    EncodedValue result;
+    result.asUInt = 0;
+    result.typeCodeWithLength = 0;
+    if(typeCode == TYPE_CODE_LIST) {
+        result.asListKey.listId = id;
+        result.asListKey.listIndex = ListKey::listIndexLength;
+    } else {
+        // Dicts and sets keep their ids in the same place.
+        result.asDictKey.dictId = id;
+    }
+    result.typeCode = typeCode;
+    return result;
+}
+
+void OOCGC_addRoot(
+    OOCMapObject* const ooc,
+    const uint8_t typeCode,
+    const uint32_t id,
+    const OOCTransactionObject* const snapshot
+) {
+    if(ooc->collector != nullptr && snapshot == nullptr)
+        ooc->collector->addRoot(OOCGC_container(typeCode, id));
+}
+
+void OOCGC_removeRoot(
+    OOCMapObject* const ooc,
+    const uint8_t typeCode,
+    const uint32_t id,
+    const OOCTransactionObject* const snapshot
+) {
+    if(ooc->collector != nullptr && snapshot == nullptr)
+        ooc->collector->removeRoot(OOCGC_container(typeCode, id));
+}
+
+void OOCGC_afterWrite(OOCMapObject* const ooc) {
+    OOCCollector* const collector = ooc->collector;
+    if(collector == nullptr || collector->rowsPerWrite == 0) return;
+
+    // The caller may be on its way to raise an error of its own.
+    PyObject* errorType;
+    PyObject* errorValue;
+    PyObject* errorTraceback;
+    PyErr_Fetch(&errorType, &errorValue, &errorTraceback);
+    try {
+        if(OOCTransactionObject_current(ooc, true) == nullptr)
+            collector->step(ooc, collector->rowsPerWrite);
+    } catch(const OocError&) {
+        PyErr_Clear();
+    }
+    PyErr_Restore(errorType, errorValue, errorTraceback);
+}
@@ -0,0 +1,204 @@
+#ifndef OOCMAP_GC_H
+#define OOCMAP_GC_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "oocmap.h"
+
+//
+// Garbage collection
+//
+// Values that don't fit into an EncodedValue have records in the other tables, and nothing counts
+// the references to those records. Overwriting or deleting the last reference to one leaves the
+// record behind. Vacuuming marks everything that can be reached from the root table, and deletes
+// every record that wasn't marked. LMDB reuses the freed pages for later writes, but the file
+// itself doesn't shrink.
+//
+// Lazy lists, dicts, and sets are roots as well, as long as they exist, so a container that was
+// popped out of a list or overwritten in the map stays readable through the lazy object that holds
+// it. Lazy objects that were read through a snapshot don't need this, since the snapshot keeps the
+// records it sees. A lazy object whose container is gone anyway, because it was read from a
+// transaction that started before the container was collected, raises ReferenceError.
+//
+
+struct OOCVacuumStats {
+    uint64_t records;   // the number of records that were deleted
+    uint64_t bytes;     // the size of their keys and values together
+};
+
+// The tables that hold records for values, in the order they are swept.
+enum OOCGCTable {
+    OOCGC_INTS,
+    OOCGC_STRINGS,
+    OOCGC_BLOBS,
+    OOCGC_TUPLES,
+    OOCGC_LISTS,
+    OOCGC_DICTS,
+    OOCGC_SETS,
+    OOCGC_TABLE_COUNT
+};
+
+// Finds the table and the id of the record that holds a value. Returns false for values that fit
+// entirely into their EncodedValue.
+bool OOCGC_record(const EncodedValue& value, OOCGCTable* table, uint64_t* id);
+
+// The LMDB table behind one of the OOCGCTables.
+MDB_dbi OOCGC_dbi(const OOCMapObject* ooc, int table);
+
+// A set of record ids. It uses open addressing, so reserving room for all the records up front means
+// it never has to rehash while a cycle runs, and freeing it is one deallocation instead of one per id.
+// The slots come from calloc(), so the OS only hands out zeroed pages as they are touched, and a big
+// reservation doesn't stall the step that makes it.
+class OOCGCMarks {
+public:
+    OOCGCMarks() : m_slots(nullptr), m_capacity(0), m_size(0), m_hasZero(false) { }
+    ~OOCGCMarks() { clear(); }
+    OOCGCMarks(const OOCGCMarks&) = delete;
+    OOCGCMarks& operator=(const OOCGCMarks&) = delete;
+
+    // Makes room for `count` ids without growing. Throws OocError.
+    void reserve(size_t count);
+    // Returns true if the id wasn't in the set before.
+    bool insert(uint64_t id);
+    bool contains(uint64_t id) const;
+    // Empties the set and frees its memory.
+    void clear();
+
+private:
+    size_t slot(uint64_t id) const;
+
+    uint64_t* m_slots;      // 0 means empty, so the id 0 is kept in m_hasZero
+    size_t m_capacity;      // always a power of two
+    size_t m_size;
+    bool m_hasZero;
+};
+
+// Appends the values that are stored inside of `value` to `children`: the elements of tuples,
+// frozensets, and lists that aren't packed, the keys and values of dicts, and the members of sets.
+// Other values have no children. This does not touch any Python objects. Throws OocError.
+void OOCGC_children(
+    OOCMapObject* ooc,
+    OOCTransaction& txn,
+    const EncodedValue& value,
+    std::vector<EncodedValue>& children);
+
+// Deletes every record that can't be reached from the root table or from a live lazy object, and
+// empties the decode cache. Throws OocError.
+OOCVacuumStats OOCMapObject_vacuum(OOCMapObject* self, OOCTransaction& txn);
+
+
+//
+// OOCCollector
+//
+// Does the same as vacuuming, but a bounded number of rows at a time, so maps that are never idle
+// can get rid of their garbage without holding the write lock for long. Each step is a write
+// transaction of its own, and picks up where the last one stopped. A cycle first walks the root
+// table from a saved key on, then marks what it found, and then sweeps the tables one after the
+// other, again from a saved key on. Dicts and sets that are too big for one step are marked from a
+// saved item key on, and lists from a saved index on.
+//
+// Writes can change anything between two steps. While a cycle runs, OOCMap_encode() shades every
+// value that is written anywhere (the write barrier), so a value that gets a new parent after that
+// parent was marked is marked anyway. References that go away only mean that the value is
+// collected in the next cycle. Items move around in a list when something is inserted or deleted,
+// so a list that changes while it is partly marked is marked again from the start.
+//
+// This only sees writes that go through this OOCMapObject. A map that other processes or other
+// OOCMap objects write to at the same time must not use it. All of its state changes inside write
+// transactions only, so the LMDB write lock keeps steps and writes from running at the same time.
+//
+
+struct OOCCollector {
+    // The number of rows for the step that runs after each write, or 0 to only collect when asked.
+    const size_t rowsPerWrite;
+
+    explicit OOCCollector(size_t rowsPerWrite);
+
+    // Runs one step that looks at about `rows` rows. Steps already in progress and steps started
+    // from inside a step do nothing. Returns true if the step finished a cycle. Must not be called
+    // while the current thread has a transaction open on the map. Throws OocError.
+    bool step(OOCMapObject* ooc, size_t rows);
+    // Forgets the current cycle. The next step starts a new one.
+    void reset();
+
+    // The write barrier. Marks a value that is being written while a cycle runs.
+    void shade(const EncodedValue& value) {
+        if(m_phase != Idle)
+            mark(value);
+    }
+    // Must be called whenever the items of a list move.
+    void listChanged(uint32_t listId);
+
+    // The containers of the live lazy objects, with the number of objects that hold each one.
+    // These only change with the GIL held, and the collector only reads them with the GIL held.
+    void addRoot(const EncodedValue& container);
+    void removeRoot(const EncodedValue& container);
+    const std::unordered_map<EncodedValue, size_t>& roots() const { return m_roots; }
+
+    bool isRunning() const { return m_phase != Idle; }
+
+    struct Stats {
+        uint64_t cycles;
+        uint64_t steps;
+        uint64_t records;
+        uint64_t bytes;
+        double totalSeconds;
+        double maxSeconds;
+    };
+    const Stats& stats() const { return m_stats; }
+
+private:
+    enum Phase { Idle, Roots, Mark, Sweep };
+
+    void mark(const EncodedValue& value);
+    size_t markRoots(OOCMapObject* ooc, OOCTransaction& txn, size_t budget);
+    size_t markGrey(OOCMapObject* ooc, OOCTransaction& txn, size_t budget);
+    bool markLiveRoots();
+    void finishCycle(OOCMapObject* ooc);
+
+    Phase m_phase;
+    bool m_stepping;
+    OOCGCMarks m_marks[OOCGC_TABLE_COUNT];
+    std::vector<EncodedValue> m_grey;       // marked, but their children aren't yet
+
+    // The container that is partly marked, if any, and how far it is marked.
+    bool m_hasCurrent;
+    EncodedValue m_current;
+    uint32_t m_currentIndex;                // for lists
+    bool m_currentResume;                   // for dicts and sets
+    EncodedValue m_currentAfter;
+
+    // The key in the root table, or in the table being swept, that the next step starts at.
+    std::vector<char> m_resumeKey;
+    int m_sweepTable;
+    uint64_t m_cycleRecords;
+
+    std::unordered_map<EncodedValue, size_t> m_roots;
+    Stats m_stats;
+};
+
+// The write barrier, for OOCMap_encode() and anything else that writes an EncodedValue it didn't
+// get from OOCMap_encode().
+inline void OOCGC_shade(OOCMapObject* const ooc, const EncodedValue& value) {
+    if(ooc->collector != nullptr)
+        ooc->collector->shade(value);
+}
+
+inline void OOCGC_listChanged(OOCMapObject* const ooc, const uint32_t listId) {
+    if(ooc->collector != nullptr)
+        ooc->collector->listChanged(listId);
+}
+
+// Called by the lazy lists, dicts, and sets when they are made and when they are deallocated, with
+// the type code of their container and its id. Objects that belong to a snapshot are not roots.
+void OOCGC_addRoot(OOCMapObject* ooc, uint8_t typeCode, uint32_t id, const OOCTransactionObject* snapshot);
+void OOCGC_removeRoot(OOCMapObject* ooc, uint8_t typeCode, uint32_t id, const OOCTransactionObject* snapshot);
+
+// Runs a step of `rowsPerWrite` rows if the map collects after writes, and the current thread has
+// no transaction open on it. Called after every write transaction commits. Errors end the cycle
+// and are not raised, since the write they follow has already succeeded.
+void OOCGC_afterWrite(OOCMapObject* ooc);
+
+#endif //OOCMAP_GC_H
@@ -3,18 +3,27 @@
 #include "oocmap.h"
 #include "db.h"
 #include "errors.h"
+#include "gc.h"
+#include "refcount.h"
 
 //
 // OOCLazyDict
 //
 
-OOCLazyDictObject* OOCLazyDict_fastnew(OOCMapObject* const ooc, const uint32_t dictId) {
+OOCLazyDictObject* OOCLazyDict_fastnew(
+    OOCMapObject* const ooc,
+    const uint32_t dictId,
+    OOCTransactionObject* const snapshot
+) {
     PyObject* const pySelf = OOCLazyDictType.tp_alloc(&OOCLazyDictType, 0);
     if(pySelf == nullptr) throw OocError(OocError::OutOfMemory);
     OOCLazyDictObject* self = reinterpret_cast<OOCLazyDictObject*>(pySelf);
     self->ooc = ooc;
     Py_INCREF(ooc);
     self->dictId = dictId;
+    self->snapshot = snapshot;
+    Py_XINCREF(snapshot);
+    OOCGC_addRoot(ooc, TYPE_CODE_DICT, dictId, snapshot);
     return self;
 }
 
@@ -27,6 +36,7 @@ static PyObject* OOCLazyDict_new(PyTypeObject* const type, PyObject* const args,
     }
     self->ooc = nullptr;
     self->dictId = 0;
+    self->snapshot = nullptr;
     return (PyObject*)self;
 }
 
@@ -34,24 +44,32 @@ static int OOCLazyDict_init(OOCLazyDictObject* const self, PyObject* const args,
     // parse parameters
     static const char *kwlist[] = {"oocmap", "dict_id", nullptr};
     PyObject* oocmapObject = nullptr;
+    unsigned long long dictId = 0;
     const int parseSuccess = PyArg_ParseTupleAndKeywords(
         args,
         kwds,
         "O!K",
         const_cast<char**>(kwlist),
-        &OOCMapType, &oocmapObject, &self->dictId);
+        &OOCMapType, &oocmapObject, &dictId);
     if(!parseSuccess)
         return -1;
 
+    if(self->ooc != nullptr)
+        OOCGC_removeRoot(self->ooc, TYPE_CODE_DICT, self->dictId, self->snapshot);
     Py_CLEAR(self->ooc);
     self->ooc = reinterpret_cast<OOCMapObject*>(oocmapObject);
     Py_INCREF(oocmapObject);
+    self->dictId = dictId;
+    OOCGC_addRoot(self->ooc, TYPE_CODE_DICT, self->dictId, self->snapshot);
 
     return 0;
 }
 
 static void OOCLazyDict_dealloc(OOCLazyDictObject* const self) {
+    if(self->ooc != nullptr)
+        OOCGC_removeRoot(self->ooc, TYPE_CODE_DICT, self->dictId, self->snapshot);
     Py_XDECREF(self->ooc);
+    Py_XDECREF(self->snapshot);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -63,7 +81,7 @@ static Py_ssize_t OOCLazyDict_length(PyObject* const pySelf) {
     OOCLazyDictObject* const self = reinterpret_cast<OOCLazyDictObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         Py_ssize_t const result = OOCLazyDictObject_length(self, txn);
         txn.commit();
         return result;
@@ -77,7 +95,7 @@ Py_ssize_t OOCLazyDictObject_length(OOCLazyDictObject* const self, OOCTransactio
     MDB_val mdbKey = { .mv_size = sizeof(self->dictId), .mv_data = &self->dictId };
     MDB_val mdbValue;
     const bool found = get(txn.txn, self->ooc->dictsDb, &mdbKey, &mdbValue);
-    if(!found) throw OocError(OocError::UnexpectedData);
+    if(!found) throw OocError(OocError::ContainerGone);
     if(mdbValue.mv_size != sizeof(Py_ssize_t)) throw OocError(OocError::UnexpectedData);
     return *reinterpret_cast<Py_ssize_t*>(mdbValue.mv_data);
 }
@@ -90,60 +108,71 @@ static int OOCLazyDict_insert(PyObject* pySelf, PyObject* key, PyObject* value)
     OOCLazyDictObject* const self = reinterpret_cast<OOCLazyDictObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, false);
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
 
-        DictItemKey encodedKey = { .dictId = self->dictId };
-        try {
-            encodedKey.key = *OOCMap_encode(self->ooc, key, txn, true);
-        } catch(const OocError& error) {
-            switch(error.errorCode) {
-            case OocError::MutableValueNotAllowed:
-                PyErr_Format(PyExc_TypeError, "unhashable type: '%s'", Py_TYPE(key)->tp_name);
-                return -1;
-            default:
-                throw;
-            }
-        }
-
-        MDB_val mdbKey = { .mv_size = sizeof(encodedKey), .mv_data = &encodedKey };
-        MDB_val mdbValueRead;
-
-        Py_ssize_t lengthChange = 0;
-        if(value == nullptr) {
+            DictItemKey encodedKey = { .dictId = self->dictId };
             try {
-                del(txn.txn, self->ooc->dictsDb, &mdbKey);
-                lengthChange -= 1;
-            } catch(const MdbError& error) {
-                if(error.mdbErrorCode != MDB_NOTFOUND)
+                encodedKey.key = *OOCMap_encode(self->ooc, key, txn, true);
+            } catch(const OocError& error) {
+                switch(error.errorCode) {
+                case OocError::MutableValueNotAllowed:
+                    PyErr_Format(PyExc_TypeError, "unhashable type: '%s'", Py_TYPE(key)->tp_name);
+                    throw OocError(OocError::AlreadyPythonizedError);
+                default:
                     throw;
+                }
             }
-        } else {
-            const bool found = get(txn.txn, self->ooc->dictsDb, &mdbKey, &mdbValueRead);
-            const EncodedValue* const encodedValue = OOCMap_encode(self->ooc, value, txn);
-            MDB_val mdbValue = {
-                .mv_size = sizeof(*encodedValue),
-                .mv_data = const_cast<EncodedValue*>(encodedValue)
-            };
 
+            MDB_val mdbKey = { .mv_size = sizeof(encodedKey), .mv_data = &encodedKey };
+            // Copy the old value out, because encoding the new one writes to the map. It loses a
+            // reference, see refcount.h.
+            MDB_val mdbValueRead;
+            const bool found = get(txn.txn, self->ooc->dictsDb, &mdbKey, &mdbValueRead);
+            EncodedValue encodedValueRead = {};
             if(found) {
                 if(mdbValueRead.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-                const EncodedValue* const encodedValueRead = static_cast<EncodedValue* const>(mdbValueRead.mv_data);
-                if(*encodedValue != *encodedValueRead)
-                    put(txn.txn, self->ooc->dictsDb, &mdbKey, &mdbValue);
+                memcpy(&encodedValueRead, mdbValueRead.mv_data, sizeof(encodedValueRead));
+            }
+
+            Py_ssize_t lengthChange = 0;
+            if(value == nullptr) {
+                if(found) {
+                    del(txn.txn, self->ooc->dictsDb, &mdbKey);
+                    OOCRefcount_decref(self->ooc, txn, encodedKey.key);
+                    OOCRefcount_decref(self->ooc, txn, encodedValueRead);
+                    lengthChange -= 1;
+                }
             } else {
-                put(txn.txn, self->ooc->dictsDb, &mdbKey, &mdbValue);
-                lengthChange += 1;
+                const EncodedValue* const encodedValue = OOCMap_encode(self->ooc, value, txn);
+                MDB_val mdbValue = {
+                    .mv_size = sizeof(*encodedValue),
+                    .mv_data = const_cast<EncodedValue*>(encodedValue)
+                };
+
+                if(found) {
+                    if(*encodedValue != encodedValueRead) {
+                        put(txn.txn, self->ooc->dictsDb, &mdbKey, &mdbValue);
+                        OOCRefcount_incref(self->ooc, txn, *encodedValue);
+                        OOCRefcount_decref(self->ooc, txn, encodedValueRead);
+                    }
+                } else {
+                    put(txn.txn, self->ooc->dictsDb, &mdbKey, &mdbValue);
+                    OOCRefcount_incref(self->ooc, txn, encodedKey.key);
+                    OOCRefcount_incref(self->ooc, txn, *encodedValue);
+                    lengthChange += 1;
+                }
             }
-        }
 
-        if(lengthChange != 0) {
-            Py_ssize_t length = OOCLazyDictObject_length(self, txn) + lengthChange;
-            MDB_val mdbLengthKey = {.mv_size = sizeof(self->dictId), .mv_data = &self->dictId};
-            MDB_val mdbLengthValue = {.mv_size = sizeof(length), .mv_data = &length};
-            put(txn.txn, self->ooc->dictsDb, &mdbLengthKey, &mdbLengthValue);
-        }
+            if(lengthChange != 0) {
+                Py_ssize_t length = OOCLazyDictObject_length(self, txn) + lengthChange;
+                MDB_val mdbLengthKey = {.mv_size = sizeof(self->dictId), .mv_data = &self->dictId};
+                MDB_val mdbLengthValue = {.mv_size = sizeof(length), .mv_data = &length};
+                put(txn.txn, self->ooc->dictsDb, &mdbLengthKey, &mdbLengthValue);
+            }
 
-        txn.commit();
+            txn.commit();
+        });
     } catch(const OocError& error) {
         error.pythonize();
         return -1;
@@ -160,7 +189,7 @@ static PyObject* OOCLazyDict_get(PyObject* const pySelf, PyObject* const key) {
     OOCLazyDictObject* const self = reinterpret_cast<OOCLazyDictObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
 
         DictItemKey encodedItemKey = { .dictId = self->dictId };
         try {
@@ -206,7 +235,7 @@ PyObject* OOCLazyDict_eager(PyObject* const pySelf) {
     OOCLazyDictObject* const self = reinterpret_cast<OOCLazyDictObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         return OOCLazyDictObject_eager(self, txn);
     } catch(const OocError& error) {
         error.pythonize();
@@ -215,55 +244,70 @@ PyObject* OOCLazyDict_eager(PyObject* const pySelf) {
 }
 
 PyObject* OOCLazyDictObject_eager(OOCLazyDictObject* const self, OOCTransaction& txn) {
-    PyObject* result = nullptr;
-    MDB_cursor* cursor = nullptr;
-    try {
-        result = PyDict_New();
-        if(result == nullptr) throw OocError(OocError::OutOfMemory);
-        cursor = cursor_open(txn.txn, self->ooc->dictsDb);
-
-        MDB_val mdbKey = { .mv_size = sizeof(self->dictId), .mv_data = &self->dictId };
-        MDB_val mdbValue;
-        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET);
-        if(!found) throw OocError(OocError::UnexpectedData);
-
-        while(true) {
-            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
-            if(!found)
-                break;
-
-            // We found the beginning of the next dict?
-            if(mdbKey.mv_size == sizeof(uint32_t)) {
-                if(*static_cast<uint32_t*>(mdbKey.mv_data) == self->dictId)
+    // Read everything from LMDB in one go without the GIL, and then build the Python objects.
+    std::vector<std::pair<FetchedValue, FetchedValue>> items;
+    {
+        GilUnlocker gil;
+        MDB_cursor* const cursor = cursor_open(txn.txn, self->ooc->dictsDb);
+        try {
+            MDB_val mdbKey = { .mv_size = sizeof(self->dictId), .mv_data = &self->dictId };
+            MDB_val mdbValue;
+            bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET);
+            if(!found) throw OocError(OocError::ContainerGone);
+            if(mdbValue.mv_size == sizeof(Py_ssize_t))
+                items.reserve(*static_cast<Py_ssize_t*>(mdbValue.mv_data));
+
+            while(true) {
+                found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+                if(!found)
+                    break;
+
+                // We found the beginning of the next dict?
+                if(mdbKey.mv_size == sizeof(uint32_t)) {
+                    if(*static_cast<uint32_t*>(mdbKey.mv_data) == self->dictId)
+                        throw OocError(OocError::UnexpectedData);
+                    break;
+                }
+
+                // We found garbage?
+                if(mdbKey.mv_size != sizeof(DictItemKey))
                     throw OocError(OocError::UnexpectedData);
-                break;
-            }
-
-            // We found garbage?
-            if(mdbKey.mv_size != sizeof(DictItemKey))
-                throw OocError(OocError::UnexpectedData);
-
-            // We found an item!
-            DictItemKey* const encodedItemKey = static_cast<DictItemKey* const>(mdbKey.mv_data);
-            if(encodedItemKey->dictId != self->dictId)
-                break;
-            PyObject* const itemKey = OOCMap_decode(self->ooc, &encodedItemKey->key, txn);
 
-            if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-            EncodedValue* const encodedItemValue = static_cast<EncodedValue* const>(mdbValue.mv_data);
-            PyObject* const itemValue = OOCMap_decode(self->ooc, encodedItemValue, txn);
+                // We found an item!
+                DictItemKey* const encodedItemKey = static_cast<DictItemKey* const>(mdbKey.mv_data);
+                if(encodedItemKey->dictId != self->dictId)
+                    break;
+                if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
+                items.emplace_back();
+                OOCMap_fetch(self->ooc, &encodedItemKey->key, txn, &items.back().first);
+                OOCMap_fetch(self->ooc, static_cast<EncodedValue*>(mdbValue.mv_data), txn, &items.back().second);
+            }
+        } catch(...) {
+            cursor_close(cursor);
+            throw;
+        }
+        cursor_close(cursor);
+    }
 
+    PyObject* const result = PyDict_New();
+    if(result == nullptr) throw OocError(OocError::OutOfMemory);
+    PyObject* itemKey = nullptr;
+    PyObject* itemValue = nullptr;
+    try {
+        for(auto& item : items) {
+            itemKey = OOCMap_decodeKey(self->ooc, &item.first, txn);
+            itemValue = OOCMap_decode(self->ooc, &item.second, txn);
             const int failure = PyDict_SetItem(result, itemKey, itemValue);
+            Py_CLEAR(itemKey);
+            Py_CLEAR(itemValue);
             if(failure) throw OocError(OocError::AlreadyPythonizedError);
         }
-
-        cursor_close(cursor);
     } catch(...) {
-        if(cursor != nullptr) cursor_close(cursor);
-        if(result != nullptr) Py_DECREF(result);
+        Py_XDECREF(itemKey);
+        Py_XDECREF(itemValue);
+        Py_DECREF(result);
         throw;
     }
-
     return result;
 }
 
@@ -301,7 +345,7 @@ static int OOCLazyDict_contains(PyObject* const pySelf, PyObject* const item) {
     OOCLazyDictObject* const self = reinterpret_cast<OOCLazyDictObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
 
         DictItemKey encodedItemKey = { .dictId = self->dictId };
         try {
@@ -479,6 +523,7 @@ OOCLazyDictItemsIterObject* OOCLazyDictItemsIter_fastnew(OOCLazyDictObject* cons
     OOCLazyDictItemsIterObject* self = reinterpret_cast<OOCLazyDictItemsIterObject*>(pySelf);
     self->dict = dict;
     Py_INCREF(dict);
+    self->txn = nullptr;
     self->cursor = nullptr;
     return self;
 }
@@ -491,6 +536,7 @@ static PyObject* OOCLazyDictItemsIter_new(PyTypeObject* const type, PyObject* co
         return nullptr;
     }
     self->dict = nullptr;
+    self->txn = nullptr;
     self->cursor = nullptr;
     return (PyObject*)self;
 }
@@ -511,18 +557,24 @@ static int OOCLazyDictItemsIter_init(OOCLazyDictItemsIterObject* const self, PyO
     Py_CLEAR(self->dict);
     self->dict = reinterpret_cast<OOCLazyDictObject*>(dictObject);
     Py_INCREF(dictObject);
+    self->txn = nullptr;
     self->cursor = nullptr;
 
     return 0;
 }
 
-static void OOCLazyDictItemsIter_dealloc(OOCLazyDictItemsIterObject* const self) {
-    Py_XDECREF(self->dict);
+static void OOCLazyDictItemsIter_release(OOCLazyDictItemsIterObject* const self) {
     if(self->cursor != nullptr) {
-        MDB_txn* const txn = mdb_cursor_txn(self->cursor);
-        mdb_cursor_close(self->cursor);
-        txn_abort(txn);
+        self->txn->closeCursor(self->cursor);
+        self->cursor = nullptr;
     }
+    delete self->txn;
+    self->txn = nullptr;
+}
+
+static void OOCLazyDictItemsIter_dealloc(OOCLazyDictItemsIterObject* const self) {
+    Py_XDECREF(self->dict);
+    OOCLazyDictItemsIter_release(self);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -540,34 +592,25 @@ static PyObject* OOCLazyDictItemsIter_iternext(PyObject* const pySelf) {
     if(self->dict == nullptr) return nullptr;
     OOCMapObject* const ooc = self->dict->ooc;
 
-    MDB_txn* txn = nullptr;
-    if(self->cursor == nullptr) {
-        try {
-            txn = txn_begin(ooc->mdb, false);
-            self->cursor = cursor_open(txn, ooc->dictsDb);
+    // If the transaction is only waiting for a savepoint to end, we can carry on after that.
+    if(self->txn != nullptr && !self->txn->isAlive()) {
+        OocError(OocError::TransactionEnded).pythonize();
+        return nullptr;
+    }
+
+    PyObject* pyKey = nullptr;
+    PyObject* pyValue = nullptr;
+    try {
+        if(self->cursor == nullptr) {
+            self->txn = new OOCTransaction(ooc, true, self->dict->snapshot);
+            self->cursor = cursor_open(self->txn->txn, ooc->dictsDb);
 
             MDB_val mdbKey = { .mv_size = sizeof(self->dict->dictId), .mv_data = &self->dict->dictId };
             MDB_val mdbValue;
             const bool found = cursor_get(self->cursor, &mdbKey, &mdbValue, MDB_SET);
-            if(!found) throw OocError(OocError::UnexpectedData);
-        } catch(const OocError& error) {
-            if(self->cursor != nullptr) {
-                cursor_close(self->cursor);
-                self->cursor = nullptr;
-            }
-            if(txn != nullptr)
-                txn_abort(txn);
-            error.pythonize();
-            return nullptr;
+            if(!found) throw OocError(OocError::ContainerGone);
         }
-    } else {
-        txn = mdb_cursor_txn(self->cursor);
-    }
-    assert(txn != nullptr);
 
-    PyObject* pyKey = nullptr;
-    PyObject* pyValue = nullptr;
-    try {
         MDB_val mdbKey;
         MDB_val mdbValue;
         const bool found = cursor_get(self->cursor, &mdbKey, &mdbValue, MDB_NEXT);
@@ -582,24 +625,21 @@ static PyObject* OOCLazyDictItemsIter_iternext(PyObject* const pySelf) {
             throw OocError(OocError::UnexpectedData);
         }
         DictItemKey* const dictItemKey = static_cast<DictItemKey* const>(mdbKey.mv_data);
+        if(dictItemKey->dictId != self->dict->dictId)
+            throw OocError(OocError::IndexError);
 
         if(mdbValue.mv_size != sizeof(EncodedValue))
             throw OocError(OocError::UnexpectedData);
         EncodedValue* const dictItemValue = static_cast<EncodedValue* const>(mdbValue.mv_data);
 
-        OOCTransaction oocTxn(txn, true);
-        pyKey = OOCMap_decode(ooc, &dictItemKey->key, oocTxn);
-        pyValue = OOCMap_decode(ooc, dictItemValue, oocTxn);
+        pyKey = OOCMap_decodeKey(ooc, &dictItemKey->key, *self->txn);
+        pyValue = OOCMap_decode(ooc, dictItemValue, *self->txn);
     } catch(const OocError& error) {
-        cursor_close(self->cursor);
-        self->cursor = nullptr;
-        if(error.errorCode == OocError::IndexError) {
-            txn_commit(txn);
-            Py_CLEAR(self->dict);
-        } else {
-            txn_abort(txn);
+        Py_XDECREF(pyKey);
+        OOCLazyDictItemsIter_release(self);
+        Py_CLEAR(self->dict);
+        if(error.errorCode != OocError::IndexError)
             error.pythonize();
-        }
         return nullptr;
     }
 
@@ -607,6 +647,7 @@ static PyObject* OOCLazyDictItemsIter_iternext(PyObject* const pySelf) {
     if(result == nullptr) {
         Py_DECREF(pyKey);
         Py_DECREF(pyValue);
+        return nullptr;
     }
     PyTuple_SET_ITEM(result, 0, pyKey);
     PyTuple_SET_ITEM(result, 1, pyValue);
@@ -15,11 +15,12 @@ typedef struct {
     PyObject_HEAD
     OOCMapObject* ooc;
     uint32_t dictId;
+    OOCTransactionObject* snapshot;     // the snapshot this was read through, if any
 } OOCLazyDictObject;
 
 extern PyTypeObject OOCLazyDictType;
 
-OOCLazyDictObject* OOCLazyDict_fastnew(OOCMapObject* ooc, uint32_t dictId);
+OOCLazyDictObject* OOCLazyDict_fastnew(OOCMapObject* ooc, uint32_t dictId, OOCTransactionObject* snapshot = nullptr);
 
 Py_ssize_t OOCLazyDictObject_length(OOCLazyDictObject* self, OOCTransaction& txn);
 PyObject* OOCLazyDictObject_eager(OOCLazyDictObject* self, OOCTransaction& txn);
@@ -47,6 +48,7 @@ OOCLazyDictItemsObject* OOCLazyDictItems_fastnew(OOCLazyDictObject* dict);
 typedef struct {
     PyObject_HEAD
     OOCLazyDictObject* dict;
+    OOCTransaction* txn;
     MDB_cursor* cursor;
 } OOCLazyDictItemsIterObject;
 
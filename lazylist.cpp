@@ -1,6 +1,13 @@
 #include "lazylist.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 #include "oocmap.h"
+#include "lazytuple.h"
+#include "liststore.h"
+#include "gc.h"
 #include "db.h"
 #include "errors.h"
 
@@ -10,26 +17,202 @@
 // These throw exceptions.
 //
 
-OOCLazyListObject* OOCLazyList_fastnew(OOCMapObject* const ooc, const uint32_t listId) {
+OOCLazyListObject* OOCLazyList_fastnew(
+    OOCMapObject* const ooc,
+    const uint32_t listId,
+    OOCTransactionObject* const snapshot
+) {
     PyObject* const pySelf = OOCLazyListType.tp_alloc(&OOCLazyListType, 0);
     if(pySelf == nullptr) throw OocError(OocError::OutOfMemory);
     OOCLazyListObject* self = reinterpret_cast<OOCLazyListObject*>(pySelf);
     self->ooc = ooc;
     Py_INCREF(ooc);
     self->listId = listId;
+    self->snapshot = snapshot;
+    Py_XINCREF(snapshot);
+    OOCGC_addRoot(ooc, TYPE_CODE_LIST, listId, snapshot);
     return self;
 }
 
-OOCLazyListIterObject* OOCLazyListIter_fastnew(OOCLazyListObject* const list) {
+OOCLazyListIterObject* OOCLazyListIter_fastnew(
+    OOCLazyListObject* const list,
+    const Py_ssize_t start,
+    const Py_ssize_t stop,
+    const Py_ssize_t step
+) {
     PyObject* const pySelf = OOCLazyListIterType.tp_alloc(&OOCLazyListIterType, 0);
     if(pySelf == nullptr) throw OocError(OocError::OutOfMemory);
     OOCLazyListIterObject* self = reinterpret_cast<OOCLazyListIterObject*>(pySelf);
     self->list = list;
     Py_INCREF(list);
-    self->cursor = nullptr;
+    self->txn = nullptr;
+    self->index = start;
+    self->stop = stop;
+    self->step = step;
+    self->chunk = nullptr;
+    self->chunkStart = 0;
+    return self;
+}
+
+OOCLazyListSliceObject* OOCLazyListSlice_fastnew(
+    OOCLazyListObject* const list,
+    const Py_ssize_t start,
+    const Py_ssize_t step,
+    const Py_ssize_t length
+) {
+    PyObject* const pySelf = OOCLazyListSliceType.tp_alloc(&OOCLazyListSliceType, 0);
+    if(pySelf == nullptr) throw OocError(OocError::OutOfMemory);
+    OOCLazyListSliceObject* self = reinterpret_cast<OOCLazyListSliceObject*>(pySelf);
+    self->list = list;
+    Py_INCREF(list);
+    self->start = start;
+    self->step = step;
+    self->length = length;
     return self;
 }
 
+// Finds the items of a slice that the list still has, when the list is `listLength` long now. There
+// are `*count` of them, and the first one is at `*first`.
+static void OOCLazyListSlice_bounds(
+    const OOCLazyListSliceObject* const self,
+    const Py_ssize_t listLength,
+    Py_ssize_t* const first,
+    Py_ssize_t* const count
+) {
+    *first = self->start;
+    *count = 0;
+    if(self->length == 0) return;
+    if(self->step > 0) {
+        if(self->start < listLength)
+            *count = std::min(self->length, (listLength - self->start + self->step - 1) / self->step);
+    } else {
+        // Going backwards, the items that are gone are the ones at the beginning of the slice.
+        Py_ssize_t skipped = 0;
+        if(self->start >= listLength)
+            skipped = (self->start - listLength - self->step) / -self->step;
+        *first = self->start + skipped * self->step;
+        *count = std::max<Py_ssize_t>(self->length - skipped, 0);
+    }
+}
+
+// Calls `visit(index, item)` for every item of a list in rows or blocks between start and stop,
+// until `visit` returns false. This reads a block's worth at a time.
+template<typename Visit>
+static void OOCLazyListObject_scan(
+    OOCLazyListObject* const self,
+    OOCTransaction& txn,
+    const ListHeader& header,
+    const Py_ssize_t start,
+    Py_ssize_t stop,
+    const Visit& visit
+) {
+    stop = std::min(stop, static_cast<Py_ssize_t>(header.length));
+    std::vector<EncodedValue> chunk;
+    for(Py_ssize_t chunkStart = std::max<Py_ssize_t>(start, 0); chunkStart < stop; chunkStart += chunk.size()) {
+        chunk.clear();
+        const Py_ssize_t chunkStop = std::min<Py_ssize_t>(stop, chunkStart + LIST_BLOCK_SIZE);
+        OOCListStore_read(self->ooc, txn, self->listId, header, chunkStart, chunkStop, chunk);
+        if(chunk.empty()) throw OocError(OocError::UnexpectedData);
+        for(size_t i = 0; i < chunk.size(); ++i) {
+            if(!visit(chunkStart + i, chunk[i]))
+                return;
+        }
+    }
+}
+
+// Calls `visit(index)` for every item between start and stop that equals value, until `visit`
+// returns false. In packed lists, this compares the raw numbers where it can, without making Python
+// objects, in a way that agrees with how Python compares ints and floats. In other lists, it
+// compares encoded values, unless value is mutable.
+template<typename Visit>
+static void OOCLazyListObject_find(
+    OOCLazyListObject* const self,
+    OOCTransaction& txn,
+    PyObject* const value,
+    const Py_ssize_t start,
+    Py_ssize_t stop,
+    const Visit& visit
+) {
+    const char* data;
+    const ListHeader header = OOCListStore_header(self->ooc, txn, self->listId, &data);
+    stop = std::min(stop, static_cast<Py_ssize_t>(header.length));
+
+    if(!ListHeader_isPacked(header)) {
+        const EncodedValue* encodedValue = nullptr;
+        try {
+            encodedValue = OOCMap_encode(self->ooc, value, txn, true, true);
+        } catch(const OocError& e) {
+            switch(e.errorCode) {
+            case OocError::MutableValueNotAllowed:
+                // For mutable values, we have to search linearly through the list and compare them all.
+                break;
+            case OocError::ImmutableValueNotFound:
+                // The immutable value isn't in the map yet, so it can't possibly be in the list.
+                return;
+            default:
+                throw;
+            }
+        }
+
+        OOCLazyListObject_scan(self, txn, header, start, stop, [&](const Py_ssize_t index, EncodedValue& item) {
+            if(encodedValue != nullptr)
+                return item != *encodedValue || visit(index);
+            PyObject* const decoded = OOCMap_decode(self->ooc, &item, txn);
+            const int comparison = PyObject_RichCompareBool(value, decoded, Py_EQ);
+            Py_DECREF(decoded);
+            if(comparison < 0) throw OocError(OocError::AlreadyPythonizedError);
+            return !comparison || visit(index);
+        });
+        return;
+    }
+
+    enum { NoMatch, CompareInts, CompareFloats, CompareObjects } mode = CompareObjects;
+    int64_t intValue = 0;
+    double floatValue = 0;
+    if(header.format == LIST_FORMAT_PACKED_FLOAT64) {
+        if(PyFloat_CheckExact(value)) {
+            mode = CompareFloats;
+            floatValue = PyFloat_AS_DOUBLE(value);
+        }
+    } else if(PyLong_CheckExact(value) || PyBool_Check(value)) {
+        int overflow;
+        intValue = PyLong_AsLongLongAndOverflow(value, &overflow);
+        mode = overflow ? NoMatch : CompareInts;
+    } else if(PyFloat_CheckExact(value)) {
+        const double d = PyFloat_AS_DOUBLE(value);
+        // 2**63 is exactly representable, but it is one more than the largest int64.
+        if(std::isfinite(d) && std::floor(d) == d && d >= -9223372036854775808.0 && d < 9223372036854775808.0) {
+            mode = CompareInts;
+            intValue = static_cast<int64_t>(d);
+        } else {
+            mode = NoMatch;
+        }
+    }
+    if(mode == NoMatch) return;
+
+    for(Py_ssize_t i = std::max<Py_ssize_t>(start, 0); i < stop; ++i) {
+        bool equal;
+        switch(mode) {
+        case CompareInts:
+            equal = OOCListStore_packedInt(header, data, i) == intValue;
+            break;
+        case CompareFloats:
+            equal = OOCListStore_packedFloat(data, i) == floatValue;
+            break;
+        default: {
+            PyObject* const item = OOCListStore_packedItem(header, data, i);
+            const int comparison = PyObject_RichCompareBool(value, item, Py_EQ);
+            Py_DECREF(item);
+            if(comparison < 0) throw OocError(OocError::AlreadyPythonizedError);
+            equal = comparison;
+            break;
+        }
+        }
+        if(equal && !visit(i))
+            return;
+    }
+}
+
 //
 // Methods that are directly exposed to Python
 // These are not allowed to throw exceptions.
@@ -44,6 +227,7 @@ static PyObject* OOCLazyList_new(PyTypeObject* const type, PyObject* const args,
     }
     self->ooc = nullptr;
     self->listId = 0;
+    self->snapshot = nullptr;
     return (PyObject*)self;
 }
 
@@ -55,7 +239,12 @@ static PyObject* OOCLazyListIter_new(PyTypeObject* const type, PyObject* const a
         return nullptr;
     }
     self->list = nullptr;
-    self->cursor = nullptr;
+    self->txn = nullptr;
+    self->index = 0;
+    self->stop = PY_SSIZE_T_MAX;
+    self->step = 1;
+    self->chunk = nullptr;
+    self->chunkStart = 0;
     return (PyObject*)self;
 }
 
@@ -75,6 +264,7 @@ static int OOCLazyList_init(OOCLazyListObject* const self, PyObject* const args,
     // TODO: consider that __init__ might be called on an already initialized object
     self->ooc = reinterpret_cast<OOCMapObject*>(oocmapObject);
     Py_INCREF(oocmapObject);
+    OOCGC_addRoot(self->ooc, TYPE_CODE_LIST, self->listId, self->snapshot);
 
     return 0;
 }
@@ -95,23 +285,34 @@ static int OOCLazyListIter_init(OOCLazyListIterObject* const self, PyObject* con
     // TODO: consider that __init__ might be called on an already initialized object
     self->list = reinterpret_cast<OOCLazyListObject*>(listObject);
     Py_INCREF(listObject);
-    self->cursor = nullptr;
+    self->txn = nullptr;
+    self->index = 0;
+    self->stop = PY_SSIZE_T_MAX;
+    self->step = 1;
+    self->chunk = nullptr;
+    self->chunkStart = 0;
 
     return 0;
 }
 
 static void OOCLazyList_dealloc(OOCLazyListObject* const self) {
+    if(self->ooc != nullptr)
+        OOCGC_removeRoot(self->ooc, TYPE_CODE_LIST, self->listId, self->snapshot);
     Py_DECREF(self->ooc);
+    Py_XDECREF(self->snapshot);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
+static void OOCLazyListIter_release(OOCLazyListIterObject* const self) {
+    delete self->chunk;
+    self->chunk = nullptr;
+    delete self->txn;
+    self->txn = nullptr;
+}
+
 static void OOCLazyListIter_dealloc(OOCLazyListIterObject* const self) {
     Py_XDECREF(self->list);
-    if(self->cursor != nullptr) {
-        MDB_txn* const txn = mdb_cursor_txn(self->cursor);
-        mdb_cursor_close(self->cursor);
-        txn_abort(txn);
-    }
+    OOCLazyListIter_release(self);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -123,7 +324,7 @@ static Py_ssize_t OOCLazyList_length(PyObject* const pySelf) {
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         const Py_ssize_t result = OOCLazyListObject_length(self, txn);
         txn.commit();
         return result;
@@ -134,17 +335,7 @@ static Py_ssize_t OOCLazyList_length(PyObject* const pySelf) {
 }
 
 Py_ssize_t OOCLazyListObject_length(OOCLazyListObject* const self, OOCTransaction& txn) {
-    ListKey encodedListKey = {
-        .listIndex = ListKey::listIndexLength,
-        .listId = self->listId,
-    };
-
-    MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
-    MDB_val mdbValue;
-    const bool found = get(txn.txn, self->ooc->listsDb, &mdbKey, &mdbValue);
-    if(!found) throw OocError(OocError::UnexpectedData);
-    if(mdbValue.mv_size != sizeof(uint32_t)) throw OocError(OocError::UnexpectedData);
-    return *reinterpret_cast<uint32_t*>(mdbValue.mv_data);
+    return OOCListStore_header(self->ooc, txn, self->listId).length;
 }
 
 static PyObject* OOCLazyList_item(PyObject* const pySelf, Py_ssize_t const index) {
@@ -161,20 +352,9 @@ static PyObject* OOCLazyList_item(PyObject* const pySelf, Py_ssize_t const index
     }
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
-    ListKey encodedListKey = {
-        .listIndex = index,
-        .listId = self->listId,
-    };
-
     try {
-        OOCTransaction txn(self->ooc, true);
-        MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
-        MDB_val mdbValue;
-        const bool found = get(txn.txn, self->ooc->listsDb, &mdbKey, &mdbValue);
-        if(!found) throw OocError(OocError::IndexError);
-        if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-        EncodedValue* const encodedResult = static_cast<EncodedValue* const>(mdbValue.mv_data);
-        PyObject* const result = OOCMap_decode(self->ooc, encodedResult, txn);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
+        PyObject* const result = OOCLazyListObject_item(self, txn, index);
         txn.commit();
         return result;
     } catch(const OocError& error) {
@@ -183,6 +363,16 @@ static PyObject* OOCLazyList_item(PyObject* const pySelf, Py_ssize_t const index
     }
 }
 
+PyObject* OOCLazyListObject_item(OOCLazyListObject* const self, OOCTransaction& txn, const Py_ssize_t index) {
+    const char* data;
+    const ListHeader header = OOCListStore_header(self->ooc, txn, self->listId, &data);
+    if(index < 0 || index >= header.length) throw OocError(OocError::IndexError);
+    if(ListHeader_isPacked(header))
+        return OOCListStore_packedItem(header, data, index);
+    EncodedValue encodedResult = OOCListStore_get(self->ooc, txn, self->listId, header, index);
+    return OOCMap_decode(self->ooc, &encodedResult, txn);
+}
+
 static int OOCLazyList_setItem(
     PyObject* const pySelf,
     const Py_ssize_t index,
@@ -201,81 +391,31 @@ static int OOCLazyList_setItem(
     }
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
-    ListKey encodedListKey = {
-        .listIndex = index,
-        .listId = self->listId,
-    };
-    OOCTransaction txn(self->ooc, false);
-    MDB_cursor* sourceCursor = nullptr;
-    MDB_cursor* destCursor = nullptr;
     try {
-        if(item == nullptr) {
-            // We're deleting the item by moving all items after it forwards by one.
-            MDB_val mdbValue;
-            destCursor = cursor_open(txn.txn, self->ooc->listsDb);
-            MDB_val mdbDestKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
-            bool destFound = cursor_get(destCursor, &mdbDestKey, &mdbValue, MDB_SET_KEY);
-            if(!destFound) throw OocError(OocError::IndexError);
-
-            sourceCursor = cursor_open(txn.txn, self->ooc->listsDb);
-            encodedListKey.listIndex += 1;
-            MDB_val mdbSourceKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
-            bool sourceFound = cursor_get(sourceCursor, &mdbSourceKey, &mdbValue, MDB_SET_RANGE);
-
-            while(sourceFound) {
-                if(mdbSourceKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
-                ListKey* const sourceListKey = reinterpret_cast<ListKey*>(mdbSourceKey.mv_data);
-                if(
-                    sourceListKey->listIndex == ListKey::listIndexLength ||
-                    sourceListKey->listId != self->listId
-                ) {
-                    sourceFound = false;
-                    break;
-                }
-
-                cursor_put(destCursor, &mdbDestKey, &mdbValue, MDB_CURRENT);
-
-                destFound = cursor_get(destCursor, &mdbDestKey, &mdbValue, MDB_NEXT);
-                if(!destFound) throw OocError(OocError::UnexpectedData);  // If we found the source before, we must find it again now.
-                sourceFound = cursor_get(sourceCursor, &mdbSourceKey, &mdbValue, MDB_NEXT);
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            if(item == nullptr) {
+                OOCLazyListObject_delItem(self, txn, index);
+            } else {
+                // We're setting the item.
+                if(index >= OOCLazyListObject_length(self, txn)) throw OocError(OocError::IndexError);
+                const EncodedValue encodedItem = *OOCMap_encode(self->ooc, item, txn);
+                OOCListStore_set(self->ooc, txn, self->listId, index, encodedItem);
             }
-
-            // sourceCursor now points to the length item, which must be updated
-            // destCursor now points to the last item, the one we're about to delete. The index of that
-            // item is the new length.
-            if(mdbDestKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
-            ListKey* const destListKey = reinterpret_cast<ListKey*>(mdbDestKey.mv_data);
-            mdbValue = (MDB_val) { .mv_size = sizeof(destListKey->listIndex), .mv_data = &destListKey->listIndex };
-            cursor_put(sourceCursor, &mdbDestKey, &mdbValue, MDB_CURRENT);
-            cursor_close(sourceCursor);
-
-            // destCursor now points to the last item and must be deleted
-            cursor_del(destCursor);
-            cursor_close(destCursor);
-        } else {
-            // We're setting the item.
-            const Py_ssize_t length = OOCLazyListObject_length(self, txn);
-            if(index >= length) throw OocError(OocError::IndexError);
-
-            Id2EncodedMap insertedItems;
-            const EncodedValue* const encodedItem = OOCMap_encode(self->ooc, item, txn);
-            MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
-            MDB_val mdbValue = {
-                .mv_size = sizeof(*encodedItem),
-                .mv_data = const_cast<EncodedValue*>(encodedItem)
-            };
-            put(txn.txn, self->ooc->listsDb, &mdbKey, &mdbValue);
-        }
-        txn.commit();
+            txn.commit();
+        });
         return 0;
     } catch(const OocError& error) {
-        if(sourceCursor != nullptr) cursor_close(sourceCursor);
-        if(destCursor != nullptr) cursor_close(destCursor);
         error.pythonize();
         return -1;
     }
 }
 
+void OOCLazyListObject_delItem(OOCLazyListObject* const self, OOCTransaction& txn, const Py_ssize_t index) {
+    if(index >= OOCLazyListObject_length(self, txn)) throw OocError(OocError::IndexError);
+    OOCListStore_splice(self->ooc, txn, self->listId, index, index + 1, nullptr, 0);
+}
+
 PyObject* OOCLazyList_eager(PyObject* const pySelf) {
     if(pySelf->ob_type != &OOCLazyListType) {
         PyErr_BadArgument();
@@ -284,10 +424,9 @@ PyObject* OOCLazyList_eager(PyObject* const pySelf) {
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         PyObject* const result = OOCLazyListObject_eager(self, txn);
         txn.commit();
-        PyObject_Print(result, stderr, Py_PRINT_RAW);
         return result;
     } catch(const OocError& error) {
         error.pythonize();
@@ -296,52 +435,35 @@ PyObject* OOCLazyList_eager(PyObject* const pySelf) {
 }
 
 PyObject* OOCLazyListObject_eager(OOCLazyListObject* const self, OOCTransaction& txn) {
-    const Py_ssize_t length = OOCLazyListObject_length(self, txn);
-    PyObject* result = nullptr;
-    MDB_cursor* cursor = nullptr;
-    try {
-        result = PyList_New(length);
-        if(result == nullptr) throw OocError(OocError::OutOfMemory);
-        if(length <= 0) return result;
-        cursor = cursor_open(txn.txn, self->ooc->listsDb);
-
-        ListKey encodedListKey = {
-            .listIndex = 0,
-            .listId = self->listId,
-        };
-        MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
-        MDB_val mdbValue;
-        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_RANGE);
-
-        while(found) {
-            if(mdbKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
-            ListKey* const listItemKey = static_cast<ListKey*>(mdbKey.mv_data);
-            if(
-                listItemKey->listId != self->listId ||
-                listItemKey->listIndex == ListKey::listIndexLength
-            ) {
-                found = false;
-                break;
-            }
-            if(listItemKey->listIndex != encodedListKey.listIndex) throw OocError(OocError::UnexpectedData);
-            encodedListKey.listIndex += 1;  // We just do this to check that we're setting all the elements in the list.
-
-            if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-            EncodedValue* const encodedResult = static_cast<EncodedValue* const>(mdbValue.mv_data);
-            PyObject* const item = OOCMap_decode(self->ooc, encodedResult, txn);
-            PyList_SET_ITEM(result, listItemKey->listIndex, item);
-
-            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+    // Read everything from LMDB in one go without the GIL, and then build the Python objects.
+    std::vector<FetchedValue> items;
+    ListHeader header;
+    const char* packedData;
+    {
+        GilUnlocker gil;
+        header = OOCListStore_header(self->ooc, txn, self->listId, &packedData);
+        if(!ListHeader_isPacked(header)) {
+            std::vector<EncodedValue> encodedItems;
+            OOCListStore_read(self->ooc, txn, self->listId, header, 0, header.length, encodedItems);
+            items.resize(encodedItems.size());
+            for(size_t i = 0; i < encodedItems.size(); ++i)
+                OOCMap_fetch(self->ooc, &encodedItems[i], txn, &items[i]);
         }
-        if(encodedListKey.listIndex != length) throw OocError(OocError::UnexpectedData);  // We didn't set all the values in the list.
+    }
 
-        cursor_close(cursor);
+    PyObject* const result = PyList_New(header.length);
+    if(result == nullptr) throw OocError(OocError::OutOfMemory);
+    try {
+        if(ListHeader_isPacked(header)) {
+            for(uint32_t i = 0; i < header.length; ++i)
+                PyList_SET_ITEM(result, i, OOCListStore_packedItem(header, packedData, i));
+        }
+        for(size_t i = 0; i < items.size(); ++i)
+            PyList_SET_ITEM(result, i, OOCMap_decode(self->ooc, &items[i], txn));
     } catch(...) {
-        if(cursor != nullptr) cursor_close(cursor);
-        if(result != nullptr) Py_DECREF(result);
+        Py_DECREF(result);
         throw;
     }
-
     return result;
 }
 
@@ -377,7 +499,7 @@ static PyObject* OOCLazyList_index(
 
     Py_ssize_t index;
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         index = OOCLazyListObject_index(self, txn, value, start, stop);
         txn.commit();
     } catch(const OocError& error) {
@@ -415,70 +537,12 @@ Py_ssize_t OOCLazyListObject_index(
         stop += length;
     }
 
-    Id2EncodedMap insertedItemsInThisTransaction;
-    const EncodedValue* encodedValue = nullptr;
-    try {
-        encodedValue = OOCMap_encode(self->ooc, value, txn, true, true);
-    } catch(const OocError& e) {
-        switch(e.errorCode) {
-        case OocError::MutableValueNotAllowed:
-            // For mutable values, we have to search linearly through the list and compare them all.
-            break;
-        case OocError::ImmutableValueNotFound:
-            // The immutable value isn't in the map yet, so it can't possibly be in the list.
-            return -1;
-        default:
-            throw;
-        }
-    }
-
-    ListKey encodedListKey = {
-        .listIndex = start,
-        .listId = self->listId,
-    };
-    MDB_val mdbKey = {.mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey};
-    MDB_val mdbValue;
-    MDB_cursor* const cursor = cursor_open(txn.txn, self->ooc->listsDb);
-    bool found;
-    try {
-        found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_RANGE);
-        while(found) {
-            if(mdbKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
-            ListKey* const listItemKey = static_cast<ListKey*>(mdbKey.mv_data);
-            if(
-                listItemKey->listIndex >= stop ||
-                listItemKey->listId != self->listId ||
-                listItemKey->listIndex == ListKey::listIndexLength
-            ) {
-                found = false;
-                break;
-            }
-
-            if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-            EncodedValue* const encodedItem = static_cast<EncodedValue* const>(mdbValue.mv_data);
-            if(encodedValue == nullptr) {
-                PyObject* const item = OOCMap_decode(self->ooc, encodedItem, txn);
-                if(PyObject_RichCompareBool(value, item, Py_EQ))
-                    break;
-            } else {
-                if(*encodedValue == *encodedItem)
-                    break;
-            }
-
-            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
-        }
-
-        cursor_close(cursor);
-    } catch(...) {
-        cursor_close(cursor);
-        throw;
-    }
-
-    if(!found)
-        return -1;
-
-    ListKey* const listKey = static_cast<ListKey* const>(mdbKey.mv_data);
-    return listKey->listIndex;
+    Py_ssize_t result = -1;
+    OOCLazyListObject_find(self, txn, value, start, stop, [&](const Py_ssize_t index) {
+        result = index;
+        return false;
+    });
+    return result;
 }
 
 static PyObject* OOCLazyList_count(
@@ -493,7 +557,7 @@ static PyObject* OOCLazyList_count(
 
     Py_ssize_t count;
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         count = OOCLazyListObject_count(self, txn, value);
         txn.commit();
     } catch(const OocError& error) {
@@ -505,65 +569,11 @@ static PyObject* OOCLazyList_count(
 }
 
 Py_ssize_t OOCLazyListObject_count(OOCLazyListObject* self, OOCTransaction& txn, PyObject* value) {
-    Id2EncodedMap insertedItemsInThisTransaction;
-    const EncodedValue* encodedValue = nullptr;
-    try {
-        encodedValue = OOCMap_encode(self->ooc, value, txn, true, true);
-    } catch(const OocError& e) {
-        switch(e.errorCode) {
-        case OocError::MutableValueNotAllowed:
-            // For mutable values, we have to search linearly through the list and compare them all.
-            break;
-        case OocError::ImmutableValueNotFound:
-            // The immutable value isn't in the map yet, so it can't possibly be in the list.
-            return 0;
-        default:
-            throw;
-        }
-    }
-
-    ListKey encodedListKey = {
-        .listIndex = 0,
-        .listId = self->listId,
-    };
     Py_ssize_t count = 0;
-    MDB_cursor* const cursor = cursor_open(txn.txn, self->ooc->listsDb);
-    try {
-        MDB_val mdbKey = {.mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey};
-        MDB_val mdbValue;
-        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_RANGE);
-
-        while(found) {
-            if(mdbKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
-            ListKey* const listItemKey = static_cast<ListKey*>(mdbKey.mv_data);
-            if(
-                listItemKey->listId != self->listId ||
-                listItemKey->listIndex == ListKey::listIndexLength
-            ) {
-                found = false;
-                break;
-            }
-
-            if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-            EncodedValue* const encodedItem = static_cast<EncodedValue* const>(mdbValue.mv_data);
-            if(encodedValue == nullptr) {
-                PyObject* const item = OOCMap_decode(self->ooc, encodedItem, txn);
-                if(PyObject_RichCompareBool(value, item, Py_EQ))
-                    count += 1;
-            } else {
-                if(*encodedValue == *encodedItem)
-                    count += 1;
-            }
-
-            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
-        }
-
-        cursor_close(cursor);
-    } catch(...) {
-        cursor_close(cursor);
-        throw;
-    }
-
+    OOCLazyListObject_find(self, txn, value, 0, ListKey::listIndexLength, [&](Py_ssize_t) {
+        count += 1;
+        return true;
+    });
     return count;
 }
 
@@ -577,12 +587,18 @@ static PyObject* OOCLazyList_extend(
     }
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
+    PyObject* reiterableOther = nullptr;
     try {
-        OOCTransaction txn(self->ooc, false);
-        OOCLazyListObject_extend(self, txn, other);
-        txn.commit();
+        reiterableOther = OOCMap_reiterable(other);
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            OOCLazyListObject_extend(self, txn, reiterableOther);
+            txn.commit();
+        });
+        Py_DECREF(reiterableOther);
     } catch(const OocError& error) {
         error.pythonize();
+        Py_XDECREF(reiterableOther);
         return nullptr;
     }
 
@@ -597,29 +613,21 @@ void OOCLazyListObject_extend(OOCLazyListObject* self, OOCTransaction& txn, PyOb
         PyObject* const iter = PyObject_GetIter(pyOther);
         if(iter == nullptr) throw OocError(OocError::AlreadyPythonizedError);
         try {
-            ListKey selfEncodedListKey = {
-                .listIndex = OOCLazyListObject_length(self, txn),
-                .listId = self->listId
-            };
-            MDB_val mdbSelfKey = {.mv_size = sizeof(selfEncodedListKey), .mv_data = &selfEncodedListKey};
-
+            std::vector<EncodedValue> encodedItems;
             PyObject* item;
             while((item = PyIter_Next(iter))) {
-                const EncodedValue* const encodedItem = OOCMap_encode(self->ooc, item, txn);
+                try {
+                    encodedItems.push_back(*OOCMap_encode(self->ooc, item, txn));
+                } catch(...) {
+                    Py_DECREF(item);
+                    throw;
+                }
                 Py_DECREF(item);
-                MDB_val mdbValue = {
-                    .mv_size = sizeof(*encodedItem),
-                    .mv_data = const_cast<EncodedValue*>(encodedItem)
-                };
-                put(txn.txn, self->ooc->listsDb, &mdbSelfKey, &mdbValue);
-                selfEncodedListKey.listIndex += 1;
             }
+            if(PyErr_Occurred()) throw OocError(OocError::AlreadyPythonizedError);
 
-            // write the new length
-            uint32_t newLength = selfEncodedListKey.listIndex;
-            MDB_val mdbLength = {.mv_size = sizeof(newLength), .mv_data = &newLength};
-            selfEncodedListKey.listIndex = ListKey::listIndexLength;
-            put(txn.txn, self->ooc->listsDb, &mdbSelfKey, &mdbLength);
+            const uint32_t length = OOCLazyListObject_length(self, txn);
+            OOCListStore_splice(self->ooc, txn, self->listId, length, length, encodedItems.data(), encodedItems.size());
             Py_DECREF(iter);
         } catch(...) {
             Py_DECREF(iter);
@@ -635,55 +643,36 @@ void OOCLazyListObject_extend(OOCLazyListObject* self, OOCTransaction& txn, OOCL
             return;
         }
 
-        ListKey selfEncodedListKey = {
-            .listIndex = OOCLazyListObject_length(self, txn),
-            .listId = self->listId
-        };
-        ListKey otherEncodedListKey = {
-            .listIndex = 0,
-            .listId = other->listId
-        };
-        MDB_val mdbSelfKey = {.mv_size = sizeof(selfEncodedListKey), .mv_data = &selfEncodedListKey};
-        MDB_val mdbOtherKey = {.mv_size = sizeof(otherEncodedListKey), .mv_data = &otherEncodedListKey};
-        MDB_cursor* const cursor = cursor_open(txn.txn, other->ooc->listsDb);
-        try {
-            MDB_val mdbValue;
-            bool found = cursor_get(cursor, &mdbOtherKey, &mdbValue, MDB_SET_RANGE);
-            while(found) {
-                if(mdbOtherKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
-                ListKey* const listItemKey = static_cast<ListKey*>(mdbOtherKey.mv_data);
-                if(
-                    listItemKey->listId != other->listId ||
-                    listItemKey->listIndex == ListKey::listIndexLength
-                ) {
-                    break;
-                }
-
-                if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-                put(txn.txn, self->ooc->listsDb, &mdbSelfKey, &mdbValue);
-                selfEncodedListKey.listIndex += 1;
-
-                found = cursor_get(cursor, &mdbOtherKey, &mdbValue, MDB_NEXT);
-            }
-
-            cursor_close(cursor);
-        } catch(const MdbError& e) {
-            cursor_close(cursor);
-            if(e.mdbErrorCode != MDB_NOTFOUND)
+        const ListHeader otherHeader = OOCListStore_header(other->ooc, txn, other->listId);
+        if(ListHeader_isPacked(otherHeader)) {
+            PyObject* const eager = OOCLazyListObject_eager(other, txn);
+            try {
+                OOCLazyListObject_extend(self, txn, eager);
+            } catch(...) {
+                Py_DECREF(eager);
                 throw;
-        } catch(...) {
-            cursor_close(cursor);
-            throw;
+            }
+            Py_DECREF(eager);
+            return;
         }
 
-        // write the new length
-        uint32_t newLength = selfEncodedListKey.listIndex;
-        MDB_val mdbLength = {.mv_size = sizeof(newLength), .mv_data = &newLength};
-        selfEncodedListKey.listIndex = ListKey::listIndexLength;
-        put(txn.txn, self->ooc->listsDb, &mdbSelfKey, &mdbLength);
+        std::vector<EncodedValue> encodedItems;
+        OOCListStore_read(other->ooc, txn, other->listId, otherHeader, 0, otherHeader.length, encodedItems);
+        // These don't go through OOCMap_encode(), so they need the write barrier here.
+        for(const EncodedValue& item : encodedItems)
+            OOCGC_shade(self->ooc, item);
+        const uint32_t length = OOCLazyListObject_length(self, txn);
+        OOCListStore_splice(self->ooc, txn, self->listId, length, length, encodedItems.data(), encodedItems.size());
     } else {
         PyObject* const eager = OOCLazyList_eager(reinterpret_cast<PyObject* const>(other));
-        OOCLazyListObject_extend(self, txn, eager);
+        if(eager == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+        try {
+            OOCLazyListObject_extend(self, txn, eager);
+        } catch(...) {
+            Py_DECREF(eager);
+            throw;
+        }
+        Py_DECREF(eager);
     }
 }
 
@@ -694,12 +683,18 @@ static PyObject* OOCLazyList_inplaceConcat(PyObject* const pySelf, PyObject* con
     }
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
+    PyObject* reiterableOther = nullptr;
     try {
-        OOCTransaction txn(self->ooc, false);
-        OOCLazyListObject_extend(self, txn, other);
-        txn.commit();
+        reiterableOther = OOCMap_reiterable(other);
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            OOCLazyListObject_extend(self, txn, reiterableOther);
+            txn.commit();
+        });
+        Py_DECREF(reiterableOther);
     } catch(const OocError& error) {
         error.pythonize();
+        Py_XDECREF(reiterableOther);
         return nullptr;
     }
 
@@ -715,9 +710,11 @@ static PyObject* OOCLazyList_inplaceRepeat(PyObject* const pySelf, const Py_ssiz
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, false);
-        OOCLazyListObject_inplaceRepeat(self, txn, count);
-        txn.commit();
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            OOCLazyListObject_inplaceRepeat(self, txn, count);
+            txn.commit();
+        });
     } catch(const OocError& error) {
         error.pythonize();
         return nullptr;
@@ -733,64 +730,31 @@ void OOCLazyListObject_inplaceRepeat(OOCLazyListObject* self, OOCTransaction& tx
         return;
     }
 
-    const Py_ssize_t length = OOCLazyListObject_length(self, txn);
-    if(length <= 0) return;
-
-    /*
-     * This is a little bit clever. It reads items at the start of the list, and it writes items at the
-     * end of the list. When it has gone through the original list once, it will start reading items
-     * that it wrote earlier in the same operation. This is fine. It makes the code easier.
-     */
-
-    ListKey destEncodedListKey = {
-        .listIndex = length,
-        .listId = self->listId
-    };
-    ListKey sourceEncodedListKey = {
-        .listIndex = 0,
-        .listId = self->listId
-    };
-    MDB_val mdbDestKey = {.mv_size = sizeof(destEncodedListKey), .mv_data = &destEncodedListKey};
-    MDB_val mdbSourceKey = {.mv_size = sizeof(sourceEncodedListKey), .mv_data = &sourceEncodedListKey};
-    MDB_cursor* const cursor = cursor_open(txn.txn, self->ooc->listsDb);
-    try {
-        MDB_val mdbValue;
-        bool found = cursor_get(cursor, &mdbSourceKey, &mdbValue, MDB_SET_RANGE);
-        if(!found) throw OocError(OocError::UnexpectedData);
-        while(destEncodedListKey.listIndex < length * count) {
-            if(mdbSourceKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
-            ListKey* const listItemKey = static_cast<ListKey*>(mdbSourceKey.mv_data);
-            if(
-                listItemKey->listId != self->listId ||
-                listItemKey->listIndex == ListKey::listIndexLength
-            ) {
-                found = false;
-                break;
-            }
-
-            if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-            put(txn.txn, self->ooc->listsDb, &mdbDestKey, &mdbValue);
-            destEncodedListKey.listIndex += 1;
-
-            found = cursor_get(cursor, &mdbSourceKey, &mdbValue, MDB_NEXT);
-            if(!found) throw OocError(OocError::UnexpectedData);
-        }
-
-        cursor_close(cursor);
-    } catch(const MdbError& e) {
-        cursor_close(cursor);
-        if(e.mdbErrorCode != MDB_NOTFOUND)
+    const ListHeader header = OOCListStore_header(self->ooc, txn, self->listId);
+    if(header.length <= 0 || count == 1) return;
+    if(ListHeader_isPacked(header)) {
+        PyObject* const eager = OOCLazyListObject_eager(self, txn);
+        PyObject* const repeated = PySequence_Repeat(eager, count - 1);
+        Py_DECREF(eager);
+        if(repeated == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+        try {
+            OOCLazyListObject_extend(self, txn, repeated);
+        } catch(...) {
+            Py_DECREF(repeated);
             throw;
-    } catch(...) {
-        cursor_close(cursor);
-        throw;
+        }
+        Py_DECREF(repeated);
+        return;
     }
 
-    // write the new length
-    uint32_t newLength = destEncodedListKey.listIndex;
-    MDB_val mdbLength = {.mv_size = sizeof(newLength), .mv_data = &newLength};
-    destEncodedListKey.listIndex = ListKey::listIndexLength;
-    put(txn.txn, self->ooc->listsDb, &mdbDestKey, &mdbLength);
+    std::vector<EncodedValue> encodedItems;
+    OOCListStore_read(self->ooc, txn, self->listId, header, 0, header.length, encodedItems);
+    encodedItems.reserve(encodedItems.size() * (count - 1));
+    for(unsigned int i = 2; i < count; ++i) {
+        for(uint32_t j = 0; j < header.length; ++j)
+            encodedItems.push_back(encodedItems[j]);
+    }
+    OOCListStore_splice(self->ooc, txn, self->listId, header.length, header.length, encodedItems.data(), encodedItems.size());
 }
 
 static PyObject* OOCLazyList_append(
@@ -804,9 +768,11 @@ static PyObject* OOCLazyList_append(
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, false);
-        OOCLazyListObject_append(self, txn, other);
-        txn.commit();
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            OOCLazyListObject_append(self, txn, other);
+            txn.commit();
+        });
     } catch(const OocError& error) {
         error.pythonize();
         return nullptr;
@@ -816,82 +782,170 @@ static PyObject* OOCLazyList_append(
 }
 
 void OOCLazyListObject_append(OOCLazyListObject* self, OOCTransaction& txn, PyObject* item) {
-    const EncodedValue* const encodedItem = OOCMap_encode(self->ooc, item, txn);
-
-    ListKey selfEncodedListKey = {
-        .listIndex = OOCLazyListObject_length(self, txn),
-        .listId = self->listId
-    };
-    MDB_val mdbSelfKey = {.mv_size = sizeof(selfEncodedListKey), .mv_data = &selfEncodedListKey};
-    MDB_val mdbValue = {
-        .mv_size = sizeof(*encodedItem),
-        .mv_data = const_cast<EncodedValue*>(encodedItem)
-    };
-    put(txn.txn, self->ooc->listsDb, &mdbSelfKey, &mdbValue);
-
-    // write the new length
-    uint32_t newLength = selfEncodedListKey.listIndex + 1;
-    MDB_val mdbLength = {.mv_size = sizeof(newLength), .mv_data = &newLength};
-    selfEncodedListKey.listIndex = ListKey::listIndexLength;
-    put(txn.txn, self->ooc->listsDb, &mdbSelfKey, &mdbLength);
+    const EncodedValue encodedItem = *OOCMap_encode(self->ooc, item, txn);
+    const uint32_t length = OOCLazyListObject_length(self, txn);
+    OOCListStore_splice(self->ooc, txn, self->listId, length, length, &encodedItem, 1);
 }
 
-PyObject* OOCLazyList_clear(PyObject* const pySelf) {
+static PyObject* OOCLazyList_insert(
+    PyObject* const pySelf,
+    PyObject *const *const args,
+    const Py_ssize_t nargs
+) {
     if(pySelf->ob_type != &OOCLazyListType) {
         PyErr_BadArgument();
         return nullptr;
     }
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
+    // parse parameters
+    if(nargs != 2) {
+        PyErr_Format(PyExc_TypeError, "insert expected 2 arguments, got %zd", nargs);
+        return nullptr;
+    }
+    const Py_ssize_t index = PyLong_AsSsize_t(args[0]);
+    if(PyErr_Occurred()) return nullptr;
+
     try {
-        OOCTransaction txn(self->ooc, false);
-        OOCLazyListObject_clear(self, txn);
-        txn.commit();
-        Py_RETURN_NONE;
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            OOCLazyListObject_insert(self, txn, index, args[1]);
+            txn.commit();
+        });
     } catch(const OocError& error) {
         error.pythonize();
         return nullptr;
     }
+
+    Py_RETURN_NONE;
 }
 
-void OOCLazyListObject_clear(OOCLazyListObject* const self, OOCTransaction& txn) {
-    MDB_cursor* cursor = nullptr;
-    try {
-        cursor = cursor_open(txn.txn, self->ooc->listsDb);
-
-        ListKey encodedListKey = {
-            .listIndex = 0,
-            .listId = self->listId,
-        };
-        MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
-        MDB_val mdbValue;
-        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_RANGE);
-
-        while(found) {
-            if(mdbKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
-            ListKey* const listItemKey = static_cast<ListKey*>(mdbKey.mv_data);
-            if(
-                listItemKey->listId != self->listId ||
-                listItemKey->listIndex == ListKey::listIndexLength
-            ) {
-                found = false;
-                break;
-            }
+void OOCLazyListObject_insert(OOCLazyListObject* self, OOCTransaction& txn, Py_ssize_t index, PyObject* item) {
+    const EncodedValue encodedItem = *OOCMap_encode(self->ooc, item, txn);
+    const Py_ssize_t length = OOCLazyListObject_length(self, txn);
+    if(index < 0) {
+        index += length;
+        if(index < 0)
+            index = 0;
+    }
+    if(index > length)
+        index = length;
+    OOCListStore_splice(self->ooc, txn, self->listId, index, index, &encodedItem, 1);
+}
 
-            cursor_del(cursor);
-            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
-        }
+static PyObject* OOCLazyList_pop(
+    PyObject* const pySelf,
+    PyObject *const *const args,
+    const Py_ssize_t nargs
+) {
+    if(pySelf->ob_type != &OOCLazyListType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
-        // cursor is now positioned at the length item, which we overwrite with 0
-        static uint32_t zeroLength = 0;
-        mdbValue = (MDB_val) { .mv_size = sizeof(zeroLength), .mv_data = &zeroLength };
-        cursor_put(cursor, &mdbKey, &mdbValue, MDB_CURRENT);
+    // parse parameters
+    if(nargs > 1) {
+        PyErr_Format(PyExc_TypeError, "pop expected at most 1 argument, got %zd", nargs);
+        return nullptr;
+    }
+    Py_ssize_t index = -1;
+    if(nargs > 0) {
+        index = PyLong_AsSsize_t(args[0]);
+        if(PyErr_Occurred()) return nullptr;
+    }
+
+    PyObject* result = nullptr;
+    try {
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            Py_CLEAR(result);
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            result = OOCLazyListObject_pop(self, txn, index);
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        Py_XDECREF(result);
+        error.pythonize();
+        return nullptr;
+    }
+
+    return result;
+}
 
-        cursor_close(cursor);
+PyObject* OOCLazyListObject_pop(OOCLazyListObject* self, OOCTransaction& txn, Py_ssize_t index) {
+    const Py_ssize_t length = OOCLazyListObject_length(self, txn);
+    if(index < 0)
+        index += length;
+    PyObject* const result = OOCLazyListObject_item(self, txn, index);
+    try {
+        // This may have been the last reference to a tuple, so it reads it while it is still there.
+        OOCLazyTuple_loadAll(result, txn);
+        OOCListStore_splice(self->ooc, txn, self->listId, index, index + 1, nullptr, 0);
     } catch(...) {
-        if(cursor != nullptr) cursor_close(cursor);
+        Py_DECREF(result);
         throw;
     }
+    return result;
+}
+
+static PyObject* OOCLazyList_remove(
+    PyObject* const pySelf,
+    PyObject* const value
+) {
+    if(pySelf->ob_type != &OOCLazyListType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
+
+    bool removed = false;
+    try {
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            removed = OOCLazyListObject_remove(self, txn, value);
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+
+    if(!removed) {
+        PyErr_Format(PyExc_ValueError, "list.remove(x): x not in list");
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+bool OOCLazyListObject_remove(OOCLazyListObject* self, OOCTransaction& txn, PyObject* value) {
+    const Py_ssize_t index = OOCLazyListObject_index(self, txn, value);
+    if(index < 0) return false;
+    OOCListStore_splice(self->ooc, txn, self->listId, index, index + 1, nullptr, 0);
+    return true;
+}
+
+PyObject* OOCLazyList_clear(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCLazyListType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
+
+    try {
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            OOCLazyListObject_clear(self, txn);
+            txn.commit();
+        });
+        Py_RETURN_NONE;
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
+
+void OOCLazyListObject_clear(OOCLazyListObject* const self, OOCTransaction& txn) {
+    OOCListStore_clear(self->ooc, txn, self->listId);
 }
 
 static int OOCLazyList_contains(PyObject* const pySelf, PyObject* const item) {
@@ -902,7 +956,7 @@ static int OOCLazyList_contains(PyObject* const pySelf, PyObject* const item) {
     OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
 
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         const Py_ssize_t index = OOCLazyListObject_index(self, txn, item);
         txn.commit();
         if(index < 0) return 0; else return 1;
@@ -967,77 +1021,75 @@ static PyObject* OOCLazyListIter_iternext(PyObject* const pySelf) {
     if(self->list == nullptr) return nullptr;
     OOCMapObject* const ooc = self->list->ooc;
 
-    if(self->cursor == nullptr) {
-        MDB_txn* txn = nullptr;
-        try {
-            txn = txn_begin(ooc->mdb, false);
-            self->cursor = cursor_open(txn, ooc->listsDb);
-
-            ListKey encodedListKey = {
-                .listIndex = 0,
-                .listId = self->list->listId
-            };
-            MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
-            MDB_val mdbValue;
-            const bool found = cursor_get(self->cursor, &mdbKey, &mdbValue, MDB_SET_KEY);
-            if(!found) {
-                cursor_close(self->cursor);
-                self->cursor = nullptr;
-                txn_commit(txn);
-                Py_CLEAR(self->list);
-                return nullptr;
-            } else {
-                if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-                EncodedValue* const encodedResult = static_cast<EncodedValue* const>(mdbValue.mv_data);
-                OOCTransaction oocTxn(txn, true);
-                return OOCMap_decode(ooc, encodedResult, oocTxn);
-            }
-        } catch(const OocError& error) {
-            if(self->cursor != nullptr) {
-                cursor_close(self->cursor);
-                self->cursor = nullptr;
-            }
-            if(txn != nullptr)
-                txn_abort(txn);
-            error.pythonize();
-            return nullptr;
+    // If the transaction is only waiting for a savepoint to end, we can carry on after that.
+    if(self->txn != nullptr && !self->txn->isAlive()) {
+        OocError(OocError::TransactionEnded).pythonize();
+        return nullptr;
+    }
+
+    try {
+        if(self->txn == nullptr)
+            self->txn = new OOCTransaction(ooc, true, self->list->snapshot);
+
+        // Items are read a block's worth at a time. Changes to the list show up in the next chunk.
+        const bool forward = self->step > 0;
+        const Py_ssize_t chunkOffset = self->index - self->chunkStart;
+        if(
+            self->chunk != nullptr &&
+            (forward ? self->index < self->stop : self->index > self->stop) &&
+            chunkOffset >= 0 && chunkOffset < static_cast<Py_ssize_t>(self->chunk->size())
+        ) {
+            self->index += self->step;
+            return OOCMap_decode(ooc, &(*self->chunk)[chunkOffset], *self->txn);
         }
-    } else {
-        MDB_txn* txn = mdb_cursor_txn(self->cursor);
-        try {
-            MDB_val mdbKey;
-            MDB_val mdbValue;
-            const bool found = cursor_get(self->cursor, &mdbKey, &mdbValue, MDB_NEXT);
-            if(!found) {
-                cursor_close(self->cursor);
-                self->cursor = nullptr;
-                txn_commit(txn);
-                Py_CLEAR(self->list);
-                return nullptr;
-            }
-            if(mdbKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
-            ListKey* const listKey = static_cast<ListKey* const>(mdbKey.mv_data);
-            if(
-                listKey->listIndex == ListKey::listIndexLength ||
-                listKey->listId != self->list->listId
-            ) {
-                cursor_close(self->cursor);
-                self->cursor = nullptr;
-                txn_commit(txn);
-                Py_CLEAR(self->list);
-                return nullptr;
-            }
-            if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
-            EncodedValue* const encodedResult = static_cast<EncodedValue* const>(mdbValue.mv_data);
-            OOCTransaction oocTxn(txn, true);
-            return OOCMap_decode(ooc, encodedResult, oocTxn);
-        } catch(const OocError& error) {
-            cursor_close(self->cursor);
-            self->cursor = nullptr;
-            txn_abort(txn);
-            error.pythonize();
+
+        const char* data;
+        const ListHeader header = OOCListStore_header(ooc, *self->txn, self->list->listId, &data);
+        const Py_ssize_t length = header.length;
+        if(!forward && self->index >= length) {
+            // The list got shorter, so skip the items that are gone.
+            self->index -= (self->index - length - self->step) / -self->step * -self->step;
+        }
+        if(self->index < 0 || self->index >= length || (forward ? self->index >= self->stop : self->index <= self->stop)) {
+            OOCLazyListIter_release(self);
+            Py_CLEAR(self->list);
             return nullptr;
         }
+
+        if(ListHeader_isPacked(header)) {
+            // The packed record is read again every time, because the list may change between calls.
+            PyObject* const result = OOCListStore_packedItem(header, data, self->index);
+            self->index += self->step;
+            return result;
+        }
+
+        // When the items are further apart than a block, reading whole blocks would only read items
+        // that are skipped.
+        const Py_ssize_t span = std::abs(self->step) >= LIST_BLOCK_SIZE ? 1 : LIST_BLOCK_SIZE;
+        Py_ssize_t chunkStart;
+        Py_ssize_t chunkStop;
+        if(forward) {
+            chunkStart = self->index;
+            chunkStop = std::min(self->index + span, self->stop);
+        } else {
+            chunkStart = std::max<Py_ssize_t>(self->index - span + 1, std::max<Py_ssize_t>(self->stop + 1, 0));
+            chunkStop = self->index + 1;
+        }
+        if(self->chunk == nullptr)
+            self->chunk = new std::vector<EncodedValue>();
+        self->chunk->clear();
+        self->chunkStart = chunkStart;
+        OOCListStore_read(ooc, *self->txn, self->list->listId, header, chunkStart, chunkStop, *self->chunk);
+        if(static_cast<Py_ssize_t>(self->chunk->size()) <= self->index - chunkStart)
+            throw OocError(OocError::UnexpectedData);
+        EncodedValue& item = (*self->chunk)[self->index - chunkStart];
+        self->index += self->step;
+        return OOCMap_decode(ooc, &item, *self->txn);
+    } catch(const OocError& error) {
+        OOCLazyListIter_release(self);
+        Py_CLEAR(self->list);
+        error.pythonize();
+        return nullptr;
     }
 }
 
@@ -1091,12 +1143,12 @@ static PyObject* _computeRichcompareResult(const int comparisonResult, const int
 }
 
 PyObject* OOCLazyList_richcompare(PyObject* const pySelf, PyObject* const other, const int op) {
-    if(pySelf->ob_type != &OOCLazyListType) {
+    if(pySelf->ob_type != &OOCLazyListType && pySelf->ob_type != &OOCLazyListSliceType) {
         PyErr_BadArgument();
         return nullptr;
     }
 
-    if(PyList_Check(other) || other->ob_type == &OOCLazyListType) {
+    if(PyList_Check(other) || other->ob_type == &OOCLazyListType || other->ob_type == &OOCLazyListSliceType) {
         PyObject* const selfIter = PyObject_GetIter(pySelf);
         if(selfIter == nullptr) return nullptr;
         PyObject* const otherIter = PyObject_GetIter(other);
@@ -1147,6 +1199,140 @@ PyObject* OOCLazyList_richcompare(PyObject* const pySelf, PyObject* const other,
     }
 }
 
+// list[index] and list[start:stop:step]
+static PyObject* OOCLazyList_subscript(PyObject* const pySelf, PyObject* const key) {
+    if(pySelf->ob_type != &OOCLazyListType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
+
+    if(PyIndex_Check(key)) {
+        Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if(index == -1 && PyErr_Occurred()) return nullptr;
+        if(index < 0) {
+            const Py_ssize_t length = OOCLazyList_length(pySelf);
+            if(length < 0) return nullptr;
+            index += length;
+        }
+        return OOCLazyList_item(pySelf, index);
+    }
+
+    if(!PySlice_Check(key)) {
+        PyErr_Format(PyExc_TypeError, "list indices must be integers or slices, not %.200s", Py_TYPE(key)->tp_name);
+        return nullptr;
+    }
+    Py_ssize_t start;
+    Py_ssize_t stop;
+    Py_ssize_t step;
+    if(PySlice_Unpack(key, &start, &stop, &step) < 0) return nullptr;
+    try {
+        OOCTransaction txn(self->ooc, true, self->snapshot);
+        const Py_ssize_t length = PySlice_AdjustIndices(OOCLazyListObject_length(self, txn), &start, &stop, step);
+        txn.commit();
+        return reinterpret_cast<PyObject*>(OOCLazyListSlice_fastnew(self, start, step, length));
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
+
+// list[index] = item, list[start:stop:step] = items, and the same with del
+static int OOCLazyList_assSubscript(PyObject* const pySelf, PyObject* const key, PyObject* const value) {
+    if(pySelf->ob_type != &OOCLazyListType) {
+        PyErr_BadArgument();
+        return -1;
+    }
+    OOCLazyListObject* const self = reinterpret_cast<OOCLazyListObject*>(pySelf);
+
+    if(PyIndex_Check(key)) {
+        Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if(index == -1 && PyErr_Occurred()) return -1;
+        if(index < 0) {
+            const Py_ssize_t length = OOCLazyList_length(pySelf);
+            if(length < 0) return -1;
+            index += length;
+        }
+        return OOCLazyList_setItem(pySelf, index, value);
+    }
+
+    if(!PySlice_Check(key)) {
+        PyErr_Format(PyExc_TypeError, "list indices must be integers or slices, not %.200s", Py_TYPE(key)->tp_name);
+        return -1;
+    }
+    Py_ssize_t start;
+    Py_ssize_t stop;
+    Py_ssize_t step;
+    if(PySlice_Unpack(key, &start, &stop, &step) < 0) return -1;
+
+    // We take the items before we write, so assigning a list to a slice of itself sees the old items.
+    PyObject* items = nullptr;
+    if(value != nullptr) {
+        items = PySequence_Fast(value, "can only assign an iterable");
+        if(items == nullptr) return -1;
+    }
+    try {
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            OOCLazyListObject_assignSlice(self, txn, start, stop, step, items);
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        Py_XDECREF(items);
+        error.pythonize();
+        return -1;
+    }
+    Py_XDECREF(items);
+    return 0;
+}
+
+void OOCLazyListObject_assignSlice(
+    OOCLazyListObject* const self,
+    OOCTransaction& txn,
+    Py_ssize_t start,
+    Py_ssize_t stop,
+    const Py_ssize_t step,
+    PyObject* const items
+) {
+    const Py_ssize_t length = PySlice_AdjustIndices(OOCLazyListObject_length(self, txn), &start, &stop, step);
+
+    std::vector<EncodedValue> encodedItems;
+    if(items != nullptr) {
+        const Py_ssize_t count = PySequence_Fast_GET_SIZE(items);
+        PyObject** const pyItems = PySequence_Fast_ITEMS(items);
+        encodedItems.reserve(count);
+        for(Py_ssize_t i = 0; i < count; ++i)
+            encodedItems.push_back(*OOCMap_encode(self->ooc, pyItems[i], txn));
+    }
+
+    if(step == 1) {
+        if(stop < start) stop = start;
+        OOCListStore_splice(
+            self->ooc, txn, self->listId, start, stop,
+            encodedItems.empty() ? nullptr : encodedItems.data(), encodedItems.size());
+        return;
+    }
+
+    if(items == nullptr) {
+        // Deleting from the highest index down keeps the indices of the rest where they are.
+        for(Py_ssize_t i = 0; i < length; ++i) {
+            const Py_ssize_t index = step > 0 ? start + (length - 1 - i) * step : start + i * step;
+            OOCListStore_splice(self->ooc, txn, self->listId, index, index + 1, nullptr, 0);
+        }
+        return;
+    }
+
+    if(static_cast<Py_ssize_t>(encodedItems.size()) != length) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "attempt to assign sequence of size %zd to extended slice of size %zd",
+            static_cast<Py_ssize_t>(encodedItems.size()), length);
+        throw OocError(OocError::AlreadyPythonizedError);
+    }
+    for(Py_ssize_t i = 0; i < length; ++i)
+        OOCListStore_set(self->ooc, txn, self->listId, start + i * step, encodedItems[i]);
+}
+
 static PyMethodDef OOCLazyList_methods[] = {
     {
         "eager",
@@ -1173,6 +1359,21 @@ static PyMethodDef OOCLazyList_methods[] = {
         (PyCFunction)OOCLazyList_append,
         METH_O,
         PyDoc_STR("appends one item to the list")
+    }, {
+        "insert",
+        (PyCFunction)OOCLazyList_insert,
+        METH_FASTCALL,
+        PyDoc_STR("inserts an item before the given index")
+    }, {
+        "pop",
+        (PyCFunction)OOCLazyList_pop,
+        METH_FASTCALL,
+        PyDoc_STR("removes and returns the item at the given index, or the last item")
+    }, {
+        "remove",
+        (PyCFunction)OOCLazyList_remove,
+        METH_O,
+        PyDoc_STR("removes the first occurrence of an item")
     },
     {
         "clear",
@@ -1194,6 +1395,12 @@ static PySequenceMethods OOCLazyList_sequence_methods = {
     .sq_inplace_repeat = OOCLazyList_inplaceRepeat
 };
 
+static PyMappingMethods OOCLazyList_mapping_methods = {
+    .mp_length = OOCLazyList_length,
+    .mp_subscript = OOCLazyList_subscript,
+    .mp_ass_subscript = OOCLazyList_assSubscript
+};
+
 static PyNumberMethods OOCLazyList_number_methods = {
     .nb_add = OOCLazyList_concat
 };
@@ -1206,6 +1413,7 @@ PyTypeObject OOCLazyListType = {
     .tp_dealloc = (destructor)OOCLazyList_dealloc,
     .tp_as_number = &OOCLazyList_number_methods,
     .tp_as_sequence = &OOCLazyList_sequence_methods,
+    .tp_as_mapping = &OOCLazyList_mapping_methods,
     .tp_flags = Py_TPFLAGS_DEFAULT,
     .tp_doc = "A list-like class that's backed by an OOCMap",
     .tp_richcompare = OOCLazyList_richcompare,
@@ -1228,3 +1436,344 @@ PyTypeObject OOCLazyListIterType = {
     .tp_init = (initproc)OOCLazyListIter_init,
     .tp_new = OOCLazyListIter_new,
 };
+
+//
+// OOCLazyListSlice
+//
+
+static void OOCLazyListSlice_dealloc(OOCLazyListSliceObject* const self) {
+    Py_DECREF(self->list);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static Py_ssize_t OOCLazyListSliceObject_length(OOCLazyListSliceObject* const self, OOCTransaction& txn) {
+    Py_ssize_t first;
+    Py_ssize_t count;
+    OOCLazyListSlice_bounds(self, OOCLazyListObject_length(self->list, txn), &first, &count);
+    return count;
+}
+
+static Py_ssize_t OOCLazyListSlice_length(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCLazyListSliceType) {
+        PyErr_BadArgument();
+        return -1;
+    }
+    OOCLazyListSliceObject* const self = reinterpret_cast<OOCLazyListSliceObject*>(pySelf);
+
+    try {
+        OOCTransaction txn(self->list->ooc, true, self->list->snapshot);
+        const Py_ssize_t result = OOCLazyListSliceObject_length(self, txn);
+        txn.commit();
+        return result;
+    } catch(const OocError& error) {
+        error.pythonize();
+        return -1;
+    }
+}
+
+PyObject* OOCLazyListSliceObject_eager(OOCLazyListSliceObject* const self, OOCTransaction& txn) {
+    OOCLazyListObject* const list = self->list;
+
+    // Read everything from LMDB in one go without the GIL, and then build the Python objects.
+    std::vector<FetchedValue> items;
+    ListHeader header;
+    const char* packedData;
+    Py_ssize_t first;
+    Py_ssize_t count;
+    {
+        GilUnlocker gil;
+        header = OOCListStore_header(list->ooc, txn, list->listId, &packedData);
+        OOCLazyListSlice_bounds(self, header.length, &first, &count);
+        if(!ListHeader_isPacked(header) && count > 0) {
+            std::vector<EncodedValue> encodedItems;
+            if(self->step == 1) {
+                OOCListStore_read(list->ooc, txn, list->listId, header, first, first + count, encodedItems);
+                if(static_cast<Py_ssize_t>(encodedItems.size()) != count) throw OocError(OocError::UnexpectedData);
+            } else if(std::abs(self->step) < LIST_BLOCK_SIZE) {
+                // Read everything between the first and the last item, and pick out the ones in the slice.
+                const Py_ssize_t last = first + (count - 1) * self->step;
+                const Py_ssize_t low = std::min(first, last);
+                std::vector<EncodedValue> between;
+                OOCListStore_read(list->ooc, txn, list->listId, header, low, std::max(first, last) + 1, between);
+                if(static_cast<Py_ssize_t>(between.size()) != std::abs(last - first) + 1)
+                    throw OocError(OocError::UnexpectedData);
+                encodedItems.reserve(count);
+                for(Py_ssize_t i = 0; i < count; ++i)
+                    encodedItems.push_back(between[first + i * self->step - low]);
+            } else {
+                for(Py_ssize_t i = 0; i < count; ++i)
+                    encodedItems.push_back(OOCListStore_get(list->ooc, txn, list->listId, header, first + i * self->step));
+            }
+            items.resize(count);
+            for(Py_ssize_t i = 0; i < count; ++i)
+                OOCMap_fetch(list->ooc, &encodedItems[i], txn, &items[i]);
+        }
+    }
+
+    PyObject* const result = PyList_New(count);
+    if(result == nullptr) throw OocError(OocError::OutOfMemory);
+    try {
+        if(ListHeader_isPacked(header)) {
+            for(Py_ssize_t i = 0; i < count; ++i)
+                PyList_SET_ITEM(result, i, OOCListStore_packedItem(header, packedData, first + i * self->step));
+        }
+        for(size_t i = 0; i < items.size(); ++i)
+            PyList_SET_ITEM(result, i, OOCMap_decode(list->ooc, &items[i], txn));
+    } catch(...) {
+        Py_DECREF(result);
+        throw;
+    }
+    return result;
+}
+
+PyObject* OOCLazyListSlice_eager(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCLazyListSliceType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazyListSliceObject* const self = reinterpret_cast<OOCLazyListSliceObject*>(pySelf);
+
+    try {
+        OOCTransaction txn(self->list->ooc, true, self->list->snapshot);
+        PyObject* const result = OOCLazyListSliceObject_eager(self, txn);
+        txn.commit();
+        return result;
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
+
+// slice[index] and slice[start:stop:step]. Slicing a slice makes another slice of the list.
+static PyObject* OOCLazyListSlice_subscript(PyObject* const pySelf, PyObject* const key) {
+    if(pySelf->ob_type != &OOCLazyListSliceType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazyListSliceObject* const self = reinterpret_cast<OOCLazyListSliceObject*>(pySelf);
+    OOCLazyListObject* const list = self->list;
+
+    Py_ssize_t index = 0;
+    Py_ssize_t start;
+    Py_ssize_t stop;
+    Py_ssize_t step;
+    const bool isIndex = PyIndex_Check(key);
+    if(isIndex) {
+        index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if(index == -1 && PyErr_Occurred()) return nullptr;
+    } else if(PySlice_Check(key)) {
+        if(PySlice_Unpack(key, &start, &stop, &step) < 0) return nullptr;
+    } else {
+        PyErr_Format(PyExc_TypeError, "list indices must be integers or slices, not %.200s", Py_TYPE(key)->tp_name);
+        return nullptr;
+    }
+
+    try {
+        OOCTransaction txn(list->ooc, true, list->snapshot);
+        const char* data;
+        const ListHeader header = OOCListStore_header(list->ooc, txn, list->listId, &data);
+        Py_ssize_t first;
+        Py_ssize_t count;
+        OOCLazyListSlice_bounds(self, header.length, &first, &count);
+
+        PyObject* result;
+        if(isIndex) {
+            if(index < 0) index += count;
+            if(index < 0 || index >= count) throw OocError(OocError::IndexError);
+            const Py_ssize_t listIndex = first + index * self->step;
+            if(ListHeader_isPacked(header)) {
+                result = OOCListStore_packedItem(header, data, listIndex);
+            } else {
+                EncodedValue item = OOCListStore_get(list->ooc, txn, list->listId, header, listIndex);
+                result = OOCMap_decode(list->ooc, &item, txn);
+            }
+        } else {
+            const Py_ssize_t length = PySlice_AdjustIndices(count, &start, &stop, step);
+            result = reinterpret_cast<PyObject*>(
+                OOCLazyListSlice_fastnew(list, first + start * self->step, self->step * step, length));
+        }
+        txn.commit();
+        return result;
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
+
+static PyObject* OOCLazyListSlice_item(PyObject* const pySelf, const Py_ssize_t index) {
+    PyObject* const key = PyLong_FromSsize_t(index);
+    if(key == nullptr) return nullptr;
+    PyObject* const result = OOCLazyListSlice_subscript(pySelf, key);
+    Py_DECREF(key);
+    return result;
+}
+
+static PyObject* OOCLazyListSlice_iter(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCLazyListSliceType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazyListSliceObject* const self = reinterpret_cast<OOCLazyListSliceObject*>(pySelf);
+
+    try {
+        OOCTransaction txn(self->list->ooc, true, self->list->snapshot);
+        Py_ssize_t first;
+        Py_ssize_t count;
+        OOCLazyListSlice_bounds(self, OOCLazyListObject_length(self->list, txn), &first, &count);
+        txn.commit();
+        return reinterpret_cast<PyObject*>(
+            OOCLazyListIter_fastnew(self->list, first, first + count * self->step, self->step));
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
+
+// Finds the items of a slice between the positions start and stop in the slice that equal value,
+// and calls `visit(position)` for each of them in the order of the list, until `visit` returns
+// false. This searches the part of the list that the slice spans.
+template<typename Visit>
+static void OOCLazyListSliceObject_find(
+    OOCLazyListSliceObject* const self,
+    OOCTransaction& txn,
+    PyObject* const value,
+    Py_ssize_t start,
+    Py_ssize_t stop,
+    const Visit& visit
+) {
+    Py_ssize_t first;
+    Py_ssize_t count;
+    OOCLazyListSlice_bounds(self, OOCLazyListObject_length(self->list, txn), &first, &count);
+    if(start < 0) start = std::max<Py_ssize_t>(start + count, 0);
+    if(stop < 0) stop = std::max<Py_ssize_t>(stop + count, 0);
+    stop = std::min(stop, count);
+    if(start >= stop) return;
+
+    const Py_ssize_t from = first + start * self->step;
+    const Py_ssize_t to = first + (stop - 1) * self->step;
+    OOCLazyListObject_find(
+        self->list, txn, value, std::min(from, to), std::max(from, to) + 1,
+        [&](const Py_ssize_t index) {
+            if((index - first) % self->step != 0) return true;
+            return visit((index - first) / self->step);
+        });
+}
+
+static PyObject* OOCLazyListSlice_index(
+    PyObject* const pySelf,
+    PyObject *const *const args,
+    const Py_ssize_t nargs
+) {
+    if(pySelf->ob_type != &OOCLazyListSliceType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazyListSliceObject* const self = reinterpret_cast<OOCLazyListSliceObject*>(pySelf);
+
+    // parse parameters
+    if(nargs < 1) {
+        PyErr_Format(PyExc_TypeError, "index expected at least 1 argument, got 0");
+        return nullptr;
+    }
+    PyObject* const value = args[0];
+
+    Py_ssize_t start = 0;
+    if(nargs > 1) {
+        start = PyLong_AsSsize_t(args[1]);
+        if(PyErr_Occurred()) return nullptr;
+    }
+
+    Py_ssize_t stop = 9223372036854775807;
+    if(nargs > 2) {
+        stop = PyLong_AsSsize_t(args[2]);
+        if(PyErr_Occurred()) return nullptr;
+    }
+
+    Py_ssize_t position = -1;
+    try {
+        OOCTransaction txn(self->list->ooc, true, self->list->snapshot);
+        // Going backwards, the first match in the slice is the last one in the list.
+        OOCLazyListSliceObject_find(self, txn, value, start, stop, [&](const Py_ssize_t found) {
+            position = found;
+            return self->step < 0;
+        });
+        txn.commit();
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+
+    if(position < 0) {
+        PyErr_Format(PyExc_ValueError, "%R is not in list", value);
+        return nullptr;
+    } else {
+        return PyLong_FromSsize_t(position);
+    }
+}
+
+static PyObject* OOCLazyListSlice_count(PyObject* const pySelf, PyObject* const value) {
+    if(pySelf->ob_type != &OOCLazyListSliceType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazyListSliceObject* const self = reinterpret_cast<OOCLazyListSliceObject*>(pySelf);
+
+    Py_ssize_t count = 0;
+    try {
+        OOCTransaction txn(self->list->ooc, true, self->list->snapshot);
+        OOCLazyListSliceObject_find(self, txn, value, 0, PY_SSIZE_T_MAX, [&](Py_ssize_t) {
+            count += 1;
+            return true;
+        });
+        txn.commit();
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    return PyLong_FromSsize_t(count);
+}
+
+static PyMethodDef OOCLazyListSlice_methods[] = {
+    {
+        "eager",
+        (PyCFunction)OOCLazyListSlice_eager,
+        METH_NOARGS,
+        PyDoc_STR("returns the items in the slice as a list")
+    }, {
+        "index",
+        (PyCFunction)OOCLazyListSlice_index,
+        METH_FASTCALL,
+        PyDoc_STR("returns the index of the given item in the slice")
+    }, {
+        "count",
+        (PyCFunction)OOCLazyListSlice_count,
+        METH_O,
+        PyDoc_STR("counts how often an item appears in the slice")
+    },
+    {nullptr}, // sentinel
+};
+
+static PySequenceMethods OOCLazyListSlice_sequence_methods = {
+    .sq_length = OOCLazyListSlice_length,
+    .sq_item = OOCLazyListSlice_item,
+};
+
+static PyMappingMethods OOCLazyListSlice_mapping_methods = {
+    .mp_length = OOCLazyListSlice_length,
+    .mp_subscript = OOCLazyListSlice_subscript,
+};
+
+PyTypeObject OOCLazyListSliceType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    .tp_name = "oocmap.LazyListSlice",
+    .tp_basicsize = sizeof(OOCLazyListSliceObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)OOCLazyListSlice_dealloc,
+    .tp_as_sequence = &OOCLazyListSlice_sequence_methods,
+    .tp_as_mapping = &OOCLazyListSlice_mapping_methods,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A view of a slice of a LazyList",
+    .tp_richcompare = OOCLazyList_richcompare,
+    .tp_iter = OOCLazyListSlice_iter,
+    .tp_methods = OOCLazyListSlice_methods,
+};
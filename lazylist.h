@@ -15,13 +15,15 @@ typedef struct {
     PyObject_HEAD
     OOCMapObject* ooc;
     uint32_t listId;
+    OOCTransactionObject* snapshot;     // the snapshot this was read through, if any
 } OOCLazyListObject;
 
 extern PyTypeObject OOCLazyListType;
 
-OOCLazyListObject* OOCLazyList_fastnew(OOCMapObject* ooc, uint32_t listId);
+OOCLazyListObject* OOCLazyList_fastnew(OOCMapObject* ooc, uint32_t listId, OOCTransactionObject* snapshot = nullptr);
 
 Py_ssize_t OOCLazyListObject_length(OOCLazyListObject* self, OOCTransaction& txn);
+PyObject* OOCLazyListObject_item(OOCLazyListObject* self, OOCTransaction& txn, Py_ssize_t index);
 
 PyObject* OOCLazyListObject_eager(OOCLazyListObject* self, OOCTransaction& txn);
 PyObject* OOCLazyList_eager(PyObject* pySelf);
@@ -34,12 +36,26 @@ Py_ssize_t OOCLazyListObject_index(
     Py_ssize_t stop = 9223372036854775807
 );
 
+void OOCLazyListObject_delItem(OOCLazyListObject* self, OOCTransaction& txn, Py_ssize_t index);
 Py_ssize_t OOCLazyListObject_count(OOCLazyListObject* self, OOCTransaction& txn, PyObject* value);
 void OOCLazyListObject_extend(OOCLazyListObject* self, OOCTransaction& txn, PyObject* pyOther);
 void OOCLazyListObject_extend(OOCLazyListObject* self, OOCTransaction& txn, OOCLazyListObject* other);
 void OOCLazyListObject_append(OOCLazyListObject* self, OOCTransaction& txn, PyObject* item);
+// These take O(log n) lookups, except that remove() first has to find the item.
+void OOCLazyListObject_insert(OOCLazyListObject* self, OOCTransaction& txn, Py_ssize_t index, PyObject* item);
+PyObject* OOCLazyListObject_pop(OOCLazyListObject* self, OOCTransaction& txn, Py_ssize_t index);
+bool OOCLazyListObject_remove(OOCLazyListObject* self, OOCTransaction& txn, PyObject* value);
 void OOCLazyListObject_clear(OOCLazyListObject* self, OOCTransaction& txn);
 void OOCLazyListObject_inplaceRepeat(OOCLazyListObject* self, OOCTransaction& txn, unsigned int count);
+// list[start:stop:step] = items, or del list[start:stop:step] if items is nullptr. `items` has to
+// be a list or a tuple. Contiguous slices are one splice, extended ones take a lookup per item.
+void OOCLazyListObject_assignSlice(
+    OOCLazyListObject* self,
+    OOCTransaction& txn,
+    Py_ssize_t start,
+    Py_ssize_t stop,
+    Py_ssize_t step,
+    PyObject* items);
 
 //
 // OOCLazyListIter
@@ -48,12 +64,48 @@ void OOCLazyListObject_inplaceRepeat(OOCLazyListObject* self, OOCTransaction& tx
 typedef struct {
     PyObject_HEAD
     OOCLazyListObject* list;
-    MDB_cursor* cursor;
+    OOCTransaction* txn;
+    Py_ssize_t index;                   // of the next item
+    Py_ssize_t stop;                    // the index where the iteration ends, in the direction of step
+    Py_ssize_t step;
+    std::vector<EncodedValue>* chunk;   // the items that were read last, starting at chunkStart
+    Py_ssize_t chunkStart;
 } OOCLazyListIterObject;
 
 extern PyTypeObject OOCLazyListIterType;
 
-OOCLazyListIterObject* OOCLazyListIter_fastnew(OOCLazyListObject* list);
+OOCLazyListIterObject* OOCLazyListIter_fastnew(
+    OOCLazyListObject* list,
+    Py_ssize_t start = 0,
+    Py_ssize_t stop = PY_SSIZE_T_MAX,
+    Py_ssize_t step = 1);
+
+//
+// OOCLazyListSlice
+//
+// list[start:stop:step] returns one of these instead of copying the items. It reads the items from
+// the list when they are asked for, so it sees the changes to the list. Which indices it covers is
+// fixed when it is made, but the ones that the list no longer has are left out.
+//
+
+typedef struct {
+    PyObject_HEAD
+    OOCLazyListObject* list;
+    Py_ssize_t start;       // the index in the list of the first item
+    Py_ssize_t step;
+    Py_ssize_t length;      // the number of items when the slice was made
+} OOCLazyListSliceObject;
+
+extern PyTypeObject OOCLazyListSliceType;
+
+OOCLazyListSliceObject* OOCLazyListSlice_fastnew(
+    OOCLazyListObject* list,
+    Py_ssize_t start,
+    Py_ssize_t step,
+    Py_ssize_t length);
+
+PyObject* OOCLazyListSliceObject_eager(OOCLazyListSliceObject* self, OOCTransaction& txn);
+PyObject* OOCLazyListSlice_eager(PyObject* pySelf);
 
 
 #endif
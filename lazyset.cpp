@@ -0,0 +1,1089 @@
+#include "lazyset.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "oocmap.h"
+#include "db.h"
+#include "errors.h"
+#include "gc.h"
+#include "lazytuple.h"
+#include "refcount.h"
+
+//
+// OOCLazySet
+//
+
+OOCLazySetObject* OOCLazySet_fastnew(
+    OOCMapObject* const ooc,
+    const uint32_t setId,
+    OOCTransactionObject* const snapshot
+) {
+    PyObject* const pySelf = OOCLazySetType.tp_alloc(&OOCLazySetType, 0);
+    if(pySelf == nullptr) throw OocError(OocError::OutOfMemory);
+    OOCLazySetObject* self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+    self->ooc = ooc;
+    Py_INCREF(ooc);
+    self->setId = setId;
+    self->snapshot = snapshot;
+    Py_XINCREF(snapshot);
+    OOCGC_addRoot(ooc, TYPE_CODE_SET, setId, snapshot);
+    return self;
+}
+
+static PyObject* OOCLazySet_new(PyTypeObject* const type, PyObject* const args, PyObject* const kwds) {
+    PyObject* pySelf = type->tp_alloc(type, 0);
+    OOCLazySetObject* self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+    if(self == nullptr) {
+        PyErr_NoMemory();
+        return nullptr;
+    }
+    self->ooc = nullptr;
+    self->setId = 0;
+    self->snapshot = nullptr;
+    return (PyObject*)self;
+}
+
+static int OOCLazySet_init(OOCLazySetObject* const self, PyObject* const args, PyObject* const kwds) {
+    // parse parameters
+    static const char *kwlist[] = {"oocmap", "set_id", nullptr};
+    PyObject* oocmapObject = nullptr;
+    unsigned int setId = 0;
+    const int parseSuccess = PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "O!I",
+        const_cast<char**>(kwlist),
+        &OOCMapType, &oocmapObject, &setId);
+    if(!parseSuccess)
+        return -1;
+
+    if(self->ooc != nullptr)
+        OOCGC_removeRoot(self->ooc, TYPE_CODE_SET, self->setId, self->snapshot);
+    Py_CLEAR(self->ooc);
+    self->ooc = reinterpret_cast<OOCMapObject*>(oocmapObject);
+    Py_INCREF(oocmapObject);
+    self->setId = setId;
+    OOCGC_addRoot(self->ooc, TYPE_CODE_SET, self->setId, self->snapshot);
+
+    return 0;
+}
+
+static void OOCLazySet_dealloc(OOCLazySetObject* const self) {
+    if(self->ooc != nullptr)
+        OOCGC_removeRoot(self->ooc, TYPE_CODE_SET, self->setId, self->snapshot);
+    Py_XDECREF(self->ooc);
+    Py_XDECREF(self->snapshot);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+bool OOCLazySet_memberLess(const EncodedValue& a, const EncodedValue& b) {
+    return memcmp(&a, &b, sizeof(EncodedValue)) < 0;
+}
+
+static Py_ssize_t OOCLazySet_length(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return -1;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    try {
+        OOCTransaction txn(self->ooc, true, self->snapshot);
+        Py_ssize_t const result = OOCLazySetObject_length(self, txn);
+        txn.commit();
+        return result;
+    } catch(const OocError& error) {
+        error.pythonize();
+        return -1;
+    }
+}
+
+Py_ssize_t OOCLazySetObject_length(OOCLazySetObject* const self, OOCTransaction& txn) {
+    MDB_val mdbKey = { .mv_size = sizeof(self->setId), .mv_data = &self->setId };
+    MDB_val mdbValue;
+    const bool found = get(txn.txn, self->ooc->setsDb, &mdbKey, &mdbValue);
+    if(!found) throw OocError(OocError::ContainerGone);
+    if(mdbValue.mv_size != sizeof(Py_ssize_t)) throw OocError(OocError::UnexpectedData);
+    return *reinterpret_cast<Py_ssize_t*>(mdbValue.mv_data);
+}
+
+static void OOCLazySetObject_setLength(OOCLazySetObject* const self, OOCTransaction& txn, Py_ssize_t length) {
+    MDB_val mdbKey = { .mv_size = sizeof(self->setId), .mv_data = &self->setId };
+    MDB_val mdbValue = { .mv_size = sizeof(length), .mv_data = &length };
+    put(txn.txn, self->ooc->setsDb, &mdbKey, &mdbValue);
+}
+
+// Encodes an item so we can look for it in the set. Returns false if the item can't be in the set
+// because it was never written to the map.
+static bool OOCLazySetObject_encodeMember(
+    OOCLazySetObject* const self,
+    OOCTransaction& txn,
+    PyObject* const item,
+    EncodedValue* const result
+) {
+    try {
+        *result = *OOCMap_encode(self->ooc, item, txn, true, true);
+        return true;
+    } catch(const OocError& error) {
+        switch(error.errorCode) {
+        case OocError::ImmutableValueNotFound:
+        case OocError::WriteNotAllowed:
+            return false;
+        case OocError::MutableValueNotAllowed:
+            PyErr_Format(PyExc_TypeError, "unhashable type: '%s'", Py_TYPE(item)->tp_name);
+            throw OocError(OocError::AlreadyPythonizedError);
+        default:
+            throw;
+        }
+    }
+}
+
+// Adds an encoded member without touching the length. Returns whether it was new.
+static bool OOCLazySetObject_insertMember(OOCLazySetObject* const self, OOCTransaction& txn, const EncodedValue& member) {
+    SetItemKey setItemKey = { .setId = self->setId, .member = member };
+    MDB_val mdbKey = { .mv_size = sizeof(setItemKey), .mv_data = &setItemKey };
+    MDB_val mdbValue = { .mv_size = 0, .mv_data = nullptr };
+    try {
+        put(txn.txn, self->ooc->setsDb, &mdbKey, &mdbValue, MDB_NOOVERWRITE);
+    } catch(const MdbError& error) {
+        if(error.mdbErrorCode == MDB_KEYEXIST) return false;
+        throw;
+    }
+    OOCRefcount_incref(self->ooc, txn, member);
+    return true;
+}
+
+// Removes an encoded member without touching the length. Returns whether it was there.
+static bool OOCLazySetObject_removeMember(OOCLazySetObject* const self, OOCTransaction& txn, const EncodedValue& member) {
+    SetItemKey setItemKey = { .setId = self->setId, .member = member };
+    MDB_val mdbKey = { .mv_size = sizeof(setItemKey), .mv_data = &setItemKey };
+    try {
+        del(txn.txn, self->ooc->setsDb, &mdbKey);
+    } catch(const MdbError& error) {
+        if(error.mdbErrorCode == MDB_NOTFOUND) return false;
+        throw;
+    }
+    OOCRefcount_decref(self->ooc, txn, member);
+    return true;
+}
+
+// Returns whether the item was new.
+static bool OOCLazySetObject_add(OOCLazySetObject* const self, OOCTransaction& txn, PyObject* const item) {
+    EncodedValue member;
+    try {
+        member = *OOCMap_encode(self->ooc, item, txn, true);
+    } catch(const OocError& error) {
+        if(error.errorCode != OocError::MutableValueNotAllowed) throw;
+        PyErr_Format(PyExc_TypeError, "unhashable type: '%s'", Py_TYPE(item)->tp_name);
+        throw OocError(OocError::AlreadyPythonizedError);
+    }
+
+    if(!OOCLazySetObject_insertMember(self, txn, member)) return false;
+    OOCLazySetObject_setLength(self, txn, OOCLazySetObject_length(self, txn) + 1);
+    return true;
+}
+
+// Returns whether the item was in the set.
+static bool OOCLazySetObject_discard(OOCLazySetObject* const self, OOCTransaction& txn, PyObject* const item) {
+    EncodedValue member;
+    if(!OOCLazySetObject_encodeMember(self, txn, item, &member))
+        return false;
+    if(!OOCLazySetObject_removeMember(self, txn, member)) return false;
+    OOCLazySetObject_setLength(self, txn, OOCLazySetObject_length(self, txn) - 1);
+    return true;
+}
+
+void OOCLazySetObject_members(OOCLazySetObject* const self, OOCTransaction& txn, std::vector<EncodedValue>& members) {
+    GilUnlocker gil;
+    MDB_cursor* const cursor = cursor_open(txn.txn, self->ooc->setsDb);
+    try {
+        MDB_val mdbKey = { .mv_size = sizeof(self->setId), .mv_data = &self->setId };
+        MDB_val mdbValue;
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET);
+        if(!found) throw OocError(OocError::ContainerGone);
+        if(mdbValue.mv_size == sizeof(Py_ssize_t))
+            members.reserve(members.size() + *static_cast<Py_ssize_t*>(mdbValue.mv_data));
+
+        while(true) {
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+            if(!found || mdbKey.mv_size != sizeof(SetItemKey))
+                break;
+            SetItemKey* const setItemKey = static_cast<SetItemKey*>(mdbKey.mv_data);
+            if(setItemKey->setId != self->setId)
+                break;
+            members.push_back(setItemKey->member);
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+}
+
+// Decodes the members into a new Python set.
+static PyObject* OOCLazySetObject_decodeMembers(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const std::vector<const EncodedValue*>& members
+) {
+    PyObject* const result = PySet_New(nullptr);
+    if(result == nullptr) throw OocError(OocError::OutOfMemory);
+    try {
+        for(const EncodedValue* const member : members) {
+            EncodedValue encodedMember = *member;
+            PyObject* const item = OOCMap_decode(ooc, &encodedMember, txn);
+            const int failure = PySet_Add(result, item);
+            Py_DECREF(item);
+            if(failure) throw OocError(OocError::AlreadyPythonizedError);
+        }
+    } catch(...) {
+        Py_DECREF(result);
+        throw;
+    }
+    return result;
+}
+
+PyObject* OOCLazySet_eager(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    try {
+        OOCTransaction txn(self->ooc, true, self->snapshot);
+        PyObject* const result = OOCLazySetObject_eager(self, txn);
+        txn.commit();
+        return result;
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
+
+PyObject* OOCLazySetObject_eager(OOCLazySetObject* const self, OOCTransaction& txn) {
+    std::vector<EncodedValue> members;
+    OOCLazySetObject_members(self, txn, members);
+    std::vector<const EncodedValue*> pointers;
+    pointers.reserve(members.size());
+    for(const EncodedValue& member : members)
+        pointers.push_back(&member);
+    return OOCLazySetObject_decodeMembers(self->ooc, txn, pointers);
+}
+
+
+//
+// Set algebra
+//
+
+enum class SetOperation { Union, Intersection, Difference, SymmetricDifference, Compare };
+
+struct SetMerge {
+    size_t onlyInSelf = 0;
+    size_t onlyInOther = 0;
+    size_t inBoth = 0;
+    std::vector<const EncodedValue*> result;
+};
+
+// Reads the other side of a set operation, sorted the way the sets table is. Items that were
+// never written to the map can't be in any set in it, so they go into `foreign` instead.
+static void OOCLazySetObject_readOther(
+    OOCLazySetObject* const self,
+    OOCTransaction& txn,
+    PyObject* const other,
+    std::vector<EncodedValue>& members,
+    PyObject* const foreign
+) {
+    if(other->ob_type == &OOCLazySetType && reinterpret_cast<OOCLazySetObject*>(other)->ooc == self->ooc) {
+        OOCLazySetObject_members(reinterpret_cast<OOCLazySetObject*>(other), txn, members);
+        return;
+    }
+
+    PyObject* const iter = PyObject_GetIter(other);
+    if(iter == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+    try {
+        while(true) {
+            PyObject* const item = PyIter_Next(iter);
+            if(item == nullptr) {
+                if(PyErr_Occurred()) throw OocError(OocError::AlreadyPythonizedError);
+                break;
+            }
+            try {
+                EncodedValue member;
+                if(OOCLazySetObject_encodeMember(self, txn, item, &member)) {
+                    members.push_back(member);
+                } else if(PyList_Append(foreign, item) != 0) {
+                    throw OocError(OocError::AlreadyPythonizedError);
+                }
+            } catch(...) {
+                Py_DECREF(item);
+                throw;
+            }
+            Py_DECREF(item);
+        }
+    } catch(...) {
+        Py_DECREF(iter);
+        throw;
+    }
+    Py_DECREF(iter);
+
+    std::sort(members.begin(), members.end(), OOCLazySet_memberLess);
+    members.erase(std::unique(members.begin(), members.end()), members.end());
+}
+
+// Walks both sorted sides at the same time and collects the members that make up the result.
+static void OOCLazySet_merge(
+    const std::vector<EncodedValue>& selfMembers,
+    const std::vector<EncodedValue>& otherMembers,
+    const SetOperation operation,
+    SetMerge& merge
+) {
+    const bool keepOnlyInSelf =
+        operation == SetOperation::Union ||
+        operation == SetOperation::Difference ||
+        operation == SetOperation::SymmetricDifference;
+    const bool keepOnlyInOther =
+        operation == SetOperation::Union ||
+        operation == SetOperation::SymmetricDifference;
+    const bool keepInBoth =
+        operation == SetOperation::Union ||
+        operation == SetOperation::Intersection;
+
+    size_t i = 0;
+    size_t j = 0;
+    while(i < selfMembers.size() || j < otherMembers.size()) {
+        if(j >= otherMembers.size() ||
+           (i < selfMembers.size() && OOCLazySet_memberLess(selfMembers[i], otherMembers[j]))) {
+            merge.onlyInSelf += 1;
+            if(keepOnlyInSelf) merge.result.push_back(&selfMembers[i]);
+            i += 1;
+        } else if(i >= selfMembers.size() || OOCLazySet_memberLess(otherMembers[j], selfMembers[i])) {
+            merge.onlyInOther += 1;
+            if(keepOnlyInOther) merge.result.push_back(&otherMembers[j]);
+            j += 1;
+        } else {
+            merge.inBoth += 1;
+            if(keepInBoth) merge.result.push_back(&selfMembers[i]);
+            i += 1;
+            j += 1;
+        }
+    }
+}
+
+// Runs a set operation. For SetOperation::Compare, the result is a new reference to a bool that
+// the `compare` function picks from the merge counts and the number of foreign items.
+template<typename Compare>
+static PyObject* OOCLazySet_operation(
+    PyObject* const pySelf,
+    PyObject* const other,
+    const SetOperation operation,
+    const Compare& compare
+) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    PyObject* const foreign = PyList_New(0);
+    if(foreign == nullptr) return nullptr;
+    PyObject* result = nullptr;
+    try {
+        OOCTransaction txn(self->ooc, true, self->snapshot);
+        std::vector<EncodedValue> selfMembers;
+        OOCLazySetObject_members(self, txn, selfMembers);
+        std::vector<EncodedValue> otherMembers;
+        OOCLazySetObject_readOther(self, txn, other, otherMembers, foreign);
+
+        SetMerge merge;
+        OOCLazySet_merge(selfMembers, otherMembers, operation, merge);
+        if(operation == SetOperation::Compare) {
+            result = PyBool_FromLong(compare(merge, PyList_GET_SIZE(foreign)));
+        } else {
+            result = OOCLazySetObject_decodeMembers(self->ooc, txn, merge.result);
+            if(operation == SetOperation::Union || operation == SetOperation::SymmetricDifference) {
+                for(Py_ssize_t i = 0; i < PyList_GET_SIZE(foreign); ++i) {
+                    if(PySet_Add(result, PyList_GET_ITEM(foreign, i)) != 0)
+                        throw OocError(OocError::AlreadyPythonizedError);
+                }
+            }
+        }
+        txn.commit();
+    } catch(const OocError& error) {
+        Py_XDECREF(result);
+        Py_DECREF(foreign);
+        error.pythonize();
+        return nullptr;
+    }
+    Py_DECREF(foreign);
+    return result;
+}
+
+static bool OOCLazySet_noCompare(const SetMerge& merge, const Py_ssize_t foreignCount) {
+    return false;
+}
+
+static PyObject* OOCLazySet_union(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_operation(pySelf, other, SetOperation::Union, OOCLazySet_noCompare);
+}
+
+static PyObject* OOCLazySet_intersection(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_operation(pySelf, other, SetOperation::Intersection, OOCLazySet_noCompare);
+}
+
+static PyObject* OOCLazySet_difference(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_operation(pySelf, other, SetOperation::Difference, OOCLazySet_noCompare);
+}
+
+static PyObject* OOCLazySet_symmetricDifference(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_operation(pySelf, other, SetOperation::SymmetricDifference, OOCLazySet_noCompare);
+}
+
+static PyObject* OOCLazySet_isdisjoint(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_operation(pySelf, other, SetOperation::Compare,
+        [](const SetMerge& merge, Py_ssize_t) { return merge.inBoth == 0; });
+}
+
+static PyObject* OOCLazySet_issubset(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_operation(pySelf, other, SetOperation::Compare,
+        [](const SetMerge& merge, Py_ssize_t) { return merge.onlyInSelf == 0; });
+}
+
+static PyObject* OOCLazySet_issuperset(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_operation(pySelf, other, SetOperation::Compare,
+        [](const SetMerge& merge, const Py_ssize_t foreignCount) {
+            return merge.onlyInOther == 0 && foreignCount == 0;
+        });
+}
+
+// The operators only work between sets, like they do for Python's sets. When the LazySet is on the
+// right, we leave the work to Python.
+static PyObject* OOCLazySet_operator(
+    PyObject* const left,
+    PyObject* const right,
+    PyObject* (*const method)(PyObject*, PyObject*),
+    PyObject* (*const fallback)(PyObject*, PyObject*)
+) {
+    PyObject* const other = left->ob_type == &OOCLazySetType ? right : left;
+    if(!PyAnySet_Check(other) && other->ob_type != &OOCLazySetType)
+        Py_RETURN_NOTIMPLEMENTED;
+    if(left->ob_type == &OOCLazySetType)
+        return method(left, right);
+
+    PyObject* const eager = OOCLazySet_eager(right);
+    if(eager == nullptr) return nullptr;
+    PyObject* const result = fallback(left, eager);
+    Py_DECREF(eager);
+    return result;
+}
+
+static PyObject* OOCLazySet_or(PyObject* const left, PyObject* const right) {
+    return OOCLazySet_operator(left, right, OOCLazySet_union, PyNumber_Or);
+}
+
+static PyObject* OOCLazySet_and(PyObject* const left, PyObject* const right) {
+    return OOCLazySet_operator(left, right, OOCLazySet_intersection, PyNumber_And);
+}
+
+static PyObject* OOCLazySet_subtract(PyObject* const left, PyObject* const right) {
+    return OOCLazySet_operator(left, right, OOCLazySet_difference, PyNumber_Subtract);
+}
+
+static PyObject* OOCLazySet_xor(PyObject* const left, PyObject* const right) {
+    return OOCLazySet_operator(left, right, OOCLazySet_symmetricDifference, PyNumber_Xor);
+}
+
+// The in-place operations run the same merge in a write transaction, and then add or remove only
+// the members that change.
+static PyObject* OOCLazySet_inplaceOperation(
+    PyObject* const pySelf,
+    PyObject* const other,
+    const SetOperation operation
+) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    PyObject* foreign = nullptr;
+    try {
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            Py_XDECREF(foreign);
+            foreign = PyList_New(0);
+            if(foreign == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            std::vector<EncodedValue> selfMembers;
+            OOCLazySetObject_members(self, txn, selfMembers);
+            std::vector<EncodedValue> otherMembers;
+            OOCLazySetObject_readOther(self, txn, other, otherMembers, foreign);
+
+            const bool adds = operation == SetOperation::Union || operation == SetOperation::SymmetricDifference;
+            SetMerge toRemove;
+            if(operation == SetOperation::Intersection)
+                OOCLazySet_merge(selfMembers, otherMembers, SetOperation::Difference, toRemove);
+            else if(operation != SetOperation::Union)
+                OOCLazySet_merge(selfMembers, otherMembers, SetOperation::Intersection, toRemove);
+            SetMerge toAdd;
+            if(adds)
+                OOCLazySet_merge(otherMembers, selfMembers, SetOperation::Difference, toAdd);
+
+            Py_ssize_t length = OOCLazySetObject_length(self, txn);
+            for(const EncodedValue* const member : toRemove.result) {
+                if(OOCLazySetObject_removeMember(self, txn, *member)) length -= 1;
+            }
+            for(const EncodedValue* const member : toAdd.result) {
+                if(OOCLazySetObject_insertMember(self, txn, *member)) length += 1;
+            }
+            OOCLazySetObject_setLength(self, txn, length);
+            if(adds) {
+                // Items that were never written to the map can't be members yet.
+                for(Py_ssize_t i = 0; i < PyList_GET_SIZE(foreign); ++i)
+                    OOCLazySetObject_add(self, txn, PyList_GET_ITEM(foreign, i));
+            }
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        Py_XDECREF(foreign);
+        error.pythonize();
+        return nullptr;
+    }
+    Py_DECREF(foreign);
+    return pySelf;
+}
+
+static PyObject* OOCLazySet_inplaceOperator(
+    PyObject* const pySelf,
+    PyObject* const other,
+    const SetOperation operation
+) {
+    if(!PyAnySet_Check(other) && other->ob_type != &OOCLazySetType)
+        Py_RETURN_NOTIMPLEMENTED;
+    PyObject* const result = OOCLazySet_inplaceOperation(pySelf, other, operation);
+    Py_XINCREF(result);
+    return result;
+}
+
+static PyObject* OOCLazySet_inplaceOr(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_inplaceOperator(pySelf, other, SetOperation::Union);
+}
+
+static PyObject* OOCLazySet_inplaceAnd(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_inplaceOperator(pySelf, other, SetOperation::Intersection);
+}
+
+static PyObject* OOCLazySet_inplaceSubtract(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_inplaceOperator(pySelf, other, SetOperation::Difference);
+}
+
+static PyObject* OOCLazySet_inplaceXor(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_inplaceOperator(pySelf, other, SetOperation::SymmetricDifference);
+}
+
+static PyObject* OOCLazySet_updateMethod(
+    PyObject* const pySelf,
+    PyObject* const other,
+    const SetOperation operation
+) {
+    if(OOCLazySet_inplaceOperation(pySelf, other, operation) == nullptr) return nullptr;
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCLazySet_intersectionUpdate(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_updateMethod(pySelf, other, SetOperation::Intersection);
+}
+
+static PyObject* OOCLazySet_differenceUpdate(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_updateMethod(pySelf, other, SetOperation::Difference);
+}
+
+static PyObject* OOCLazySet_symmetricDifferenceUpdate(PyObject* const pySelf, PyObject* const other) {
+    return OOCLazySet_updateMethod(pySelf, other, SetOperation::SymmetricDifference);
+}
+
+
+//
+// Methods that change the set
+//
+
+static PyObject* OOCLazySet_addItem(PyObject* const pySelf, PyObject* const item) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    try {
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            OOCLazySetObject_add(self, txn, item);
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCLazySet_update(PyObject* const pySelf, PyObject* const items) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    PyObject* reiterableItems = nullptr;
+    try {
+        reiterableItems = OOCMap_reiterable(items);
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            PyObject* const iter = PyObject_GetIter(reiterableItems);
+            if(iter == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+            try {
+                while(PyObject* const item = PyIter_Next(iter)) {
+                    try {
+                        OOCLazySetObject_add(self, txn, item);
+                    } catch(...) {
+                        Py_DECREF(item);
+                        throw;
+                    }
+                    Py_DECREF(item);
+                }
+                if(PyErr_Occurred()) throw OocError(OocError::AlreadyPythonizedError);
+            } catch(...) {
+                Py_DECREF(iter);
+                throw;
+            }
+            Py_DECREF(iter);
+            txn.commit();
+        });
+        Py_DECREF(reiterableItems);
+    } catch(const OocError& error) {
+        error.pythonize();
+        Py_XDECREF(reiterableItems);
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCLazySet_discardItem(PyObject* const pySelf, PyObject* const item, const bool mustExist) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    bool found = false;
+    try {
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            found = OOCLazySetObject_discard(self, txn, item);
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    if(mustExist && !found) {
+        PyErr_SetObject(PyExc_KeyError, item);
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCLazySet_discard(PyObject* const pySelf, PyObject* const item) {
+    return OOCLazySet_discardItem(pySelf, item, false);
+}
+
+static PyObject* OOCLazySet_remove(PyObject* const pySelf, PyObject* const item) {
+    return OOCLazySet_discardItem(pySelf, item, true);
+}
+
+static PyObject* OOCLazySet_clear(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    try {
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            MDB_cursor* const cursor = cursor_open(txn.txn, self->ooc->setsDb);
+            try {
+                MDB_val mdbKey = { .mv_size = sizeof(self->setId), .mv_data = &self->setId };
+                MDB_val mdbValue;
+                if(!cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET))
+                    throw OocError(OocError::ContainerGone);
+                while(cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT)) {
+                    if(mdbKey.mv_size != sizeof(SetItemKey) ||
+                       static_cast<SetItemKey*>(mdbKey.mv_data)->setId != self->setId)
+                        break;
+                    OOCRefcount_decref(self->ooc, txn, static_cast<SetItemKey*>(mdbKey.mv_data)->member);
+                    cursor_del(cursor);
+                }
+            } catch(...) {
+                cursor_close(cursor);
+                throw;
+            }
+            cursor_close(cursor);
+            OOCLazySetObject_setLength(self, txn, 0);
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCLazySet_pop(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    PyObject* result = nullptr;
+    try {
+        OOCMapObject_growingWrite(self->ooc, [&]() {
+            Py_CLEAR(result);
+            OOCTransaction txn(self->ooc, false, self->snapshot);
+            // The member that comes first in storage order is the cheapest one to find.
+            EncodedValue member;
+            bool found;
+            {
+                MDB_cursor* const cursor = cursor_open(txn.txn, self->ooc->setsDb);
+                try {
+                    MDB_val mdbKey = { .mv_size = sizeof(self->setId), .mv_data = &self->setId };
+                    MDB_val mdbValue;
+                    if(!cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET))
+                        throw OocError(OocError::UnexpectedData);
+                    found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT) &&
+                        mdbKey.mv_size == sizeof(SetItemKey) &&
+                        static_cast<SetItemKey*>(mdbKey.mv_data)->setId == self->setId;
+                    if(found)
+                        member = static_cast<SetItemKey*>(mdbKey.mv_data)->member;
+                } catch(...) {
+                    cursor_close(cursor);
+                    throw;
+                }
+                cursor_close(cursor);
+            }
+            if(!found) {
+                PyErr_SetString(PyExc_KeyError, "pop from an empty set");
+                throw OocError(OocError::AlreadyPythonizedError);
+            }
+
+            EncodedValue encodedMember = member;
+            result = OOCMap_decode(self->ooc, &encodedMember, txn);
+            // This may have been the last reference to a tuple, so we read it while it is still there.
+            OOCLazyTuple_loadAll(result, txn);
+            OOCLazySetObject_removeMember(self, txn, member);
+            OOCLazySetObject_setLength(self, txn, OOCLazySetObject_length(self, txn) - 1);
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        Py_XDECREF(result);
+        error.pythonize();
+        return nullptr;
+    }
+    return result;
+}
+
+
+//
+// The rest of the Python interface
+//
+
+static int OOCLazySet_contains(PyObject* const pySelf, PyObject* const item) {
+    if(pySelf->ob_type != &OOCLazySetType) {
+        PyErr_BadArgument();
+        return -1;
+    }
+    OOCLazySetObject* const self = reinterpret_cast<OOCLazySetObject*>(pySelf);
+
+    try {
+        OOCTransaction txn(self->ooc, true, self->snapshot);
+        SetItemKey setItemKey = { .setId = self->setId };
+        if(!OOCLazySetObject_encodeMember(self, txn, item, &setItemKey.member))
+            return 0;
+
+        MDB_val mdbKey = { .mv_size = sizeof(setItemKey), .mv_data = &setItemKey };
+        MDB_val mdbValue;
+        const bool found = get(txn.txn, self->ooc->setsDb, &mdbKey, &mdbValue);
+        txn.commit();
+        return found ? 1 : 0;
+    } catch(const OocError& error) {
+        error.pythonize();
+        return -1;
+    }
+}
+
+static PyObject* OOCLazySet_richcompare(PyObject* const pySelf, PyObject* const other, const int op) {
+    PyObject* const eager = OOCLazySet_eager(pySelf);
+    if(eager == nullptr) return nullptr;
+    PyObject* result = PyObject_RichCompare(eager, other, op);
+    Py_DECREF(eager);
+    return result;
+}
+
+static PyObject* OOCLazySet_iter(PyObject* const pySelf) {
+    return PyObject_CallOneArg(reinterpret_cast<PyObject*>(&OOCLazySetIterType), pySelf);
+}
+
+static PyMethodDef OOCLazySet_methods[] = {
+    {
+        "eager",
+        (PyCFunction)OOCLazySet_eager,
+        METH_NOARGS,
+        PyDoc_STR("returns the original set")
+    }, {
+        "add",
+        (PyCFunction)OOCLazySet_addItem,
+        METH_O,
+        PyDoc_STR("adds an element to the set")
+    }, {
+        "update",
+        (PyCFunction)OOCLazySet_update,
+        METH_O,
+        PyDoc_STR("adds all the elements of an iterable to the set")
+    }, {
+        "discard",
+        (PyCFunction)OOCLazySet_discard,
+        METH_O,
+        PyDoc_STR("removes an element from the set if it is a member")
+    }, {
+        "remove",
+        (PyCFunction)OOCLazySet_remove,
+        METH_O,
+        PyDoc_STR("removes an element from the set, and raises KeyError if it is not a member")
+    }, {
+        "pop",
+        (PyCFunction)OOCLazySet_pop,
+        METH_NOARGS,
+        PyDoc_STR("removes and returns an arbitrary element of the set, and raises KeyError if the set is empty")
+    }, {
+        "intersection_update",
+        (PyCFunction)OOCLazySet_intersectionUpdate,
+        METH_O,
+        PyDoc_STR("removes the elements of the set that are not in an iterable")
+    }, {
+        "difference_update",
+        (PyCFunction)OOCLazySet_differenceUpdate,
+        METH_O,
+        PyDoc_STR("removes the elements of an iterable from the set")
+    }, {
+        "symmetric_difference_update",
+        (PyCFunction)OOCLazySet_symmetricDifferenceUpdate,
+        METH_O,
+        PyDoc_STR("keeps only the elements that are in exactly one of the set and an iterable")
+    }, {
+        "clear",
+        (PyCFunction)OOCLazySet_clear,
+        METH_NOARGS,
+        PyDoc_STR("removes all elements from the set")
+    }, {
+        "union",
+        (PyCFunction)OOCLazySet_union,
+        METH_O,
+        PyDoc_STR("returns the union of the set and an iterable as a new set")
+    }, {
+        "intersection",
+        (PyCFunction)OOCLazySet_intersection,
+        METH_O,
+        PyDoc_STR("returns the intersection of the set and an iterable as a new set")
+    }, {
+        "difference",
+        (PyCFunction)OOCLazySet_difference,
+        METH_O,
+        PyDoc_STR("returns the elements of the set that are not in an iterable as a new set")
+    }, {
+        "symmetric_difference",
+        (PyCFunction)OOCLazySet_symmetricDifference,
+        METH_O,
+        PyDoc_STR("returns the elements that are in exactly one of the set and an iterable as a new set")
+    }, {
+        "isdisjoint",
+        (PyCFunction)OOCLazySet_isdisjoint,
+        METH_O,
+        PyDoc_STR("returns True if the set has no elements in common with an iterable")
+    }, {
+        "issubset",
+        (PyCFunction)OOCLazySet_issubset,
+        METH_O,
+        PyDoc_STR("returns True if every element of the set is in an iterable")
+    }, {
+        "issuperset",
+        (PyCFunction)OOCLazySet_issuperset,
+        METH_O,
+        PyDoc_STR("returns True if every element of an iterable is in the set")
+    },
+    {nullptr}, // sentinel
+};
+
+static PySequenceMethods OOCLazySet_sequence_methods = {
+    .sq_length = OOCLazySet_length,
+    .sq_contains = OOCLazySet_contains
+};
+
+static PyNumberMethods OOCLazySet_number_methods = {
+    .nb_subtract = OOCLazySet_subtract,
+    .nb_and = OOCLazySet_and,
+    .nb_xor = OOCLazySet_xor,
+    .nb_or = OOCLazySet_or,
+    .nb_inplace_subtract = OOCLazySet_inplaceSubtract,
+    .nb_inplace_and = OOCLazySet_inplaceAnd,
+    .nb_inplace_xor = OOCLazySet_inplaceXor,
+    .nb_inplace_or = OOCLazySet_inplaceOr,
+};
+
+PyTypeObject OOCLazySetType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    .tp_name = "oocmap.LazySet",
+    .tp_basicsize = sizeof(OOCLazySetObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)OOCLazySet_dealloc,
+    .tp_as_number = &OOCLazySet_number_methods,
+    .tp_as_sequence = &OOCLazySet_sequence_methods,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A set-like class that's backed by an OOCMap",
+    .tp_richcompare = OOCLazySet_richcompare,
+    .tp_iter = OOCLazySet_iter,
+    .tp_methods = OOCLazySet_methods,
+    .tp_init = (initproc)OOCLazySet_init,
+    .tp_new = OOCLazySet_new,
+};
+
+
+//
+// OOCLazySetIter
+//
+
+OOCLazySetIterObject* OOCLazySetIter_fastnew(OOCLazySetObject* const set) {
+    PyObject* const pySelf = OOCLazySetIterType.tp_alloc(&OOCLazySetIterType, 0);
+    if(pySelf == nullptr) throw OocError(OocError::OutOfMemory);
+    OOCLazySetIterObject* self = reinterpret_cast<OOCLazySetIterObject*>(pySelf);
+    self->set = set;
+    Py_INCREF(set);
+    self->txn = nullptr;
+    self->cursor = nullptr;
+    return self;
+}
+
+static PyObject* OOCLazySetIter_new(PyTypeObject* const type, PyObject* const args, PyObject* const kwds) {
+    PyObject* pySelf = type->tp_alloc(type, 0);
+    OOCLazySetIterObject* self = reinterpret_cast<OOCLazySetIterObject*>(pySelf);
+    if(self == nullptr) {
+        PyErr_NoMemory();
+        return nullptr;
+    }
+    self->set = nullptr;
+    self->txn = nullptr;
+    self->cursor = nullptr;
+    return (PyObject*)self;
+}
+
+static int OOCLazySetIter_init(OOCLazySetIterObject* const self, PyObject* const args, PyObject* const kwds) {
+    // parse parameters
+    static const char *kwlist[] = {"set", nullptr};
+    PyObject* setObject = nullptr;
+    const int parseSuccess = PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "O!",
+        const_cast<char**>(kwlist),
+        &OOCLazySetType, &setObject);
+    if(!parseSuccess)
+        return -1;
+
+    Py_CLEAR(self->set);
+    self->set = reinterpret_cast<OOCLazySetObject*>(setObject);
+    Py_INCREF(setObject);
+    self->txn = nullptr;
+    self->cursor = nullptr;
+
+    return 0;
+}
+
+static void OOCLazySetIter_release(OOCLazySetIterObject* const self) {
+    if(self->cursor != nullptr) {
+        self->txn->closeCursor(self->cursor);
+        self->cursor = nullptr;
+    }
+    delete self->txn;
+    self->txn = nullptr;
+}
+
+static void OOCLazySetIter_dealloc(OOCLazySetIterObject* const self) {
+    Py_XDECREF(self->set);
+    OOCLazySetIter_release(self);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* OOCLazySetIter_iter(PyObject* const pySelf) {
+    Py_INCREF(pySelf);
+    return pySelf;
+}
+
+static PyObject* OOCLazySetIter_iternext(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCLazySetIterType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCLazySetIterObject* const self = reinterpret_cast<OOCLazySetIterObject*>(pySelf);
+    if(self->set == nullptr) return nullptr;
+    OOCMapObject* const ooc = self->set->ooc;
+
+    // If the transaction is only waiting for a savepoint to end, we can carry on after that.
+    if(self->txn != nullptr && !self->txn->isAlive()) {
+        OocError(OocError::TransactionEnded).pythonize();
+        return nullptr;
+    }
+
+    try {
+        if(self->cursor == nullptr) {
+            self->txn = new OOCTransaction(ooc, true, self->set->snapshot);
+            self->cursor = cursor_open(self->txn->txn, ooc->setsDb);
+
+            MDB_val mdbKey = { .mv_size = sizeof(self->set->setId), .mv_data = &self->set->setId };
+            MDB_val mdbValue;
+            const bool found = cursor_get(self->cursor, &mdbKey, &mdbValue, MDB_SET);
+            if(!found) throw OocError(OocError::ContainerGone);
+        }
+
+        MDB_val mdbKey;
+        MDB_val mdbValue;
+        const bool found = cursor_get(self->cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        if(!found || mdbKey.mv_size != sizeof(SetItemKey))
+            throw OocError(OocError::IndexError);
+        SetItemKey* const setItemKey = static_cast<SetItemKey*>(mdbKey.mv_data);
+        if(setItemKey->setId != self->set->setId)
+            throw OocError(OocError::IndexError);
+
+        return OOCMap_decode(ooc, &setItemKey->member, *self->txn);
+    } catch(const OocError& error) {
+        OOCLazySetIter_release(self);
+        Py_CLEAR(self->set);
+        if(error.errorCode != OocError::IndexError)
+            error.pythonize();
+        return nullptr;
+    }
+}
+
+PyTypeObject OOCLazySetIterType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    .tp_name = "oocmap.LazySetIter",
+    .tp_basicsize = sizeof(OOCLazySetIterObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)OOCLazySetIter_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "An iterator for LazySet",
+    .tp_iter = OOCLazySetIter_iter,
+    .tp_iternext = OOCLazySetIter_iternext,
+    .tp_init = (initproc)OOCLazySetIter_init,
+    .tp_new = OOCLazySetIter_new,
+};
@@ -0,0 +1,56 @@
+#ifndef OOCMAP_LAZYSET_H
+#define OOCMAP_LAZYSET_H
+
+#include <vector>
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "oocmap.h"
+#include "lmdb.h"
+
+//
+// OOCLazySet
+//
+// The members of a set are the keys of the sets table, after a header key that holds the length,
+// so membership tests are B-tree lookups, and iterating walks the members in the order of their
+// encoded bytes. The set algebra reads both sides in that order and merges them.
+//
+
+typedef struct {
+    PyObject_HEAD
+    OOCMapObject* ooc;
+    uint32_t setId;
+    OOCTransactionObject* snapshot;     // the snapshot this was read through, if any
+} OOCLazySetObject;
+
+extern PyTypeObject OOCLazySetType;
+
+OOCLazySetObject* OOCLazySet_fastnew(OOCMapObject* ooc, uint32_t setId, OOCTransactionObject* snapshot = nullptr);
+
+Py_ssize_t OOCLazySetObject_length(OOCLazySetObject* self, OOCTransaction& txn);
+// Reads the encoded members in storage order.
+void OOCLazySetObject_members(OOCLazySetObject* self, OOCTransaction& txn, std::vector<EncodedValue>& members);
+PyObject* OOCLazySetObject_eager(OOCLazySetObject* self, OOCTransaction& txn);
+PyObject* OOCLazySet_eager(PyObject* pySelf);
+
+// Orders EncodedValues the same way LMDB orders the keys of the sets table.
+bool OOCLazySet_memberLess(const EncodedValue& a, const EncodedValue& b);
+
+
+//
+// OOCLazySetIter
+//
+
+typedef struct {
+    PyObject_HEAD
+    OOCLazySetObject* set;
+    OOCTransaction* txn;
+    MDB_cursor* cursor;
+} OOCLazySetIterObject;
+
+extern PyTypeObject OOCLazySetIterType;
+
+OOCLazySetIterObject* OOCLazySetIter_fastnew(OOCLazySetObject* set);
+
+#endif
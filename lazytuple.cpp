@@ -9,13 +9,19 @@
 // These throw exceptions.
 //
 
-OOCLazyTupleObject* OOCLazyTuple_fastnew(OOCMapObject* const ooc, const uint64_t tupleId) {
+OOCLazyTupleObject* OOCLazyTuple_fastnew(
+    OOCMapObject* const ooc,
+    const uint64_t tupleId,
+    OOCTransactionObject* const snapshot
+) {
     PyObject* const pySelf = OOCLazyTupleType.tp_alloc(&OOCLazyTupleType, 0);
     if(pySelf == nullptr) throw OocError(OocError::OutOfMemory);
     OOCLazyTupleObject* self = reinterpret_cast<OOCLazyTupleObject*>(pySelf);
     self->ooc = ooc;
     Py_INCREF(ooc);
     self->tupleId = tupleId;
+    self->snapshot = snapshot;
+    Py_XINCREF(snapshot);
     self->eager = nullptr;
     return self;
 }
@@ -26,22 +32,63 @@ PyObject* OOCLazyTupleObject_eager(OOCLazyTupleObject* const self, OOCTransactio
         return self->eager;
     }
 
-    MDB_val mdbKey = { .mv_size = sizeof(self->tupleId), .mv_data = &self->tupleId };
-    MDB_val mdbValue;
-    const bool found = get(txn.txn, self->ooc->tuplesDb, &mdbKey, &mdbValue);
-    if(!found) throw OocError(OocError::UnexpectedData);
-    const Py_ssize_t size = mdbValue.mv_size / sizeof(EncodedValue);
-    PyObject* const result = PyTuple_New(size);
+    // Read everything from LMDB in one go without the GIL, and then build the Python objects.
+    std::vector<FetchedValue> items;
+    {
+        GilUnlocker gil;
+        MDB_val mdbKey = { .mv_size = sizeof(self->tupleId), .mv_data = &self->tupleId };
+        MDB_val mdbValue;
+        const bool found = get(txn.txn, self->ooc->tuplesDb, &mdbKey, &mdbValue);
+        if(!found) throw OocError(OocError::UnexpectedData);
+        const size_t size = mdbValue.mv_size / sizeof(EncodedValue);
+        items.resize(size);
+        EncodedValue* const encodedResults = static_cast<EncodedValue* const>(mdbValue.mv_data);
+        for(size_t i = 0; i < size; ++i)
+            OOCMap_fetch(self->ooc, encodedResults + i, txn, &items[i]);
+    }
+
+    PyObject* const result = PyTuple_New(items.size());
     if(result == nullptr) throw OocError(OocError::OutOfMemory);
-    EncodedValue* const encodedResults = static_cast<EncodedValue* const>(mdbValue.mv_data);
-    for(Py_ssize_t i = 0; i < size; ++i)
-        PyTuple_SET_ITEM(result, i, OOCMap_decode(self->ooc, encodedResults + i, txn));
-    txn.commit();
+    try {
+        for(size_t i = 0; i < items.size(); ++i)
+            PyTuple_SET_ITEM(result, i, OOCMap_decode(self->ooc, &items[i], txn));
+    } catch(...) {
+        Py_DECREF(result);
+        throw;
+    }
     self->eager = result;
     Py_INCREF(result);
     return result;
 }
 
+void OOCLazyTuple_loadAll(PyObject* const value, OOCTransaction& txn) {
+    if(value->ob_type == &OOCLazyTupleType) {
+        PyObject* const eager = OOCLazyTupleObject_eager(reinterpret_cast<OOCLazyTupleObject*>(value), txn);
+        Py_DECREF(eager);   // the lazy tuple keeps its own reference
+        OOCLazyTuple_loadAll(eager, txn);
+    } else if(PyTuple_CheckExact(value)) {
+        for(Py_ssize_t i = 0; i < PyTuple_GET_SIZE(value); ++i)
+            OOCLazyTuple_loadAll(PyTuple_GET_ITEM(value, i), txn);
+    } else if(PyFrozenSet_CheckExact(value)) {
+        PyObject* member;
+        Py_ssize_t pos = 0;
+        Py_hash_t hash;
+        while(_PySet_NextEntry(value, &pos, &member, &hash))
+            OOCLazyTuple_loadAll(member, txn);
+    } else if(PyObject_TypeCheck(value, &PyDictProxy_Type)) {
+        PyObject* const items = PyMapping_Values(value);
+        if(items == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+        try {
+            for(Py_ssize_t i = 0; i < PyList_GET_SIZE(items); ++i)
+                OOCLazyTuple_loadAll(PyList_GET_ITEM(items, i), txn);
+        } catch(...) {
+            Py_DECREF(items);
+            throw;
+        }
+        Py_DECREF(items);
+    }
+}
+
 //
 // Methods that are directly exposed to Python
 // These are not allowed to throw exceptions.
@@ -56,6 +103,7 @@ static PyObject* OOCLazyTuple_new(PyTypeObject* const type, PyObject* const args
     }
     self->ooc = nullptr;
     self->tupleId = 0;
+    self->snapshot = nullptr;
     self->eager = nullptr;
     return (PyObject*)self;
 }
@@ -83,6 +131,7 @@ static int OOCLazyTuple_init(OOCLazyTupleObject* const self, PyObject* const arg
 
 static void OOCLazyTuple_dealloc(OOCLazyTupleObject* const self) {
     Py_DECREF(self->ooc);
+    Py_XDECREF(self->snapshot);
     Py_XDECREF(self->eager);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
@@ -98,7 +147,7 @@ static Py_ssize_t OOCLazyTuple_length(PyObject* const pySelf) {
         return PyTuple_Size(self->eager);
 
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         const Py_ssize_t result = OOCLazyTupleObject_length(self, txn);
         txn.commit();
         return result;
@@ -131,7 +180,7 @@ static PyObject* OOCLazyTuple_item(PyObject* const pySelf, Py_ssize_t const inde
         return PyTuple_GET_ITEM(self->eager, index);
 
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         MDB_val mdbKey = { .mv_size = sizeof(self->tupleId), .mv_data = &self->tupleId };
         MDB_val mdbValue;
         const bool found = get(txn.txn, self->ooc->tuplesDb, &mdbKey, &mdbValue);
@@ -161,8 +210,10 @@ PyObject* OOCLazyTuple_eager(PyObject* const pySelf) {
     }
 
     try {
-        OOCTransaction txn(self->ooc, true);
-        return OOCLazyTupleObject_eager(self, txn);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
+        PyObject* const result = OOCLazyTupleObject_eager(self, txn);
+        txn.commit();
+        return result;
     } catch(const OocError& error) {
         error.pythonize();
         return nullptr;
@@ -220,7 +271,7 @@ static PyObject* OOCLazyTuple_index(
 
     Py_ssize_t index;
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         index = OOCLazyTupleObject_index(self, txn, value, start, stop);
         txn.commit();
     } catch(const OocError& error) {
@@ -307,7 +358,7 @@ static PyObject* OOCLazyTuple_count(
 
     Py_ssize_t count;
     try {
-        OOCTransaction txn(self->ooc, true);
+        OOCTransaction txn(self->ooc, true, self->snapshot);
         count = OOCLazyTupleObject_count(self, txn, value);
         txn.commit();
     } catch(const OocError& error) {
@@ -11,18 +11,23 @@ typedef struct {
     PyObject_HEAD
     OOCMapObject* ooc;
     uint64_t tupleId;
+    OOCTransactionObject* snapshot;     // the snapshot this was read through, if any
     PyObject* eager;
 } OOCLazyTupleObject;
 
 extern PyTypeObject OOCLazyTupleType;
 
-OOCLazyTupleObject* OOCLazyTuple_fastnew(OOCMapObject* ooc, uint64_t tupleId);
+OOCLazyTupleObject* OOCLazyTuple_fastnew(OOCMapObject* ooc, uint64_t tupleId, OOCTransactionObject* snapshot = nullptr);
 
 Py_ssize_t OOCLazyTupleObject_length(OOCLazyTupleObject* self, OOCTransaction& txn);
 
 PyObject* OOCLazyTupleObject_eager(OOCLazyTupleObject* self, OOCTransaction& txn);
 PyObject* OOCLazyTuple_eager(PyObject* pySelf);
 
+// Reads every lazy tuple in `value`, including the ones in tuples, frozensets, and read-only
+// mappings inside of it, so they keep working after their records are deleted. See refcount.h.
+void OOCLazyTuple_loadAll(PyObject* value, OOCTransaction& txn);
+
 Py_ssize_t OOCLazyTupleObject_index(
     OOCLazyTupleObject* self,
     OOCTransaction& txn,
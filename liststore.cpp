@@ -0,0 +1,721 @@
+#include "liststore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "db.h"
+#include "errors.h"
+#include "gc.h"
+#include "refcount.h"
+
+static size_t OOCListStore_packedElementSize(const uint8_t format) {
+    switch(format) {
+    case LIST_FORMAT_PACKED_INT8:
+        return sizeof(int8_t);
+    case LIST_FORMAT_PACKED_INT16:
+        return sizeof(int16_t);
+    case LIST_FORMAT_PACKED_INT32:
+        return sizeof(int32_t);
+    case LIST_FORMAT_PACKED_INT64:
+        return sizeof(int64_t);
+    case LIST_FORMAT_PACKED_FLOAT64:
+        return sizeof(double);
+    default:
+        throw OocError(OocError::UnexpectedData);
+    }
+}
+
+ListHeader OOCListStore_header(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const uint32_t listId,
+    const char** const packedData
+) {
+    ListKey encodedListKey = {
+        .listIndex = ListKey::listIndexLength,
+        .listId = listId,
+    };
+    MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
+    MDB_val mdbValue;
+    const bool found = get(txn.txn, ooc->listsDb, &mdbKey, &mdbValue);
+    if(!found) throw OocError(OocError::ContainerGone);
+
+    ListHeader header = {};
+    if(mdbValue.mv_size == sizeof(uint32_t)) {
+        memcpy(&header.length, mdbValue.mv_data, sizeof(header.length));
+        header.format = LIST_FORMAT_ROWS;
+        return header;
+    }
+
+    if(mdbValue.mv_size < LIST_SHORT_HEADER_SIZE) throw OocError(OocError::UnexpectedData);
+    memcpy(&header, mdbValue.mv_data, LIST_SHORT_HEADER_SIZE);
+    if(header.format == LIST_FORMAT_BLOCKS) {
+        if(mdbValue.mv_size != sizeof(header)) throw OocError(OocError::UnexpectedData);
+        memcpy(&header, mdbValue.mv_data, sizeof(header));
+    } else {
+        const size_t dataSize = header.length * OOCListStore_packedElementSize(header.format);
+        if(mdbValue.mv_size != LIST_SHORT_HEADER_SIZE + dataSize) throw OocError(OocError::UnexpectedData);
+        if(packedData != nullptr)
+            *packedData = static_cast<const char*>(mdbValue.mv_data) + LIST_SHORT_HEADER_SIZE;
+    }
+    return header;
+}
+
+std::vector<char> OOCListStore_pack(PyObject* const list) {
+    const Py_ssize_t length = PyList_GET_SIZE(list);
+    if(length == 0 || length >= ListKey::listIndexLength) return {};
+
+    ListHeader header = { .length = static_cast<uint32_t>(length) };
+    std::vector<int64_t> ints;
+    if(PyFloat_CheckExact(PyList_GET_ITEM(list, 0))) {
+        for(Py_ssize_t i = 0; i < length; ++i) {
+            if(!PyFloat_CheckExact(PyList_GET_ITEM(list, i))) return {};
+        }
+        header.format = LIST_FORMAT_PACKED_FLOAT64;
+    } else {
+        // Bools are ints to Python, but PyLong_CheckExact() leaves them out, so they still come back as bools.
+        ints.resize(length);
+        int64_t min = 0;
+        int64_t max = 0;
+        for(Py_ssize_t i = 0; i < length; ++i) {
+            PyObject* const item = PyList_GET_ITEM(list, i);
+            if(!PyLong_CheckExact(item)) return {};
+            int overflow;
+            ints[i] = PyLong_AsLongLongAndOverflow(item, &overflow);
+            if(overflow) return {};
+            min = std::min(min, ints[i]);
+            max = std::max(max, ints[i]);
+        }
+        if(min >= std::numeric_limits<int8_t>::min() && max <= std::numeric_limits<int8_t>::max())
+            header.format = LIST_FORMAT_PACKED_INT8;
+        else if(min >= std::numeric_limits<int16_t>::min() && max <= std::numeric_limits<int16_t>::max())
+            header.format = LIST_FORMAT_PACKED_INT16;
+        else if(min >= std::numeric_limits<int32_t>::min() && max <= std::numeric_limits<int32_t>::max())
+            header.format = LIST_FORMAT_PACKED_INT32;
+        else
+            header.format = LIST_FORMAT_PACKED_INT64;
+    }
+
+    const size_t elementSize = OOCListStore_packedElementSize(header.format);
+    std::vector<char> result(LIST_SHORT_HEADER_SIZE + length * elementSize);
+    memcpy(result.data(), &header, LIST_SHORT_HEADER_SIZE);
+    char* const data = result.data() + LIST_SHORT_HEADER_SIZE;
+    for(Py_ssize_t i = 0; i < length; ++i) {
+        char* const element = data + i * elementSize;
+        switch(header.format) {
+        case LIST_FORMAT_PACKED_INT8: {
+            const int8_t value = ints[i];
+            memcpy(element, &value, sizeof(value));
+            break;
+        }
+        case LIST_FORMAT_PACKED_INT16: {
+            const int16_t value = ints[i];
+            memcpy(element, &value, sizeof(value));
+            break;
+        }
+        case LIST_FORMAT_PACKED_INT32: {
+            const int32_t value = ints[i];
+            memcpy(element, &value, sizeof(value));
+            break;
+        }
+        case LIST_FORMAT_PACKED_INT64:
+            memcpy(element, &ints[i], sizeof(int64_t));
+            break;
+        case LIST_FORMAT_PACKED_FLOAT64: {
+            const double value = PyFloat_AS_DOUBLE(PyList_GET_ITEM(list, i));
+            memcpy(element, &value, sizeof(value));
+            break;
+        }
+        }
+    }
+    return result;
+}
+
+// LMDB only aligns values to two bytes, so the elements have to be copied out.
+template<typename T>
+static T OOCListStore_readPacked(const char* const data, const Py_ssize_t index) {
+    T result;
+    memcpy(&result, data + index * sizeof(T), sizeof(T));
+    return result;
+}
+
+int64_t OOCListStore_packedInt(const ListHeader& header, const char* const data, const Py_ssize_t index) {
+    switch(header.format) {
+    case LIST_FORMAT_PACKED_INT8:
+        return OOCListStore_readPacked<int8_t>(data, index);
+    case LIST_FORMAT_PACKED_INT16:
+        return OOCListStore_readPacked<int16_t>(data, index);
+    case LIST_FORMAT_PACKED_INT32:
+        return OOCListStore_readPacked<int32_t>(data, index);
+    case LIST_FORMAT_PACKED_INT64:
+        return OOCListStore_readPacked<int64_t>(data, index);
+    default:
+        throw OocError(OocError::UnexpectedData);
+    }
+}
+
+double OOCListStore_packedFloat(const char* const data, const Py_ssize_t index) {
+    return OOCListStore_readPacked<double>(data, index);
+}
+
+PyObject* OOCListStore_packedItem(const ListHeader& header, const char* const data, const Py_ssize_t index) {
+    PyObject* const result =
+        header.format == LIST_FORMAT_PACKED_FLOAT64 ?
+        PyFloat_FromDouble(OOCListStore_packedFloat(data, index)) :
+        PyLong_FromLongLong(OOCListStore_packedInt(header, data, index));
+    if(result == nullptr) throw OocError(OocError::OutOfMemory);
+    return result;
+}
+
+//
+// Lists in rows, as older versions wrote them
+//
+
+static void OOCListStore_readRows(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const uint32_t listId,
+    const uint32_t start,
+    const uint32_t stop,
+    std::vector<EncodedValue>& items
+) {
+    ListKey encodedListKey = {
+        .listIndex = start,
+        .listId = listId,
+    };
+    MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(txn.txn, ooc->listsDb);
+    try {
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_KEY);
+        for(uint32_t index = start; index < stop; ++index) {
+            if(!found || mdbKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
+            const ListKey* const listItemKey = static_cast<const ListKey*>(mdbKey.mv_data);
+            if(listItemKey->listId != listId || listItemKey->listIndex != index)
+                throw OocError(OocError::UnexpectedData);
+            if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
+            items.push_back(*static_cast<const EncodedValue*>(mdbValue.mv_data));
+            if(index + 1 < stop)
+                found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+}
+
+// Deletes all the rows or nodes of a list, but not its header.
+static void OOCListStore_deleteRecords(OOCMapObject* const ooc, OOCTransaction& txn, const uint32_t listId) {
+    ListKey encodedListKey = {
+        .listIndex = 0,
+        .listId = listId,
+    };
+    MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
+    MDB_val mdbValue;
+    MDB_cursor* const cursor = cursor_open(txn.txn, ooc->listsDb);
+    try {
+        bool found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_RANGE);
+        while(found) {
+            if(mdbKey.mv_size != sizeof(ListKey)) throw OocError(OocError::UnexpectedData);
+            const ListKey* const listItemKey = static_cast<const ListKey*>(mdbKey.mv_data);
+            if(listItemKey->listId != listId || listItemKey->listIndex == ListKey::listIndexLength)
+                break;
+            cursor_del(cursor);
+            found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_NEXT);
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+}
+
+//
+// Lists in blocks
+//
+
+// Node numbers are never reused, so a list that changes a lot runs through them. When it gets close
+// to the end, the next change writes the whole list again, numbered from 0.
+static const uint32_t LIST_RENUMBER_THRESHOLD = 0xF0000000;
+
+// The tree of one list, for the length of one operation. Changes to the header are only written
+// by putHeader().
+struct OOCListTree {
+    OOCMapObject* const ooc;
+    OOCTransaction& txn;
+    const uint32_t listId;
+    ListHeader header;
+    const unsigned int putFlags;
+
+    OOCListTree(
+        OOCMapObject* const ooc,
+        OOCTransaction& txn,
+        const uint32_t listId,
+        const ListHeader& header,
+        const unsigned int putFlags = 0
+    ) : ooc(ooc), txn(txn), listId(listId), header(header), putFlags(putFlags) { }
+
+    bool isLeaf(const uint32_t depth) const {
+        return depth == header.height;
+    }
+
+    uint32_t newNode() {
+        if(header.nextNode == ListKey::listIndexLength) throw OocError(OocError::UnexpectedData);
+        return header.nextNode++;
+    }
+
+    MDB_val readRaw(const uint32_t node) const {
+        ListKey encodedListKey = {
+            .listIndex = node,
+            .listId = listId,
+        };
+        MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
+        MDB_val mdbValue;
+        if(!get(txn.txn, ooc->listsDb, &mdbKey, &mdbValue)) throw OocError(OocError::UnexpectedData);
+        return mdbValue;
+    }
+
+    template<typename T> std::vector<T> read(const uint32_t node) const {
+        const MDB_val mdbValue = readRaw(node);
+        if(mdbValue.mv_size % sizeof(T) != 0) throw OocError(OocError::UnexpectedData);
+        std::vector<T> result(mdbValue.mv_size / sizeof(T));
+        memcpy(result.data(), mdbValue.mv_data, mdbValue.mv_size);
+        return result;
+    }
+
+    template<typename T> void write(const uint32_t node, const T* const items, const size_t count) {
+        ListKey encodedListKey = {
+            .listIndex = node,
+            .listId = listId,
+        };
+        MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
+        MDB_val mdbValue = { .mv_size = count * sizeof(T), .mv_data = const_cast<T*>(items) };
+        put(txn.txn, ooc->listsDb, &mdbKey, &mdbValue, putFlags);
+    }
+
+    void remove(const uint32_t node) {
+        ListKey encodedListKey = {
+            .listIndex = node,
+            .listId = listId,
+        };
+        MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
+        del(txn.txn, ooc->listsDb, &mdbKey);
+    }
+
+    void removeSubtree(const uint32_t node, const uint32_t depth) {
+        if(!isLeaf(depth)) {
+            for(const ListTreeEntry& entry : read<ListTreeEntry>(node))
+                removeSubtree(entry.node, depth + 1);
+        }
+        remove(node);
+    }
+
+    void putHeader() {
+        ListKey encodedListKey = {
+            .listIndex = ListKey::listIndexLength,
+            .listId = listId,
+        };
+        header.format = LIST_FORMAT_BLOCKS;
+        MDB_val mdbKey = { .mv_size = sizeof(encodedListKey), .mv_data = &encodedListKey };
+        MDB_val mdbValue = { .mv_size = sizeof(header), .mv_data = &header };
+        put(txn.txn, ooc->listsDb, &mdbKey, &mdbValue, putFlags);
+    }
+
+    static uint32_t itemCount(const EncodedValue&) { return 1; }
+    static uint32_t itemCount(const ListTreeEntry& entry) { return entry.count; }
+
+    // Writes items into as few nodes as hold them. The first one is `node`, and the others are new.
+    // With `append`, all of them but the last are full, so lists that only grow at the end have full
+    // blocks. Otherwise they all get about the same number of items. Returns the parent's entries for
+    // the nodes.
+    template<typename T> std::vector<ListTreeEntry> writeSplit(
+        const uint32_t node,
+        const std::vector<T>& items,
+        const uint32_t capacity,
+        const bool append
+    ) {
+        const size_t nodeCount = std::max<size_t>(1, (items.size() + capacity - 1) / capacity);
+        std::vector<ListTreeEntry> result;
+        result.reserve(nodeCount);
+        size_t offset = 0;
+        for(size_t i = 0; i < nodeCount; ++i) {
+            const size_t remaining = items.size() - offset;
+            const size_t size = append ? std::min<size_t>(capacity, remaining) : remaining / (nodeCount - i);
+            ListTreeEntry entry = { .node = i == 0 ? node : newNode(), .count = 0 };
+            for(size_t j = offset; j < offset + size; ++j)
+                entry.count += itemCount(items[j]);
+            write(entry.node, items.data() + offset, size);
+            result.push_back(entry);
+            offset += size;
+        }
+        return result;
+    }
+
+    // Makes the root from the entries that replace it, adding levels while there is more than one.
+    void setRoot(std::vector<ListTreeEntry> entries, const bool append) {
+        while(entries.size() > 1) {
+            entries = writeSplit(newNode(), entries, LIST_NODE_SIZE, append);
+            header.height += 1;
+        }
+        header.root = entries[0].node;
+    }
+
+    // Descends to the leaf that holds index, and makes index relative to that leaf.
+    uint32_t findLeaf(uint32_t& index) const {
+        uint32_t node = header.root;
+        for(uint32_t depth = 0; !isLeaf(depth); ++depth) {
+            const MDB_val mdbValue = readRaw(node);
+            const size_t entryCount = mdbValue.mv_size / sizeof(ListTreeEntry);
+            if(entryCount == 0) throw OocError(OocError::UnexpectedData);
+            size_t child = 0;
+            ListTreeEntry entry;
+            while(true) {
+                memcpy(&entry, static_cast<const ListTreeEntry*>(mdbValue.mv_data) + child, sizeof(entry));
+                if(index < entry.count) break;
+                index -= entry.count;
+                child += 1;
+                if(child >= entryCount) throw OocError(OocError::UnexpectedData);
+            }
+            node = entry.node;
+        }
+        return node;
+    }
+
+    void read(
+        const uint32_t node,
+        const uint32_t depth,
+        const uint32_t start,
+        const uint32_t stop,
+        std::vector<EncodedValue>& items
+    ) const {
+        if(isLeaf(depth)) {
+            const MDB_val mdbValue = readRaw(node);
+            if(mdbValue.mv_size < stop * sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
+            const EncodedValue* const values = static_cast<const EncodedValue*>(mdbValue.mv_data);
+            items.insert(items.end(), values + start, values + stop);
+            return;
+        }
+
+        uint32_t offset = 0;
+        for(const ListTreeEntry& entry : read<ListTreeEntry>(node)) {
+            const uint32_t childStart = offset;
+            const uint32_t childStop = offset + entry.count;
+            offset = childStop;
+            if(childStop <= start) continue;
+            if(childStart >= stop) break;
+            read(
+                entry.node,
+                depth + 1,
+                std::max(start, childStart) - childStart,
+                std::min(stop, childStop) - childStart,
+                items);
+        }
+    }
+
+    // Inserts items at index into the subtree under node. Returns the entries that replace the
+    // node's entry in its parent.
+    std::vector<ListTreeEntry> insert(
+        const uint32_t node,
+        const uint32_t depth,
+        uint32_t index,
+        const EncodedValue* const items,
+        const size_t count,
+        const bool append
+    ) {
+        if(isLeaf(depth)) {
+            std::vector<EncodedValue> leaf = read<EncodedValue>(node);
+            if(index > leaf.size()) throw OocError(OocError::UnexpectedData);
+            leaf.insert(leaf.begin() + index, items, items + count);
+            return writeSplit(node, leaf, LIST_BLOCK_SIZE, append);
+        }
+
+        std::vector<ListTreeEntry> entries = read<ListTreeEntry>(node);
+        if(entries.empty()) throw OocError(OocError::UnexpectedData);
+        // An index between two children goes to the end of the first one.
+        size_t child = 0;
+        while(child + 1 < entries.size() && index > entries[child].count) {
+            index -= entries[child].count;
+            child += 1;
+        }
+        if(index > entries[child].count) throw OocError(OocError::UnexpectedData);
+        const std::vector<ListTreeEntry> replacement = insert(entries[child].node, depth + 1, index, items, count, append);
+        entries.erase(entries.begin() + child);
+        entries.insert(entries.begin() + child, replacement.begin(), replacement.end());
+        return writeSplit(node, entries, LIST_NODE_SIZE, append);
+    }
+
+    struct Erased {
+        uint32_t count;     // the number of items left in the subtree
+        size_t size;        // the number of items or entries left in its top node
+    };
+
+    // Removes the items from start to stop from the subtree under node. If none are left, the node
+    // is removed as well.
+    Erased erase(const uint32_t node, const uint32_t depth, const uint32_t start, const uint32_t stop) {
+        if(isLeaf(depth)) {
+            std::vector<EncodedValue> leaf = read<EncodedValue>(node);
+            if(stop > leaf.size()) throw OocError(OocError::UnexpectedData);
+            leaf.erase(leaf.begin() + start, leaf.begin() + stop);
+            if(leaf.empty())
+                remove(node);
+            else
+                write(node, leaf.data(), leaf.size());
+            return { static_cast<uint32_t>(leaf.size()), leaf.size() };
+        }
+
+        // Only the children at the ends of the range are left partly erased, so only they can end up
+        // small enough to merge with a neighbour.
+        const uint32_t childCapacity = isLeaf(depth + 1) ? LIST_BLOCK_SIZE : LIST_NODE_SIZE;
+        std::vector<ListTreeEntry> entries;
+        std::vector<size_t> small;
+        uint32_t offset = 0;
+        uint32_t count = 0;
+        for(const ListTreeEntry& entry : read<ListTreeEntry>(node)) {
+            const uint32_t childStart = offset;
+            const uint32_t childStop = offset + entry.count;
+            offset = childStop;
+            if(childStop <= start || childStart >= stop) {
+                entries.push_back(entry);
+            } else if(start <= childStart && childStop <= stop) {
+                removeSubtree(entry.node, depth + 1);
+                continue;
+            } else {
+                const Erased erased = erase(
+                    entry.node,
+                    depth + 1,
+                    std::max(start, childStart) - childStart,
+                    std::min(stop, childStop) - childStart);
+                if(erased.count == 0) continue;
+                if(erased.size < childCapacity / 4)
+                    small.push_back(entries.size());
+                entries.push_back({ entry.node, erased.count });
+            }
+            count += entries.back().count;
+        }
+        for(auto i = small.rbegin(); i != small.rend(); ++i) {
+            if(*i < entries.size())
+                merge(entries, *i, depth + 1);
+        }
+
+        if(entries.empty())
+            remove(node);
+        else
+            write(node, entries.data(), entries.size());
+        return { count, entries.size() };
+    }
+
+    // Merges the child at index with its right neighbour, or with its left one if it is the last,
+    // when both fit into one node.
+    void merge(std::vector<ListTreeEntry>& entries, const size_t index, const uint32_t childDepth) {
+        if(entries.size() < 2) return;
+        const size_t left = index + 1 < entries.size() ? index : index - 1;
+        if(isLeaf(childDepth))
+            mergeNodes<EncodedValue>(entries, left, LIST_BLOCK_SIZE);
+        else
+            mergeNodes<ListTreeEntry>(entries, left, LIST_NODE_SIZE);
+    }
+
+    template<typename T> void mergeNodes(std::vector<ListTreeEntry>& entries, const size_t left, const uint32_t capacity) {
+        std::vector<T> items = read<T>(entries[left].node);
+        const std::vector<T> rightItems = read<T>(entries[left + 1].node);
+        if(items.size() + rightItems.size() > capacity) return;
+        items.insert(items.end(), rightItems.begin(), rightItems.end());
+        write(entries[left].node, items.data(), items.size());
+        remove(entries[left + 1].node);
+        entries[left].count += entries[left + 1].count;
+        entries.erase(entries.begin() + left + 1);
+    }
+
+    // Removes inner nodes at the top that have only one child.
+    void collapseRoot() {
+        while(header.height > 0) {
+            const std::vector<ListTreeEntry> entries = read<ListTreeEntry>(header.root);
+            if(entries.size() != 1) break;
+            remove(header.root);
+            header.root = entries[0].node;
+            header.height -= 1;
+        }
+    }
+};
+
+void OOCListStore_read(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const uint32_t listId,
+    const ListHeader& header,
+    const uint32_t start,
+    uint32_t stop,
+    std::vector<EncodedValue>& items
+) {
+    stop = std::min(stop, header.length);
+    if(start >= stop) return;
+    items.reserve(items.size() + (stop - start));
+    switch(header.format) {
+    case LIST_FORMAT_ROWS:
+        OOCListStore_readRows(ooc, txn, listId, start, stop, items);
+        break;
+    case LIST_FORMAT_BLOCKS: {
+        const OOCListTree tree(ooc, txn, listId, header);
+        tree.read(header.root, 0, start, stop, items);
+        break;
+    }
+    default:
+        throw OocError(OocError::UnexpectedData);
+    }
+}
+
+EncodedValue OOCListStore_get(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const uint32_t listId,
+    const ListHeader& header,
+    uint32_t index
+) {
+    if(index >= header.length) throw OocError(OocError::IndexError);
+    uint32_t node;
+    switch(header.format) {
+    case LIST_FORMAT_ROWS:
+        node = index;
+        index = 0;
+        break;
+    case LIST_FORMAT_BLOCKS:
+        node = OOCListTree(ooc, txn, listId, header).findLeaf(index);
+        break;
+    default:
+        throw OocError(OocError::UnexpectedData);
+    }
+
+    const MDB_val mdbValue = OOCListTree(ooc, txn, listId, header).readRaw(node);
+    if(mdbValue.mv_size < (index + 1) * sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
+    EncodedValue result;
+    memcpy(&result, static_cast<const EncodedValue*>(mdbValue.mv_data) + index, sizeof(result));
+    return result;
+}
+
+void OOCListStore_create(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const uint32_t listId,
+    const std::vector<EncodedValue>& items,
+    const unsigned int putFlags
+) {
+    const ListHeader header = { .length = static_cast<uint32_t>(items.size()), .format = LIST_FORMAT_BLOCKS };
+    // The nodes are numbered in the order they are written, and the header comes last, so the
+    // records go in in key order.
+    OOCListTree tree(ooc, txn, listId, header, putFlags);
+    tree.setRoot(tree.writeSplit(tree.newNode(), items, LIST_BLOCK_SIZE, true), true);
+    tree.putHeader();
+}
+
+// Converts a list in rows or packed into blocks, and returns its new header.
+static ListHeader OOCListStore_toBlocks(OOCMapObject* const ooc, OOCTransaction& txn, const uint32_t listId) {
+    const char* packedData;
+    const ListHeader header = OOCListStore_header(ooc, txn, listId, &packedData);
+    if(header.format == LIST_FORMAT_BLOCKS && header.nextNode < LIST_RENUMBER_THRESHOLD) return header;
+
+    std::vector<EncodedValue> items;
+    if(ListHeader_isPacked(header)) {
+        // Encoding the items can move the packed record, so we copy it first.
+        const std::vector<char> packed(
+            packedData,
+            packedData + header.length * OOCListStore_packedElementSize(header.format));
+        items.reserve(header.length);
+        for(uint32_t i = 0; i < header.length; ++i) {
+            PyObject* const item = OOCListStore_packedItem(header, packed.data(), i);
+            try {
+                items.push_back(*OOCMap_encode(ooc, item, txn));
+            } catch(...) {
+                Py_DECREF(item);
+                throw;
+            }
+            Py_DECREF(item);
+        }
+    } else {
+        OOCListStore_read(ooc, txn, listId, header, 0, header.length, items);
+        OOCListStore_deleteRecords(ooc, txn, listId);
+    }
+
+    OOCListStore_create(ooc, txn, listId, items);
+    return OOCListStore_header(ooc, txn, listId);
+}
+
+void OOCListStore_set(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const uint32_t listId,
+    uint32_t index,
+    const EncodedValue& item
+) {
+    const ListHeader header = OOCListStore_toBlocks(ooc, txn, listId);
+    if(index >= header.length) throw OocError(OocError::IndexError);
+
+    OOCListTree tree(ooc, txn, listId, header);
+    const uint32_t node = tree.findLeaf(index);
+    std::vector<EncodedValue> leaf = tree.read<EncodedValue>(node);
+    if(index >= leaf.size()) throw OocError(OocError::UnexpectedData);
+    const EncodedValue oldItem = leaf[index];
+    leaf[index] = item;
+    tree.write(node, leaf.data(), leaf.size());
+    OOCRefcount_incref(ooc, txn, item);
+    OOCRefcount_decref(ooc, txn, oldItem);
+}
+
+void OOCListStore_splice(
+    OOCMapObject* const ooc,
+    OOCTransaction& txn,
+    const uint32_t listId,
+    const uint32_t start,
+    const uint32_t stop,
+    const EncodedValue* const items,
+    const size_t count
+) {
+    // The items after `start` move, so the collector has to mark this list again.
+    OOCGC_listChanged(ooc, listId);
+    OOCListTree tree(ooc, txn, listId, OOCListStore_toBlocks(ooc, txn, listId));
+    ListHeader& header = tree.header;
+    if(start > stop || stop > header.length) throw OocError(OocError::IndexError);
+    if(header.length - (stop - start) + count >= ListKey::listIndexLength) throw OocError(OocError::IndexError);
+
+    // The erased items lose a reference, see refcount.h.
+    std::vector<EncodedValue> erasedItems;
+    OOCListStore_read(ooc, txn, listId, header, start, stop, erasedItems);
+
+    if(start < stop) {
+        const OOCListTree::Erased erased = tree.erase(header.root, 0, start, stop);
+        header.length = erased.count;
+        if(erased.count == 0) {
+            header.height = 0;
+            header.root = tree.newNode();
+            tree.write<EncodedValue>(header.root, nullptr, 0);
+        } else {
+            tree.collapseRoot();
+        }
+    }
+
+    if(count > 0) {
+        const bool append = start == header.length;
+        tree.setRoot(tree.insert(header.root, 0, start, items, count, append), append);
+        header.length += count;
+    }
+
+    tree.putHeader();
+    for(size_t i = 0; i < count; ++i)
+        OOCRefcount_incref(ooc, txn, items[i]);
+    for(const EncodedValue& item : erasedItems)
+        OOCRefcount_decref(ooc, txn, item);
+}
+
+void OOCListStore_clear(OOCMapObject* const ooc, OOCTransaction& txn, const uint32_t listId) {
+    OOCGC_listChanged(ooc, listId);
+    // Packed lists hold only numbers that fit into their EncodedValues, so nothing counts them.
+    const ListHeader header = OOCListStore_header(ooc, txn, listId);
+    std::vector<EncodedValue> items;
+    if(!ListHeader_isPacked(header))
+        OOCListStore_read(ooc, txn, listId, header, 0, header.length, items);
+    OOCListStore_deleteRecords(ooc, txn, listId);
+    OOCListStore_create(ooc, txn, listId, {});
+    for(const EncodedValue& item : items)
+        OOCRefcount_decref(ooc, txn, item);
+}
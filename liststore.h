@@ -0,0 +1,130 @@
+#ifndef OOCMAP_LISTSTORE_H
+#define OOCMAP_LISTSTORE_H
+
+#include <vector>
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "oocmap.h"
+#include "lmdb.h"
+
+//
+// How lists are stored in the lists table
+//
+// Every list has a record under ListKey{ListKey::listIndexLength, listId}. Lists written by older
+// versions have only a uint32_t length there, and one row per element under ListKey{index, listId}.
+// Newer lists have a ListHeader there instead, and its format says where the elements are:
+//  * LIST_FORMAT_BLOCKS: in a B+tree of blocks that counts the items under each node, so an index
+//    finds its block in O(log n) lookups, and inserting or deleting in the middle only rewrites the
+//    nodes on one path. Each node is a record under ListKey{node, listId}. Leaves hold up to
+//    LIST_BLOCK_SIZE EncodedValues. Inner nodes hold up to LIST_NODE_SIZE ListTreeEntrys, one for
+//    each child. The header says which node is the root, and how many levels of inner nodes are
+//    above the leaves.
+//  * LIST_FORMAT_PACKED_*: right after the first LIST_SHORT_HEADER_SIZE bytes of the header, as a C
+//    array of the narrowest type that holds all of them. This is for lists that hold only ints that
+//    fit into 64 bits, or only floats.
+// All the functions that change a list convert rows and packed lists to blocks first. All of them
+// throw OocError.
+//
+
+#pragma pack(push, 1)
+
+struct ListHeader {
+    uint32_t length;
+    uint8_t format;
+    uint8_t height;         // only for blocks: the number of inner levels above the leaves
+    uint8_t reserved[2];
+    // Packed lists only store the fields up to here.
+    uint32_t root;          // only for blocks: the root node
+    uint32_t nextNode;      // only for blocks: the node number the next new node gets
+};
+
+struct ListTreeEntry {
+    uint32_t node;
+    uint32_t count;         // the number of items in the subtree under node
+};
+
+#pragma pack(pop)
+
+const size_t LIST_SHORT_HEADER_SIZE = 8;
+
+const uint8_t LIST_FORMAT_ROWS = 0;     // never stored, see above
+const uint8_t LIST_FORMAT_PACKED_INT8 = 1;
+const uint8_t LIST_FORMAT_PACKED_INT16 = 2;
+const uint8_t LIST_FORMAT_PACKED_INT32 = 3;
+const uint8_t LIST_FORMAT_PACKED_INT64 = 4;
+const uint8_t LIST_FORMAT_PACKED_FLOAT64 = 5;
+const uint8_t LIST_FORMAT_BLOCKS = 6;
+
+// The most EncodedValues, or the most ListTreeEntrys, that fit into one LMDB record on a 4KB page
+// without spilling into an overflow page, so two full nodes fill a page.
+const uint32_t LIST_BLOCK_SIZE = 224;
+const uint32_t LIST_NODE_SIZE = 252;
+
+inline bool ListHeader_isPacked(const ListHeader& header) {
+    return header.format >= LIST_FORMAT_PACKED_INT8 && header.format <= LIST_FORMAT_PACKED_FLOAT64;
+}
+
+// Reads the header of a list. For packed lists, *packedData points to the elements afterwards, and
+// stays valid until the next write in the transaction.
+ListHeader OOCListStore_header(
+    OOCMapObject* ooc,
+    OOCTransaction& txn,
+    uint32_t listId,
+    const char** packedData = nullptr);
+
+// Packs a list into one of the packed formats, header included. Returns an empty vector if the list
+// holds anything other than ints that fit into 64 bits, or anything other than floats.
+std::vector<char> OOCListStore_pack(PyObject* list);
+
+int64_t OOCListStore_packedInt(const ListHeader& header, const char* data, Py_ssize_t index);
+double OOCListStore_packedFloat(const char* data, Py_ssize_t index);
+// Returns a new reference to the item at index in a packed list.
+PyObject* OOCListStore_packedItem(const ListHeader& header, const char* data, Py_ssize_t index);
+
+// Reads the items from start to stop of a list that is stored in rows or blocks, and appends them
+// to `items`. This does not touch any Python objects.
+void OOCListStore_read(
+    OOCMapObject* ooc,
+    OOCTransaction& txn,
+    uint32_t listId,
+    const ListHeader& header,
+    uint32_t start,
+    uint32_t stop,
+    std::vector<EncodedValue>& items);
+
+// Reads one item of a list that is stored in rows or blocks. For blocks, this takes O(log n) lookups.
+EncodedValue OOCListStore_get(
+    OOCMapObject* ooc,
+    OOCTransaction& txn,
+    uint32_t listId,
+    const ListHeader& header,
+    uint32_t index);
+
+// Writes a new list in blocks, with node numbers starting at 0. The records are written in key order,
+// so if the list sorts after everything else in the table, `putFlags` can be MDB_APPEND.
+void OOCListStore_create(
+    OOCMapObject* ooc,
+    OOCTransaction& txn,
+    uint32_t listId,
+    const std::vector<EncodedValue>& items,
+    unsigned int putFlags = 0);
+
+void OOCListStore_set(OOCMapObject* ooc, OOCTransaction& txn, uint32_t listId, uint32_t index, const EncodedValue& item);
+
+// Replaces the items from start to stop with `count` new ones. This takes O(log n + count) lookups,
+// plus one for every block that is entirely between start and stop.
+void OOCListStore_splice(
+    OOCMapObject* ooc,
+    OOCTransaction& txn,
+    uint32_t listId,
+    uint32_t start,
+    uint32_t stop,
+    const EncodedValue* items,
+    size_t count);
+
+// Removes all the elements, in any format, and leaves an empty list in blocks.
+void OOCListStore_clear(OOCMapObject* ooc, OOCTransaction& txn, uint32_t listId);
+
+#endif //OOCMAP_LISTSTORE_H
@@ -4,8 +4,18 @@
 #include "lazytuple.h"
 #include "lazylist.h"
 #include "lazydict.h"
+#include "lazyset.h"
+#include "transaction.h"
+#include "writer.h"
+#include "frozen.h"
 
 static PyMethodDef OocmapMethods[] = {
+    {
+        "freeze",
+        OOCFrozen_freeze,
+        METH_O,
+        PyDoc_STR("returns a copy with lists as tuples, sets as frozensets, and dicts as read-only mappings, which the map stores once per distinct content")
+    },
     {nullptr, nullptr, 0, nullptr}        /* Sentinel */
 };
 
@@ -26,6 +36,8 @@ PyMODINIT_FUNC PyInit_oocmap() {
         return nullptr;
     if(PyType_Ready(&OOCLazyListIterType) < 0)
         return nullptr;
+    if(PyType_Ready(&OOCLazyListSliceType) < 0)
+        return nullptr;
     if(PyType_Ready(&OOCLazyDictType) < 0)
         return nullptr;
     if(PyType_Ready(&OOCLazyDictItemsType) < 0)
@@ -40,6 +52,20 @@ PyMODINIT_FUNC PyInit_oocmap() {
         return nullptr;
     if(PyType_Ready(&OOCLazyDictValuesIterType) < 0)
         return nullptr;
+    if(PyType_Ready(&OOCLazySetType) < 0)
+        return nullptr;
+    if(PyType_Ready(&OOCLazySetIterType) < 0)
+        return nullptr;
+    if(PyType_Ready(&OOCTransactionType) < 0)
+        return nullptr;
+    if(PyType_Ready(&OOCSavepointType) < 0)
+        return nullptr;
+    if(PyType_Ready(&OOCSnapshotType) < 0)
+        return nullptr;
+    if(PyType_Ready(&OOCSnapshotBufferType) < 0)
+        return nullptr;
+    if(PyType_Ready(&OOCAsyncWriterType) < 0)
+        return nullptr;
 
     PyObject* const m = PyModule_Create(&oocmap_module);
     if(m == nullptr)
@@ -49,6 +75,7 @@ PyMODINIT_FUNC PyInit_oocmap() {
     Py_INCREF(&OOCLazyTupleType);
     Py_INCREF(&OOCLazyListType);
     Py_INCREF(&OOCLazyListIterType);
+    Py_INCREF(&OOCLazyListSliceType);
     Py_INCREF(&OOCLazyDictType);
     Py_INCREF(&OOCLazyDictItemsType);
     Py_INCREF(&OOCLazyDictItemsIterType);
@@ -56,23 +83,39 @@ PyMODINIT_FUNC PyInit_oocmap() {
     Py_INCREF(&OOCLazyDictKeysIterType);
     Py_INCREF(&OOCLazyDictValuesType);
     Py_INCREF(&OOCLazyDictValuesIterType);
+    Py_INCREF(&OOCLazySetType);
+    Py_INCREF(&OOCLazySetIterType);
+    Py_INCREF(&OOCTransactionType);
+    Py_INCREF(&OOCSavepointType);
+    Py_INCREF(&OOCSnapshotType);
+    Py_INCREF(&OOCSnapshotBufferType);
+    Py_INCREF(&OOCAsyncWriterType);
     if(
         PyModule_AddObject(m, "OOCMap", (PyObject*)&OOCMapType) < 0 ||
         PyModule_AddObject(m, "LazyTuple", (PyObject*)&OOCLazyTupleType) < 0 ||
         PyModule_AddObject(m, "LazyList", (PyObject*)&OOCLazyListType) < 0 ||
         PyModule_AddObject(m, "LazyListIter", (PyObject*)&OOCLazyListIterType) < 0 ||
+        PyModule_AddObject(m, "LazyListSlice", (PyObject*)&OOCLazyListSliceType) < 0 ||
         PyModule_AddObject(m, "LazyDict", (PyObject*)&OOCLazyDictType) < 0 ||
         PyModule_AddObject(m, "LazyDictItems", (PyObject*)&OOCLazyDictItemsType) < 0 ||
         PyModule_AddObject(m, "LazyDictItemsIter", (PyObject*)&OOCLazyDictItemsIterType) < 0 ||
         PyModule_AddObject(m, "LazyDictKeys", (PyObject*)&OOCLazyDictKeysType) < 0 ||
         PyModule_AddObject(m, "LazyDictKeysIter", (PyObject*)&OOCLazyDictKeysIterType) < 0 ||
         PyModule_AddObject(m, "LazyDictValues", (PyObject*)&OOCLazyDictKeysType) < 0 ||
-        PyModule_AddObject(m, "LazyDictValuesIter", (PyObject*)&OOCLazyDictKeysIterType) < 0
+        PyModule_AddObject(m, "LazyDictValuesIter", (PyObject*)&OOCLazyDictKeysIterType) < 0 ||
+        PyModule_AddObject(m, "LazySet", (PyObject*)&OOCLazySetType) < 0 ||
+        PyModule_AddObject(m, "LazySetIter", (PyObject*)&OOCLazySetIterType) < 0 ||
+        PyModule_AddObject(m, "Transaction", (PyObject*)&OOCTransactionType) < 0 ||
+        PyModule_AddObject(m, "Savepoint", (PyObject*)&OOCSavepointType) < 0 ||
+        PyModule_AddObject(m, "Snapshot", (PyObject*)&OOCSnapshotType) < 0 ||
+        PyModule_AddObject(m, "SnapshotBuffer", (PyObject*)&OOCSnapshotBufferType) < 0 ||
+        PyModule_AddObject(m, "AsyncWriter", (PyObject*)&OOCAsyncWriterType) < 0
     ) {
         Py_DECREF(&OOCMapType);
         Py_DECREF(&OOCLazyTupleType);
         Py_DECREF(&OOCLazyListType);
         Py_DECREF(&OOCLazyListIterType);
+        Py_DECREF(&OOCLazyListSliceType);
         Py_DECREF(&OOCLazyDictType);
         Py_DECREF(&OOCLazyDictItemsType);
         Py_DECREF(&OOCLazyDictItemsIterType);
@@ -80,6 +123,13 @@ PyMODINIT_FUNC PyInit_oocmap() {
         Py_DECREF(&OOCLazyDictKeysIterType);
         Py_DECREF(&OOCLazyDictValuesType);
         Py_DECREF(&OOCLazyDictValuesIterType);
+        Py_DECREF(&OOCLazySetType);
+        Py_DECREF(&OOCLazySetIterType);
+        Py_DECREF(&OOCTransactionType);
+        Py_DECREF(&OOCSavepointType);
+        Py_DECREF(&OOCSnapshotType);
+        Py_DECREF(&OOCSnapshotBufferType);
+        Py_DECREF(&OOCAsyncWriterType);
         Py_DECREF(m);
         return nullptr;
     }
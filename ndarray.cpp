@@ -0,0 +1,117 @@
+#include "ndarray.h"
+
+#include <cstring>
+
+#include "errors.h"
+#include "transaction.h"
+
+namespace {
+
+// Holds a new reference for as long as it is in scope.
+struct OwnedRef {
+    PyObject* const object;
+    explicit OwnedRef(PyObject* const object) : object(object) {
+        if(object == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+    }
+    ~OwnedRef() { Py_DECREF(object); }
+};
+
+}
+
+static size_t roundUp(const size_t value, const size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+static size_t shapeOffset(const size_t dtypeLength) {
+    return roundUp(sizeof(NdarrayHeader) + dtypeLength, sizeof(int64_t));
+}
+
+bool OOCNdarray_check(PyObject* const value) {
+    PyObject* const numpy = PyDict_GetItemString(PyImport_GetModuleDict(), "numpy");
+    if(numpy == nullptr) return false;
+    PyObject* const ndarrayType = PyObject_GetAttrString(numpy, "ndarray");
+    if(ndarrayType == nullptr) {
+        PyErr_Clear();
+        return false;
+    }
+    const bool result = PyType_Check(ndarrayType) && PyObject_TypeCheck(value, (PyTypeObject*)ndarrayType);
+    Py_DECREF(ndarrayType);
+    return result;
+}
+
+std::vector<char> OOCNdarray_serialize(PyObject* const value) {
+    const OwnedRef numpy(PyImport_ImportModule("numpy"));
+    const OwnedRef array(PyObject_CallMethod(numpy.object, "ascontiguousarray", "O", value));
+    const OwnedRef dtype(PyObject_GetAttrString(array.object, "dtype"));
+
+    // Object arrays hold pointers, and structured ones would lose their field names.
+    const OwnedRef kind(PyObject_GetAttrString(dtype.object, "kind"));
+    if(PyUnicode_CompareWithASCIIString(kind.object, "O") == 0 ||
+       PyUnicode_CompareWithASCIIString(kind.object, "V") == 0)
+        throw UnknownTypeError(PyObject_Type(value));
+
+    const OwnedRef dtypeString(PyObject_GetAttrString(dtype.object, "str"));
+    Py_ssize_t dtypeLength;
+    const char* const dtypeChars = PyUnicode_AsUTF8AndSize(dtypeString.object, &dtypeLength);
+    if(dtypeChars == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+    if(dtypeLength > 255) throw UnknownTypeError(PyObject_Type(value));
+
+    // ascontiguousarray() turns 0-d arrays into 1-d ones, so the shape has to come from the original.
+    const OwnedRef shape(PyObject_GetAttrString(value, "shape"));
+    if(!PyTuple_Check(shape.object) || PyTuple_GET_SIZE(shape.object) > 255)
+        throw OocError(OocError::UnexpectedData);
+    const size_t ndim = PyTuple_GET_SIZE(shape.object);
+
+    // Viewing the array as bytes works for every dtype, even the ones that the buffer protocol
+    // can't describe, like datetimes.
+    const OwnedRef flat(PyObject_CallMethod(array.object, "reshape", "i", -1));
+    const OwnedRef bytes(PyObject_CallMethod(flat.object, "view", "s", "u1"));
+    Py_buffer buffer;
+    if(PyObject_GetBuffer(bytes.object, &buffer, PyBUF_SIMPLE) != 0)
+        throw OocError(OocError::AlreadyPythonizedError);
+
+    const size_t headerSize = roundUp(shapeOffset(dtypeLength) + ndim * sizeof(int64_t), 16);
+    std::vector<char> result(headerSize + buffer.len, 0);
+    NdarrayHeader* const header = reinterpret_cast<NdarrayHeader*>(result.data());
+    header->headerSize = headerSize;
+    header->ndim = ndim;
+    header->dtypeLength = dtypeLength;
+    memcpy(result.data() + sizeof(NdarrayHeader), dtypeChars, dtypeLength);
+    int64_t* const shapeData = reinterpret_cast<int64_t*>(result.data() + shapeOffset(dtypeLength));
+    for(size_t i = 0; i < ndim; ++i)
+        shapeData[i] = PyLong_AsLongLong(PyTuple_GET_ITEM(shape.object, i));
+    memcpy(result.data() + headerSize, buffer.buf, buffer.len);
+    PyBuffer_Release(&buffer);
+    return result;
+}
+
+PyObject* OOCNdarray_deserialize(const MDB_val* const payload, OOCTransactionObject* const snapshot) {
+    if(payload->mv_size < sizeof(NdarrayHeader)) throw OocError(OocError::UnexpectedData);
+    char* const data = static_cast<char*>(payload->mv_data);
+    const NdarrayHeader* const header = reinterpret_cast<const NdarrayHeader*>(data);
+    if(header->headerSize > payload->mv_size ||
+       shapeOffset(header->dtypeLength) + header->ndim * sizeof(int64_t) > header->headerSize)
+        throw OocError(OocError::UnexpectedData);
+
+    const OwnedRef numpy(PyImport_ImportModule("numpy"));
+    const OwnedRef dtypeString(PyUnicode_DecodeUTF8(data + sizeof(NdarrayHeader), header->dtypeLength, nullptr));
+    const OwnedRef shape(PyTuple_New(header->ndim));
+    const int64_t* const shapeData = reinterpret_cast<const int64_t*>(data + shapeOffset(header->dtypeLength));
+    for(size_t i = 0; i < header->ndim; ++i) {
+        int64_t dimension;
+        memcpy(&dimension, shapeData + i, sizeof(dimension));
+        PyObject* const pyDimension = PyLong_FromLongLong(dimension);
+        if(pyDimension == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+        PyTuple_SET_ITEM(shape.object, i, pyDimension);
+    }
+
+    const size_t size = payload->mv_size - header->headerSize;
+    const OwnedRef buffer(
+        snapshot != nullptr ?
+        OOCSnapshot_memoryview(snapshot, data + header->headerSize, size) :
+        PyByteArray_FromStringAndSize(data + header->headerSize, size));
+    const OwnedRef flat(PyObject_CallMethod(numpy.object, "frombuffer", "OO", buffer.object, dtypeString.object));
+    PyObject* const result = PyObject_CallMethod(flat.object, "reshape", "(O)", shape.object);
+    if(result == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+    return result;
+}
@@ -0,0 +1,43 @@
+#ifndef OOCMAP_NDARRAY_H
+#define OOCMAP_NDARRAY_H
+
+#include <vector>
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "oocmap.h"
+#include "lmdb.h"
+
+//
+// NumPy arrays
+//
+// Arrays are stored in the blobs table as an NdarrayHeader, the dtype string, and the shape,
+// followed by the raw data in C order. The header part is padded to a multiple of 16 bytes, so the
+// data is as well aligned as LMDB keeps the value. OOCMap does not link against NumPy. It only
+// looks for it when it sees a value of a type it doesn't otherwise know.
+//
+
+#pragma pack(push, 1)
+
+struct NdarrayHeader {
+    uint16_t headerSize;    // everything before the data, including this struct
+    uint8_t ndim;
+    uint8_t dtypeLength;
+    // Followed by the dtype string (numpy's `dtype.str`), padding up to 8 bytes, `ndim` int64s for
+    // the shape, and padding up to 16 bytes.
+};
+
+#pragma pack(pop)
+
+// True if value is a NumPy array. This never imports NumPy.
+bool OOCNdarray_check(PyObject* value);
+
+// Serializes an array into the format above. Throws OocError.
+std::vector<char> OOCNdarray_serialize(PyObject* value);
+
+// Makes an array from the serialized format. With a snapshot, the array is a read-only view
+// straight into the map. Without one, it is a writable copy. Throws OocError.
+PyObject* OOCNdarray_deserialize(const MDB_val* payload, OOCTransactionObject* snapshot);
+
+#endif //OOCMAP_NDARRAY_H
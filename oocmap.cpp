@@ -1,8 +1,10 @@
 #include "oocmap.h"
 
-#include <memory>
-#include <random>
+#include <algorithm>
 #include <chrono>
+#include <memory>
+#include <system_error>
+#include <thread>
 #include "spooky.h"
 
 #include "errors.h"
@@ -10,29 +12,201 @@
 #include "lazytuple.h"
 #include "lazylist.h"
 #include "lazydict.h"
-
-static std::mt19937 random_engine(std::chrono::system_clock::now().time_since_epoch().count());
+#include "lazyset.h"
+#include "transaction.h"
+#include "durability.h"
+#include "decodecache.h"
+#include "writer.h"
+#include "ndarray.h"
+#include "liststore.h"
+#include "gc.h"
+#include "compact.h"
+#include "refcount.h"
+#include "frozen.h"
 
 const uint32_t ListKey::listIndexLength = std::numeric_limits<uint32_t>::max();
 
-OOCTransaction::OOCTransaction(OOCMapObject* const ooc, const bool readonly) :
-    readonly(readonly),
-    txnOwned(true),
-    txn(txn_begin(ooc->mdb, !readonly))
-{ }
+// True when the used part of the map has grown past 3/4 of its size. Write transactions grow the
+// map before that happens when they can, because once a write runs out of space, the map can only
+// grow when no other transaction is open.
+static bool OOCMapObject_nearlyFull(OOCMapObject* const self) {
+    MDB_envinfo info;
+    MDB_stat stat;
+    if(mdb_env_info(self->mdb, &info) != 0 || mdb_env_stat(self->mdb, &stat) != 0) return false;
+    return (info.me_last_pgno + 1) * stat.ms_psize > info.me_mapsize / 4 * 3;
+}
 
-OOCTransaction::OOCTransaction(MDB_txn* const txn, const bool readonly) :
-    readonly(readonly),
-    txnOwned(false),
-    txn(txn)
-{ }
+// True if the current thread started one of the transactions that are open on the map.
+static bool OOCMapObject_threadHasTxn(OOCMapObject* const self) {
+    const unsigned long threadId = PyThread_get_thread_ident();
+    for(const auto& pair : *self->txnThreads) {
+        if(pair.second == threadId) return true;
+    }
+    return false;
+}
+
+// Waits with the GIL released until `done()` returns true, or until the time is up. Returns what
+// `done()` returned last.
+template<typename Done> static bool OOCMapObject_waitFor(const Done& done) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(OOCMAP_GROW_WAIT_MS);
+    while(!done()) {
+        if(std::chrono::steady_clock::now() >= deadline) return false;
+        GilUnlocker gil;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+MDB_txn* OOCMapObject_txnBegin(OOCMapObject* const self, const bool readonly) {
+    // A write that ran out of space is waiting for the open transactions to end. New ones would keep
+    // it waiting, so they wait too, unless their thread holds one of the open ones.
+    if(self->growPending && self->liveTxns > 0 && !OOCMapObject_threadHasTxn(self))
+        OOCMapObject_waitFor([self]() { return !self->growPending || self->liveTxns == 0; });
+
+    if(self->liveTxns == 0 && (self->growPending || (!readonly && OOCMapObject_nearlyFull(self))))
+        OOCMapObject_grow(self);
+
+    // This counts the transaction before it has started, because starting it releases the GIL,
+    // and OOCMapObject_grow() must not run in another thread while it does.
+    self->liveTxns += 1;
+    MDB_txn* txn = nullptr;
+    try {
+        if(readonly) {
+            while(self->readTxnPoolSize > 0) {
+                self->readTxnPoolSize -= 1;
+                MDB_txn* const pooled = self->readTxnPool[self->readTxnPoolSize];
+                if(txn_renew(pooled)) {
+                    txn = pooled;
+                    break;
+                }
+                txn_abort(pooled);
+            }
+        }
+        if(txn == nullptr)
+            txn = txn_begin(self->mdb, !readonly);
+        self->txnThreads->emplace_back(txn, PyThread_get_thread_ident());
+        return txn;
+    } catch(...) {
+        if(txn != nullptr) txn_abort(txn);
+        self->liveTxns -= 1;
+        throw;
+    }
+}
+
+void OOCMapObject_txnEnd(OOCMapObject* const self, MDB_txn* const txn, const bool readonly, const bool commit) {
+    // Same as in OOCMapObject_txnBegin(), the transaction counts until it has completely ended.
+    struct Uncount {
+        OOCMapObject* const self;
+        MDB_txn* const txn;
+        ~Uncount() {
+            self->liveTxns -= 1;
+            auto& threads = *self->txnThreads;
+            for(auto& pair : threads) {
+                if(pair.first == txn) {
+                    pair = threads.back();
+                    threads.pop_back();
+                    break;
+                }
+            }
+        }
+    } uncount = { self, txn };
+
+    const unsigned int poolCapacity = sizeof(self->readTxnPool) / sizeof(self->readTxnPool[0]);
+    if(readonly && self->readTxnPoolSize < poolCapacity) {
+        // Committing and aborting are the same thing for a read-only transaction.
+        txn_reset(txn);
+        self->readTxnPool[self->readTxnPoolSize] = txn;
+        self->readTxnPoolSize += 1;
+    } else if(commit) {
+        if(!readonly) {
+            try {
+                OOCRefcount_beforeCommit(self, txn);
+            } catch(...) {
+                txn_abort(txn);
+                OOCRefcount_afterAbort(self);
+                OOCMapObject_clearDecodeCache(self);
+                throw;
+            }
+        }
+        txn_commit(txn);
+        if(!readonly && self->syncer != nullptr)
+            self->syncer->afterCommit();
+    } else {
+        txn_abort(txn);
+        if(!readonly) {
+            OOCRefcount_afterAbort(self);
+            OOCMapObject_clearDecodeCache(self);
+        }
+    }
+}
+
+void OOCMapObject_clearDecodeCache(OOCMapObject* const self) {
+    if(self->decodeCache != nullptr)
+        self->decodeCache->clear();
+    if(self->internedKeys != nullptr)
+        self->internedKeys->clear();
+}
+
+bool OOCMapObject_grow(OOCMapObject* const self) {
+    if(self->liveTxns > 0) {
+        self->growPending = true;
+        return false;
+    }
+
+    // Reset transactions still point into the old map, so they have to go.
+    while(self->readTxnPoolSize > 0) {
+        self->readTxnPoolSize -= 1;
+        mdb_txn_abort(self->readTxnPool[self->readTxnPoolSize]);
+    }
+
+    // We keep the GIL while we do this, so no other thread can start a transaction. The syncer
+    // thread doesn't need the GIL, so it has to be kept out separately.
+    std::unique_lock<std::mutex> syncLock;
+    if(self->syncer != nullptr)
+        syncLock = std::unique_lock<std::mutex>(self->syncer->syncMutex);
+
+    MDB_envinfo info;
+    mdb_env_info(self->mdb, &info);
+    const int error = mdb_env_set_mapsize(self->mdb, info.me_mapsize * 2);
+    if(error != 0)
+        throw MdbError(error);
+    self->growPending = false;
+    return true;
+}
+
+bool OOCMapObject_growWaiting(OOCMapObject* const self) {
+    if(OOCMapObject_grow(self)) return true;
+    if(OOCMapObject_threadHasTxn(self)) return false;
+    if(!OOCMapObject_waitFor([self]() { return !self->growPending || self->liveTxns == 0; }))
+        return false;
+    // Another thread may have grown the map while we waited.
+    return !self->growPending || OOCMapObject_grow(self);
+}
 
+OOCTransaction::OOCTransaction(
+    OOCMapObject* const ooc,
+    const bool readonly,
+    OOCTransactionObject* const snapshot
+) :
+    ooc(ooc),
+    readonly(readonly),
+    snapshot(snapshot),
+    borrowedFrom(
+        snapshot != nullptr ?
+        OOCSnapshotObject_check(snapshot, readonly) :
+        OOCTransactionObject_current(ooc, readonly)),
+    txnOwned(borrowedFrom == nullptr),
+    txn(txnOwned ? OOCMapObject_txnBegin(ooc, readonly) : borrowedFrom->txn)
+{
+    Py_XINCREF(borrowedFrom);
+}
 
 OOCTransaction::~OOCTransaction() {
-    if(txnOwned && txn != nullptr)
+    if(txn != nullptr)
         abort();
     else
         clear();
+    Py_XDECREF(borrowedFrom);
 }
 
 void OOCTransaction::clear() {
@@ -41,17 +215,36 @@ void OOCTransaction::clear() {
 }
 
 void OOCTransaction::commit() {
-    txn_commit(txn);
+    // LMDB frees the transaction even if the commit fails, so we forget about it first.
+    MDB_txn* const committing = txn;
     txn = nullptr;
+    if(txnOwned)
+        OOCMapObject_txnEnd(ooc, committing, readonly, true);
     clear();
+    if(txnOwned && !readonly)
+        OOCGC_afterWrite(ooc);
 }
 
 void OOCTransaction::abort() {
-    txn_abort(txn);
+    if(txnOwned)
+        OOCMapObject_txnEnd(ooc, txn, readonly, false);
     txn = nullptr;
     clear();
 }
 
+bool OOCTransaction::isAlive() const {
+    return txn != nullptr && (
+        borrowedFrom == nullptr ||
+        (borrowedFrom->txn == txn && borrowedFrom->child == nullptr));
+}
+
+void OOCTransaction::closeCursor(MDB_cursor* const cursor) const {
+    // LMDB frees the cursors of a write transaction by itself when the transaction ends. That
+    // can only have happened here if the transaction was borrowed and its owner ended it.
+    if(isAlive() || borrowedFrom == nullptr || borrowedFrom->readonly)
+        cursor_close(cursor);
+}
+
 
 //
 // Functions that are not exposed to Python
@@ -66,8 +259,62 @@ static const EncodedValue ENCODED_TRUE = {{.asUInt = 3}, {{.typeCode = TYPE_CODE
 static const EncodedValue ENCODED_FALSE = {{.asUInt = 4}, {{.typeCode = TYPE_CODE_HARDCODED, .lengthMinusOne = 0}}};
 static const EncodedValue ENCODED_EMPTY_TUPLE = {{.asUInt = 5}, {{.typeCode = TYPE_CODE_HARDCODED, .lengthMinusOne = 0}}};
 static const EncodedValue ENCODED_EMPTY_STRING = {{.asUInt = 6}, {{.typeCode = TYPE_CODE_HARDCODED, .lengthMinusOne = 0}}};
+static const EncodedValue ENCODED_EMPTY_BYTES = {{.asUInt = 7}, {{.typeCode = TYPE_CODE_HARDCODED, .lengthMinusOne = 0}}};
+static const EncodedValue ENCODED_EMPTY_BYTEARRAY = {{.asUInt = 8}, {{.typeCode = TYPE_CODE_HARDCODED, .lengthMinusOne = 0}}};
+static const EncodedValue ENCODED_EMPTY_FROZENSET = {{.asUInt = 9}, {{.typeCode = TYPE_CODE_HARDCODED, .lengthMinusOne = 0}}};
+static const EncodedValue ENCODED_EMPTY_FROZENDICT = {{.asUInt = 10}, {{.typeCode = TYPE_CODE_HARDCODED, .lengthMinusOne = 0}}};
+
+// Returns the next value of a counter in the meta table, and advances it. Containers get their ids
+// from these, so the ones that are written together end up next to each other in their tables.
+// Maps written by older versions have random ids, so the caller still has to check that the id is
+// free.
+static uint32_t OOCMap_nextId(OOCMapObject* const self, OOCTransaction& txn, const char* const counter) {
+    MDB_val mdbKey = { .mv_size = strlen(counter), .mv_data = const_cast<char*>(counter) };
+    MDB_val mdbValue;
+    uint32_t result = 0;
+    if(get(txn.txn, self->metaDb, &mdbKey, &mdbValue)) {
+        if(mdbValue.mv_size != sizeof(result)) throw OocError(OocError::UnexpectedData);
+        memcpy(&result, mdbValue.mv_data, sizeof(result));
+    }
+    uint32_t next = result + 1;
+    mdbValue = (MDB_val) { .mv_size = sizeof(next), .mv_data = &next };
+    put(txn.txn, self->metaDb, &mdbKey, &mdbValue);
+    return result;
+}
 
-const EncodedValue* OOCMap_encode(
+uint32_t OOCMap_bytewiseId(const uint32_t id) {
+    const uint8_t bytes[sizeof(id)] = {
+        static_cast<uint8_t>(id >> 24),
+        static_cast<uint8_t>(id >> 16),
+        static_cast<uint8_t>(id >> 8),
+        static_cast<uint8_t>(id),
+    };
+    uint32_t result;
+    memcpy(&result, bytes, sizeof(result));
+    return result;
+}
+
+// Gives a record that OOCMap_encode() just wrote a count, see refcount.h. The elements of tuples and
+// frozensets are stored in the record, so it counts them too.
+static void OOCMap_countCreated(
+    OOCMapObject* const self,
+    OOCTransaction& txn,
+    const EncodedValue& value,
+    const MDB_val& mdbValue
+) {
+    OOCRefcount_created(self, txn, value);
+    if(
+        value.typeCode == TYPE_CODE_TUPLE ||
+        value.typeCode == TYPE_CODE_FROZENSET ||
+        value.typeCode == TYPE_CODE_FROZENDICT
+    ) {
+        const EncodedValue* const elements = static_cast<const EncodedValue*>(mdbValue.mv_data);
+        for(size_t i = 0; i < mdbValue.mv_size / sizeof(EncodedValue); ++i)
+            OOCRefcount_incref(self, txn, elements[i]);
+    }
+}
+
+static const EncodedValue* OOCMap_encodeUnshaded(
     OOCMapObject* const self,
     PyObject* const value,
     OOCTransaction& txn,
@@ -118,12 +365,22 @@ const EncodedValue* OOCMap_encode(
 
                 MDB_val mdbValue = { .mv_size = longBufferSize, .mv_data = longObject->ob_digit };
 
-                result.asUInt = putImmutable(
-                    txn.txn,
-                    self->intsDb,
-                    &mdbValue,
-                    result.typeCode,
-                    txn.readonly || failOnWrite);
+                try {
+                    bool created = false;
+                    result.asUInt = putImmutable(
+                        txn.txn,
+                        self->intsDb,
+                        &mdbValue,
+                        result.typeCode,
+                        txn.readonly || failOnWrite,
+                        &created);
+                    if(created)
+                        OOCMap_countCreated(self, txn, result, mdbValue);
+                } catch(...) {
+                    // We already filled in parts of `result` above, so we need to clear it now.
+                    result = ENCODED_UNINITIALIZED;
+                    throw;
+                }
                 return &result;
             }
         }
@@ -153,11 +410,49 @@ const EncodedValue* OOCMap_encode(
     // Python's complex numbers
     // TODO
 
-    // Python's bytes objects
-    // TODO
+    // Python's bytes and bytearray objects
+    const bool isBytes = PyBytes_CheckExact(value);
+    if(isBytes || PyByteArray_CheckExact(value)) {
+        // A bytearray is stored by value, so it can't change under a key that uses it.
+        if(!isBytes && failOnMutable)
+            throw OocError(OocError::MutableValueNotAllowed);
 
-    // Python's byte array objects
-    // TODO
+        const size_t dataSize = isBytes ? PyBytes_GET_SIZE(value) : PyByteArray_GET_SIZE(value);
+        char* const data = isBytes ? PyBytes_AS_STRING(value) : PyByteArray_AS_STRING(value);
+        if(dataSize == 0) {
+            result = isBytes ? ENCODED_EMPTY_BYTES : ENCODED_EMPTY_BYTEARRAY;
+            return &result;
+        } else if(dataSize <= sizeof(result.asChars)) {
+            // Fits into one EncodedValue
+            result.asUInt = 0;
+            memcpy(result.asChars, data, dataSize);
+            result.typeCode = isBytes ? TYPE_CODE_BYTES : TYPE_CODE_BYTEARRAY;
+            result.lengthMinusOne = dataSize - 1;
+            return &result;
+        } else {
+            // Does not fit into one EncodedValue, has to be written to the DB
+            result.typeCode = isBytes ? TYPE_CODE_BYTES_LONG : TYPE_CODE_BYTEARRAY_LONG;
+            result.lengthMinusOne = 0;
+            MDB_val mdbValue = {.mv_size = dataSize, .mv_data = data};
+            try {
+                bool created = false;
+                result.asUInt = putImmutable(
+                    txn.txn,
+                    self->blobsDb,
+                    &mdbValue,
+                    TYPE_CODE_BYTES_LONG,
+                    txn.readonly || failOnWrite,
+                    &created);
+                if(created)
+                    OOCMap_countCreated(self, txn, result, mdbValue);
+            } catch(...) {
+                // We already filled in parts of `result` above, so we need to clear it now.
+                result = ENCODED_UNINITIALIZED;
+                throw;
+            }
+            return &result;
+        }
+    }
 
     // Python's unicode objects (strings)
     if(PyUnicode_Check(value)) {
@@ -202,12 +497,22 @@ const EncodedValue* OOCMap_encode(
                 result.lengthMinusOne = 0;
                 result.typeCode += TYPE_CODE_UNICODE_LONG_SHORT_OFFSET;
                 MDB_val mdbValue = {.mv_size = dataSize, .mv_data = PyUnicode_DATA(value)};
-                result.asUInt = putImmutable(
-                    txn.txn,
-                    self->stringsDb,
-                    &mdbValue,
-                    result.typeCode,
-                    txn.readonly || failOnWrite);
+                try {
+                    bool created = false;
+                    result.asUInt = putImmutable(
+                        txn.txn,
+                        self->stringsDb,
+                        &mdbValue,
+                        result.typeCode,
+                        txn.readonly || failOnWrite,
+                        &created);
+                    if(created)
+                        OOCMap_countCreated(self, txn, result, mdbValue);
+                } catch(...) {
+                    // We already filled in parts of `result` above, so we need to clear it now.
+                    result = ENCODED_UNINITIALIZED;
+                    throw;
+                }
                 return &result;
             }
         }
@@ -233,13 +538,23 @@ const EncodedValue* OOCMap_encode(
                 .mv_size = PyTuple_GET_SIZE(value) * sizeof(EncodedValue),
                 .mv_data = encodedValues.data()
             };
-            result.asUInt = putImmutable(
-                txn.txn,
-                self->tuplesDb,
-                &mdbValue,
-                result.typeCode,
-                txn.readonly || failOnWrite
-            );
+            try {
+                bool created = false;
+                result.asUInt = putImmutable(
+                    txn.txn,
+                    self->tuplesDb,
+                    &mdbValue,
+                    result.typeCode,
+                    txn.readonly || failOnWrite,
+                    &created
+                );
+                if(created)
+                    OOCMap_countCreated(self, txn, result, mdbValue);
+            } catch(...) {
+                // We already filled in parts of `result` above, so we need to clear it now.
+                result = ENCODED_UNINITIALIZED;
+                throw;
+            }
             return &result;
         }
     }
@@ -254,14 +569,19 @@ const EncodedValue* OOCMap_encode(
         result.typeCode = TYPE_CODE_LIST;
         result.asListKey.listIndex = ListKey::listIndexLength;
         MDB_val mdbKey = { .mv_size = sizeof(result.asListKey), .mv_data = &result.asListKey };
-        uint32_t length = Py_SIZE(value);
+        std::vector<char> packed = OOCListStore_pack(value);
+        // Other lists are written once all their elements are encoded. Until then, they are empty.
+        uint32_t emptyLength = 0;
 
         // find a key
         while(true) {
-            result.asListKey.listId = random_engine();
-            MDB_val mdbValue = { .mv_size = sizeof(uint32_t), .mv_data = &length};
+            MDB_val mdbValue = { .mv_size = sizeof(emptyLength), .mv_data = &emptyLength };
+            if(!packed.empty())
+                mdbValue = (MDB_val) { .mv_size = packed.size(), .mv_data = packed.data() };
             try {
-                put(txn.txn, self->listsDb, &mdbKey, &mdbValue, MDB_NODUPDATA);
+                // The lists table compares its keys as integers, with the list id in the high half.
+                result.asListKey.listId = OOCMap_nextId(self, txn, "nextListId");
+                put(txn.txn, self->listsDb, &mdbKey, &mdbValue, MDB_NOOVERWRITE);
             } catch(const MdbError& e) {
                 if(e.mdbErrorCode == MDB_KEYEXIST) {
                     continue;
@@ -272,25 +592,18 @@ const EncodedValue* OOCMap_encode(
             }
             break;
         }
+        if(!packed.empty())
+            return &result;
 
         try {
             // add the list elements
-            EncodedValue encodedListElement = result;
-            MDB_val mdbElementKey = {
-                .mv_size = sizeof(encodedListElement.asListKey),
-                .mv_data = &encodedListElement.asListKey
-            };
-
-            for(Py_ssize_t i = 0; i < PyList_GET_SIZE(value); ++i) {
-                const EncodedValue* const encodedItem = OOCMap_encode(self, PyList_GET_ITEM(value, i), txn, failOnMutable, failOnWrite);
-
-                encodedListElement.asListKey.listIndex = i;
-                MDB_val mdbElementValue = {
-                    .mv_size = sizeof(EncodedValue),
-                    .mv_data = const_cast<EncodedValue*>(encodedItem)
-                };
-                put(txn.txn, self->listsDb, &mdbElementKey, &mdbElementValue);
-            }
+            std::vector<EncodedValue> encodedItems;
+            encodedItems.reserve(PyList_GET_SIZE(value));
+            for(Py_ssize_t i = 0; i < PyList_GET_SIZE(value); ++i)
+                encodedItems.push_back(*OOCMap_encode(self, PyList_GET_ITEM(value, i), txn, failOnMutable, failOnWrite));
+            OOCListStore_create(self, txn, result.asListKey.listId, encodedItems);
+            for(const EncodedValue& item : encodedItems)
+                OOCRefcount_incref(self, txn, item);
         } catch(...) {
             // We already filled in `result` above, so we need to explicitly clear it now.
             result = ENCODED_UNINITIALIZED;
@@ -319,9 +632,9 @@ const EncodedValue* OOCMap_encode(
 
         // find a key
         while(true) {
-            dictId = random_engine();
             try {
-                put(txn.txn, self->dictsDb, &mdbKey, &mdbValue, MDB_NODUPDATA);
+                dictId = OOCMap_bytewiseId(OOCMap_nextId(self, txn, "nextDictId"));
+                put(txn.txn, self->dictsDb, &mdbKey, &mdbValue, MDB_NOOVERWRITE);
             } catch(const MdbError& e) {
                 if(e.mdbErrorCode == MDB_KEYEXIST) {
                     continue;
@@ -358,6 +671,8 @@ const EncodedValue* OOCMap_encode(
                     .mv_data = const_cast<EncodedValue*>(encodedValue)
                 };
                 put(txn.txn, self->dictsDb, &mdbDictItemKey, &mdbDictItemValue);
+                OOCRefcount_incref(self, txn, dictItemKey.key);
+                OOCRefcount_incref(self, txn, *encodedValue);
             }
         } catch(...) {
             // We already filled in `result` above, so we need to clear it now.
@@ -369,24 +684,182 @@ const EncodedValue* OOCMap_encode(
     }
 
     // Python's set objects
-    // TODO
+    if(PySet_CheckExact(value)) {
+        if(failOnMutable)
+            throw OocError(OocError::MutableValueNotAllowed);
+        if(failOnWrite)
+            throw OocError(OocError::WriteNotAllowed);
+
+        uint32_t setId;
+        MDB_val mdbKey = { .mv_size = sizeof(setId), .mv_data = &setId };
+
+        Py_ssize_t setSize = PySet_GET_SIZE(value);
+        MDB_val mdbValue = { .mv_size = sizeof(setSize), .mv_data = &setSize };
+
+        // find a key
+        while(true) {
+            try {
+                setId = OOCMap_bytewiseId(OOCMap_nextId(self, txn, "nextSetId"));
+                put(txn.txn, self->setsDb, &mdbKey, &mdbValue, MDB_NOOVERWRITE);
+            } catch(const MdbError& e) {
+                if(e.mdbErrorCode == MDB_KEYEXIST) {
+                    continue;
+                } else {
+                    result = ENCODED_UNINITIALIZED;
+                    throw;
+                }
+            }
+            break;
+        }
+
+        result.asSetKey.setId = setId;
+        result.asSetKey.reserved = 0;
+        result.typeCode = TYPE_CODE_SET;
+        try {
+            // insert the members
+            PyObject* member;
+            Py_ssize_t pos = 0;
+            Py_hash_t hash;
+            SetItemKey setItemKey = { .setId = setId };
+            MDB_val mdbSetItemKey = {.mv_size = sizeof(setItemKey), .mv_data = &setItemKey};
+            MDB_val mdbSetItemValue = {.mv_size = 0, .mv_data = nullptr};
+            while(_PySet_NextEntry(value, &pos, &member, &hash)) {
+                setItemKey.member = *OOCMap_encode(self, member, txn, true, failOnWrite);
+                put(txn.txn, self->setsDb, &mdbSetItemKey, &mdbSetItemValue);
+                OOCRefcount_incref(self, txn, setItemKey.member);
+            }
+        } catch(...) {
+            // We already filled in `result` above, so we need to clear it now.
+            result = ENCODED_UNINITIALIZED;
+            throw;
+        }
+
+        return &result;
+    }
+
+    // Python's frozenset objects
+    if(PyFrozenSet_CheckExact(value)) {
+        if(PySet_GET_SIZE(value) == 0) {
+            result = ENCODED_EMPTY_FROZENSET;
+            return &result;
+        }
+
+        // Sort the members, so equal frozensets encode to the same bytes.
+        std::vector<EncodedValue> encodedValues;
+        encodedValues.reserve(PySet_GET_SIZE(value));
+        PyObject* member;
+        Py_ssize_t pos = 0;
+        Py_hash_t hash;
+        while(_PySet_NextEntry(value, &pos, &member, &hash))
+            encodedValues.push_back(*OOCMap_encode(self, member, txn, true, failOnWrite));
+        std::sort(encodedValues.begin(), encodedValues.end(), OOCLazySet_memberLess);
+        encodedValues.erase(std::unique(encodedValues.begin(), encodedValues.end()), encodedValues.end());
+
+        result.lengthMinusOne = 0;
+        result.typeCode = TYPE_CODE_FROZENSET;
+        MDB_val mdbValue = {
+            .mv_size = encodedValues.size() * sizeof(EncodedValue),
+            .mv_data = encodedValues.data()
+        };
+        try {
+            bool created = false;
+            result.asUInt = putImmutable(
+                txn.txn,
+                self->tuplesDb,
+                &mdbValue,
+                result.typeCode,
+                txn.readonly || failOnWrite,
+                &created
+            );
+            if(created)
+                OOCMap_countCreated(self, txn, result, mdbValue);
+        } catch(...) {
+            // We already filled in parts of `result` above, so we need to clear it now.
+            result = ENCODED_UNINITIALIZED;
+            throw;
+        }
+        return &result;
+    }
+
+    // Read-only mappings, like the ones that freeze() makes
+    if(PyObject_TypeCheck(value, &PyDictProxy_Type)) {
+        PyObject* const items = PyMapping_Items(value);
+        if(items == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+        std::vector<EncodedValue> encodedValues;
+        try {
+            if(PyList_GET_SIZE(items) == 0) {
+                Py_DECREF(items);
+                result = ENCODED_EMPTY_FROZENDICT;
+                return &result;
+            }
+            encodedValues.reserve(PyList_GET_SIZE(items) * 2);
+            for(Py_ssize_t i = 0; i < PyList_GET_SIZE(items); ++i) {
+                PyObject* const item = PyList_GET_ITEM(items, i);
+                encodedValues.push_back(*OOCMap_encode(self, PyTuple_GET_ITEM(item, 0), txn, true, failOnWrite));
+                encodedValues.push_back(
+                    *OOCMap_encode(self, PyTuple_GET_ITEM(item, 1), txn, failOnMutable, failOnWrite));
+            }
+        } catch(...) {
+            Py_DECREF(items);
+            throw;
+        }
+        Py_DECREF(items);
+        // Sort the items, so equal mappings encode to the same bytes.
+        OOCFrozen_sortItems(encodedValues);
+
+        result.lengthMinusOne = 0;
+        result.typeCode = TYPE_CODE_FROZENDICT;
+        MDB_val mdbValue = {
+            .mv_size = encodedValues.size() * sizeof(EncodedValue),
+            .mv_data = encodedValues.data()
+        };
+        try {
+            bool created = false;
+            result.asUInt = putImmutable(
+                txn.txn,
+                self->tuplesDb,
+                &mdbValue,
+                result.typeCode,
+                txn.readonly || failOnWrite,
+                &created
+            );
+            if(created)
+                OOCMap_countCreated(self, txn, result, mdbValue);
+        } catch(...) {
+            // We already filled in parts of `result` above, so we need to clear it now.
+            result = ENCODED_UNINITIALIZED;
+            throw;
+        }
+        return &result;
+    }
 
     // LazyTuple objects
     if(value->ob_type == &OOCLazyTupleType) {
         OOCLazyTupleObject* const tupleValue = reinterpret_cast<OOCLazyTupleObject*>(value);
         if(tupleValue->ooc == self) {
-            result.asUInt = tupleValue->tupleId;
-            result.typeCode = TYPE_CODE_TUPLE;
-            result.lengthMinusOne = 0;
+            // Nothing counts the reference the lazy tuple holds, so its record may be gone. We can
+            // only write it back if we still have its contents.
+            uint64_t tupleId = tupleValue->tupleId;
+            MDB_val mdbKey = { .mv_size = sizeof(tupleId), .mv_data = &tupleId };
+            MDB_val mdbValue;
+            if(txn.readonly || failOnWrite || get(txn.txn, self->tuplesDb, &mdbKey, &mdbValue)) {
+                result.asUInt = tupleValue->tupleId;
+                result.typeCode = TYPE_CODE_TUPLE;
+                result.lengthMinusOne = 0;
+                return &result;
+            }
+            if(tupleValue->eager == nullptr)
+                throw OocError(OocError::LazyTupleGone);
+            result = *OOCMap_encode(self, tupleValue->eager, txn, failOnMutable, failOnWrite);
             return &result;
         } else {
             if(failOnWrite)
                 throw OocError(OocError::WriteNotAllowed);
 
-            OOCTransaction otherTxn(tupleValue->ooc, true);
+            OOCTransaction otherTxn(tupleValue->ooc, true, tupleValue->snapshot);
             PyObject* const eager = OOCLazyTupleObject_eager(tupleValue, otherTxn);
             try {
-                txn.commit();
+                otherTxn.commit();
                 const EncodedValue* const encoded = OOCMap_encode(self, eager, txn, failOnMutable, false);
                 Py_DECREF(eager);
                 result = *encoded;
@@ -414,7 +887,7 @@ const EncodedValue* OOCMap_encode(
             if(failOnWrite)
                 throw OocError(OocError::WriteNotAllowed);
 
-            OOCTransaction otherTxn(listValue->ooc, true);
+            OOCTransaction otherTxn(listValue->ooc, true, listValue->snapshot);
             PyObject* const eager = OOCLazyListObject_eager(listValue, otherTxn);
             try {
                 otherTxn.commit();
@@ -430,6 +903,38 @@ const EncodedValue* OOCMap_encode(
         }
     }
 
+    // Slices of LazyList objects are written as new lists, like slices of lists.
+    if(value->ob_type == &OOCLazyListSliceType) {
+        if(failOnMutable)
+            throw OocError(OocError::MutableValueNotAllowed);
+        if(failOnWrite)
+            throw OocError(OocError::WriteNotAllowed);
+
+        OOCLazyListSliceObject* const sliceValue = reinterpret_cast<OOCLazyListSliceObject*>(value);
+        PyObject* eager;
+        if(sliceValue->list->ooc == self) {
+            eager = OOCLazyListSliceObject_eager(sliceValue, txn);
+        } else {
+            OOCTransaction otherTxn(sliceValue->list->ooc, true, sliceValue->list->snapshot);
+            eager = OOCLazyListSliceObject_eager(sliceValue, otherTxn);
+            try {
+                otherTxn.commit();
+            } catch(...) {
+                Py_DECREF(eager);
+                throw;
+            }
+        }
+        try {
+            const EncodedValue* const encoded = OOCMap_encode(self, eager, txn, failOnMutable, false);
+            Py_DECREF(eager);
+            result = *encoded;
+        } catch(...) {
+            Py_DECREF(eager);
+            throw;
+        }
+        return &result;
+    }
+
     // LazyDict objects
     if(value->ob_type == &OOCLazyDictType) {
         if(failOnMutable)
@@ -446,7 +951,7 @@ const EncodedValue* OOCMap_encode(
             if(failOnWrite)
                 throw OocError(OocError::WriteNotAllowed);
 
-            OOCTransaction otherTxn(dictValue->ooc, true);
+            OOCTransaction otherTxn(dictValue->ooc, true, dictValue->snapshot);
             PyObject* const eager = OOCLazyDictObject_eager(dictValue, otherTxn);
             try {
                 otherTxn.commit();
@@ -461,43 +966,277 @@ const EncodedValue* OOCMap_encode(
         }
     }
 
-    throw UnknownTypeError(PyObject_Type(value));
-}
+    // LazySet objects
+    if(value->ob_type == &OOCLazySetType) {
+        if(failOnMutable)
+            throw OocError(OocError::MutableValueNotAllowed);
 
-PyObject* OOCMap_decode(
-    OOCMapObject* const self,
-    EncodedValue* const encodedValue,
-    OOCTransaction& txn
-    // We don't need a cache of objects we have decoded. Because of lazyness, we only ever decode
-    // one object at a time.
-) {
-    switch(encodedValue->typeCode) {
-    case TYPE_CODE_HARDCODED: {
-        PyObject* result = nullptr;
-        switch(encodedValue->asInt) {
-        case 1:
-            Py_RETURN_NONE;
-        case 2:
-            result = PyLong_FromLong(0);
-            break;
-        case 3:
-            Py_RETURN_TRUE;
-        case 4:
-            Py_RETURN_FALSE;
-        case 5:
-            result = PyTuple_New(0);
-            break;
-        case 6:
-            result = PyUnicode_New(0, 127);
-            break;
-        default:
-            throw OocError(OocError::UnknownHardcodedValue);
-        }
-        if(result == nullptr) throw OocError(OocError::OutOfMemory);
-        return result;
-    }
-    case TYPE_CODE_SHORT_POSITIVE_INT:
-    case TYPE_CODE_SHORT_NEGATIVE_INT: {
+        OOCLazySetObject* const setValue = reinterpret_cast<OOCLazySetObject*>(value);
+        if(setValue->ooc == self) {
+            result.asSetKey.setId = setValue->setId;
+            result.asSetKey.reserved = 0;
+            result.typeCode = TYPE_CODE_SET;
+            result.lengthMinusOne = 0;
+            return &result;
+        } else {
+            if(failOnWrite)
+                throw OocError(OocError::WriteNotAllowed);
+
+            OOCTransaction otherTxn(setValue->ooc, true, setValue->snapshot);
+            PyObject* const eager = OOCLazySetObject_eager(setValue, otherTxn);
+            try {
+                otherTxn.commit();
+                const EncodedValue* const encoded = OOCMap_encode(self, eager, txn, failOnMutable, false);
+                Py_DECREF(eager);
+                result = *encoded;
+            } catch(...) {
+                Py_DECREF(eager);
+                throw;
+            }
+            return &result;
+        }
+    }
+
+    // NumPy arrays
+    if(OOCNdarray_check(value)) {
+        // Arrays are stored by value, like bytearrays.
+        if(failOnMutable)
+            throw OocError(OocError::MutableValueNotAllowed);
+
+        std::vector<char> serialized = OOCNdarray_serialize(value);
+        result.typeCode = TYPE_CODE_NDARRAY;
+        result.lengthMinusOne = 0;
+        MDB_val mdbValue = {.mv_size = serialized.size(), .mv_data = serialized.data()};
+        try {
+            bool created = false;
+            result.asUInt = putImmutable(
+                txn.txn,
+                self->blobsDb,
+                &mdbValue,
+                TYPE_CODE_NDARRAY,
+                txn.readonly || failOnWrite,
+                &created);
+            if(created)
+                OOCMap_countCreated(self, txn, result, mdbValue);
+        } catch(...) {
+            // We already filled in parts of `result` above, so we need to clear it now.
+            result = ENCODED_UNINITIALIZED;
+            throw;
+        }
+        return &result;
+    }
+
+    throw UnknownTypeError(PyObject_Type(value));
+}
+
+const EncodedValue* OOCMap_encode(
+    OOCMapObject* const self,
+    PyObject* const value,
+    OOCTransaction& txn,
+    const bool failOnMutable,
+    const bool failOnWrite
+) {
+    const EncodedValue* const result = OOCMap_encodeUnshaded(self, value, txn, failOnMutable, failOnWrite);
+    // This is the write barrier for the incremental collector. The recursive calls for the
+    // elements of containers come through here too.
+    if(!txn.readonly && !failOnWrite)
+        OOCGC_shade(self, *result);
+    return result;
+}
+
+void OOCMap_fetch(
+    OOCMapObject* const self,
+    const EncodedValue* const encodedValue,
+    OOCTransaction& txn,
+    FetchedValue* const fetched
+) {
+    fetched->value = *encodedValue;
+    fetched->payload = { .mv_size = 0, .mv_data = nullptr };
+
+    MDB_dbi dbi;
+    switch(encodedValue->typeCode) {
+    case TYPE_CODE_LONG_POSITIVE_INT:
+    case TYPE_CODE_LONG_NEGATIVE_INT:
+        dbi = self->intsDb;
+        break;
+    case TYPE_CODE_UNICODE_LONG_WCHAR:
+    case TYPE_CODE_UNICODE_LONG_1BYTE:
+    case TYPE_CODE_UNICODE_LONG_2BYTE:
+    case TYPE_CODE_UNICODE_LONG_4BYTE:
+        dbi = self->stringsDb;
+        break;
+    case TYPE_CODE_BYTES_LONG:
+    case TYPE_CODE_BYTEARRAY_LONG:
+    case TYPE_CODE_NDARRAY:
+        dbi = self->blobsDb;
+        break;
+    case TYPE_CODE_FROZENSET:
+    case TYPE_CODE_FROZENDICT:
+        dbi = self->tuplesDb;
+        break;
+    default:
+        return;
+    }
+
+    MDB_val mdbKey = { .mv_size = sizeof(fetched->value.asUInt), .mv_data = &fetched->value.asUInt };
+    const bool found = get(txn.txn, dbi, &mdbKey, &fetched->payload);
+    if(!found) throw OocError(OocError::UnexpectedData);
+}
+
+// Makes a bytes or bytearray object. When reading through a snapshot, this makes a read-only
+// memoryview instead, so it matches what long values read through a snapshot come back as.
+static PyObject* OOCMap_decodeBytes(
+    OOCTransaction& txn,
+    const uint8_t typeCode,
+    const char* const data,
+    const size_t size
+) {
+    if(txn.snapshot != nullptr) {
+        PyObject* const copy = PyBytes_FromStringAndSize(data, size);
+        if(copy == nullptr) throw OocError(OocError::OutOfMemory);
+        PyObject* const result = PyMemoryView_FromObject(copy);
+        Py_DECREF(copy);
+        if(result == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+        return result;
+    }
+
+    PyObject* const result =
+        typeCode == TYPE_CODE_BYTES ?
+        PyBytes_FromStringAndSize(data, size) :
+        PyByteArray_FromStringAndSize(data, size);
+    if(result == nullptr) throw OocError(OocError::OutOfMemory);
+    return result;
+}
+
+PyObject* OOCMap_decode(OOCMapObject* const self, FetchedValue* const fetched, OOCTransaction& txn) {
+    return OOCMap_decode(self, &fetched->value, txn, &fetched->payload);
+}
+
+static PyObject* OOCMap_decodeUncached(
+    OOCMapObject* const self,
+    EncodedValue* const encodedValue,
+    OOCTransaction& txn,
+    const MDB_val* payload
+);
+
+PyObject* OOCMap_decode(
+    OOCMapObject* const self,
+    EncodedValue* const encodedValue,
+    OOCTransaction& txn,
+    const MDB_val* const payload
+) {
+    // Only values that live in their own table are worth caching. Everything else is decoded
+    // straight from the EncodedValue, or is a lazy object that holds a reference to the map, which
+    // the cache would then keep alive forever. Long bytes read through a snapshot are views into
+    // the map, so they can't be shared either.
+    bool cacheable;
+    switch(encodedValue->typeCode) {
+    case TYPE_CODE_LONG_POSITIVE_INT:
+    case TYPE_CODE_LONG_NEGATIVE_INT:
+    case TYPE_CODE_UNICODE_LONG_WCHAR:
+    case TYPE_CODE_UNICODE_LONG_1BYTE:
+    case TYPE_CODE_UNICODE_LONG_2BYTE:
+    case TYPE_CODE_UNICODE_LONG_4BYTE:
+        cacheable = self->decodeCache != nullptr;
+        break;
+    case TYPE_CODE_BYTES_LONG:
+        cacheable = self->decodeCache != nullptr && txn.snapshot == nullptr;
+        break;
+    default:
+        cacheable = false;
+    }
+    if(!cacheable)
+        return OOCMap_decodeUncached(self, encodedValue, txn, payload);
+
+    PyObject* const cached = self->decodeCache->get(*encodedValue);
+    if(cached != nullptr)
+        return cached;
+    PyObject* const result = OOCMap_decodeUncached(self, encodedValue, txn, payload);
+    self->decodeCache->put(*encodedValue, result);
+    return result;
+}
+
+PyObject* OOCMap_decodeKey(OOCMapObject* const self, FetchedValue* const fetched, OOCTransaction& txn) {
+    return OOCMap_decodeKey(self, &fetched->value, txn, &fetched->payload);
+}
+
+PyObject* OOCMap_decodeKey(
+    OOCMapObject* const self,
+    EncodedValue* const encodedValue,
+    OOCTransaction& txn,
+    const MDB_val* const payload
+) {
+    if(self->internedKeys == nullptr)
+        return OOCMap_decode(self, encodedValue, txn, payload);
+    switch(encodedValue->typeCode) {
+    case TYPE_CODE_UNICODE_SHORT_WCHAR:
+    case TYPE_CODE_UNICODE_SHORT_1BYTE:
+    case TYPE_CODE_UNICODE_SHORT_2BYTE:
+    case TYPE_CODE_UNICODE_SHORT_4BYTE:
+    case TYPE_CODE_UNICODE_LONG_WCHAR:
+    case TYPE_CODE_UNICODE_LONG_1BYTE:
+    case TYPE_CODE_UNICODE_LONG_2BYTE:
+    case TYPE_CODE_UNICODE_LONG_4BYTE:
+        break;
+    default:
+        return OOCMap_decode(self, encodedValue, txn, payload);
+    }
+
+    PyObject* result = self->internedKeys->get(*encodedValue);
+    if(result != nullptr)
+        return result;
+    result = OOCMap_decode(self, encodedValue, txn, payload);
+    self->internedKeys->put(*encodedValue, &result);
+    return result;
+}
+
+static PyObject* OOCMap_decodeUncached(
+    OOCMapObject* const self,
+    EncodedValue* const encodedValue,
+    OOCTransaction& txn,
+    const MDB_val* payload
+) {
+    switch(encodedValue->typeCode) {
+    case TYPE_CODE_HARDCODED: {
+        PyObject* result = nullptr;
+        switch(encodedValue->asInt) {
+        case 1:
+            Py_RETURN_NONE;
+        case 2:
+            result = PyLong_FromLong(0);
+            break;
+        case 3:
+            Py_RETURN_TRUE;
+        case 4:
+            Py_RETURN_FALSE;
+        case 5:
+            result = PyTuple_New(0);
+            break;
+        case 6:
+            result = PyUnicode_New(0, 127);
+            break;
+        case 7:
+            return OOCMap_decodeBytes(txn, TYPE_CODE_BYTES, nullptr, 0);
+        case 8:
+            return OOCMap_decodeBytes(txn, TYPE_CODE_BYTEARRAY, nullptr, 0);
+        case 9:
+            result = PyFrozenSet_New(nullptr);
+            break;
+        case 10: {
+            PyObject* const dict = PyDict_New();
+            if(dict == nullptr) throw OocError(OocError::OutOfMemory);
+            result = PyDictProxy_New(dict);
+            Py_DECREF(dict);
+            break;
+        }
+        default:
+            throw OocError(OocError::UnknownHardcodedValue);
+        }
+        if(result == nullptr) throw OocError(OocError::OutOfMemory);
+        return result;
+    }
+    case TYPE_CODE_SHORT_POSITIVE_INT:
+    case TYPE_CODE_SHORT_NEGATIVE_INT: {
         const size_t length = encodedValue->lengthMinusOne + 1;
         PyLongObject* const result = _PyLong_New(length / sizeof(digit));
         // TODO: Every duplicate long will create its own PyObject this way. We should cache
@@ -510,16 +1249,17 @@ PyObject* OOCMap_decode(
     }
     case TYPE_CODE_LONG_POSITIVE_INT:
     case TYPE_CODE_LONG_NEGATIVE_INT: {
-        MDB_val mdbKey = { .mv_size = sizeof(encodedValue->asUInt), .mv_data = &(encodedValue->asUInt) };
-        MDB_val mdbValue;
-        const bool found = get(txn.txn, self->intsDb, &mdbKey, &mdbValue);
-        if(!found) throw OocError(OocError::UnexpectedData);
+        FetchedValue fetched;
+        if(payload == nullptr) {
+            OOCMap_fetch(self, encodedValue, txn, &fetched);
+            payload = &fetched.payload;
+        }
 
-        PyLongObject* const result = _PyLong_New(mdbValue.mv_size / sizeof(digit));
+        PyLongObject* const result = _PyLong_New(payload->mv_size / sizeof(digit));
         if(result == nullptr) throw OocError(OocError::OutOfMemory);
         if(encodedValue->typeCode == TYPE_CODE_LONG_NEGATIVE_INT)
             result->ob_base.ob_size *= -1;
-        memcpy(result->ob_digit, mdbValue.mv_data, mdbValue.mv_size);
+        memcpy(result->ob_digit, payload->mv_data, payload->mv_size);
         return (PyObject*)result;
     }
     case TYPE_CODE_FLOAT: {
@@ -561,12 +1301,13 @@ PyObject* OOCMap_decode(
     case TYPE_CODE_UNICODE_LONG_1BYTE:
     case TYPE_CODE_UNICODE_LONG_2BYTE:
     case TYPE_CODE_UNICODE_LONG_4BYTE: {
-        MDB_val mdbKey = {.mv_size = sizeof(encodedValue->asUInt), .mv_data = &(encodedValue->asUInt)};
-        MDB_val mdbValue;
-        const bool found = get(txn.txn, self->stringsDb, &mdbKey, &mdbValue);
-        if(!found) throw OocError(OocError::UnexpectedData);
+        FetchedValue fetched;
+        if(payload == nullptr) {
+            OOCMap_fetch(self, encodedValue, txn, &fetched);
+            payload = &fetched.payload;
+        }
 
-        Py_ssize_t size = mdbValue.mv_size;
+        Py_ssize_t size = payload->mv_size;
         int kind;
         switch(encodedValue->typeCode) {
         case TYPE_CODE_UNICODE_LONG_WCHAR:
@@ -588,21 +1329,319 @@ PyObject* OOCMap_decode(
         default:
             throw OocError(OocError::UnexpectedData);
         }
-        PyObject* const result = PyUnicode_FromKindAndData(kind, mdbValue.mv_data, size);
+        PyObject* const result = PyUnicode_FromKindAndData(kind, payload->mv_data, size);
         if(result == nullptr) throw OocError(OocError::OutOfMemory);
         return result;
     }
+    case TYPE_CODE_BYTES:
+    case TYPE_CODE_BYTEARRAY:
+        return OOCMap_decodeBytes(
+            txn,
+            encodedValue->typeCode,
+            reinterpret_cast<const char*>(encodedValue->asChars),
+            encodedValue->lengthMinusOne + 1);
+    case TYPE_CODE_BYTES_LONG:
+    case TYPE_CODE_BYTEARRAY_LONG: {
+        FetchedValue fetched;
+        if(payload == nullptr) {
+            OOCMap_fetch(self, encodedValue, txn, &fetched);
+            payload = &fetched.payload;
+        }
+        if(txn.snapshot != nullptr)
+            return OOCSnapshot_memoryview(txn.snapshot, payload->mv_data, payload->mv_size);
+        return OOCMap_decodeBytes(
+            txn,
+            encodedValue->typeCode == TYPE_CODE_BYTES_LONG ? TYPE_CODE_BYTES : TYPE_CODE_BYTEARRAY,
+            static_cast<const char*>(payload->mv_data),
+            payload->mv_size);
+    }
+    case TYPE_CODE_NDARRAY: {
+        FetchedValue fetched;
+        if(payload == nullptr) {
+            OOCMap_fetch(self, encodedValue, txn, &fetched);
+            payload = &fetched.payload;
+        }
+        return OOCNdarray_deserialize(payload, txn.snapshot);
+    }
     case TYPE_CODE_TUPLE:
-        return reinterpret_cast<PyObject*>(OOCLazyTuple_fastnew(self, encodedValue->asUInt));
+        return reinterpret_cast<PyObject*>(OOCLazyTuple_fastnew(self, encodedValue->asUInt, txn.snapshot));
     case TYPE_CODE_LIST:
-        return reinterpret_cast<PyObject*>(OOCLazyList_fastnew(self, encodedValue->asListKey.listId));
+        return reinterpret_cast<PyObject*>(OOCLazyList_fastnew(self, encodedValue->asListKey.listId, txn.snapshot));
     case TYPE_CODE_DICT:
-        return reinterpret_cast<PyObject*>(OOCLazyDict_fastnew(self, encodedValue->asDictKey.dictId));
+        return reinterpret_cast<PyObject*>(OOCLazyDict_fastnew(self, encodedValue->asDictKey.dictId, txn.snapshot));
+    case TYPE_CODE_SET:
+        return reinterpret_cast<PyObject*>(OOCLazySet_fastnew(self, encodedValue->asSetKey.setId, txn.snapshot));
+    case TYPE_CODE_FROZENSET: {
+        // Frozensets are immutable and hashable, so there is nothing to gain from a lazy one.
+        FetchedValue fetched;
+        if(payload == nullptr) {
+            OOCMap_fetch(self, encodedValue, txn, &fetched);
+            payload = &fetched.payload;
+        }
+        if(payload->mv_size % sizeof(EncodedValue) != 0) throw OocError(OocError::UnexpectedData);
+
+        // Copy the members out, because decoding them may read from the map.
+        std::vector<EncodedValue> members(payload->mv_size / sizeof(EncodedValue));
+        memcpy(members.data(), payload->mv_data, payload->mv_size);
+        PyObject* const result = PyFrozenSet_New(nullptr);
+        if(result == nullptr) throw OocError(OocError::OutOfMemory);
+        try {
+            for(EncodedValue& member : members) {
+                PyObject* const item = OOCMap_decode(self, &member, txn);
+                const int failure = PySet_Add(result, item);
+                Py_DECREF(item);
+                if(failure) throw OocError(OocError::AlreadyPythonizedError);
+            }
+        } catch(...) {
+            Py_DECREF(result);
+            throw;
+        }
+        return result;
+    }
+    case TYPE_CODE_FROZENDICT: {
+        FetchedValue fetched;
+        if(payload == nullptr) {
+            OOCMap_fetch(self, encodedValue, txn, &fetched);
+            payload = &fetched.payload;
+        }
+        if(payload->mv_size % (2 * sizeof(EncodedValue)) != 0) throw OocError(OocError::UnexpectedData);
+
+        // Copy the items out, because decoding them may read from the map.
+        std::vector<EncodedValue> items(payload->mv_size / sizeof(EncodedValue));
+        memcpy(items.data(), payload->mv_data, payload->mv_size);
+        PyObject* const dict = PyDict_New();
+        if(dict == nullptr) throw OocError(OocError::OutOfMemory);
+        try {
+            for(size_t i = 0; i < items.size(); i += 2) {
+                PyObject* const key = OOCMap_decodeKey(self, &items[i], txn);
+                PyObject* item;
+                try {
+                    item = OOCMap_decode(self, &items[i + 1], txn);
+                } catch(...) {
+                    Py_DECREF(key);
+                    throw;
+                }
+                const int failure = PyDict_SetItem(dict, key, item);
+                Py_DECREF(key);
+                Py_DECREF(item);
+                if(failure) throw OocError(OocError::AlreadyPythonizedError);
+            }
+        } catch(...) {
+            Py_DECREF(dict);
+            throw;
+        }
+        PyObject* const result = PyDictProxy_New(dict);
+        Py_DECREF(dict);
+        if(result == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+        return result;
+    }
     default:
         throw OocError(OocError::UnknownType);
     }
 }
 
+PyObject* OOCMap_reiterable(PyObject* const items) {
+    if(PyDict_Check(items) || PySequence_Check(items) || PyObject_HasAttrString(items, "keys")) {
+        Py_INCREF(items);
+        return items;
+    }
+    PyObject* const result = PySequence_List(items);
+    if(result == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+    return result;
+}
+
+void OOCMapObject_putMany(OOCMapObject* const self, OOCTransaction& txn, PyObject* const items) {
+    // Encode everything first. The values have to be written to their own tables anyway, but the
+    // root table entries can be written in key order afterwards, which touches every B-tree page
+    // only once.
+    std::vector<std::pair<EncodedValue, EncodedValue>> encodedItems;
+    const auto addItem = [&](PyObject* const key, PyObject* const value) {
+        const EncodedValue encodedKey = *OOCMap_encode(self, key, txn, true);
+        const EncodedValue encodedValue = *OOCMap_encode(self, value, txn);
+        encodedItems.emplace_back(encodedKey, encodedValue);
+    };
+
+    if(PyDict_Check(items)) {
+        PyObject* key;
+        PyObject* value;
+        Py_ssize_t pos = 0;
+        encodedItems.reserve(PyDict_GET_SIZE(items));
+        while(PyDict_Next(items, &pos, &key, &value))
+            addItem(key, value);
+    } else {
+        const bool isMapping = PyObject_HasAttrString(items, "keys");
+        PyObject* const pairs = isMapping ? PyMapping_Items(items) : PySequence_List(items);
+        if(pairs == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+        try {
+            encodedItems.reserve(PyList_GET_SIZE(pairs));
+            for(Py_ssize_t i = 0; i < PyList_GET_SIZE(pairs); ++i) {
+                PyObject* const pair = PySequence_Fast(PyList_GET_ITEM(pairs, i), "");
+                if(pair == nullptr || PySequence_Fast_GET_SIZE(pair) != 2) {
+                    PyErr_Clear();
+                    PyErr_Format(
+                        PyExc_ValueError,
+                        "update sequence element #%zd is not a sequence of length 2",
+                        i);
+                    Py_XDECREF(pair);
+                    throw OocError(OocError::AlreadyPythonizedError);
+                }
+                try {
+                    addItem(PySequence_Fast_GET_ITEM(pair, 0), PySequence_Fast_GET_ITEM(pair, 1));
+                } catch(...) {
+                    Py_DECREF(pair);
+                    throw;
+                }
+                Py_DECREF(pair);
+            }
+        } catch(...) {
+            Py_DECREF(pairs);
+            throw;
+        }
+        Py_DECREF(pairs);
+    }
+    OOCMapObject_putEncoded(self, txn, encodedItems);
+}
+
+void OOCMapObject_putEncoded(
+    OOCMapObject* const self,
+    OOCTransaction& txn,
+    std::vector<std::pair<EncodedValue, EncodedValue>>& encodedItems
+) {
+    if(encodedItems.empty()) return;
+
+    // Sort by key the same way LMDB does. When a key appears more than once, the last one wins.
+    const auto keyLess = [](
+        const std::pair<EncodedValue, EncodedValue>& a,
+        const std::pair<EncodedValue, EncodedValue>& b
+    ) {
+        return memcmp(&a.first, &b.first, sizeof(EncodedValue)) < 0;
+    };
+    std::stable_sort(encodedItems.begin(), encodedItems.end(), keyLess);
+    size_t uniqueCount = 0;
+    for(size_t i = 0; i < encodedItems.size(); ++i) {
+        if(i + 1 < encodedItems.size() && encodedItems[i].first == encodedItems[i + 1].first)
+            continue;
+        encodedItems[uniqueCount++] = encodedItems[i];
+    }
+    encodedItems.resize(uniqueCount);
+
+    MDB_cursor* const cursor = cursor_open(txn.txn, self->rootDb);
+    try {
+        // If all the new keys sort after the existing ones, LMDB can append them to the last page
+        // without searching the tree at all.
+        MDB_val mdbKey;
+        MDB_val mdbValue;
+        unsigned int flags = MDB_APPEND;
+        if(cursor_get(cursor, &mdbKey, &mdbValue, MDB_LAST)) {
+            if(mdbKey.mv_size != sizeof(EncodedValue) ||
+               memcmp(mdbKey.mv_data, &encodedItems.front().first, sizeof(EncodedValue)) >= 0)
+                flags = 0;
+        }
+
+        for(auto& item : encodedItems) {
+            mdbKey = { .mv_size = sizeof(item.first), .mv_data = &item.first };
+            // Overwritten values lose a reference, see refcount.h.
+            bool found = false;
+            if(flags != MDB_APPEND) {
+                found = cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_KEY);
+                if(found) {
+                    if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
+                    EncodedValue oldValue;
+                    memcpy(&oldValue, mdbValue.mv_data, sizeof(oldValue));
+                    OOCRefcount_decref(self, txn, oldValue);
+                }
+                mdbKey = { .mv_size = sizeof(item.first), .mv_data = &item.first };
+            }
+            if(!found)
+                OOCRefcount_incref(self, txn, item.first);
+            OOCRefcount_incref(self, txn, item.second);
+            mdbValue = { .mv_size = sizeof(item.second), .mv_data = &item.second };
+            cursor_put(cursor, &mdbKey, &mdbValue, found ? MDB_CURRENT : flags);
+        }
+    } catch(...) {
+        txn.closeCursor(cursor);
+        throw;
+    }
+    txn.closeCursor(cursor);
+}
+
+PyObject* OOCMapObject_getMany(
+    OOCMapObject* const self,
+    OOCTransaction& txn,
+    PyObject* const keys,
+    PyObject* const defaultValue
+) {
+    PyObject* const keysFast = PySequence_Fast(keys, "get_many() expects an iterable of keys");
+    if(keysFast == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+    const Py_ssize_t keyCount = PySequence_Fast_GET_SIZE(keysFast);
+    PyObject* const result = PyList_New(keyCount);
+    if(result == nullptr) {
+        Py_DECREF(keysFast);
+        throw OocError(OocError::OutOfMemory);
+    }
+
+    MDB_cursor* cursor = nullptr;
+    try {
+        // Encode all the keys. Keys that can't be encoded without writing can't be in the map.
+        std::vector<std::pair<EncodedValue, Py_ssize_t>> encodedKeys;
+        encodedKeys.reserve(keyCount);
+        for(Py_ssize_t i = 0; i < keyCount; ++i) {
+            try {
+                const EncodedValue* const encodedKey =
+                    OOCMap_encode(self, PySequence_Fast_GET_ITEM(keysFast, i), txn, true, true);
+                encodedKeys.emplace_back(*encodedKey, i);
+            } catch(const OocError& error) {
+                if(error.errorCode != OocError::WriteNotAllowed &&
+                   error.errorCode != OocError::ImmutableValueNotFound)
+                    throw;
+            }
+        }
+
+        // Look them up in the order LMDB stores them in, so the cursor can usually find the next
+        // key on the page it is already on instead of searching the whole tree again.
+        std::sort(
+            encodedKeys.begin(),
+            encodedKeys.end(),
+            [](const std::pair<EncodedValue, Py_ssize_t>& a, const std::pair<EncodedValue, Py_ssize_t>& b) {
+                return memcmp(&a.first, &b.first, sizeof(EncodedValue)) < 0;
+            });
+        // All the LMDB reads happen without the GIL. We only get it back to build the results.
+        std::vector<std::pair<FetchedValue, Py_ssize_t>> fetchedValues;
+        fetchedValues.reserve(encodedKeys.size());
+        {
+            GilUnlocker gil;
+            cursor = cursor_open(txn.txn, self->rootDb);
+            for(auto& encodedKey : encodedKeys) {
+                MDB_val mdbKey = { .mv_size = sizeof(encodedKey.first), .mv_data = &encodedKey.first };
+                MDB_val mdbValue;
+                if(!cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET)) continue;
+                if(mdbValue.mv_size != sizeof(EncodedValue)) throw OocError(OocError::UnexpectedData);
+                fetchedValues.emplace_back();
+                fetchedValues.back().second = encodedKey.second;
+                OOCMap_fetch(self, static_cast<EncodedValue*>(mdbValue.mv_data), txn, &fetchedValues.back().first);
+            }
+            txn.closeCursor(cursor);
+            cursor = nullptr;
+        }
+        for(auto& fetched : fetchedValues)
+            PyList_SET_ITEM(result, fetched.second, OOCMap_decode(self, &fetched.first, txn));
+    } catch(...) {
+        if(cursor != nullptr) txn.closeCursor(cursor);
+        Py_DECREF(result);
+        Py_DECREF(keysFast);
+        throw;
+    }
+    Py_DECREF(keysFast);
+
+    for(Py_ssize_t i = 0; i < keyCount; ++i) {
+        if(PyList_GET_ITEM(result, i) == nullptr) {
+            Py_INCREF(defaultValue);
+            PyList_SET_ITEM(result, i, defaultValue);
+        }
+    }
+    return result;
+}
+
 static bool isOOCMap(PyObject* self);
 
 //
@@ -611,6 +1650,16 @@ static bool isOOCMap(PyObject* self);
 //
 
 static void OOCMap_dealloc(OOCMapObject* self) {
+    while(self->readTxnPoolSize > 0) {
+        self->readTxnPoolSize -= 1;
+        mdb_txn_abort(self->readTxnPool[self->readTxnPoolSize]);
+    }
+    delete self->syncer;
+    delete self->decodeCache;
+    delete self->internedKeys;
+    delete self->collector;
+    delete self->refcounts;
+    delete self->txnThreads;
     mdb_env_close(self->mdb);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
@@ -627,24 +1676,72 @@ static PyObject* OOCMap_new(PyTypeObject* type, PyObject* args, PyObject* kwds)
             MdbError(error).pythonize();
             return nullptr;
         }
-        mdb_env_set_maxdbs(self->mdb, 6);
+        mdb_env_set_maxdbs(self->mdb, 10);
+        self->activeTxns = nullptr;
+        self->readTxnPoolSize = 0;
+        self->liveTxns = 0;
+        self->growPending = false;
+        self->txnThreads = new std::vector<std::pair<MDB_txn*, unsigned long>>();
+        self->syncer = nullptr;
+        self->decodeCache = nullptr;
+        self->internedKeys = nullptr;
+        self->collector = nullptr;
+        self->refcounts = nullptr;
     }
     return (PyObject*)self;
 }
 
 static int OOCMap_init(OOCMapObject* self, PyObject* args, PyObject* kwds) {
     // parse parameters
-    static const char *kwlist[] = {"filename", "max_size", nullptr};
+    static const char *kwlist[] = {
+        "filename", "max_size", "writemap", "durability", "sync_interval", "decode_cache_size", "intern_keys",
+        "gc_rows_per_write", nullptr
+    };
     PyObject* filenameObject = nullptr;
     unsigned long long mapsize = 0;
+    int writemap = 1;
+    const char* durabilityName = "none";
+    double syncInterval = 1.0;
+    Py_ssize_t decodeCacheSize = 4096;
+    int internKeys = 0;
+    Py_ssize_t gcRowsPerWrite = 0;
     const int parseSuccess = PyArg_ParseTupleAndKeywords(
             args,
             kwds,
-            "O&|$K",
+            "O&|$Kpsdnpn",
             const_cast<char**>(kwlist),
-            PyUnicode_FSConverter, &filenameObject, &mapsize);
+            PyUnicode_FSConverter, &filenameObject, &mapsize, &writemap, &durabilityName, &syncInterval,
+            &decodeCacheSize, &internKeys, &gcRowsPerWrite);
     if(!parseSuccess)
         return -1;
+
+    Durability durability;
+    if(strcmp(durabilityName, "none") == 0) {
+        durability = Durability::None;
+    } else if(strcmp(durabilityName, "periodic") == 0) {
+        durability = Durability::Periodic;
+    } else if(strcmp(durabilityName, "commit") == 0) {
+        durability = Durability::Commit;
+    } else {
+        Py_XDECREF(filenameObject);
+        PyErr_Format(PyExc_ValueError, "durability must be 'none', 'periodic', or 'commit', not '%s'", durabilityName);
+        return -1;
+    }
+    if(!(syncInterval > 0)) {
+        Py_XDECREF(filenameObject);
+        PyErr_Format(PyExc_ValueError, "sync_interval must be positive");
+        return -1;
+    }
+    if(decodeCacheSize < 0) {
+        Py_XDECREF(filenameObject);
+        PyErr_Format(PyExc_ValueError, "decode_cache_size can't be negative");
+        return -1;
+    }
+    if(gcRowsPerWrite < 0) {
+        Py_XDECREF(filenameObject);
+        PyErr_Format(PyExc_ValueError, "gc_rows_per_write can't be negative");
+        return -1;
+    }
     const char* filename = PyBytes_AS_STRING(filenameObject);
 
     // set mapsize
@@ -657,12 +1754,13 @@ static int OOCMap_init(OOCMapObject* self, PyObject* args, PyObject* kwds) {
     }
 
     // open lmdb
-    // These are some aggressive flags that don't guarantee data integrity.
-    const int mdbOpenError = mdb_env_open(
-            self->mdb,
-            filename,
-            MDB_NOSUBDIR | MDB_NOSYNC | MDB_WRITEMAP | MDB_NOMETASYNC| MDB_MAPASYNC | MDB_NOMEMINIT | MDB_NOTLS,
-            0644);
+    // These are some aggressive flags that don't guarantee data integrity. If the user wants
+    // durability, OOCSyncer takes care of it.
+    // Writing through the memory map is faster, but LMDB can't do nested transactions that way.
+    unsigned int flags = MDB_NOSUBDIR | MDB_NOSYNC | MDB_NOMETASYNC | MDB_NOMEMINIT | MDB_NOTLS;
+    if(writemap)
+        flags |= MDB_WRITEMAP | MDB_MAPASYNC;
+    const int mdbOpenError = mdb_env_open(self->mdb, filename, flags, 0644);
     Py_CLEAR(filenameObject);
     if(mdbOpenError != 0) {
         MdbError(mdbOpenError).pythonize();
@@ -672,6 +1770,19 @@ static int OOCMap_init(OOCMapObject* self, PyObject* args, PyObject* kwds) {
     mdb_env_info(self->mdb, &info);
     // TODO: We should check for and handle the case where self->mdb has already been opened.
 
+    try {
+        self->syncer = new OOCSyncer(self->mdb, durability, syncInterval);
+    } catch(const std::system_error& e) {
+        PyErr_Format(PyExc_RuntimeError, "Could not start the sync thread: %s", e.what());
+        return -1;
+    }
+    if(decodeCacheSize > 0)
+        self->decodeCache = new OOCDecodeCache(decodeCacheSize);
+    if(internKeys)
+        self->internedKeys = new OOCInternedKeys();
+    self->collector = new OOCCollector(gcRowsPerWrite);
+    self->refcounts = new OOCRefcounts();
+
     // open all the DBs
     MDB_txn* txn = nullptr;
     try {
@@ -682,6 +1793,10 @@ static int OOCMap_init(OOCMapObject* self, PyObject* args, PyObject* kwds) {
         open_db(txn, "lists", MDB_CREATE | MDB_INTEGERKEY, &self->listsDb);
         open_db(txn, "tuples", MDB_CREATE | MDB_INTEGERKEY, &self->tuplesDb);
         open_db(txn, "dicts", MDB_CREATE, &self->dictsDb);
+        open_db(txn, "blobs", MDB_CREATE | MDB_INTEGERKEY, &self->blobsDb);
+        open_db(txn, "sets", MDB_CREATE, &self->setsDb);
+        open_db(txn, "meta", MDB_CREATE, &self->metaDb);
+        open_db(txn, "refcounts", MDB_CREATE, &self->refcountsDb);
         txn_commit(txn);
     } catch (const OocError& error) {
         if(txn != nullptr)
@@ -693,28 +1808,27 @@ static int OOCMap_init(OOCMapObject* self, PyObject* args, PyObject* kwds) {
     return 0;
 }
 
-static Py_ssize_t OOCMap_length(PyObject* pySelf) {
-    if(!isOOCMap(pySelf)) {
-        PyErr_BadArgument();
-        return -1;
-    }
-    OOCMapObject* const self = reinterpret_cast<OOCMapObject*>(pySelf);
-
-    MDB_txn* txn = nullptr;
+Py_ssize_t OOCMap_lengthInSnapshot(OOCMapObject* const self, OOCTransactionObject* const snapshot) {
     try {
-        txn = txn_begin(self->mdb, false);
+        OOCTransaction txn(self, true, snapshot);
         MDB_stat stat;
-        mdb_stat(txn, self->rootDb, &stat);
-        txn_commit(txn);
+        mdb_stat(txn.txn, self->rootDb, &stat);
+        txn.commit();
         return stat.ms_entries;
     } catch(const OocError& error) {
-        if(txn != nullptr)
-            txn_abort(txn);
         error.pythonize();
         return -1;
     }
 }
 
+static Py_ssize_t OOCMap_length(PyObject* pySelf) {
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return -1;
+    }
+    return OOCMap_lengthInSnapshot(reinterpret_cast<OOCMapObject*>(pySelf), nullptr);
+}
+
 static int OOCMap_insert(PyObject* pySelf, PyObject* key, PyObject* value) {
     // cast the input
     if(!isOOCMap(pySelf)) {
@@ -725,28 +1839,45 @@ static int OOCMap_insert(PyObject* pySelf, PyObject* key, PyObject* value) {
 
     // start transaction
     try {
-        OOCTransaction txn(self, false);
+        OOCMapObject_growingWrite(self, [&]() {
+            OOCTransaction txn(self, false);
 
-        const EncodedValue* const encodedKey = OOCMap_encode(self, key, txn, true);
-        MDB_val mdbKey = {
-            .mv_size = sizeof(*encodedKey),
-            .mv_data = const_cast<EncodedValue*>(encodedKey)
-        };
-
-        if(value == nullptr) {
-            // Deleting the value
-            del(txn.txn, self->rootDb, &mdbKey);
-        } else {
-            // Inserting a new value
-            const EncodedValue* const encodedValue = OOCMap_encode(self, value, txn);
-            MDB_val mdbValue = {
-                .mv_size = sizeof(*encodedValue),
-                .mv_data = const_cast<EncodedValue*>(encodedValue)
+            const EncodedValue* const encodedKey = OOCMap_encode(self, key, txn, true);
+            MDB_val mdbKey = {
+                .mv_size = sizeof(*encodedKey),
+                .mv_data = const_cast<EncodedValue*>(encodedKey)
             };
 
-            put(txn.txn, self->rootDb, &mdbKey, &mdbValue);
-        }
-        txn.commit();
+            // The old value loses a reference, see refcount.h.
+            MDB_val mdbOldValue;
+            const bool found = get(txn.txn, self->rootDb, &mdbKey, &mdbOldValue);
+            EncodedValue oldValue = ENCODED_NONE;
+            if(found) {
+                if(mdbOldValue.mv_size != sizeof(oldValue)) throw OocError(OocError::UnexpectedData);
+                memcpy(&oldValue, mdbOldValue.mv_data, sizeof(oldValue));
+            }
+
+            if(value == nullptr) {
+                // Deleting the value
+                del(txn.txn, self->rootDb, &mdbKey);
+                OOCRefcount_decref(self, txn, *encodedKey);
+            } else {
+                // Inserting a new value
+                const EncodedValue* const encodedValue = OOCMap_encode(self, value, txn);
+                MDB_val mdbValue = {
+                    .mv_size = sizeof(*encodedValue),
+                    .mv_data = const_cast<EncodedValue*>(encodedValue)
+                };
+
+                put(txn.txn, self->rootDb, &mdbKey, &mdbValue);
+                if(!found)
+                    OOCRefcount_incref(self, txn, *encodedKey);
+                OOCRefcount_incref(self, txn, *encodedValue);
+            }
+            if(found)
+                OOCRefcount_decref(self, txn, oldValue);
+            txn.commit();
+        });
     } catch(const OocError& error) {
         if(error.errorCode == OocError::MutableValueNotAllowed)
             PyErr_Format(PyExc_TypeError, "unhashable type: '%s'", Py_TYPE(key)->tp_name);
@@ -758,16 +1889,9 @@ static int OOCMap_insert(PyObject* pySelf, PyObject* key, PyObject* value) {
     return 0;
 }
 
-static PyObject* OOCMap_get(PyObject* pySelf, PyObject* key) {
-    // cast the input
-    if(!isOOCMap(pySelf)) {
-        PyErr_BadArgument();
-        return nullptr;
-    }
-    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
-
+PyObject* OOCMap_getInSnapshot(OOCMapObject* const self, PyObject* const key, OOCTransactionObject* const snapshot) {
     try {
-        OOCTransaction txn(self, true);
+        OOCTransaction txn(self, true, snapshot);
 
         const EncodedValue* const encodedKey = OOCMap_encode(self, key, txn, true, true);
         MDB_val mdbKey = {
@@ -805,12 +1929,489 @@ static PyObject* OOCMap_get(PyObject* pySelf, PyObject* key) {
     }
 }
 
+static PyObject* OOCMap_get(PyObject* pySelf, PyObject* key) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    return OOCMap_getInSnapshot(reinterpret_cast<OOCMapObject*>(pySelf), key, nullptr);
+}
+
+static PyObject* OOCMap_getMany(PyObject* pySelf, PyObject* args, PyObject* kwds) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    // parse parameters
+    static const char *kwlist[] = {"keys", "default", nullptr};
+    PyObject* keys = nullptr;
+    PyObject* defaultValue = Py_None;
+    const int parseSuccess = PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "O|O",
+        const_cast<char**>(kwlist),
+        &keys, &defaultValue);
+    if(!parseSuccess)
+        return nullptr;
+
+    try {
+        OOCTransaction txn(self, true);
+        PyObject* const result = OOCMapObject_getMany(self, txn, keys, defaultValue);
+        txn.commit();
+        return result;
+    } catch(const OocError& error) {
+        if(error.errorCode == OocError::MutableValueNotAllowed)
+            PyErr_Format(PyExc_TypeError, "unhashable key in get_many()");
+        else
+            error.pythonize();
+        return nullptr;
+    }
+}
+
+static PyObject* OOCMap_putMany(PyObject* pySelf, PyObject* items) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    PyObject* reiterableItems = nullptr;
+    try {
+        reiterableItems = OOCMap_reiterable(items);
+        OOCMapObject_growingWrite(self, [&]() {
+            OOCTransaction txn(self, false);
+            OOCMapObject_putMany(self, txn, reiterableItems);
+            txn.commit();
+        });
+        Py_DECREF(reiterableItems);
+    } catch(const OocError& error) {
+        if(error.errorCode == OocError::MutableValueNotAllowed)
+            PyErr_Format(PyExc_TypeError, "unhashable key in put_many()");
+        else
+            error.pythonize();
+        Py_XDECREF(reiterableItems);
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCMap_update(PyObject* pySelf, PyObject* args, PyObject* kwds) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    // parse parameters
+    PyObject* items = nullptr;
+    if(!PyArg_UnpackTuple(args, "update", 0, 1, &items))
+        return nullptr;
+
+    PyObject* reiterableItems = nullptr;
+    try {
+        if(items != nullptr)
+            reiterableItems = OOCMap_reiterable(items);
+        OOCMapObject_growingWrite(self, [&]() {
+            OOCTransaction txn(self, false);
+            if(reiterableItems != nullptr)
+                OOCMapObject_putMany(self, txn, reiterableItems);
+            if(kwds != nullptr)
+                OOCMapObject_putMany(self, txn, kwds);
+            txn.commit();
+        });
+        Py_XDECREF(reiterableItems);
+    } catch(const OocError& error) {
+        if(error.errorCode == OocError::MutableValueNotAllowed)
+            PyErr_Format(PyExc_TypeError, "unhashable key in update()");
+        else
+            error.pythonize();
+        Py_XDECREF(reiterableItems);
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCMap_transaction(PyObject* pySelf, PyObject* args, PyObject* kwds) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    // parse parameters
+    static const char *kwlist[] = {"write", nullptr};
+    int write = 0;
+    const int parseSuccess = PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "|p",
+        const_cast<char**>(kwlist),
+        &write);
+    if(!parseSuccess)
+        return nullptr;
+
+    try {
+        return reinterpret_cast<PyObject*>(OOCTransaction_fastnew(self, !write));
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
+
+static PyObject* OOCMap_sync(PyObject* pySelf) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    try {
+        self->syncer->sync();
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCMap_syncStats(PyObject* pySelf) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    const OOCSyncer::Stats stats = self->syncer->stats();
+    return Py_BuildValue(
+        "{s:K,s:K,s:d,s:d,s:d}",
+        "syncs", (unsigned long long)stats.syncs,
+        "errors", (unsigned long long)stats.errors,
+        "total_seconds", stats.totalSeconds,
+        "max_seconds", stats.maxSeconds,
+        "last_seconds", stats.lastSeconds);
+}
+
+static PyObject* OOCMap_cacheInfo(PyObject* pySelf) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    const OOCDecodeCache* const cache = self->decodeCache;
+    return Py_BuildValue(
+        "{s:K,s:K,s:n,s:n,s:n}",
+        "hits", (unsigned long long)(cache == nullptr ? 0 : cache->hits),
+        "misses", (unsigned long long)(cache == nullptr ? 0 : cache->misses),
+        "size", (Py_ssize_t)(cache == nullptr ? 0 : cache->size()),
+        "max_size", (Py_ssize_t)(cache == nullptr ? 0 : cache->capacity),
+        "interned_keys", (Py_ssize_t)(self->internedKeys == nullptr ? 0 : self->internedKeys->size()));
+}
+
+static PyObject* OOCMap_vacuum(PyObject* pySelf) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    OOCVacuumStats stats;
+    try {
+        OOCMapObject_growingWrite(self, [&]() {
+            OOCTransaction txn(self, false);
+            stats = OOCMapObject_vacuum(self, txn);
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    return Py_BuildValue(
+        "{s:K,s:K}",
+        "records", (unsigned long long)stats.records,
+        "bytes", (unsigned long long)stats.bytes);
+}
+
+static PyObject* OOCMap_collect(PyObject* pySelf, PyObject* args, PyObject* kwds) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    // parse parameters
+    static const char *kwlist[] = {"rows", nullptr};
+    Py_ssize_t rows = 1000;
+    const int parseSuccess = PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "|n",
+        const_cast<char**>(kwlist),
+        &rows);
+    if(!parseSuccess)
+        return nullptr;
+    if(rows <= 0) {
+        PyErr_Format(PyExc_ValueError, "rows must be positive");
+        return nullptr;
+    }
+
+    bool finished;
+    try {
+        // The step would run inside the transaction, and see writes that may still be rolled back.
+        if(OOCTransactionObject_current(self, true) != nullptr)
+            throw OocError(OocError::CollectInTransaction);
+        finished = self->collector->step(self, rows);
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    return PyBool_FromLong(finished);
+}
+
+static PyObject* OOCMap_gcStats(PyObject* pySelf) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    const OOCCollector::Stats& stats = self->collector->stats();
+    return Py_BuildValue(
+        "{s:O,s:K,s:K,s:K,s:K,s:d,s:d}",
+        "running", self->collector->isRunning() ? Py_True : Py_False,
+        "cycles", (unsigned long long)stats.cycles,
+        "steps", (unsigned long long)stats.steps,
+        "records", (unsigned long long)stats.records,
+        "bytes", (unsigned long long)stats.bytes,
+        "total_seconds", stats.totalSeconds,
+        "max_seconds", stats.maxSeconds);
+}
+
+static PyObject* OOCMap_compactTo(PyObject* pySelf, PyObject* args, PyObject* kwds) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    // parse parameters
+    static const char *kwlist[] = {"path", nullptr};
+    PyObject* path = nullptr;
+    const int parseSuccess = PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "O",
+        const_cast<char**>(kwlist),
+        &path);
+    if(!parseSuccess)
+        return nullptr;
+
+    // The copy can't be bigger than this map. Without writemap, LMDB only grows the file as far as
+    // the pages it uses.
+    MDB_envinfo info;
+    mdb_env_info(self->mdb, &info);
+    PyObject* const targetArgs = Py_BuildValue("(O)", path);
+    PyObject* const targetKwds = Py_BuildValue(
+        "{s:K,s:O}",
+        "max_size", (unsigned long long)info.me_mapsize,
+        "writemap", Py_False);
+    PyObject* pyTarget = nullptr;
+    if(targetArgs != nullptr && targetKwds != nullptr)
+        pyTarget = PyObject_Call(reinterpret_cast<PyObject*>(&OOCMapType), targetArgs, targetKwds);
+    Py_XDECREF(targetArgs);
+    Py_XDECREF(targetKwds);
+    if(pyTarget == nullptr)
+        return nullptr;
+    OOCMapObject* const target = reinterpret_cast<OOCMapObject*>(pyTarget);
+
+    try {
+        OOCTransaction txn(self, true);
+        OOCCompactor compactor(self, txn);
+        compactor.plan();
+        OOCMapObject_growingWrite(target, [&]() {
+            OOCTransaction targetTxn(target, false);
+            compactor.write(target, targetTxn);
+            targetTxn.commit();
+        });
+        txn.commit();
+        target->syncer->sync();
+    } catch(const OocError& error) {
+        Py_DECREF(pyTarget);
+        error.pythonize();
+        return nullptr;
+    }
+    Py_DECREF(pyTarget);
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCMap_savepoint(PyObject* pySelf) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    try {
+        return reinterpret_cast<PyObject*>(OOCSavepoint_fastnew(self));
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
+
+static PyObject* OOCMap_snapshot(PyObject* pySelf) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    try {
+        return reinterpret_cast<PyObject*>(OOCSnapshot_fastnew(self));
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
+
+
+static PyObject* OOCMap_asyncWriter(PyObject* pySelf, PyObject* args, PyObject* kwds) {
+    // cast the input
+    if(!isOOCMap(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCMapObject* self = reinterpret_cast<OOCMapObject*>(pySelf);
+
+    // parse parameters
+    static const char *kwlist[] = {"batch_size", "max_delay", nullptr};
+    Py_ssize_t batchSize = 1000;
+    double maxDelay = 0.01;
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "|$nd", const_cast<char**>(kwlist), &batchSize, &maxDelay))
+        return nullptr;
+    if(batchSize <= 0) {
+        PyErr_Format(PyExc_ValueError, "batch_size must be positive");
+        return nullptr;
+    }
+    if(!(maxDelay >= 0)) {
+        PyErr_Format(PyExc_ValueError, "max_delay must not be negative");
+        return nullptr;
+    }
+
+    try {
+        return reinterpret_cast<PyObject*>(OOCAsyncWriter_fastnew(self, batchSize, maxDelay));
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+}
 
 //
 // Python definitions to tie it all together
 //
 
 static PyMethodDef OOCMap_methods[] = {
+        {
+            "update",
+            (PyCFunction)OOCMap_update,
+            METH_VARARGS | METH_KEYWORDS,
+            PyDoc_STR("inserts all items from a mapping or an iterable of pairs, and from the keyword arguments")
+        },
+        {
+            "get_many",
+            (PyCFunction)OOCMap_getMany,
+            METH_VARARGS | METH_KEYWORDS,
+            PyDoc_STR("returns a list with the values for all the given keys, or the default for keys that are missing")
+        },
+        {
+            "put_many",
+            (PyCFunction)OOCMap_putMany,
+            METH_O,
+            PyDoc_STR("inserts all items from a mapping or an iterable of pairs in one transaction")
+        },
+        {
+            "transaction",
+            (PyCFunction)OOCMap_transaction,
+            METH_VARARGS | METH_KEYWORDS,
+            PyDoc_STR("returns a transaction that all operations on the map share while it is open")
+        },
+        {
+            "sync",
+            (PyCFunction)OOCMap_sync,
+            METH_NOARGS,
+            PyDoc_STR("flushes everything that was written to the map to disk")
+        },
+        {
+            "sync_stats",
+            (PyCFunction)OOCMap_syncStats,
+            METH_NOARGS,
+            PyDoc_STR("returns a dict with the number of syncs to disk and how long they took")
+        },
+        {
+            "cache_info",
+            (PyCFunction)OOCMap_cacheInfo,
+            METH_NOARGS,
+            PyDoc_STR("returns a dict with the hits, misses, and size of the cache of decoded values, and the number of interned keys")
+        },
+        {
+            "vacuum",
+            (PyCFunction)OOCMap_vacuum,
+            METH_NOARGS,
+            PyDoc_STR("deletes everything that can't be reached from the map anymore, and returns a dict with the number of records and bytes it freed")
+        },
+        {
+            "collect",
+            (PyCFunction)OOCMap_collect,
+            METH_VARARGS | METH_KEYWORDS,
+            PyDoc_STR("runs one step of incremental garbage collection that looks at about `rows` rows, and returns whether it finished a cycle")
+        },
+        {
+            "gc_stats",
+            (PyCFunction)OOCMap_gcStats,
+            METH_NOARGS,
+            PyDoc_STR("returns a dict with the number of garbage collection cycles and steps, what they freed, and how long they took")
+        },
+        {
+            "compact_to",
+            (PyCFunction)OOCMap_compactTo,
+            METH_VARARGS | METH_KEYWORDS,
+            PyDoc_STR("copies everything that can be reached from the map into a new map file at `path`, with the containers numbered and laid out in the order they are found")
+        },
+        {
+            "savepoint",
+            (PyCFunction)OOCMap_savepoint,
+            METH_NOARGS,
+            PyDoc_STR("returns a savepoint that can roll back part of the write transaction that is open in this thread")
+        },
+        {
+            "snapshot",
+            (PyCFunction)OOCMap_snapshot,
+            METH_NOARGS,
+            PyDoc_STR("returns a read-only view of the map as it is now")
+        },
+        {
+            "async_writer",
+            (PyCFunction)OOCMap_asyncWriter,
+            METH_VARARGS | METH_KEYWORDS,
+            PyDoc_STR("returns a writer that any thread can queue items into, and that commits them in batches from a background thread")
+        },
         {nullptr}, // sentinel
 };
 
@@ -11,9 +11,17 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include "lmdb.h"
+#include "errors.h"
 
 extern PyTypeObject OOCMapType;
 
+struct OOCTransactionObject;
+struct OOCSyncer;
+struct OOCDecodeCache;
+struct OOCInternedKeys;
+struct OOCCollector;
+struct OOCRefcounts;
+
 typedef struct {
     PyObject_HEAD
     MDB_env* mdb;
@@ -23,8 +31,71 @@ typedef struct {
     MDB_dbi listsDb;
     MDB_dbi tuplesDb;
     MDB_dbi dictsDb;
+    MDB_dbi blobsDb;
+    MDB_dbi setsDb;
+    MDB_dbi metaDb;     // counters and other bookkeeping, under short string keys
+    MDB_dbi refcountsDb;    // see refcount.h
+
+    // User-scoped transactions that are currently open on this map, innermost first.
+    // See transaction.h.
+    OOCTransactionObject* activeTxns;
+
+    // Read-only transactions that were reset instead of ended, so they can be renewed much more
+    // cheaply than a new one can be started. See OOCMapObject_txnBegin().
+    MDB_txn* readTxnPool[8];
+    unsigned int readTxnPoolSize;
+
+    // The number of transactions started with OOCMapObject_txnBegin() that haven't ended yet. The
+    // map can only be grown while this is zero. See OOCMapObject_grow().
+    unsigned int liveTxns;
+    bool growPending;
+    // The thread that started each of those transactions, once it has started, so a thread can tell
+    // whether waiting for the transactions to end would mean waiting for itself.
+    std::vector<std::pair<MDB_txn*, unsigned long>>* txnThreads;
+
+    // Syncs the map to disk according to the `durability` setting. See durability.h.
+    OOCSyncer* syncer;
+
+    // Recently decoded immutable values, or nullptr if `decode_cache_size` is 0. See decodecache.h.
+    OOCDecodeCache* decodeCache;
+    // Interned dict keys, or nullptr unless `intern_keys` is set. See decodecache.h.
+    OOCInternedKeys* internedKeys;
+
+    // Collects garbage a few rows at a time, see gc.h.
+    OOCCollector* collector;
+
+    // The reference counts that changed in the current write transaction, see refcount.h.
+    OOCRefcounts* refcounts;
 } OOCMapObject;
 
+// Starts a transaction. Read-only transactions are taken from the map's pool when possible.
+MDB_txn* OOCMapObject_txnBegin(OOCMapObject* self, bool readonly);
+// Ends a transaction that was started with OOCMapObject_txnBegin(). Read-only transactions go
+// back into the pool.
+void OOCMapObject_txnEnd(OOCMapObject* self, MDB_txn* txn, bool readonly, bool commit);
+
+// Doubles the size of the memory map. LMDB only allows that while no transactions are open in
+// this process, so if some are, this sets growPending instead, OOCMapObject_txnBegin() grows the
+// map before the next transaction starts, and this returns false. Must be called with the GIL
+// held. Throws MdbError.
+bool OOCMapObject_grow(OOCMapObject* self);
+
+// How long a write that ran out of space waits for the transactions in other threads to end, so
+// the map can grow. Snapshots and iterators that stay open in the writing thread never end while it
+// waits, so writes that need more space fail after this long while they are open.
+const int OOCMAP_GROW_WAIT_MS = 1000;
+
+// Grows the map like OOCMapObject_grow(), but when transactions are open, waits up to
+// OOCMAP_GROW_WAIT_MS for them to end, with the GIL released. While it waits, other threads don't
+// start new transactions, unless they already have one open. It doesn't wait at all when the
+// current thread has a transaction open, because that can't end while it waits. Returns true once
+// the map has grown, by this thread or another one. Throws MdbError.
+bool OOCMapObject_growWaiting(OOCMapObject* self);
+
+// Empties the decode cache and the interned keys. Anything that throws away written data has to
+// call this.
+void OOCMapObject_clearDecodeCache(OOCMapObject* self);
+
 #pragma pack(push, 1)
 
 struct ListKey {
@@ -43,6 +114,11 @@ struct DictKey {
     uint32_t reserved;
 };
 
+struct SetKey {
+    uint32_t setId;
+    uint32_t reserved;
+};
+
 struct EncodedValue {
     union {
         uint8_t asChars[8];
@@ -51,6 +127,7 @@ struct EncodedValue {
         double asFloat;
         ListKey asListKey;
         DictKey asDictKey;
+        SetKey asSetKey;
     };
     union {
         struct {
@@ -80,6 +157,13 @@ struct DictItemKey {
     EncodedValue key;
 };
 
+// The keys in the sets table. Sets are stored like dicts, but the members are the keys, and the
+// values are empty.
+struct SetItemKey {
+    uint32_t setId;
+    EncodedValue member;
+};
+
 #pragma pack(pop)
 
 
@@ -102,30 +186,108 @@ typedef std::unordered_map<PyObject*, EncodedValue> Id2EncodedMap;
 typedef std::unordered_map<EncodedValue, PyObject*> Encoded2IdMap;
 
 
+// One operation's view of a transaction. If the operation comes from an object that was read
+// through a snapshot, or if the current thread has a user-scoped transaction open on the map (see
+// transaction.h), this borrows that MDB_txn, and commit() and abort() leave the underlying
+// transaction alone. Otherwise it owns a fresh MDB_txn.
 struct OOCTransaction {
+    OOCMapObject* ooc;
     bool readonly;
+    OOCTransactionObject* snapshot;
+    OOCTransactionObject* borrowedFrom;
     bool txnOwned;
     MDB_txn* txn;
     Id2EncodedMap insertedItems;
 
-    explicit OOCTransaction(OOCMapObject* ooc, bool readonly);
-    explicit OOCTransaction(MDB_txn* txn, bool readonly);
+    explicit OOCTransaction(OOCMapObject* ooc, bool readonly, OOCTransactionObject* snapshot = nullptr);
     ~OOCTransaction();
 
     void commit();
     void abort();
 
+    // False once the transaction has ended, including when a borrowed transaction was ended
+    // by its owner.
+    bool isAlive() const;
+
+    // Closes a cursor that was opened in this transaction, if LMDB hasn't already done so.
+    void closeCursor(MDB_cursor* cursor) const;
+
 private:
     void clear();
 };
 
+// Runs a write operation, and when it runs out of space in the map, grows the map and runs it
+// again. The operation has to start and commit its own OOCTransaction, so that the failed
+// transaction is gone before the map grows, and it must be safe to run more than once.
+template<typename Operation> void OOCMapObject_growingWrite(OOCMapObject* const self, const Operation& operation) {
+    while(true) {
+        try {
+            operation();
+            return;
+        } catch(const MdbError& error) {
+            if(error.mdbErrorCode != MDB_MAP_FULL || !OOCMapObject_growWaiting(self))
+                throw;
+        }
+    }
+}
+
+// The dicts and sets tables compare their keys byte by byte, so for the ids to sort in the order they
+// were handed out, the most significant byte has to come first. This turns the n-th id into the
+// id that is stored.
+uint32_t OOCMap_bytewiseId(uint32_t id);
+
+// Returns a new reference to something that gives the same items every time it is iterated:
+// `items` itself if it is a sequence or a mapping, or a list of its items otherwise. Operations
+// that go through OOCMapObject_growingWrite() need this for arguments that might be iterators.
+PyObject* OOCMap_reiterable(PyObject* items);
+
 const EncodedValue* OOCMap_encode(
     OOCMapObject* self,
     PyObject* value,
     OOCTransaction& txn,
     const bool failOnMutable = false,
     const bool failOnWrite = false);
-PyObject* OOCMap_decode(OOCMapObject* self, EncodedValue* encodedValue, OOCTransaction& txn);
+
+// An encoded value together with the data that decoding it needs from the other tables, if any.
+// OOCMap_fetch() fills these in without touching any Python objects, so loops can read a whole
+// batch of them inside one GilUnlocker (see db.h), and decode them after getting the GIL back.
+struct FetchedValue {
+    EncodedValue value;
+    MDB_val payload;
+};
+
+void OOCMap_fetch(OOCMapObject* self, const EncodedValue* encodedValue, OOCTransaction& txn, FetchedValue* fetched);
+PyObject* OOCMap_decode(OOCMapObject* self, FetchedValue* fetched, OOCTransaction& txn);
+PyObject* OOCMap_decode(
+    OOCMapObject* self,
+    EncodedValue* encodedValue,
+    OOCTransaction& txn,
+    const MDB_val* payload = nullptr);
+// Decodes a dict key. This is the same as OOCMap_decode(), except that it returns interned strings
+// when the map was opened with `intern_keys=True`.
+PyObject* OOCMap_decodeKey(OOCMapObject* self, FetchedValue* fetched, OOCTransaction& txn);
+PyObject* OOCMap_decodeKey(
+    OOCMapObject* self,
+    EncodedValue* encodedValue,
+    OOCTransaction& txn,
+    const MDB_val* payload = nullptr);
+
+// Returns a new list with the values for all the keys, in the same order. Missing keys get the
+// default value.
+PyObject* OOCMapObject_getMany(OOCMapObject* self, OOCTransaction& txn, PyObject* keys, PyObject* defaultValue);
+
+// Writes all the items from a dict, a mapping, or an iterable of key/value pairs into the map.
+void OOCMapObject_putMany(OOCMapObject* self, OOCTransaction& txn, PyObject* items);
+// Writes already encoded key/value pairs into the root table in key order. When a key appears
+// more than once, the last one wins. This sorts the vector.
+void OOCMapObject_putEncoded(
+    OOCMapObject* self,
+    OOCTransaction& txn,
+    std::vector<std::pair<EncodedValue, EncodedValue>>& encodedItems);
+
+// The Python-facing implementations of len(map) and map[key]. The snapshot may be nullptr.
+Py_ssize_t OOCMap_lengthInSnapshot(OOCMapObject* self, OOCTransactionObject* snapshot);
+PyObject* OOCMap_getInSnapshot(OOCMapObject* self, PyObject* key, OOCTransactionObject* snapshot);
 
 
 const uint8_t TYPE_CODE_HARDCODED = 0;
@@ -149,6 +311,13 @@ const uint8_t TYPE_CODE_SET = 17;
 const uint8_t TYPE_CODE_COMPLEX = 18;
 const uint8_t TYPE_CODE_BYTES = 19;
 const uint8_t TYPE_CODE_BYTEARRAY = 20;
+// Bytes and bytearrays longer than 8 bytes live in the blobs table, keyed by a hash of their content,
+// so a bytes object and a bytearray with the same content share their storage.
+const uint8_t TYPE_CODE_BYTES_LONG = 21;
+const uint8_t TYPE_CODE_BYTEARRAY_LONG = 22;
+const uint8_t TYPE_CODE_NDARRAY = 23;    // in the blobs table, see ndarray.h
+const uint8_t TYPE_CODE_FROZENSET = 24;  // in the tuples table, with the members sorted like the keys in the sets table
+const uint8_t TYPE_CODE_FROZENDICT = 25; // read-only mappings, in the tuples table, see frozen.h
 
 
 #endif
@@ -1,8 +1,11 @@
+import sys
 import tempfile
+import time
+import types
 
 import pytest
 
-from oocmap import OOCMap
+from oocmap import OOCMap, LazyListSlice, LazySet, freeze
 
 
 SMALL_MAP = 32*1024*1024
@@ -385,3 +388,1185 @@ def test_two_oocmaps():
             assert m2[0].eager()[2].eager() == ["一", "二", "三"]
             assert m2[0].eager() == [["one", "two", "three"], ["eins", "zwei", "drei"], ["一", "二", "三"]]
             assert m2[0] == [["one", "two", "three"], ["eins", "zwei", "drei"], ["一", "二", "三"]]
+
+
+def test_transactions():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+
+        # writes inside a write transaction are visible inside it, and committed at the end
+        with m.transaction(write=True):
+            for i in range(100):
+                m[i] = [i, str(i), {"i": i}]
+            assert len(m) == 100
+            assert m[42] == [42, "42", {"i": 42}]
+            m[42].append("appended")
+            assert list(m[42]) == [42, "42", {"i": 42}, "appended"]
+            assert list(m[42][2].items()) == [("i", 42)]
+        assert len(m) == 100
+        assert m[42].eager() == [42, "42", {"i": 42}, "appended"]
+
+        # an exception aborts the transaction
+        with pytest.raises(ZeroDivisionError):
+            with m.transaction(write=True):
+                m["new"] = "value"
+                m["broken"] = 1 / 0
+        with pytest.raises(KeyError):
+            _ = m["new"]
+
+        # explicit abort
+        with m.transaction(write=True) as t:
+            m["new"] = "value"
+            t.abort()
+            m["after"] = "abort"
+        with pytest.raises(KeyError):
+            _ = m["new"]
+        assert m["after"] == "abort"
+
+        # read transactions don't allow writes
+        with m.transaction():
+            assert m[7] == [7, "7", {"i": 7}]
+            with pytest.raises(ValueError):
+                m[7] = None
+            with pytest.raises(ValueError):
+                m[7].append(None)
+        assert m[7] == [7, "7", {"i": 7}]
+
+        # only one transaction per thread
+        with m.transaction():
+            with pytest.raises(RuntimeError):
+                with m.transaction():
+                    pass
+
+        # iterators can't outlive the transaction they were started in
+        with m.transaction() as t:
+            i = iter(m[7])
+            assert next(i) == 7
+        with pytest.raises(RuntimeError):
+            next(i)
+
+
+def test_snapshots():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        m["list"] = [1, (2, 3), {"four": [4]}]
+        m["other"] = "before"
+
+        with m.snapshot() as s:
+            assert len(s) == 2
+            l = s["list"]
+            m["list"].append(5)
+            m["other"] = "after"
+            m["new"] = "value"
+
+            # everything read through the snapshot sees the old version of the map
+            assert len(s) == 2
+            assert s["other"] == "before"
+            with pytest.raises(KeyError):
+                _ = s["new"]
+            assert len(l) == 3
+            assert list(l) == [1, (2, 3), {"four": [4]}]
+            assert l[2]["four"].eager() == [4]
+            assert l.eager() == [1, (2, 3), {"four": [4]}]
+            assert len(m["list"]) == 4
+
+            # snapshots are read-only
+            with pytest.raises(ValueError):
+                l.append(6)
+            with pytest.raises(ValueError):
+                l[2]["five"] = 5
+
+            # objects from a snapshot can still be stored in the map
+            m["copy"] = l[2]
+        assert m["copy"]["four"][0] == 4
+
+        # objects read through a snapshot can't be used after it is closed
+        with pytest.raises(RuntimeError):
+            len(l)
+        with pytest.raises(RuntimeError):
+            _ = s["other"]
+
+
+def test_pooled_read_transactions():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+
+        # Read transactions are reused, but every one of them has to see the latest writes.
+        for i in range(100):
+            m["counter"] = i
+            assert m["counter"] == i
+            assert len(m) == 1
+
+        # more readers at the same time than there is room for in the pool
+        l = [i for i in range(10)]
+        m["list"] = l
+        iterators = [iter(m["list"]) for _ in range(20)]
+        for i in l:
+            for iterator in iterators:
+                assert next(iterator) == i
+        snapshots = [m.snapshot() for _ in range(20)]
+        m["counter"] = "new"
+        for s in snapshots:
+            assert s["counter"] == 99
+            s.close()
+        assert m["counter"] == "new"
+
+
+def test_put_many():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+
+        # into an empty map, from a dict
+        m.put_many({i: str(i) for i in range(1000)})
+        assert len(m) == 1000
+        assert all(m[i] == str(i) for i in range(1000))
+
+        # in between existing keys, from pairs, with a duplicate key where the last one wins
+        m.put_many([(-1, "minus one"), (500, "replaced"), ("x", [1, 2]), (500, "five hundred")])
+        assert len(m) == 1002
+        assert m[-1] == "minus one"
+        assert m[500] == "five hundred"
+        assert m["x"] == [1, 2]
+
+        # update() works like dict.update()
+        m.update({"a": 1}, b=2)
+        m.update([("c", {"d": 3})])
+        m.update({})
+        assert m["a"] == 1
+        assert m["b"] == 2
+        assert m["c"]["d"] == 3
+
+        # bad input doesn't write anything
+        with pytest.raises(TypeError):
+            m.put_many([("fine", 1), ([], 2)])
+        with pytest.raises(ValueError):
+            m.update([("fine", 1), ("too", "many", "items")])
+        with pytest.raises(KeyError):
+            _ = m["fine"]
+        assert len(m) == 1005
+
+
+def test_get_many():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        m.put_many({i: i * 2 for i in range(1000)})
+        m["list"] = [1, 2, 3]
+        long_key = "a key that is too long to fit into an encoded value"
+        m[long_key] = "long"
+
+        keys = [999, 3, "list", 3, -5, "nope", long_key, long_key + "!", (1, "missing")]
+        assert m.get_many(keys) == [1998, 6, [1, 2, 3], 6, None, None, "long", None, None]
+        assert m.get_many(iter([1, 2, 10000]), default=-1) == [2, 4, -1]
+        assert m.get_many([]) == []
+        with pytest.raises(TypeError):
+            m.get_many([1, []])
+
+        # it works inside a transaction, and a key that's missing doesn't stop a later
+        # identical key from being found after it was written
+        with m.transaction(write=True):
+            assert m.get_many([long_key + "!"]) == [None]
+            m[long_key + "!"] = "found"
+            assert m.get_many([long_key + "!"]) == ["found"]
+
+
+def test_eager_with_stored_values():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        long_string = "a string that is too long to be stored inline"
+        big_int = 162259276829213363391578010288127
+        values = [long_string, -big_int, big_int, "short", 1.5, None, [long_string], (big_int,)]
+        m["list"] = values
+        m["tuple"] = tuple(values[:-2])
+        m["dict"] = {long_string: big_int, big_int: -big_int, "list": [long_string]}
+        assert m["list"].eager() == values
+        assert m["tuple"].eager() == tuple(values[:-2])
+        assert m["dict"].eager() == {long_string: big_int, big_int: -big_int, "list": [long_string]}
+        assert m.get_many(["list", "nope", "tuple"])[2] == tuple(values[:-2])
+
+
+def test_savepoints():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP, writemap=False)
+
+        class BadRecord:
+            pass
+
+        records = [(i, [i, str(i)] if i % 10 != 7 else [i, BadRecord()]) for i in range(100)]
+        with m.transaction(write=True):
+            for key, value in records:
+                try:
+                    with m.savepoint():
+                        m[key] = value
+                except ValueError:
+                    pass
+            assert len(m) == 90
+
+            # nested savepoints, rolled back explicitly
+            with m.savepoint():
+                m["outer"] = 1
+                with m.savepoint() as s:
+                    m["inner"] = 2
+                    s.abort()
+                    m["after inner"] = 3
+            assert m["outer"] == 1
+            assert m["after inner"] == 3
+            with pytest.raises(KeyError):
+                _ = m["inner"]
+
+            # the transaction can't be used underneath an open savepoint
+            i = iter(m[0])
+            assert next(i) == 0
+            with m.savepoint():
+                with pytest.raises(RuntimeError):
+                    next(i)
+            assert next(i) == "0"
+        assert len(m) == 92
+        with pytest.raises(KeyError):
+            _ = m[17]
+        assert m[18] == [18, "18"]
+
+        # savepoints need a write transaction
+        with pytest.raises(RuntimeError):
+            with m.savepoint():
+                pass
+        with m.transaction():
+            with pytest.raises(ValueError):
+                with m.savepoint():
+                    pass
+
+    # and LMDB can't do them when it writes through the memory map
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        with m.transaction(write=True):
+            with pytest.raises(RuntimeError):
+                with m.savepoint():
+                    pass
+
+
+def test_durability():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        m["key"] = "value"
+        assert m.sync_stats()["syncs"] == 0
+        m.sync()
+        assert m.sync_stats()["syncs"] == 1
+
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP, durability="commit")
+        for i in range(10):
+            m[i] = i
+        _ = m[3]
+        with m.transaction(write=True):
+            m.put_many({"a": 1, "b": 2})
+            m["c"] = 3
+        stats = m.sync_stats()
+        assert stats["syncs"] == 11
+        assert stats["errors"] == 0
+        assert stats["max_seconds"] >= stats["last_seconds"]
+        assert stats["total_seconds"] >= stats["max_seconds"]
+
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP, durability="periodic", sync_interval=0.01)
+        m["key"] = "value"
+        deadline = time.time() + 10
+        while m.sync_stats()["syncs"] == 0 and time.time() < deadline:
+            time.sleep(0.01)
+        assert m.sync_stats()["syncs"] > 0
+        del m
+
+    with tempfile.NamedTemporaryFile() as f:
+        with pytest.raises(ValueError):
+            OOCMap(f.name, max_size=SMALL_MAP, durability="sometimes")
+
+
+def test_map_growth():
+    tiny_map = 256*1024
+    value = "x" * 1000
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=tiny_map)
+        for i in range(1000):
+            m[i] = value + str(i)
+        m.put_many((f"key{i}", value + str(i)) for i in range(1000, 2000))
+        m["list"] = []
+        for i in range(2000, 3000):
+            m["list"].append(value + str(i))
+        assert len(m) == 2001
+        assert m[5] == value + "5"
+        assert m["key1500"] == value + "1500"
+        assert m["list"][999] == value + "2999"
+
+    # An open transaction can't be retried, but the map grows as soon as it ends.
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=tiny_map)
+        with pytest.raises(Exception):
+            with m.transaction(write=True):
+                for i in range(1000):
+                    m[i] = value + str(i)
+        assert len(m) == 0
+        m.put_many((i, value + str(i)) for i in range(1000))
+        assert len(m) == 1000
+
+
+def test_async_writer():
+    import threading
+
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        with m.async_writer(batch_size=100, max_delay=0.001) as w:
+            def produce(start):
+                for i in range(start, start + 1000):
+                    w[i] = str(i) * 3
+            threads = [threading.Thread(target=produce, args=(i * 1000,)) for i in range(4)]
+            for t in threads:
+                t.start()
+            for t in threads:
+                t.join()
+            w.flush()
+            assert len(m) == 4000
+            assert m[1234] == "123412341234"
+            w["later"] = [1, 2, 3]
+        assert m["later"] == [1, 2, 3]
+        stats = w.stats()
+        assert stats["ops"] == 4001
+        assert 0 < stats["batches"] <= 4001
+        assert stats["max_batch"] <= 400
+
+        with pytest.raises(RuntimeError):
+            w["closed"] = 1
+
+        w = m.async_writer()
+        with pytest.raises(TypeError):
+            w[[1, 2]] = 1
+        with m.transaction(write=True):
+            with pytest.raises(RuntimeError):
+                w.flush()
+        w.close()
+
+
+def test_bytes():
+    values = [b"", b"short", b"exactly8", b"longer than eight bytes" * 10, bytearray(), bytearray(b"abc"), bytearray(b"x" * 100)]
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        for i, value in enumerate(values):
+            m[i] = value
+        m[b"key" * 10] = "bytes as a key"
+        m["nested"] = [b"in a list", (b"in a tuple", bytearray(b"mutable" * 3))]
+
+        for i, value in enumerate(values):
+            assert m[i] == value
+            assert type(m[i]) == type(value)
+        assert m[b"key" * 10] == "bytes as a key"
+        assert m["nested"][1][1] == bytearray(b"mutable" * 3)
+        with pytest.raises(TypeError):
+            m[bytearray(b"abc")] = 1
+
+        # Through a snapshot, we get read-only memoryviews, and the long ones point into the map.
+        s = m.snapshot()
+        for i, value in enumerate(values):
+            view = s[i]
+            assert isinstance(view, memoryview)
+            assert view.readonly
+            assert view == value
+        view = s[3]
+        assert bytes(view[:6]) == b"longer"
+        with pytest.raises(BufferError):
+            s.close()
+        del view
+        s.close()
+
+
+def test_ndarray():
+    np = pytest.importorskip("numpy")
+    arrays = [
+        np.arange(12, dtype=np.float32).reshape(3, 4),
+        np.arange(10, dtype=np.int64)[::2],     # not contiguous
+        np.array(3.5),
+        np.zeros((0, 3), dtype=np.uint8),
+        np.array(["a", "bc"]),
+        np.array(["2022-08-12"], dtype="datetime64[D]"),
+        np.arange(6, dtype=">i2").reshape(2, 3, order="F"),
+    ]
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        for i, array in enumerate(arrays):
+            m[i] = array
+        m["nested"] = {"embedding": arrays[0]}
+
+        for i, array in enumerate(arrays):
+            copy = m[i]
+            assert isinstance(copy, np.ndarray)
+            assert copy.dtype == array.dtype
+            assert copy.shape == array.shape
+            assert np.array_equal(copy, array)
+            copy[...] = copy     # copies are writable
+        assert np.array_equal(m["nested"]["embedding"], arrays[0])
+
+        with pytest.raises(TypeError):
+            m[arrays[0]] = 1
+        with pytest.raises(ValueError):
+            m["objects"] = np.array([object()])
+
+        with m.snapshot() as s:
+            view = s[0]
+            assert not view.flags.writeable
+            assert np.array_equal(view, arrays[0])
+            with pytest.raises(BufferError):
+                s.close()
+            del view
+
+
+def test_sets():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        m["s"] = {1, "two", (3, 4), None}
+        m["f"] = frozenset({1, 2, 3})
+        m[frozenset({"a", "b"})] = "frozenset as a key"
+        m["empty"] = frozenset()
+
+        s = m["s"]
+        assert len(s) == 4
+        assert 1 in s
+        assert (3, 4) in s
+        assert "never written" not in s
+        assert 5 not in s
+        with pytest.raises(TypeError):
+            [1] in s
+        assert s == {1, "two", (3, 4), None}
+        assert set(s) == s.eager()
+
+        assert m["f"] == frozenset({1, 2, 3})
+        assert type(m["f"]) == frozenset
+        assert m[frozenset({"b", "a"})] == "frozenset as a key"
+        assert m["empty"] == frozenset()
+        with pytest.raises(TypeError):
+            m[{1}] = 1
+
+        s.add(5)
+        s.add(5)
+        s.discard("two")
+        s.discard("missing")
+        with pytest.raises(KeyError):
+            s.remove("missing")
+        s.update([6, 7, 1])
+        assert m["s"] == {1, (3, 4), None, 5, 6, 7}
+        assert len(m["s"]) == 6
+
+        m["t"] = {5, 6, 8}
+        t = m["t"]
+        assert s | t == {1, (3, 4), None, 5, 6, 7, 8}
+        assert s & t == {5, 6}
+        assert s - t == {1, (3, 4), None, 7}
+        assert s ^ t == {1, (3, 4), None, 7, 8}
+        assert s.union(["new"]) == {1, (3, 4), None, 5, 6, 7, "new"}
+        assert s.intersection([5, "new"]) == {5}
+        assert s.symmetric_difference({5, "new"}) == {1, (3, 4), None, 6, 7, "new"}
+        assert {5, 9} & s == {5}
+        assert not s.isdisjoint(t)
+        assert s.isdisjoint(["new"])
+        assert m["t"].issubset(s | {8})
+        assert s.issuperset([1, 5])
+        assert not s.issuperset([1, "new"])
+        with pytest.raises(TypeError):
+            s | [1]
+
+        m["nested"] = {"members": t}
+        assert m["nested"]["members"] == {5, 6, 8}
+        t.clear()
+        assert len(m["t"]) == 0
+        assert m["nested"]["members"] == set()
+
+
+def test_packed_lists():
+    lists = [
+        [1, -2, 3],
+        [1000, -2, 3],
+        [100000, 0],
+        [2**40, -2**63, 2**63 - 1],
+        [1.5, -0.0, float("inf")],
+        [2**64, 1],     # too big to pack
+        [True, 1],      # not all ints
+        [1, 2.0],       # mixed
+    ]
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        for i, l in enumerate(lists):
+            m[i] = l
+        for i, l in enumerate(lists):
+            lazy = m[i]
+            assert len(lazy) == len(l)
+            assert list(lazy) == l
+            assert lazy.eager() == l
+            assert [type(x) for x in lazy] == [type(x) for x in l]
+            assert lazy[-1] == l[-1]
+            with pytest.raises(IndexError):
+                lazy[len(l)]
+
+        m["tokens"] = [5, 7, 5, 300, 5]
+        tokens = m["tokens"]
+        assert tokens.count(5) == 3
+        assert tokens.count(5.0) == 3
+        assert tokens.count(True) == 0
+        assert tokens.count("5") == 0
+        assert tokens.count(2**70) == 0
+        assert tokens.index(300) == 3
+        assert tokens.index(5, 1) == 2
+        assert 7 in tokens
+        assert 7.5 not in tokens
+        with pytest.raises(ValueError):
+            tokens.index(6)
+        assert m[4].count(-0.0) == 1
+        assert m[4].index(float("inf")) == 2
+
+        # Changing a packed list turns it into a normal one.
+        tokens.append("eos")
+        tokens[0] = 6
+        del tokens[1]
+        assert m["tokens"] == [6, 5, 300, 5, "eos"]
+        m[0].extend(m[1])
+        assert m[0] == [1, -2, 3, 1000, -2, 3]
+        m[2] *= 2
+        assert m[2] == [100000, 0, 100000, 0]
+        m[3].clear()
+        assert m[3] == []
+
+
+def test_list_blocks():
+    # Long enough to span several blocks, and not packable, so it is stored in blocks.
+    expected = [f"item {i}" for i in range(1000)] + [None, (1, 2)]
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        m["l"] = expected
+        lazy = m["l"]
+        assert len(lazy) == len(expected)
+        assert list(lazy) == expected
+        assert lazy.eager() == expected
+        for i in (0, 223, 224, 225, 447, 448, 999, -1):
+            assert lazy[i] == expected[i]
+        assert lazy.index("item 500") == 500
+        assert lazy.index("item 500", 224, 600) == 500
+        assert lazy.count((1, 2)) == 1
+        assert [1] not in lazy
+
+        def check():
+            assert len(lazy) == len(expected)
+            assert list(lazy) == expected
+
+        lazy[224] = "changed"
+        expected[224] = "changed"
+        check()
+        del lazy[10]
+        del expected[10]
+        check()
+        lazy.append([3])
+        expected.append([3])
+        check()
+        assert lazy.index([3]) == len(expected) - 1
+        lazy.extend(range(300))
+        expected.extend(range(300))
+        check()
+        lazy *= 2
+        expected *= 2
+        check()
+        for _ in range(len(expected) - 5):
+            del lazy[0]
+            del expected[0]
+        check()
+        lazy.clear()
+        expected.clear()
+        check()
+        lazy.extend("abc")
+        expected.extend("abc")
+        check()
+
+        # Packed lists turn into blocks when they change.
+        m["p"] = list(range(500))
+        packed = m["p"]
+        packed.append("x")
+        assert packed.eager() == list(range(500)) + ["x"]
+
+
+def test_list_insert_pop_remove():
+    import random
+    rnd = random.Random(0)
+    expected = [f"item {i}" for i in range(3000)]
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        m["l"] = expected
+        lazy = m["l"]
+        for step in range(2000):
+            length = len(expected)
+            op = rnd.randrange(4)
+            if op == 0:
+                index = rnd.randint(-length - 2, length + 2)
+                lazy.insert(index, step)
+                expected.insert(index, step)
+            elif op == 1:
+                index = rnd.randint(-length, length - 1)
+                assert lazy.pop(index) == expected.pop(index)
+            elif op == 2:
+                item = expected[rnd.randrange(length)]
+                lazy.remove(item)
+                expected.remove(item)
+            else:
+                items = [f"extended {step} {i}" for i in range(rnd.randrange(300))]
+                lazy.extend(items)
+                expected.extend(items)
+            if step % 100 == 0:
+                assert lazy.eager() == expected
+        assert len(lazy) == len(expected)
+        assert list(lazy) == expected
+
+        assert lazy.pop() == expected.pop()
+        with pytest.raises(ValueError):
+            lazy.remove("not there")
+        lazy.clear()
+        with pytest.raises(IndexError):
+            lazy.pop()
+        lazy.insert(5, "a")
+        lazy.insert(-5, "b")
+        assert lazy.eager() == ["b", "a"]
+
+        # Packed lists turn into blocks when they change.
+        m["p"] = [1, 2, 3]
+        m["p"].insert(1, 1.5)
+        assert m["p"].eager() == [1, 1.5, 2, 3]
+
+
+def test_container_ids():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        for i in range(100):
+            m[i] = {"list": ["a", i], "set": {i}, "dict": {"i": i}}
+        del m
+
+        # The id counters are stored in the map, so containers written after reopening it don't
+        # replace the ones from before.
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        for i in range(100, 200):
+            m[i] = {"list": ["a", i], "set": {i}, "dict": {"i": i}}
+        for i in range(200):
+            assert m[i].eager() == {"list": ["a", i], "set": {i}, "dict": {"i": i}}
+
+
+def test_vacuum():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        kept = {
+            "list": ["long string " * 10, 2**100, (1, "x" * 20)],
+            "dict": {"key " * 5: b"bytes " * 5, "set": {"member " * 5}},
+            "packed": [1, 2, 3],
+            "frozen": frozenset({"frozen " * 5}),
+        }
+        cycle = {"name": "cycle " * 5}
+        cycle["self"] = cycle
+        m["kept"] = kept
+        m["cycle"] = cycle
+        assert m.vacuum() == {"records": 0, "bytes": 0}
+
+        for i in range(100):
+            m[i] = [f"gone {i} " * 5, {"number": 2**100 + i}, {f"member {i} " * 5}]
+        m["kept"]["list"][0] = "also gone " * 10
+        for i in range(100):
+            del m[i]
+        stats = m.vacuum()
+        assert stats["records"] >= 100 * 6 + 1
+        assert stats["bytes"] > 100 * 50
+        assert m.vacuum() == {"records": 0, "bytes": 0}
+
+        kept["list"][0] = "also gone " * 10
+        assert m["kept"].eager() == kept
+        c = m["cycle"]
+        assert c["self"]["self"]["name"] == "cycle " * 5
+        m["new"] = ["long string " * 10, {"set": {"member " * 5}}]
+        assert m["new"].eager() == ["long string " * 10, {"set": {"member " * 5}}]
+
+
+def test_incremental_gc():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        strings = [f"string number {i} " * 3 for i in range(1000)]
+        m["list"] = strings
+        m["dict"] = {"inner": ["inner string " * 3], "other": "other string " * 3}
+        for i in range(100):
+            m[i] = [f"garbage {i} " * 3]
+        for i in range(100):
+            del m[i]
+
+        # Mark the roots, then part of the list.
+        assert not m.collect(rows=10)
+        assert not m.collect(rows=300)
+        assert m.gc_stats()["running"]
+        # Everything in the list moves, so it has to be marked again.
+        lazy_list = m["list"]
+        for _ in range(20):
+            assert lazy_list.pop(0) == strings.pop(0)
+        # The inner list gets a new parent after it may have been marked. Then it loses its old one.
+        m["moved"] = m["dict"]["inner"]
+        del m["dict"]["inner"]
+        while not m.collect(rows=50):
+            pass
+
+        stats = m.gc_stats()
+        assert not stats["running"] and stats["cycles"] == 1 and stats["steps"] > 2
+        assert stats["records"] >= 200
+        assert m["list"].eager() == strings
+        assert m["moved"].eager() == ["inner string " * 3]
+        assert m["dict"].eager() == {"other": "other string " * 3}
+        # The strings that were popped off the list lost their last reference, so they went when
+        # the pops committed, without waiting for a cycle.
+        assert m.vacuum()["records"] == 0
+
+        with m.transaction():
+            with pytest.raises(RuntimeError):
+                m.collect()
+
+    # Collecting after every write
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP, gc_rows_per_write=20)
+        for i in range(1000):
+            m[i % 10] = {"value": f"value number {i} " * 3, "list": [i, str(i) * 20]}
+        stats = m.gc_stats()
+        assert stats["cycles"] > 0 and stats["records"] > 0
+        for i in range(990, 1000):
+            assert m[i % 10].eager() == {"value": f"value number {i} " * 3, "list": [i, str(i) * 20]}
+
+
+def test_compact_to():
+    with tempfile.NamedTemporaryFile() as f, tempfile.TemporaryDirectory() as d:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        kept = {
+            "list": ["long string " * 10, 2**100, (1, "x" * 20, [2, "y" * 20]), {"set": {"member " * 5}}],
+            "packed": [1, 2, 3],
+            "frozen": frozenset({"frozen " * 5, (3, "z" * 20)}),
+            "rows": [str(i) * 10 for i in range(500)],
+        }
+        cycle = {"name": "cycle " * 5}
+        cycle["self"] = cycle
+        m["kept"] = kept
+        m["cycle"] = cycle
+        m[(1, 2)] = b"bytes " * 5
+        for i in range(100):
+            m[i] = [f"gone {i} " * 5, {"number": 2**100 + i}]
+        for i in range(100):
+            del m[i]
+
+        path = d + "/compacted"
+        m.compact_to(path)
+        with pytest.raises(ValueError):
+            m.compact_to(path)
+
+        c = OOCMap(path, max_size=SMALL_MAP)
+        assert len(c) == 3
+        assert c["kept"].eager() == kept
+        assert c["cycle"]["self"]["self"]["name"] == "cycle " * 5
+        assert c[(1, 2)] == b"bytes " * 5
+        assert c.vacuum() == {"records": 0, "bytes": 0}
+
+        # The copy keeps working like any other map.
+        c["new"] = ["long string " * 10, {"set": {"member " * 5}}]
+        c["kept"]["list"][2][2].append("appended " * 5)
+        kept["list"][2][2].append("appended " * 5)
+        assert c["new"].eager() == ["long string " * 10, {"set": {"member " * 5}}]
+        assert c["kept"].eager() == kept
+
+
+def test_refcounts():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP, writemap=False)
+        shared = "shared string " * 5
+        m["a"] = shared
+        m["b"] = (shared, 2**100)
+        m["dict"] = {"key " * 5: "old value " * 5}
+        m["list"] = ["old item " * 5, shared]
+        m["set"] = {"member " * 5}
+
+        # Overwritten and deleted values are freed when the write commits, without vacuum().
+        for i in range(10):
+            m["a"] = f"value number {i} " * 5
+        m["b"] = (("nested " * 5, frozenset({"frozen " * 5})), 3)
+        m["dict"]["key " * 5] = "new value " * 5
+        m["list"][0] = "new item " * 5
+        m["set"].discard("member " * 5)
+        m["long key " * 5] = "long value " * 5
+        del m["long key " * 5]
+        assert m.vacuum() == {"records": 0, "bytes": 0}
+
+        # Records that are still referenced stay.
+        assert m["list"][1] == shared
+        del m["dict"]["key " * 5]
+        m["list"].clear()
+        m["b"] = None
+        assert m.vacuum() == {"records": 0, "bytes": 0}
+
+        # Rolled back changes don't free anything.
+        m["c"] = "kept " * 5
+        with m.transaction(write=True):
+            with m.savepoint() as s:
+                del m["c"]
+                s.abort()
+        assert m["c"] == "kept " * 5
+        with m.transaction(write=True) as t:
+            m["d"] = ("kept " * 5, "aborted " * 5)
+            t.abort()
+        m["e"] = ("kept " * 5,)
+        del m["e"]
+        assert m["c"] == "kept " * 5
+        assert m.vacuum() == {"records": 0, "bytes": 0}
+
+        # A lazy tuple whose record is gone can only be written back if it was read before.
+        m["t"] = ("tuple " * 5, 1)
+        gone = m["t"]
+        m["list"].append(m["t"])
+        read = m["list"].pop()
+        assert read == ("tuple " * 5, 1)
+        del m["t"]
+        with pytest.raises(ValueError):
+            m["t"] = gone
+        m["t"] = read
+        assert m["t"] == ("tuple " * 5, 1)
+
+
+def test_freeze():
+    meta = {"source": "a long source name " * 3, "tags": ["tag", "another tag " * 3], "empty": {}}
+    frozen = freeze({"meta": meta, "ids": [1, 2, 3], "set": {"member"}})
+    assert isinstance(frozen, types.MappingProxyType)
+    assert frozen["meta"]["tags"] == ("tag", "another tag " * 3)
+    assert frozen["set"] == frozenset({"member"})
+    with pytest.raises(TypeError):
+        frozen["meta"]["source"] = "something else"
+
+    with tempfile.NamedTemporaryFile() as f, tempfile.NamedTemporaryFile() as compacted:
+        m = OOCMap(f.name, max_size=SMALL_MAP, writemap=False)
+        m["list"] = [1, {"a": "b"}]
+        m.put_many((i, freeze({"id": i, "meta": meta})) for i in range(100))
+        m["lazy"] = freeze(m["list"])
+        assert m[0] == {"id": 0, "meta": freeze(meta)}
+        assert m[99]["meta"]["tags"] == ("tag", "another tag " * 3)
+        assert m["lazy"] == (1, {"a": "b"})
+
+        # Writing one back, or an equal one that was built differently, finds the same record.
+        m["copy"] = m[5]["meta"]
+        m["built"] = types.MappingProxyType({
+            "empty": types.MappingProxyType({}),
+            "tags": ("tag", "another tag " * 3),
+            "source": "a long source name " * 3,
+        })
+        assert m["copy"] == m["built"] == freeze(meta)
+        assert m.vacuum() == {"records": 0, "bytes": 0}
+        for i in range(100):
+            del m[i]
+        del m["copy"]
+        assert m["built"]["source"] == "a long source name " * 3
+        del m["built"]
+        assert m.vacuum() == {"records": 0, "bytes": 0}
+
+        m.compact_to(compacted.name)
+        assert OOCMap(compacted.name, max_size=SMALL_MAP, writemap=False)["lazy"] == (1, {"a": "b"})
+
+
+def test_list_slices():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        items = [f"item {i}" * 3 for i in range(1000)]
+        m["strings"] = items
+        m["ints"] = list(range(1000))
+        for key, expected in (("strings", items), ("ints", list(range(1000)))):
+            l = m[key]
+            for s in (slice(10, 20), slice(None, None, -1), slice(-5, None), slice(3, 900, 7), slice(990, 5, -300)):
+                view = l[s]
+                assert isinstance(view, LazyListSlice)
+                assert len(view) == len(expected[s])
+                assert list(view) == view.eager() == expected[s]
+                assert view == expected[s]
+                assert view[-1] == expected[s][-1]
+                assert view[1:-1:2] == expected[s][1:-1:2]
+            assert l[-1] == expected[-1]
+            assert l[2000:] == []
+
+        # Slices see changes to the list, and leave out the items it no longer has.
+        l = m["strings"]
+        view = l[::-100]
+        l[999] = "changed"
+        assert view[0] == "changed"
+        while len(l) > 500:
+            l.pop()
+        assert view == items[499::-100]
+
+        m["copy"] = l[:3]
+        assert m["copy"] == items[:3]
+        del l[0]
+        assert m["copy"] == items[:3]
+
+
+def test_decode_cache():
+    url = "https://example.com/" + "x" * 100
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP, decode_cache_size=2)
+        m["records"] = [{"url": url, "label": "label " * 10} for _ in range(10)]
+        m["big"] = 2**100
+        assert m.cache_info() == {"hits": 0, "misses": 0, "size": 0, "max_size": 2, "interned_keys": 0}
+
+        first = m["records"][0]["url"]
+        assert first == url
+        assert m["records"][5]["url"] is first
+        info = m.cache_info()
+        assert info["hits"] == 1 and info["misses"] == 1 and info["size"] == 1
+
+        assert m["big"] == 2**100
+        assert m["records"][0]["label"] == "label " * 10
+        assert m.cache_info()["size"] == 2     # bounded, so the url was evicted
+        assert m["records"][0]["url"] is not first
+
+        # Rolling back a write forgets everything, since the rolled back values may come back different.
+        with pytest.raises(ZeroDivisionError):
+            with m.transaction(write=True):
+                assert m["big"] == 2**100
+                1 / 0
+        assert m.cache_info()["size"] == 0
+
+        del m
+        m = OOCMap(f.name, max_size=SMALL_MAP, decode_cache_size=0)
+        assert m["records"][0]["url"] == url
+        assert m.cache_info() == {"hits": 0, "misses": 0, "size": 0, "max_size": 0, "interned_keys": 0}
+        with pytest.raises(ValueError):
+            OOCMap(f.name, decode_cache_size=-1)
+
+
+def test_intern_keys():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP, intern_keys=True)
+        m["records"] = [{"id": i, "text": "hello", "a_long_key_name": None, 5: "int key"} for i in range(3)]
+        records = m["records"]
+        first = records[0].eager()
+        second = records[1].eager()
+        assert first == {"id": 0, "text": "hello", "a_long_key_name": None, 5: "int key"}
+        keys = [k for k in first if isinstance(k, str)]
+        assert all(a is b for a, b in zip(keys, (k for k in second if isinstance(k, str))))
+        assert [k for k in records[2].keys() if isinstance(k, str)][0] is keys[0]
+        assert keys[0] is sys.intern("id")
+        assert m.cache_info()["interned_keys"] == 3
+
+
+def test_map_growth_with_readers():
+    import threading
+
+    tiny_map = 256*1024
+    value = "x" * 1000
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=tiny_map)
+        m["list"] = list(range(1000))
+        done = threading.Event()
+        errors = []
+
+        def read():
+            try:
+                while not done.is_set():
+                    assert m["list"][500] == 500
+                    assert sum(1 for _ in m["list"]) == 1000
+            except Exception as e:
+                errors.append(e)
+
+        readers = [threading.Thread(target=read) for _ in range(2)]
+        for reader in readers:
+            reader.start()
+        try:
+            for i in range(2000):
+                m[i] = value + str(i)
+        finally:
+            done.set()
+            for reader in readers:
+                reader.join()
+        assert errors == []
+        assert m[1999] == value + "1999"
+
+        # A snapshot that stays open in the writing thread keeps the map from growing.
+        with m.snapshot():
+            with pytest.raises(Exception):
+                for i in range(2000, 10000):
+                    m[i] = value + str(i)
+        m[10000] = value
+
+
+def test_async_writer_bad_item():
+    import threading
+
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        with m.async_writer(batch_size=10000, max_delay=10) as w:
+            queued = threading.Barrier(2)
+            errors = {}
+
+            def produce(name, bad):
+                try:
+                    for i in range(100):
+                        w[(name, i)] = i
+                    if bad:
+                        w["bad"] = object()
+                    queued.wait()
+                    w.flush()
+                except ValueError as e:
+                    errors[name] = e
+
+            threads = [
+                threading.Thread(target=produce, args=("good", False)),
+                threading.Thread(target=produce, args=("bad", True))]
+            for t in threads:
+                t.start()
+            for t in threads:
+                t.join()
+        assert w.stats()["batches"] == 1
+        assert list(errors.keys()) == ["bad"]
+        assert "'bad'" in str(errors["bad"])
+        with pytest.raises(KeyError):
+            m["bad"]
+        assert len(m) == 200
+        assert m[("good", 99)] == 99
+        assert m[("bad", 99)] == 99
+
+        w = m.async_writer()
+        t = threading.Thread(target=w.__setitem__, args=("unclaimed", object()))
+        t.start()
+        t.join()
+        with pytest.raises(ValueError, match="unclaimed"):
+            w.close()
+
+
+def test_lazy_set_inplace():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        m["s"] = {1, 2, 3, "a", (1, 2)}
+        m["other"] = {3, 4, "b"}
+        s = m["s"]
+        expected = {1, 2, 3, "a", (1, 2)}
+
+        s |= {9, "new", (3, 4)}
+        expected |= {9, "new", (3, 4)}
+        assert isinstance(s, LazySet)
+        assert m["s"] == expected
+
+        s |= m["other"]
+        expected |= {3, 4, "b"}
+        assert m["s"] == expected
+        assert len(m["s"]) == len(expected)
+
+        s -= {1, "a", "never written"}
+        expected -= {1, "a"}
+        assert m["s"] == expected
+
+        s &= {2, 3, 4, 9, (3, 4), "b", "also never written"}
+        expected &= {2, 3, 4, 9, (3, 4), "b"}
+        assert m["s"] == expected
+
+        s ^= {2, 5, "c"}
+        expected ^= {2, 5, "c"}
+        assert m["s"] == expected
+        assert len(m["s"]) == len(expected)
+
+        with pytest.raises(TypeError):
+            s |= [1, 2]
+        s.difference_update([3, 4])
+        expected.difference_update([3, 4])
+        s.symmetric_difference_update(["b", "d"])
+        expected.symmetric_difference_update(["b", "d"])
+        s.intersection_update(range(10))
+        expected.intersection_update(range(10))
+        assert m["s"] == expected
+
+        s |= {(7, 8)}
+        expected |= {(7, 8)}
+        popped = set()
+        while len(expected) > 0:
+            item = s.pop()
+            expected.remove(item)
+            popped.add(item)
+            assert m["s"] == expected
+        assert (7, 8) in popped
+        with pytest.raises(KeyError):
+            s.pop()
+        assert m["other"] == {3, 4, "b"}
+
+
+def test_intern_keys_bounded():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP, intern_keys=True, decode_cache_size=0)
+        long_key = "a key that is much too long to be worth interning"
+        m["records"] = [{f"key {i}": i, long_key: i} for i in range(3000)]
+        for record in m["records"]:
+            assert len(record.eager()) == 2
+            assert m.cache_info()["interned_keys"] <= 1024
+        assert m.cache_info()["interned_keys"] == 1024
+
+        first, second = m["records"][0].eager(), m["records"][1].eager()
+        key1 = next(k for k in first if k == long_key)
+        key2 = next(k for k in second if k == long_key)
+        assert key1 is not key2
+        assert next(iter(m["records"][0].keys())) is sys.intern("key 0")
+
+
+def test_gc_keeps_lazy_containers():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP, gc_rows_per_write=1000)
+        m["l"] = [[1, "x"], {"a": 1}, "s"]
+        d = m["l"].pop(1)
+        inner = m["l"].pop(0)
+        m["other"] = 1
+        m["another"] = 2
+        assert m.gc_stats()["cycles"] >= 2
+        assert d.eager() == {"a": 1}
+        assert inner.eager() == [1, "x"]
+        m.vacuum()
+        assert d.eager() == {"a": 1}
+        assert inner.eager() == [1, "x"]
+
+        del d
+        del inner
+        assert m.vacuum()["records"] > 0
+        assert m["l"].eager() == ["s"]
+
+        s = LazySet(m, 12345)
+        with pytest.raises(ReferenceError, match="garbage collected"):
+            len(s)
+
+
+def test_list_slice_assignment():
+    with tempfile.NamedTemporaryFile() as f:
+        m = OOCMap(f.name, max_size=SMALL_MAP)
+        for expected in [list(range(10)), [f"item {i}" for i in range(10)]]:
+            m["l"] = expected
+            lazy = m["l"]
+
+            view = lazy[1:9:2]
+            assert view.count(expected[3]) == 1
+            assert view.count(expected[2]) == 0
+            assert view.index(expected[5]) == 2
+            assert view.index(expected[5], -2) == 2
+            with pytest.raises(ValueError):
+                view.index(expected[5], 3)
+            with pytest.raises(ValueError):
+                view.index(expected[2])
+            assert lazy[::-3].index(expected[3]) == 2
+
+            lazy[1:3] = ["a", "b", "c"]
+            expected[1:3] = ["a", "b", "c"]
+            assert m["l"] == expected
+            del lazy[1:3]
+            del expected[1:3]
+            assert m["l"] == expected
+            lazy[::2] = range(len(expected[::2]))
+            expected[::2] = range(len(expected[::2]))
+            assert m["l"] == expected
+            del lazy[::-3]
+            del expected[::-3]
+            assert m["l"] == expected
+            lazy[-1] = "last"
+            expected[-1] = "last"
+            assert m["l"] == expected
+            lazy[:0] = lazy
+            expected[:0] = expected
+            assert m["l"] == expected
+
+            with pytest.raises(ValueError):
+                lazy[::2] = [1]
+            with pytest.raises(TypeError):
+                lazy["x"] = 1
+            assert m["l"] == expected
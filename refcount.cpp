@@ -0,0 +1,180 @@
+#include "refcount.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "db.h"
+#include "gc.h"
+
+// Finds the key of the count of a value. Returns false for values that have no count, because they
+// fit into their EncodedValue, or because they are containers.
+static bool OOCRefcount_key(const EncodedValue& value, RefcountKey* const key) {
+    OOCGCTable table;
+    uint64_t id;
+    if(!OOCGC_record(value, &table, &id)) return false;
+    if(table != OOCGC_INTS && table != OOCGC_STRINGS && table != OOCGC_BLOBS && table != OOCGC_TUPLES)
+        return false;
+    key->table = static_cast<uint8_t>(table);
+    key->id = id;
+    return true;
+}
+
+// Returns the change for a key, and remembers what it was before if a savepoint is open.
+static OOCRefcounts::Change& OOCRefcount_change(OOCRefcounts* const refcounts, const RefcountKey& key) {
+    const auto inserted = refcounts->changes.emplace(key, OOCRefcounts::Change { .delta = 0, .created = false });
+    if(!refcounts->savepoints.empty())
+        refcounts->undo.push_back({ .key = key, .existed = !inserted.second, .change = inserted.first->second });
+    return inserted.first->second;
+}
+
+static void OOCRefcount_add(OOCMapObject* const ooc, const EncodedValue& value, const int64_t delta) {
+    RefcountKey key;
+    if(ooc->refcounts == nullptr || !OOCRefcount_key(value, &key)) return;
+    OOCRefcount_change(ooc->refcounts, key).delta += delta;
+}
+
+void OOCRefcount_created(OOCMapObject* const ooc, OOCTransaction& txn, const EncodedValue& value) {
+    RefcountKey key;
+    if(ooc->refcounts == nullptr || !OOCRefcount_key(value, &key)) return;
+    // A record is only created when it isn't there, so there are no references to it yet.
+    OOCRefcounts::Change& change = OOCRefcount_change(ooc->refcounts, key);
+    change.delta = 0;
+    change.created = true;
+}
+
+void OOCRefcount_incref(OOCMapObject* const ooc, OOCTransaction& txn, const EncodedValue& value) {
+    OOCRefcount_add(ooc, value, 1);
+}
+
+void OOCRefcount_decref(OOCMapObject* const ooc, OOCTransaction& txn, const EncodedValue& value) {
+    OOCRefcount_add(ooc, value, -1);
+}
+
+void OOCRefcount_forget(OOCMapObject* const ooc, OOCTransaction& txn, const uint8_t table, const uint64_t id) {
+    RefcountKey key = { .table = table, .id = id };
+    if(ooc->refcounts != nullptr && ooc->refcounts->changes.count(key) != 0) {
+        OOCRefcount_change(ooc->refcounts, key);
+        ooc->refcounts->changes.erase(key);
+    }
+
+    MDB_val mdbKey = { .mv_size = sizeof(key), .mv_data = &key };
+    try {
+        del(txn.txn, ooc->refcountsDb, &mdbKey);
+    } catch(const MdbError& error) {
+        if(error.mdbErrorCode != MDB_NOTFOUND)
+            throw;
+    }
+}
+
+// Deletes a record whose count went to 0. Tuples and frozensets let go of their elements.
+static void OOCRefcount_free(OOCMapObject* const ooc, MDB_txn* const txn, const RefcountKey& key) {
+    uint64_t id = key.id;
+    MDB_val mdbKey = { .mv_size = sizeof(id), .mv_data = &id };
+    const MDB_dbi dbi = OOCGC_dbi(ooc, key.table);
+    if(key.table == OOCGC_TUPLES) {
+        MDB_val mdbValue;
+        if(!get(txn, dbi, &mdbKey, &mdbValue)) return;
+        if(mdbValue.mv_size % sizeof(EncodedValue) != 0) throw OocError(OocError::UnexpectedData);
+        const EncodedValue* const elements = static_cast<const EncodedValue*>(mdbValue.mv_data);
+        for(size_t i = 0; i < mdbValue.mv_size / sizeof(EncodedValue); ++i)
+            OOCRefcount_add(ooc, elements[i], -1);
+    }
+    try {
+        del(txn, dbi, &mdbKey);
+    } catch(const MdbError& error) {
+        if(error.mdbErrorCode != MDB_NOTFOUND)
+            throw;
+    }
+}
+
+void OOCRefcount_beforeCommit(OOCMapObject* const ooc, MDB_txn* const txn) {
+    OOCRefcounts* const refcounts = ooc->refcounts;
+    if(refcounts == nullptr) return;
+    refcounts->undo.clear();
+    refcounts->savepoints.clear();
+
+    std::vector<std::pair<RefcountKey, OOCRefcounts::Change>> changes;
+    MDB_cursor* const cursor = cursor_open(txn, ooc->refcountsDb);
+    try {
+        // Deleting a tuple changes the counts of its elements, so this goes around until nothing
+        // changes anymore.
+        while(!refcounts->changes.empty()) {
+            // Going through the keys in order touches each page of the table only once.
+            changes.assign(refcounts->changes.begin(), refcounts->changes.end());
+            refcounts->changes.clear();
+            std::sort(changes.begin(), changes.end(), [](const auto& a, const auto& b) {
+                return memcmp(&a.first, &b.first, sizeof(RefcountKey)) < 0;
+            });
+
+            for(auto& pair : changes) {
+                RefcountKey& key = pair.first;
+                const OOCRefcounts::Change& change = pair.second;
+                MDB_val mdbKey = { .mv_size = sizeof(key), .mv_data = &key };
+                MDB_val mdbValue;
+                int64_t count = change.delta;
+                if(change.created) {
+                    if(count > 0) {
+                        mdbValue = { .mv_size = sizeof(count), .mv_data = &count };
+                        cursor_put(cursor, &mdbKey, &mdbValue);
+                    } else {
+                        OOCRefcount_free(ooc, txn, key);
+                    }
+                    continue;
+                }
+
+                // Records without a count were written by older versions, and are never deleted here.
+                if(change.delta == 0 || !cursor_get(cursor, &mdbKey, &mdbValue, MDB_SET_KEY)) continue;
+                if(mdbValue.mv_size != sizeof(count)) throw OocError(OocError::UnexpectedData);
+                int64_t oldCount;
+                memcpy(&oldCount, mdbValue.mv_data, sizeof(oldCount));
+                count += oldCount;
+                if(count > 0) {
+                    mdbValue = { .mv_size = sizeof(count), .mv_data = &count };
+                    cursor_put(cursor, &mdbKey, &mdbValue, MDB_CURRENT);
+                } else {
+                    cursor_del(cursor);
+                    OOCRefcount_free(ooc, txn, key);
+                }
+            }
+        }
+    } catch(...) {
+        cursor_close(cursor);
+        throw;
+    }
+    cursor_close(cursor);
+}
+
+void OOCRefcount_afterAbort(OOCMapObject* const ooc) {
+    OOCRefcounts* const refcounts = ooc->refcounts;
+    if(refcounts == nullptr) return;
+    refcounts->changes.clear();
+    refcounts->undo.clear();
+    refcounts->savepoints.clear();
+}
+
+void OOCRefcount_savepointBegin(OOCMapObject* const ooc, const size_t depth) {
+    OOCRefcounts* const refcounts = ooc->refcounts;
+    if(refcounts == nullptr) return;
+    refcounts->savepoints.resize(depth - 1, refcounts->undo.size());
+    refcounts->savepoints.push_back(refcounts->undo.size());
+}
+
+void OOCRefcount_savepointEnd(OOCMapObject* const ooc, const size_t depth, const bool commit) {
+    OOCRefcounts* const refcounts = ooc->refcounts;
+    if(refcounts == nullptr || refcounts->savepoints.size() < depth) return;
+    const size_t begin = refcounts->savepoints[depth - 1];
+    refcounts->savepoints.resize(depth - 1);
+    if(!commit) {
+        while(refcounts->undo.size() > begin) {
+            const OOCRefcounts::Undo& undo = refcounts->undo.back();
+            if(undo.existed)
+                refcounts->changes[undo.key] = undo.change;
+            else
+                refcounts->changes.erase(undo.key);
+            refcounts->undo.pop_back();
+        }
+    }
+    // The savepoint around this one can still be rolled back, so it needs the log until it ends.
+    if(refcounts->savepoints.empty())
+        refcounts->undo.clear();
+}
@@ -0,0 +1,102 @@
+#ifndef OOCMAP_REFCOUNT_H
+#define OOCMAP_REFCOUNT_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "oocmap.h"
+
+//
+// Reference counts
+//
+// Long ints, long strings, long bytes, arrays, tuples, and frozensets are stored once for each
+// distinct content, keyed by a hash of it (see putImmutable()). The refcounts table counts the
+// rows that refer to each of these records: entries in the root table, items in lists, dicts, and
+// sets, and the elements of tuples and frozensets. When one of those rows is overwritten or
+// deleted, the count goes down. A record whose count is 0 when the write transaction commits is
+// deleted then, and so are the counts of whatever it refers to in turn.
+//
+// OOCMap_encode() gives the records it creates a count of 0, and whatever stores the value counts
+// it. So records that end up not being stored are deleted again on commit. Records that were
+// written by older versions have no count. Only vacuum() and the collector delete those.
+//
+// A count is never lower than the number of rows that refer to the record, but it can be higher.
+// Containers don't have counts, so a container that nobody refers to anymore keeps its rows, and
+// those keep counting, until the garbage collector deletes them. The collector doesn't take the
+// counts down when it does that, because it can take many transactions to get through a table, and
+// in between, a record it deleted can be written again with the same key. The rows that referred to
+// the old record would then take away from the count of the new one. So a record that garbage
+// referred to is only deleted by the collector, once nothing can reach it.
+//
+// Nothing counts the references that lazy objects hold, so a lazy tuple stops working once the last
+// row that refers to it is gone, unless it was read before. LazyList.pop() reads the tuples it
+// returns for that reason. A lazy list, dict, or set for a container that nothing refers to anymore
+// should not be changed, because the rows it deletes may have been counted against a newer record.
+//
+
+#pragma pack(push, 1)
+
+struct RefcountKey {
+    uint8_t table;      // an OOCGCTable, see gc.h
+    uint64_t id;
+};
+
+#pragma pack(pop)
+
+struct RefcountKeyHash {
+    size_t operator()(const RefcountKey& key) const {
+        return static_cast<size_t>((key.id ^ key.table) * 0x9E3779B97F4A7C15ull);
+    }
+};
+
+inline bool operator==(const RefcountKey& a, const RefcountKey& b) {
+    return a.table == b.table && a.id == b.id;
+}
+
+// The changes to the counts in the write transaction that is open now. They are kept here, and only
+// written to the refcounts table right before it commits, so a record that is written and referred to
+// many times in one transaction has its count written once. The changes live on the map object, but
+// like the counts they only change inside of write transactions, and there is only ever one of those.
+struct OOCRefcounts {
+    struct Change {
+        int64_t delta;
+        bool created;   // the record is new, so its count starts at 0 instead of at what the table says
+    };
+    std::unordered_map<RefcountKey, Change, RefcountKeyHash> changes;
+
+    // Savepoints can be rolled back, so while one is open, this remembers what each change was
+    // before it was changed, or that it wasn't there (with `existed` false).
+    struct Undo {
+        RefcountKey key;
+        bool existed;
+        Change change;
+    };
+    std::vector<Undo> undo;
+    std::vector<size_t> savepoints;     // where the undo log was when each open savepoint began
+};
+
+// Gives a record that OOCMap_encode() just created a count of 0. Throws OocError.
+void OOCRefcount_created(OOCMapObject* ooc, OOCTransaction& txn, const EncodedValue& value);
+
+// Counts a row that was written and refers to `value`. Does nothing for values that don't have a
+// record with a count.
+void OOCRefcount_incref(OOCMapObject* ooc, OOCTransaction& txn, const EncodedValue& value);
+// Counts a row that referred to `value` and was overwritten or deleted.
+void OOCRefcount_decref(OOCMapObject* ooc, OOCTransaction& txn, const EncodedValue& value);
+
+// Deletes the count of a record that the garbage collector deleted. Throws OocError.
+void OOCRefcount_forget(OOCMapObject* ooc, OOCTransaction& txn, uint8_t table, uint64_t id);
+
+// Writes the changed counts, and deletes the records whose count is 0. Must run before a top-level
+// write transaction commits. Throws OocError.
+void OOCRefcount_beforeCommit(OOCMapObject* ooc, MDB_txn* txn);
+// Forgets about the changes when a top-level write transaction is aborted.
+void OOCRefcount_afterAbort(OOCMapObject* ooc);
+
+// Savepoints at `depth` 1 are directly inside the top-level transaction, the ones at depth 2 are
+// inside of those, and so on. Ending a savepoint also ends the ones that are still open inside it.
+void OOCRefcount_savepointBegin(OOCMapObject* ooc, size_t depth);
+void OOCRefcount_savepointEnd(OOCMapObject* ooc, size_t depth, bool commit);
+
+#endif //OOCMAP_REFCOUNT_H
@@ -10,7 +10,18 @@ oocmap_module = Extension(
         'oocmap.cpp',
         'lazytuple.cpp',
         'lazylist.cpp',
+        'liststore.cpp',
+        'gc.cpp',
+        'compact.cpp',
+        'refcount.cpp',
+        'frozen.cpp',
         'lazydict.cpp',
+        'lazyset.cpp',
+        'transaction.cpp',
+        'durability.cpp',
+        'decodecache.cpp',
+        'writer.cpp',
+        'ndarray.cpp',
         'errors.cpp',
         'db.cpp',
         'mdb.c',
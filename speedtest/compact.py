@@ -0,0 +1,62 @@
+# Measures the file size, and how fast all the records read back from a cold cache, for a map that was
+# rewritten a few times, after vacuum() and after compact_to().
+#
+# Run it like this:
+#   python ./compact.py
+
+import os
+import tempfile
+import time
+
+import oocmap
+
+N = 200000
+BATCH = 1000
+REWRITES = 3
+
+
+def record(i, version):
+    return {
+        "id": i,
+        "tags": ["tag", "another tag", f"tag number {i} version {version}"],
+        "meta": {"source": f"source number {i} version {version}", "position": [i, f"{i}"]},
+    }
+
+
+def drop_cache(filename):
+    fd = os.open(filename, os.O_RDONLY)
+    try:
+        os.fsync(fd)
+        os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+    finally:
+        os.close(fd)
+
+
+def read_all(filename):
+    drop_cache(filename)
+    m = oocmap.OOCMap(filename, max_size=2**32, writemap=False)
+    start = time.perf_counter()
+    for i in range(N):
+        m[i].eager()
+    return time.perf_counter() - start
+
+
+with tempfile.TemporaryDirectory() as d:
+    filename = os.path.join(d, "map")
+    # Without writemap, LMDB only grows the file as far as the pages it uses.
+    m = oocmap.OOCMap(filename, max_size=2**32, writemap=False)
+    for version in range(REWRITES):
+        for batch_start in range(0, N, BATCH):
+            m.put_many((i, record(i, version)) for i in range(batch_start, batch_start + BATCH))
+    m.vacuum()
+
+    compacted = os.path.join(d, "compacted")
+    start = time.perf_counter()
+    m.compact_to(compacted)
+    compact_seconds = time.perf_counter() - start
+    del m
+
+    for name, path in (("vacuum()", filename), ("compact_to()", compacted)):
+        seconds = read_all(path)
+        print(f"{name}: {os.path.getsize(path) / 2**20:.1f} MB, cold read {N / seconds:.0f} records per second")
+    print(f"compact_to() took {compact_seconds:.2f}s")
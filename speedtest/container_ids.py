@@ -0,0 +1,43 @@
+# Measures ingest throughput and file size for records that each hold a few dicts and lists, to show
+# the effect of how container ids are handed out. Run it against two builds to compare them.
+#
+# Run it like this:
+#   python ./container_ids.py
+
+import os
+import tempfile
+import time
+
+import oocmap
+
+N = 200000
+BATCH = 1000
+
+
+def record(i):
+    return {
+        "id": i,
+        "tags": ["tag", "another tag", f"tag number {i}"],
+        "meta": {"source": f"source number {i % 1000}", "position": [i, f"{i}"]},
+    }
+
+
+with tempfile.TemporaryDirectory() as d:
+    filename = os.path.join(d, "map")
+    # Without writemap, LMDB only grows the file as far as the pages it uses.
+    m = oocmap.OOCMap(filename, max_size=2**32, writemap=False)
+    start = time.perf_counter()
+    for batch_start in range(0, N, BATCH):
+        m.put_many((i, record(i)) for i in range(batch_start, batch_start + BATCH))
+    ingest_seconds = time.perf_counter() - start
+
+    start = time.perf_counter()
+    for i in range(N):
+        m[i].eager()
+    read_seconds = time.perf_counter() - start
+    del m
+
+    size = os.path.getsize(filename)
+    print(f"ingest: {N / ingest_seconds:.0f} records per second")
+    print(f"read in key order: {N / read_seconds:.0f} records per second")
+    print(f"file size: {size / 2**20:.1f} MB")
@@ -0,0 +1,48 @@
+# Measures how fast records that share most of their metadata are written, and how big the file gets,
+# with the records written as they are and with them frozen with oocmap.freeze().
+#
+# Run it like this:
+#   python ./freeze.py
+
+import os
+import tempfile
+import time
+
+import oocmap
+
+N = 100000
+BATCH = 1000
+SOURCES = 10
+
+
+def record(i):
+    source = i % SOURCES
+    return {
+        "id": i,
+        "text": f"text number {i}",
+        "meta": {
+            "source": f"source number {source}",
+            "license": "a long license name that is the same everywhere",
+            "tags": ["tag", "another tag", f"tag for source {source}"],
+            "processing": {"tokenizer": "some tokenizer", "steps": ["dedup", "filter", "normalize"]},
+        },
+    }
+
+
+for name, convert in (("as is", lambda value: value), ("freeze()", oocmap.freeze)):
+    with tempfile.TemporaryDirectory() as d:
+        filename = os.path.join(d, "map")
+        # Without writemap, LMDB only grows the file as far as the pages it uses.
+        m = oocmap.OOCMap(filename, max_size=2**32, writemap=False)
+        start = time.perf_counter()
+        for batch_start in range(0, N, BATCH):
+            m.put_many((i, convert(record(i))) for i in range(batch_start, batch_start + BATCH))
+        seconds = time.perf_counter() - start
+
+        start = time.perf_counter()
+        for i in range(N):
+            m[i]["meta"]["tags"][2]
+        read_seconds = time.perf_counter() - start
+        print(
+            f"{name}: {N / seconds:.0f} records per second, {os.path.getsize(filename) / 2**20:.1f} MB, "
+            f"{N / read_seconds:.0f} reads per second")
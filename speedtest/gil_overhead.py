@@ -0,0 +1,33 @@
+# Measures the per-item cost of the native loops that read many values from LMDB at once.
+#
+# Run it like this:
+#   python ./gil_overhead.py
+
+import tempfile
+import timeit
+
+import oocmap
+
+N = 200000
+LONG = "a string that is too long to be stored inline, number "
+
+with tempfile.NamedTemporaryFile() as f:
+    m = oocmap.OOCMap(f.name)
+    with m.transaction(write=True):
+        m["ints"] = list(range(N))
+        m["strings"] = [LONG + str(i) for i in range(N)]
+        m["tuple"] = tuple(LONG + str(i) for i in range(N))
+        m["dict"] = {i: LONG + str(i) for i in range(N)}
+        m.put_many((i, i) for i in range(N))
+
+    keys = list(range(N))
+    benchmarks = {
+        "LazyList.eager(), ints": lambda: m["ints"].eager(),
+        "LazyList.eager(), long strings": lambda: m["strings"].eager(),
+        "LazyTuple.eager(), long strings": lambda: m["tuple"].eager(),
+        "LazyDict.eager(), long strings": lambda: m["dict"].eager(),
+        "OOCMap.get_many(), ints": lambda: m.get_many(keys),
+    }
+    for name, fn in benchmarks.items():
+        seconds = min(timeit.repeat(fn, number=1, repeat=5))
+        print(f"{name}: {seconds * 1e9 / N:.0f} ns per item")
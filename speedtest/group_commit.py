@@ -0,0 +1,45 @@
+# Compares writing from several threads with `m[k] = v`, which commits once per item, against
+# queueing the same items into an `AsyncWriter`, which commits them in batches.
+#
+# Run it like this:
+#   python ./group_commit.py
+
+import tempfile
+import threading
+import time
+
+import oocmap
+
+THREADS = 4
+N = 5000
+LONG = "a string that is too long to be stored inline, number "
+
+
+def run(durability, use_writer):
+    with tempfile.NamedTemporaryFile() as f:
+        m = oocmap.OOCMap(f.name, durability=durability)
+        writer = m.async_writer() if use_writer else None
+        target = writer if use_writer else m
+
+        def produce(start):
+            for i in range(start, start + N):
+                target[i] = LONG + str(i)
+
+        threads = [threading.Thread(target=produce, args=(t * N,)) for t in range(THREADS)]
+        start = time.perf_counter()
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        if use_writer:
+            writer.close()
+        seconds = time.perf_counter() - start
+        assert len(m) == THREADS * N
+        return seconds
+
+
+for durability in ["none", "commit"]:
+    for use_writer in [False, True]:
+        seconds = run(durability, use_writer)
+        method = "AsyncWriter" if use_writer else "m[k] = v"
+        print(f"durability={durability}, {method}: {seconds * 1e6 / (THREADS * N):.1f} µs per item")
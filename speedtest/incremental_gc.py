@@ -0,0 +1,49 @@
+# Measures how long garbage collection keeps the write lock, with one vacuum() and with collect() steps of a
+# few sizes. Each run starts from a map of records where half of them were deleted.
+#
+# Run it like this:
+#   python ./incremental_gc.py
+
+import os
+import tempfile
+import time
+
+import oocmap
+
+N = 200000
+BATCH = 1000
+
+
+def record(i):
+    return {
+        "id": i,
+        "tags": ["tag", "another tag", f"tag number {i}"],
+        "meta": {"source": f"source number {i}", "position": [i, f"{i}"]},
+    }
+
+
+def garbage_map(filename):
+    m = oocmap.OOCMap(filename, max_size=2**32)
+    for batch_start in range(0, N, BATCH):
+        m.put_many((i, record(i)) for i in range(batch_start, batch_start + BATCH))
+    for i in range(0, N, 2):
+        del m[i]
+    return m
+
+
+with tempfile.TemporaryDirectory() as d:
+    m = garbage_map(os.path.join(d, "vacuum"))
+    start = time.perf_counter()
+    stats = m.vacuum()
+    print(f"vacuum(): {time.perf_counter() - start:.3f}s, {stats['records']} records")
+    del m
+
+    for rows in [100, 1000, 10000]:
+        m = garbage_map(os.path.join(d, f"collect{rows}"))
+        while not m.collect(rows=rows):
+            pass
+        stats = m.gc_stats()
+        print(
+            f"collect(rows={rows}): {stats['steps']} steps, {stats['total_seconds']:.3f}s in total, "
+            f"longest step {stats['max_seconds'] * 1000:.2f}ms, {stats['records']} records")
+        del m
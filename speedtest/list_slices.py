@@ -0,0 +1,34 @@
+# Measures how fast a window of 100 items is read from the middle of a list of a million strings, by
+# slicing the LazyList, and by copying the list with eager() first.
+#
+# Run it like this:
+#   python ./list_slices.py
+
+import os
+import random
+import tempfile
+import time
+
+import oocmap
+
+N = 1000000
+WINDOW = 100
+READS = 1000
+
+with tempfile.TemporaryDirectory() as d:
+    m = oocmap.OOCMap(os.path.join(d, "map"), max_size=2**32)
+    m["list"] = [f"string number {i}" for i in range(N)]
+    l = m["list"]
+    starts = [random.randrange(N - WINDOW) for _ in range(READS)]
+
+    start = time.perf_counter()
+    for s in starts:
+        window = l[s:s + WINDOW].eager()
+    seconds = time.perf_counter() - start
+    print(f"slice: {seconds / READS * 1000:.3f} ms per window")
+
+    start = time.perf_counter()
+    for s in starts[:10]:
+        window = l.eager()[s:s + WINDOW]
+    seconds = time.perf_counter() - start
+    print(f"eager() and slice: {seconds / 10 * 1000:.3f} ms per window")
@@ -0,0 +1,34 @@
+# Measures how fast a few keys can be overwritten with new long strings and tuples many times, how big
+# the file gets, and how much garbage vacuum() finds afterwards.
+#
+# Run it like this:
+#   python ./refcounts.py
+
+import os
+import tempfile
+import time
+
+import oocmap
+
+KEYS = 1000
+ROUNDS = 200
+
+
+def value(key, round):
+    return (f"status of {key} in round {round} " * 4, f"note {round} " * 8)
+
+
+with tempfile.TemporaryDirectory() as d:
+    filename = os.path.join(d, "map")
+    # Without writemap, LMDB only grows the file as far as the pages it uses.
+    m = oocmap.OOCMap(filename, max_size=2**32, writemap=False)
+    start = time.perf_counter()
+    for round in range(ROUNDS):
+        for key in range(KEYS):
+            m[key] = value(key, round)
+    seconds = time.perf_counter() - start
+    print(f"{KEYS * ROUNDS / seconds:.0f} overwrites per second, {os.path.getsize(filename) / 2**20:.1f} MB")
+
+    start = time.perf_counter()
+    stats = m.vacuum()
+    print(f"vacuum() freed {stats['records']} records in {time.perf_counter() - start:.2f}s")
@@ -0,0 +1,521 @@
+#include "transaction.h"
+
+#include "db.h"
+#include "errors.h"
+#include "gc.h"
+#include "refcount.h"
+
+//
+// Methods that are not directly exposed to Python.
+// These throw exceptions.
+//
+
+static OOCTransactionObject* OOCTransactionObject_alloc(
+    PyTypeObject* const type,
+    OOCMapObject* const ooc,
+    const bool readonly
+) {
+    PyObject* const pySelf = type->tp_alloc(type, 0);
+    if(pySelf == nullptr) throw OocError(OocError::OutOfMemory);
+    OOCTransactionObject* self = reinterpret_cast<OOCTransactionObject*>(pySelf);
+    self->ooc = ooc;
+    Py_XINCREF(ooc);
+    self->txn = nullptr;
+    self->readonly = readonly;
+    self->threadId = 0;
+    self->next = nullptr;
+    self->parent = nullptr;
+    self->child = nullptr;
+    self->exports = 0;
+    return self;
+}
+
+OOCTransactionObject* OOCTransaction_fastnew(OOCMapObject* const ooc, const bool readonly) {
+    return OOCTransactionObject_alloc(&OOCTransactionType, ooc, readonly);
+}
+
+OOCTransactionObject* OOCSavepoint_fastnew(OOCMapObject* const ooc) {
+    return OOCTransactionObject_alloc(&OOCSavepointType, ooc, false);
+}
+
+OOCTransactionObject* OOCTransactionObject_current(OOCMapObject* const ooc, const bool readonly) {
+    if(ooc->activeTxns == nullptr) return nullptr;
+
+    const unsigned long threadId = PyThread_get_thread_ident();
+    for(OOCTransactionObject* txn = ooc->activeTxns; txn != nullptr; txn = txn->next) {
+        if(txn->threadId != threadId) continue;
+        if(txn->readonly && !readonly) throw OocError(OocError::ReadonlyTransaction);
+        return txn;
+    }
+    return nullptr;
+}
+
+OOCTransactionObject* OOCSnapshot_fastnew(OOCMapObject* const ooc) {
+    OOCTransactionObject* const self = OOCTransactionObject_alloc(&OOCSnapshotType, ooc, true);
+    try {
+        self->txn = OOCMapObject_txnBegin(ooc, true);
+    } catch(...) {
+        Py_DECREF(self);
+        throw;
+    }
+    return self;
+}
+
+OOCTransactionObject* OOCSnapshotObject_check(OOCTransactionObject* const snapshot, const bool readonly) {
+    if(!readonly) throw OocError(OocError::ReadonlyTransaction);
+    if(snapshot->txn == nullptr) throw OocError(OocError::TransactionEnded);
+    return snapshot;
+}
+
+static void OOCTransactionObject_unlink(OOCTransactionObject* const self) {
+    OOCTransactionObject** link = &self->ooc->activeTxns;
+    while(*link != nullptr) {
+        if(*link == self) {
+            *link = self->next;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    self->next = nullptr;
+}
+
+// Forgets about a transaction and all the savepoints inside it, without ending the MDB_txn.
+static void OOCTransactionObject_detach(OOCTransactionObject* const self) {
+    if(self->child != nullptr)
+        OOCTransactionObject_detach(self->child);
+    self->txn = nullptr;
+    OOCTransactionObject_unlink(self);
+    if(self->parent != nullptr) {
+        self->parent->child = nullptr;
+        Py_CLEAR(self->parent);
+    }
+}
+
+// The number of savepoints this is nested in, counting itself if it is one.
+static size_t OOCTransactionObject_depth(const OOCTransactionObject* self) {
+    size_t depth = 0;
+    for(; self->parent != nullptr; self = self->parent)
+        depth += 1;
+    return depth;
+}
+
+static void OOCTransactionObject_end(OOCTransactionObject* const self, const bool commit) {
+    // LMDB frees the transaction even if the commit fails, so we forget about it first. Savepoints
+    // that are still open inside it are committed or aborted by LMDB along with it.
+    MDB_txn* const txn = self->txn;
+    const size_t depth = OOCTransactionObject_depth(self);
+    OOCTransactionObject_detach(self);
+    if(depth > 0) {
+        OOCRefcount_savepointEnd(self->ooc, depth, commit);
+        if(commit) {
+            txn_commit(txn);
+        } else {
+            txn_abort(txn);
+            OOCMapObject_clearDecodeCache(self->ooc);
+        }
+    } else {
+        OOCMapObject_txnEnd(self->ooc, txn, self->readonly, commit);
+        if(commit && !self->readonly)
+            OOCGC_afterWrite(self->ooc);
+    }
+}
+
+PyObject* OOCSnapshot_memoryview(OOCTransactionObject* const snapshot, void* const data, const size_t size) {
+    PyObject* const pyBuffer = OOCSnapshotBufferType.tp_alloc(&OOCSnapshotBufferType, 0);
+    if(pyBuffer == nullptr) throw OocError(OocError::OutOfMemory);
+    OOCSnapshotBufferObject* const buffer = reinterpret_cast<OOCSnapshotBufferObject*>(pyBuffer);
+    buffer->snapshot = snapshot;
+    Py_INCREF(snapshot);
+    snapshot->exports += 1;
+    buffer->data = data;
+    buffer->size = size;
+
+    PyObject* const result = PyMemoryView_FromObject(pyBuffer);
+    Py_DECREF(pyBuffer);
+    if(result == nullptr) throw OocError(OocError::AlreadyPythonizedError);
+    return result;
+}
+
+static bool isTransactionObject(PyObject* const pySelf) {
+    return pySelf->ob_type == &OOCTransactionType || pySelf->ob_type == &OOCSavepointType;
+}
+
+//
+// Methods that are directly exposed to Python
+// These are not allowed to throw exceptions.
+//
+
+static PyObject* OOCTransaction_new(PyTypeObject* const type, PyObject* const args, PyObject* const kwds) {
+    PyObject* pySelf = type->tp_alloc(type, 0);
+    OOCTransactionObject* self = reinterpret_cast<OOCTransactionObject*>(pySelf);
+    if(self == nullptr) {
+        PyErr_NoMemory();
+        return nullptr;
+    }
+    self->ooc = nullptr;
+    self->txn = nullptr;
+    self->readonly = true;
+    self->threadId = 0;
+    self->next = nullptr;
+    self->parent = nullptr;
+    self->child = nullptr;
+    self->exports = 0;
+    return (PyObject*)self;
+}
+
+static int OOCTransaction_init(OOCTransactionObject* const self, PyObject* const args, PyObject* const kwds) {
+    // parse parameters
+    static const char *kwlist[] = {"oocmap", "write", nullptr};
+    PyObject* oocmapObject = nullptr;
+    int write = 0;
+    const int parseSuccess = PyArg_ParseTupleAndKeywords(
+        args,
+        kwds,
+        "O!|p",
+        const_cast<char**>(kwlist),
+        &OOCMapType, &oocmapObject, &write);
+    if(!parseSuccess)
+        return -1;
+
+    if(self->txn != nullptr) {
+        PyErr_Format(PyExc_RuntimeError, "Cannot re-initialize a transaction that is in progress");
+        return -1;
+    }
+
+    Py_XDECREF(self->ooc);
+    self->ooc = reinterpret_cast<OOCMapObject*>(oocmapObject);
+    Py_INCREF(oocmapObject);
+    self->readonly = !write;
+
+    return 0;
+}
+
+static void OOCTransaction_dealloc(OOCTransactionObject* const self) {
+    if(self->txn != nullptr)
+        OOCTransactionObject_end(self, false);
+    Py_XDECREF(self->ooc);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* OOCTransaction_enter(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCTransactionType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCTransactionObject* const self = reinterpret_cast<OOCTransactionObject*>(pySelf);
+    if(self->ooc == nullptr) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    if(self->txn != nullptr || self->threadId != 0) {
+        PyErr_Format(PyExc_RuntimeError, "A transaction can only be used once");
+        return nullptr;
+    }
+
+    const unsigned long threadId = PyThread_get_thread_ident();
+    for(OOCTransactionObject* txn = self->ooc->activeTxns; txn != nullptr; txn = txn->next) {
+        if(txn->threadId == threadId) {
+            PyErr_Format(PyExc_RuntimeError, "This thread already has a transaction open on this OOCMap");
+            return nullptr;
+        }
+    }
+
+    try {
+        self->txn = OOCMapObject_txnBegin(self->ooc, self->readonly);
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    self->threadId = threadId;
+    self->next = self->ooc->activeTxns;
+    self->ooc->activeTxns = self;
+
+    Py_INCREF(pySelf);
+    return pySelf;
+}
+
+static PyObject* OOCSavepoint_enter(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCSavepointType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCTransactionObject* const self = reinterpret_cast<OOCTransactionObject*>(pySelf);
+    if(self->txn != nullptr || self->threadId != 0) {
+        PyErr_Format(PyExc_RuntimeError, "A savepoint can only be used once");
+        return nullptr;
+    }
+
+    unsigned int envFlags = 0;
+    mdb_env_get_flags(self->ooc->mdb, &envFlags);
+    if(envFlags & MDB_WRITEMAP) {
+        PyErr_Format(PyExc_RuntimeError, "Savepoints need an OOCMap that was opened with writemap=False");
+        return nullptr;
+    }
+
+    try {
+        OOCTransactionObject* const parent = OOCTransactionObject_current(self->ooc, false);
+        if(parent == nullptr) {
+            PyErr_Format(PyExc_RuntimeError, "Savepoints can only be used inside a write transaction");
+            return nullptr;
+        }
+        self->txn = txn_begin(self->ooc->mdb, true, parent->txn);
+        self->parent = parent;
+        Py_INCREF(parent);
+        parent->child = self;
+        self->threadId = parent->threadId;
+        OOCRefcount_savepointBegin(self->ooc, OOCTransactionObject_depth(self));
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    self->next = self->ooc->activeTxns;
+    self->ooc->activeTxns = self;
+
+    Py_INCREF(pySelf);
+    return pySelf;
+}
+
+static PyObject* OOCTransaction_finish(PyObject* const pySelf, const bool commit) {
+    if(!isTransactionObject(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCTransactionObject* const self = reinterpret_cast<OOCTransactionObject*>(pySelf);
+    if(self->txn == nullptr) {
+        PyErr_Format(PyExc_RuntimeError, "The transaction is not in progress");
+        return nullptr;
+    }
+
+    try {
+        OOCTransactionObject_end(self, commit);
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCTransaction_commit(PyObject* const pySelf) {
+    return OOCTransaction_finish(pySelf, true);
+}
+
+static PyObject* OOCTransaction_abort(PyObject* const pySelf) {
+    return OOCTransaction_finish(pySelf, false);
+}
+
+static PyObject* OOCTransaction_exit(PyObject* const pySelf, PyObject* const args) {
+    if(!isTransactionObject(pySelf)) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCTransactionObject* const self = reinterpret_cast<OOCTransactionObject*>(pySelf);
+
+    PyObject* excType = Py_None;
+    PyObject* excValue = Py_None;
+    PyObject* traceback = Py_None;
+    if(!PyArg_UnpackTuple(args, "__exit__", 0, 3, &excType, &excValue, &traceback))
+        return nullptr;
+
+    // The user may have ended the transaction explicitly inside the with block.
+    if(self->txn != nullptr) {
+        PyObject* const result = OOCTransaction_finish(pySelf, excType == Py_None);
+        if(result == nullptr) return nullptr;
+        Py_DECREF(result);
+    }
+    Py_RETURN_FALSE;
+}
+
+static PyMethodDef OOCTransaction_methods[] = {
+    {
+        "__enter__",
+        (PyCFunction)OOCTransaction_enter,
+        METH_NOARGS,
+        PyDoc_STR("starts the transaction")
+    }, {
+        "__exit__",
+        (PyCFunction)OOCTransaction_exit,
+        METH_VARARGS,
+        PyDoc_STR("commits the transaction, or aborts it if the block raised an exception")
+    }, {
+        "commit",
+        (PyCFunction)OOCTransaction_commit,
+        METH_NOARGS,
+        PyDoc_STR("commits the transaction")
+    }, {
+        "abort",
+        (PyCFunction)OOCTransaction_abort,
+        METH_NOARGS,
+        PyDoc_STR("aborts the transaction, discarding everything written in it")
+    },
+    {nullptr}, // sentinel
+};
+
+PyTypeObject OOCTransactionType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    .tp_name = "oocmap.Transaction",
+    .tp_basicsize = sizeof(OOCTransactionObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)OOCTransaction_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A transaction that groups many operations on an OOCMap",
+    .tp_methods = OOCTransaction_methods,
+    .tp_init = (initproc)OOCTransaction_init,
+    .tp_new = OOCTransaction_new,
+};
+
+static PyMethodDef OOCSavepoint_methods[] = {
+    {
+        "__enter__",
+        (PyCFunction)OOCSavepoint_enter,
+        METH_NOARGS,
+        PyDoc_STR("starts the savepoint inside the current write transaction")
+    }, {
+        "__exit__",
+        (PyCFunction)OOCTransaction_exit,
+        METH_VARARGS,
+        PyDoc_STR("keeps the changes made since the savepoint, or rolls them back if the block raised an exception")
+    }, {
+        "commit",
+        (PyCFunction)OOCTransaction_commit,
+        METH_NOARGS,
+        PyDoc_STR("keeps the changes made since the savepoint as part of the enclosing transaction")
+    }, {
+        "abort",
+        (PyCFunction)OOCTransaction_abort,
+        METH_NOARGS,
+        PyDoc_STR("rolls back the changes made since the savepoint")
+    },
+    {nullptr}, // sentinel
+};
+
+PyTypeObject OOCSavepointType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    .tp_name = "oocmap.Savepoint",
+    .tp_basicsize = sizeof(OOCTransactionObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)OOCTransaction_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A nested transaction that can be rolled back without ending the transaction around it",
+    .tp_methods = OOCSavepoint_methods,
+};
+
+
+static void OOCSnapshot_dealloc(OOCTransactionObject* const self) {
+    if(self->txn != nullptr)
+        OOCMapObject_txnEnd(self->ooc, self->txn, true, false);
+    Py_XDECREF(self->ooc);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* OOCSnapshot_close(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCSnapshotType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCTransactionObject* const self = reinterpret_cast<OOCTransactionObject*>(pySelf);
+    if(self->exports > 0) {
+        PyErr_Format(PyExc_BufferError, "cannot close a snapshot while memoryviews into it exist");
+        return nullptr;
+    }
+    if(self->txn != nullptr) {
+        MDB_txn* const txn = self->txn;
+        self->txn = nullptr;
+        OOCMapObject_txnEnd(self->ooc, txn, true, false);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCSnapshot_enter(PyObject* const pySelf) {
+    Py_INCREF(pySelf);
+    return pySelf;
+}
+
+static PyObject* OOCSnapshot_exit(PyObject* const pySelf, PyObject* const args) {
+    PyObject* const result = OOCSnapshot_close(pySelf);
+    if(result == nullptr) return nullptr;
+    Py_DECREF(result);
+    Py_RETURN_FALSE;
+}
+
+static Py_ssize_t OOCSnapshot_length(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCSnapshotType) {
+        PyErr_BadArgument();
+        return -1;
+    }
+    OOCTransactionObject* const self = reinterpret_cast<OOCTransactionObject*>(pySelf);
+    return OOCMap_lengthInSnapshot(self->ooc, self);
+}
+
+static PyObject* OOCSnapshot_get(PyObject* const pySelf, PyObject* const key) {
+    if(pySelf->ob_type != &OOCSnapshotType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCTransactionObject* const self = reinterpret_cast<OOCTransactionObject*>(pySelf);
+    return OOCMap_getInSnapshot(self->ooc, key, self);
+}
+
+static PyMethodDef OOCSnapshot_methods[] = {
+    {
+        "__enter__",
+        (PyCFunction)OOCSnapshot_enter,
+        METH_NOARGS,
+        PyDoc_STR("returns the snapshot")
+    }, {
+        "__exit__",
+        (PyCFunction)OOCSnapshot_exit,
+        METH_VARARGS,
+        PyDoc_STR("closes the snapshot")
+    }, {
+        "close",
+        (PyCFunction)OOCSnapshot_close,
+        METH_NOARGS,
+        PyDoc_STR("closes the snapshot, after which the objects read through it can no longer be used")
+    },
+    {nullptr}, // sentinel
+};
+
+static PyMappingMethods OOCSnapshot_mapping_methods = {
+    .mp_length = OOCSnapshot_length,
+    .mp_subscript = OOCSnapshot_get,
+};
+
+PyTypeObject OOCSnapshotType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    .tp_name = "oocmap.Snapshot",
+    .tp_basicsize = sizeof(OOCTransactionObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)OOCSnapshot_dealloc,
+    .tp_as_mapping = &OOCSnapshot_mapping_methods,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A read-only view of an OOCMap as it was when the snapshot was taken",
+    .tp_methods = OOCSnapshot_methods,
+};
+
+
+static void OOCSnapshotBuffer_dealloc(OOCSnapshotBufferObject* const self) {
+    self->snapshot->exports -= 1;
+    Py_DECREF(self->snapshot);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int OOCSnapshotBuffer_getBuffer(PyObject* const pySelf, Py_buffer* const view, const int flags) {
+    OOCSnapshotBufferObject* const self = reinterpret_cast<OOCSnapshotBufferObject*>(pySelf);
+    return PyBuffer_FillInfo(view, pySelf, self->data, self->size, 1, flags);
+}
+
+static PyBufferProcs OOCSnapshotBuffer_buffer_procs = {
+    .bf_getbuffer = OOCSnapshotBuffer_getBuffer,
+    .bf_releasebuffer = nullptr,
+};
+
+PyTypeObject OOCSnapshotBufferType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    .tp_name = "oocmap.SnapshotBuffer",
+    .tp_basicsize = sizeof(OOCSnapshotBufferObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)OOCSnapshotBuffer_dealloc,
+    .tp_as_buffer = &OOCSnapshotBuffer_buffer_procs,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A read-only piece of the memory map that stays valid while its snapshot is open",
+};
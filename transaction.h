@@ -0,0 +1,93 @@
+#ifndef OOCMAP_TRANSACTION_H
+#define OOCMAP_TRANSACTION_H
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "oocmap.h"
+#include "lmdb.h"
+
+//
+// OOCTransactionObject
+//
+// A transaction the user opens explicitly with `with m.transaction(write=...)`. While it is
+// open, all operations on the map from the same thread, including the ones on lazy objects,
+// run inside it instead of starting and committing their own.
+//
+
+typedef struct OOCTransactionObject {
+    PyObject_HEAD
+    OOCMapObject* ooc;
+    MDB_txn* txn;
+    bool readonly;
+    unsigned long threadId;
+    OOCTransactionObject* next;     // the next entry in ooc->activeTxns
+    OOCTransactionObject* parent;   // for savepoints, the transaction they are nested in
+    OOCTransactionObject* child;    // the savepoint that is currently open inside this, if any
+    Py_ssize_t exports;             // for snapshots, the number of live buffers pointing into the map
+} OOCTransactionObject;
+
+extern PyTypeObject OOCTransactionType;
+
+OOCTransactionObject* OOCTransaction_fastnew(OOCMapObject* ooc, bool readonly);
+
+// Returns the open transaction that operations on this map should run in when they come from
+// the current thread, or nullptr if there is none. This is the innermost savepoint, if there is one.
+OOCTransactionObject* OOCTransactionObject_current(OOCMapObject* ooc, bool readonly);
+
+
+//
+// OOCSavepoint
+//
+// A nested write transaction returned by `m.savepoint()`, also with the OOCTransactionObject layout.
+// It runs as an LMDB child transaction of the write transaction that is open in the current thread,
+// so it can be rolled back without losing the rest of the work in that transaction. While it is
+// open, its parent can't be used. LMDB doesn't support child transactions with MDB_WRITEMAP, so
+// this only works on maps opened with `writemap=False`.
+//
+
+extern PyTypeObject OOCSavepointType;
+
+OOCTransactionObject* OOCSavepoint_fastnew(OOCMapObject* ooc);
+
+
+//
+// OOCSnapshot
+//
+// A read-only view of the map returned by `m.snapshot()`. It shares the OOCTransactionObject
+// layout, but its MDB_txn starts right away, is not tied to a thread, and stays open until the
+// snapshot is closed or garbage collected. Lazy objects read through a snapshot keep a reference
+// to it and run all their reads in its transaction, so a whole traversal sees one consistent
+// version of the data. Like any LMDB read transaction, it keeps the pages of that version from
+// being reused while it is open.
+//
+
+extern PyTypeObject OOCSnapshotType;
+
+OOCTransactionObject* OOCSnapshot_fastnew(OOCMapObject* ooc);
+
+// Returns the snapshot if an operation may run in it, and throws otherwise.
+OOCTransactionObject* OOCSnapshotObject_check(OOCTransactionObject* snapshot, bool readonly);
+
+
+//
+// OOCSnapshotBuffer
+//
+// Exports a piece of the memory map as a read-only buffer. LMDB doesn't move or reuse the pages a
+// read transaction can see, so the data stays valid for as long as the snapshot is open, and the
+// snapshot can't be closed while any of these exist.
+//
+
+typedef struct {
+    PyObject_HEAD
+    OOCTransactionObject* snapshot;
+    void* data;
+    Py_ssize_t size;
+} OOCSnapshotBufferObject;
+
+extern PyTypeObject OOCSnapshotBufferType;
+
+// Returns a read-only memoryview of data that was read in the snapshot's transaction.
+PyObject* OOCSnapshot_memoryview(OOCTransactionObject* snapshot, void* data, size_t size);
+
+#endif
@@ -0,0 +1,406 @@
+#include "writer.h"
+
+#include <new>
+#include <system_error>
+
+#include "db.h"
+#include "errors.h"
+#include "transaction.h"
+
+//
+// Methods that are not directly exposed to Python.
+// These throw exceptions.
+//
+
+OOCWriter::OOCWriter(OOCMapObject* const ooc, const size_t batchSize, const double maxDelay) :
+    ooc(ooc),
+    batchSize(batchSize),
+    maxDelay(maxDelay),
+    m_enqueued(0),
+    m_applied(0),
+    m_flushTarget(0),
+    m_stopping(false),
+    m_stats({0, 0, 0, 0.0}),
+    m_closed(false)
+{
+    Py_INCREF(ooc);
+    try {
+        m_thread = std::thread([this]() { run(); });
+    } catch(...) {
+        Py_DECREF(ooc);
+        throw;
+    }
+}
+
+OOCWriter::~OOCWriter() {
+    stop();
+    for(const Error& error : m_errors) {
+        Py_XDECREF(error.type);
+        Py_XDECREF(error.value);
+        Py_XDECREF(error.traceback);
+    }
+    Py_DECREF(ooc);
+}
+
+void OOCWriter::run() {
+    const auto maxDelayDuration =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(maxDelay));
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true) {
+        m_wakeWriter.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+        if(m_queue.empty()) break;
+
+        m_wakeWriter.wait_until(lock, m_oldest + maxDelayDuration, [this]() {
+            return m_stopping || m_queue.size() >= batchSize || m_flushTarget > m_applied;
+        });
+        std::vector<Item> batch;
+        batch.swap(m_queue);
+        const uint64_t batchCount = batch.size();
+
+        // Never wait for the GIL while holding the lock. The producers hold the GIL when they take it.
+        lock.unlock();
+        const auto start = std::chrono::steady_clock::now();
+        applyBatch(batch);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        lock.lock();
+
+        m_applied += batchCount;
+        m_stats.ops += batchCount;
+        m_stats.batches += 1;
+        m_stats.totalSeconds += seconds;
+        if(batchCount > m_stats.maxBatch)
+            m_stats.maxBatch = batchCount;
+        m_wakeProducers.notify_all();
+    }
+}
+
+void OOCWriter::applyBatch(std::vector<Item>& batch) {
+    const PyGILState_STATE gilState = PyGILState_Ensure();
+    if(!write(batch.data(), batch.data() + batch.size())) {
+        if(batch.size() == 1) {
+            keepError(batch[0]);
+        } else {
+            // One bad item should not cost the other producers their writes, so we find the bad
+            // items by writing each of them in its own transaction.
+            PyErr_Clear();
+            for(const Item& item : batch) {
+                if(!write(&item, &item + 1))
+                    keepError(item);
+            }
+        }
+    }
+    for(const Item& item : batch) {
+        Py_DECREF(item.key);
+        Py_DECREF(item.value);
+    }
+    batch.clear();
+    PyGILState_Release(gilState);
+}
+
+bool OOCWriter::write(const Item* const begin, const Item* const end) {
+    try {
+        OOCMapObject_growingWrite(ooc, [&]() {
+            OOCTransaction txn(ooc, false);
+            std::vector<std::pair<EncodedValue, EncodedValue>> encodedItems;
+            encodedItems.reserve(end - begin);
+            for(const Item* item = begin; item != end; ++item) {
+                const EncodedValue encodedKey = *OOCMap_encode(ooc, item->key, txn, true);
+                const EncodedValue encodedValue = *OOCMap_encode(ooc, item->value, txn);
+                encodedItems.emplace_back(encodedKey, encodedValue);
+            }
+            OOCMapObject_putEncoded(ooc, txn, encodedItems);
+            txn.commit();
+        });
+    } catch(const OocError& error) {
+        error.pythonize();
+        return false;
+    } catch(const std::bad_alloc&) {
+        PyErr_NoMemory();
+        return false;
+    } catch(const std::exception& e) {
+        PyErr_Format(PyExc_RuntimeError, "%s", e.what());
+        return false;
+    }
+    return true;
+}
+
+void OOCWriter::keepError(const Item& item) {
+    PyObject* type;
+    PyObject* value;
+    PyObject* traceback;
+    PyErr_Fetch(&type, &value, &traceback);
+    PyErr_NormalizeException(&type, &value, &traceback);
+
+    // We raise the same type of error, with the key in the message. Error types that can't be made
+    // from just a message are kept as they are.
+    PyObject* const message = PyUnicode_FromFormat("Could not write the item with key %R: %S", item.key, value);
+    PyObject* const named = message == nullptr ? nullptr : PyObject_CallFunctionObjArgs(type, message, nullptr);
+    Py_XDECREF(message);
+    if(named != nullptr && PyExceptionInstance_Check(named)) {
+        if(traceback != nullptr)
+            PyException_SetTraceback(named, traceback);
+        PyException_SetCause(named, value);
+        value = named;
+    } else {
+        Py_XDECREF(named);
+        PyErr_Clear();
+    }
+
+    for(const Error& error : m_errors) {
+        if(error.threadId == item.threadId) {
+            // We only keep the first error for each thread.
+            Py_XDECREF(type);
+            Py_XDECREF(value);
+            Py_XDECREF(traceback);
+            return;
+        }
+    }
+    m_errors.push_back({item.threadId, type, value, traceback});
+}
+
+void OOCWriter::stop() {
+    if(!m_thread.joinable()) return;
+    {
+        // The writer thread needs the GIL to write what is left.
+        GilUnlocker gil;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeWriter.notify_all();
+        m_thread.join();
+    }
+}
+
+void OOCWriter::raiseError(const bool anyThread) {
+    const unsigned long threadId = PyThread_get_thread_ident();
+    for(auto error = m_errors.begin(); error != m_errors.end(); ++error) {
+        if(!anyThread && error->threadId != threadId) continue;
+        PyErr_Restore(error->type, error->value, error->traceback);
+        m_errors.erase(error);
+        throw OocError(OocError::AlreadyPythonizedError);
+    }
+}
+
+void OOCWriter::checkNotBlocking() const {
+    // If this thread holds the LMDB write lock, the writer thread can never get it.
+    const unsigned long threadId = PyThread_get_thread_ident();
+    for(OOCTransactionObject* txn = ooc->activeTxns; txn != nullptr; txn = txn->next) {
+        if(txn->threadId == threadId && !txn->readonly)
+            throw OocError(OocError::WriterBlocked);
+    }
+}
+
+void OOCWriter::enqueue(PyObject* const key, PyObject* const value) {
+    if(m_closed) throw OocError(OocError::WriterClosed);
+    raiseError();
+    // Unhashable keys would only fail in the writer thread, so we catch them here.
+    if(PyObject_Hash(key) == -1) throw OocError(OocError::AlreadyPythonizedError);
+
+    // We don't let the queue grow without bounds if the producers are faster than the disk.
+    const size_t maxQueued = batchSize * 4;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(m_queue.size() >= maxQueued) {
+        // Never wait for the GIL while holding the lock, or we deadlock with other producers.
+        lock.unlock();
+        checkNotBlocking();
+        {
+            GilUnlocker gil;
+            std::unique_lock<std::mutex> waitLock(m_mutex);
+            m_wakeProducers.wait(waitLock, [&]() { return m_queue.size() < maxQueued; });
+        }
+        lock.lock();
+    }
+
+    Py_INCREF(key);
+    Py_INCREF(value);
+    if(m_queue.empty())
+        m_oldest = std::chrono::steady_clock::now();
+    m_queue.push_back({key, value, PyThread_get_thread_ident()});
+    m_enqueued += 1;
+    if(m_queue.size() == 1 || m_queue.size() == batchSize)
+        m_wakeWriter.notify_one();
+}
+
+void OOCWriter::flush() {
+    if(m_closed) throw OocError(OocError::WriterClosed);
+    checkNotBlocking();
+    {
+        GilUnlocker gil;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const uint64_t target = m_enqueued;
+        if(target > m_flushTarget)
+            m_flushTarget = target;
+        m_wakeWriter.notify_one();
+        m_wakeProducers.wait(lock, [&]() { return m_applied >= target; });
+    }
+    raiseError();
+}
+
+void OOCWriter::close() {
+    if(m_closed) return;
+    checkNotBlocking();
+    m_closed = true;
+    stop();
+    // Nobody else will ask for errors after this, so we raise those of other threads as well.
+    raiseError();
+    raiseError(true);
+}
+
+OOCWriter::Stats OOCWriter::stats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+OOCAsyncWriterObject* OOCAsyncWriter_fastnew(OOCMapObject* const ooc, const size_t batchSize, const double maxDelay) {
+    PyObject* const pySelf = OOCAsyncWriterType.tp_alloc(&OOCAsyncWriterType, 0);
+    if(pySelf == nullptr) throw OocError(OocError::OutOfMemory);
+    OOCAsyncWriterObject* const self = reinterpret_cast<OOCAsyncWriterObject*>(pySelf);
+    self->writer = nullptr;
+    try {
+        self->writer = new OOCWriter(ooc, batchSize, maxDelay);
+    } catch(const std::system_error& e) {
+        Py_DECREF(self);
+        PyErr_Format(PyExc_RuntimeError, "Could not start the writer thread: %s", e.what());
+        throw OocError(OocError::AlreadyPythonizedError);
+    }
+    return self;
+}
+
+//
+// Methods that are directly exposed to Python
+// These are not allowed to throw exceptions.
+//
+
+static void OOCAsyncWriter_dealloc(OOCAsyncWriterObject* const self) {
+    // Whatever is still queued gets written. Errors have nowhere to go at this point.
+    delete self->writer;
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int OOCAsyncWriter_insert(PyObject* const pySelf, PyObject* const key, PyObject* const value) {
+    if(pySelf->ob_type != &OOCAsyncWriterType) {
+        PyErr_BadArgument();
+        return -1;
+    }
+    OOCAsyncWriterObject* const self = reinterpret_cast<OOCAsyncWriterObject*>(pySelf);
+    if(value == nullptr) {
+        PyErr_Format(PyExc_TypeError, "AsyncWriter does not support deleting items");
+        return -1;
+    }
+
+    try {
+        self->writer->enqueue(key, value);
+    } catch(const OocError& error) {
+        error.pythonize();
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject* OOCAsyncWriter_flush(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCAsyncWriterType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCAsyncWriterObject* const self = reinterpret_cast<OOCAsyncWriterObject*>(pySelf);
+
+    try {
+        self->writer->flush();
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCAsyncWriter_close(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCAsyncWriterType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCAsyncWriterObject* const self = reinterpret_cast<OOCAsyncWriterObject*>(pySelf);
+
+    try {
+        self->writer->close();
+    } catch(const OocError& error) {
+        error.pythonize();
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* OOCAsyncWriter_enter(PyObject* const pySelf) {
+    Py_INCREF(pySelf);
+    return pySelf;
+}
+
+static PyObject* OOCAsyncWriter_exit(PyObject* const pySelf, PyObject* const args) {
+    PyObject* const result = OOCAsyncWriter_close(pySelf);
+    if(result == nullptr) return nullptr;
+    Py_DECREF(result);
+    Py_RETURN_FALSE;
+}
+
+static PyObject* OOCAsyncWriter_stats(PyObject* const pySelf) {
+    if(pySelf->ob_type != &OOCAsyncWriterType) {
+        PyErr_BadArgument();
+        return nullptr;
+    }
+    OOCAsyncWriterObject* const self = reinterpret_cast<OOCAsyncWriterObject*>(pySelf);
+
+    const OOCWriter::Stats stats = self->writer->stats();
+    return Py_BuildValue(
+        "{s:K,s:K,s:K,s:d}",
+        "ops", (unsigned long long)stats.ops,
+        "batches", (unsigned long long)stats.batches,
+        "max_batch", (unsigned long long)stats.maxBatch,
+        "total_seconds", stats.totalSeconds);
+}
+
+static PyMethodDef OOCAsyncWriter_methods[] = {
+    {
+        "__enter__",
+        (PyCFunction)OOCAsyncWriter_enter,
+        METH_NOARGS,
+        PyDoc_STR("returns the writer")
+    }, {
+        "__exit__",
+        (PyCFunction)OOCAsyncWriter_exit,
+        METH_VARARGS,
+        PyDoc_STR("writes everything that is queued and closes the writer")
+    }, {
+        "flush",
+        (PyCFunction)OOCAsyncWriter_flush,
+        METH_NOARGS,
+        PyDoc_STR("waits until everything that was queued so far is committed")
+    }, {
+        "close",
+        (PyCFunction)OOCAsyncWriter_close,
+        METH_NOARGS,
+        PyDoc_STR("writes everything that is queued and stops the writer thread")
+    }, {
+        "stats",
+        (PyCFunction)OOCAsyncWriter_stats,
+        METH_NOARGS,
+        PyDoc_STR("returns a dict with the number of operations and batches written, and how long they took")
+    },
+    {nullptr}, // sentinel
+};
+
+static PyMappingMethods OOCAsyncWriter_mapping_methods = {
+    .mp_ass_subscript = OOCAsyncWriter_insert,
+};
+
+PyTypeObject OOCAsyncWriterType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    .tp_name = "oocmap.AsyncWriter",
+    .tp_basicsize = sizeof(OOCAsyncWriterObject),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor)OOCAsyncWriter_dealloc,
+    .tp_as_mapping = &OOCAsyncWriter_mapping_methods,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Writes items into an OOCMap from a background thread, many to a transaction",
+    .tp_methods = OOCAsyncWriter_methods,
+};
@@ -0,0 +1,113 @@
+#ifndef OOCMAP_WRITER_H
+#define OOCMAP_WRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "oocmap.h"
+
+//
+// OOCWriter
+//
+// Applies `w[key] = value` operations from any number of Python threads in a native thread of its
+// own, in one write transaction per batch. A batch is written when `batchSize` operations are
+// waiting, when the oldest of them has waited for `maxDelay` seconds, or when someone flushes.
+// Encoding needs the write transaction, since most values go into their own tables, so the
+// producers only queue references and the writer thread takes the GIL to encode each batch.
+// If a batch fails, its items are written one at a time, so only the items that fail are lost.
+// Their errors name the key, and are raised in the next call from the thread that queued them.
+//
+
+struct OOCWriter {
+    OOCMapObject* const ooc;
+    const size_t batchSize;
+    const double maxDelay;
+
+    // Starts the writer thread. Must be called with the GIL held. Throws std::system_error.
+    explicit OOCWriter(OOCMapObject* ooc, size_t batchSize, double maxDelay);
+    // Writes what is still queued and stops the writer thread. Must be called with the GIL held.
+    ~OOCWriter();
+
+    // These must be called with the GIL held. They throw OocError.
+    void enqueue(PyObject* key, PyObject* value);
+    void flush();
+    void close();
+    bool isClosed() const { return m_closed; }
+
+    struct Stats {
+        uint64_t ops;
+        uint64_t batches;
+        uint64_t maxBatch;
+        double totalSeconds;
+    };
+    Stats stats();
+
+private:
+    struct Item {
+        PyObject* key;
+        PyObject* value;
+        unsigned long threadId;
+    };
+    struct Error {
+        unsigned long threadId;
+        PyObject* type;
+        PyObject* value;
+        PyObject* traceback;
+    };
+
+    void run();
+    void applyBatch(std::vector<Item>& batch);
+    // Returns false and leaves a Python error set if the items could not be written.
+    bool write(const Item* begin, const Item* end);
+    // Turns the current Python error into one that names the item's key, and keeps it for the
+    // thread that queued the item.
+    void keepError(const Item& item);
+    void stop();
+    // Raises the first error of the calling thread, or of any thread if `anyThread` is set.
+    void raiseError(bool anyThread = false);
+    void checkNotBlocking() const;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeWriter;
+    std::condition_variable m_wakeProducers;
+
+    // These are protected by m_mutex.
+    std::vector<Item> m_queue;
+    std::chrono::steady_clock::time_point m_oldest;
+    uint64_t m_enqueued;
+    uint64_t m_applied;
+    uint64_t m_flushTarget;
+    bool m_stopping;
+    Stats m_stats;
+
+    // These are protected by the GIL.
+    bool m_closed;
+    std::vector<Error> m_errors;
+};
+
+
+//
+// OOCAsyncWriterObject
+//
+// The Python side of an OOCWriter, returned by `m.async_writer()`.
+//
+
+typedef struct {
+    PyObject_HEAD
+    OOCWriter* writer;
+} OOCAsyncWriterObject;
+
+extern PyTypeObject OOCAsyncWriterType;
+
+OOCAsyncWriterObject* OOCAsyncWriter_fastnew(OOCMapObject* ooc, size_t batchSize, double maxDelay);
+
+#endif //OOCMAP_WRITER_H